@@ -0,0 +1,285 @@
+#include "benchmark/benchmark.h"
+#include "hash_join.h"
+#include "predicate.h"
+#include "storage_layer.h"
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Benchmarks of the storage layer's main paths over generated tables:
+ *
+ *   storage_bench [--rows=10000,1000000,10000000] [--cache_frames=1024[,...]] [--scan_threads=1]
+ *                 [--bench_dir=DIR] [--benchmark_* flags]
+ *
+ * Every benchmark runs once per row count and buffer pool size. The tables for a row count are
+ * built the first time a benchmark needs them and removed on exit. Google Benchmark writes JSON
+ * with --benchmark_out=results.json --benchmark_out_format=json.
+ */
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr size_t INSERT_CHUNK_ROWS = 10000; // Rows per insert_batch and commit
+constexpr uint32_t GROUP_COUNT = 1000;      // Rows of the joined table, and distinct fact grp values
+constexpr uint32_t AMOUNT_RANGE = 100000;
+
+struct BenchConfig {
+    std::vector<size_t> rows = {10000, 1000000, 10000000};
+    std::vector<size_t> cache_frames = {DEFAULT_BUFFER_POOL_FRAMES};
+    size_t scan_threads = 1;
+    std::string dir = (fs::temp_directory_path() / "storage_bench").string();
+};
+
+BenchConfig config;
+
+const std::vector<ColumnSchema> FACT_SCHEMA = {
+    {"id", ColumnType::INT, INT_SIZE},
+    {"grp", ColumnType::INT, INT_SIZE},
+    {"amount", ColumnType::INT, INT_SIZE},
+    {"name", ColumnType::TEXT, 0}
+};
+const std::vector<ColumnSchema> GROUP_SCHEMA = {
+    {"grp", ColumnType::INT, INT_SIZE},
+    {"label", ColumnType::TEXT, 0}
+};
+
+// Row i of the fact table; a multiplicative hash spreads the amounts, so only id is in insert order
+std::vector<std::string> fact_row(size_t i) {
+    const uint32_t amount = static_cast<uint32_t>(i * 2654435761u) % AMOUNT_RANGE;
+    return {std::to_string(i), std::to_string(i % GROUP_COUNT), std::to_string(amount), "name" + std::to_string(i)};
+}
+
+StorageOptions options_for(size_t cache_frames) {
+    StorageOptions options;
+    options.buffer_pool_frames = cache_frames;
+    options.scan_threads = config.scan_threads;
+    return options;
+}
+
+/**
+ * Insert rows [0, count) of the fact table, a chunk per batch and commit. With a state, building
+ * the chunks is left out of its timing.
+ */
+void load_facts(FileStorageLayer& storage, size_t count, benchmark::State* state, std::vector<uint32_t>* ids) {
+    std::vector<std::vector<std::string>> chunk;
+    for (size_t start = 0; start < count; start += INSERT_CHUNK_ROWS) {
+        if (state) state->PauseTiming();
+        chunk.clear();
+        for (size_t i = start; i < std::min(count, start + INSERT_CHUNK_ROWS); ++i) chunk.push_back(fact_row(i));
+        if (state) state->ResumeTiming();
+        auto chunk_ids = storage.insert_batch("facts", chunk);
+        storage.commit();
+        if (ids) ids->insert(ids->end(), chunk_ids.begin(), chunk_ids.end());
+    }
+}
+
+struct Dataset {
+    std::string path;
+    std::vector<uint32_t> ids; // Record ids of the fact rows
+};
+
+// The fact and group tables for a row count, built on first use
+const Dataset& dataset(size_t rows) {
+    static std::map<size_t, Dataset> datasets;
+    auto it = datasets.find(rows);
+    if (it != datasets.end()) return it->second;
+    Dataset data;
+    data.path = (fs::path(config.dir) / ("rows_" + std::to_string(rows))).string();
+    fs::remove_all(data.path);
+    fs::create_directories(data.path);
+    FileStorageLayer storage;
+    storage.open(data.path);
+    storage.create("facts", FACT_SCHEMA);
+    storage.create("groups", GROUP_SCHEMA);
+    std::vector<std::vector<std::string>> groups;
+    for (uint32_t g = 0; g < GROUP_COUNT; ++g) groups.push_back({std::to_string(g), "group" + std::to_string(g)});
+    storage.insert_batch("groups", groups);
+    data.ids.reserve(rows);
+    load_facts(storage, rows, nullptr, &data.ids);
+    storage.close();
+    return datasets.emplace(rows, std::move(data)).first->second;
+}
+
+// A dataset opened with the benchmark's cache size for the length of one benchmark
+struct OpenDataset {
+    FileStorageLayer storage;
+    const Dataset& data;
+
+    OpenDataset(size_t rows, size_t cache_frames) : storage(options_for(cache_frames)), data(dataset(rows)) {
+        storage.open(data.path);
+    }
+    ~OpenDataset() { storage.close(); }
+};
+
+void report(benchmark::State& state, const BufferPoolStats& stats, size_t items_per_iteration, size_t rows, size_t cache_frames) {
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * items_per_iteration));
+    state.counters["rows"] = static_cast<double>(rows);
+    state.counters["cache_frames"] = static_cast<double>(cache_frames);
+    const uint64_t fetches = stats.hits + stats.misses;
+    state.counters["pool_hit_rate"] = fetches == 0 ? 0.0 : static_cast<double>(stats.hits) / fetches;
+}
+
+void bench_bulk_insert(benchmark::State& state, size_t rows, size_t cache_frames) {
+    const std::string path = (fs::path(config.dir) / "insert").string();
+    BufferPoolStats stats;
+    for (auto _ : state) {
+        state.PauseTiming();
+        fs::remove_all(path);
+        fs::create_directories(path);
+        FileStorageLayer storage(options_for(cache_frames));
+        storage.open(path);
+        storage.create("facts", FACT_SCHEMA);
+        state.ResumeTiming();
+        load_facts(storage, rows, &state, nullptr);
+        state.PauseTiming();
+        stats = storage.buffer_pool_stats();
+        storage.close();
+        state.ResumeTiming();
+    }
+    fs::remove_all(path);
+    report(state, stats, rows, rows, cache_frames);
+}
+
+void bench_point_lookup(benchmark::State& state, size_t rows, size_t cache_frames) {
+    OpenDataset db(rows, cache_frames);
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<size_t> pick(0, db.data.ids.size() - 1);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(db.storage.get("facts", db.data.ids[pick(rng)]));
+    }
+    report(state, db.storage.buffer_pool_stats(), 1, rows, cache_frames);
+}
+
+// WHERE amount < 10% of the range, so about a tenth of the rows qualify
+void bench_scan_filter(benchmark::State& state, size_t rows, size_t cache_frames) {
+    OpenDataset db(rows, cache_frames);
+    PredicateProgram where({FilterClause{2, "<", std::to_string(AMOUNT_RANGE / 10)}}, FACT_SCHEMA);
+    ScanSpec spec;
+    spec.where = &where;
+    for (auto _ : state) {
+        auto result = db.storage.scan("facts", spec);
+        benchmark::DoNotOptimize(result.size());
+    }
+    report(state, db.storage.buffer_pool_stats(), rows, rows, cache_frames);
+}
+
+// SELECT id, amount ORDER BY amount DESC LIMIT 100
+void bench_order_by_limit(benchmark::State& state, size_t rows, size_t cache_frames) {
+    OpenDataset db(rows, cache_frames);
+    ScanSpec spec;
+    spec.projection = std::vector<int>{0, 2};
+    spec.order_by = std::vector<std::pair<int, bool>>{{1, false}};
+    spec.limit = 100;
+    for (auto _ : state) {
+        auto result = db.storage.scan("facts", spec);
+        benchmark::DoNotOptimize(result.size());
+    }
+    report(state, db.storage.buffer_pool_stats(), rows, rows, cache_frames);
+}
+
+void bench_sum(benchmark::State& state, size_t rows, size_t cache_frames) {
+    OpenDataset db(rows, cache_frames);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(db.storage.aggregate("facts", 2).sum);
+    }
+    report(state, db.storage.buffer_pool_stats(), rows, rows, cache_frames);
+}
+
+// facts JOIN groups ON grp, handing over facts.amount and groups.label
+void bench_join(benchmark::State& state, size_t rows, size_t cache_frames) {
+    OpenDataset db(rows, cache_frames);
+    for (auto _ : state) {
+        size_t matches = 0;
+        HashJoin join(db.storage, JoinInput{"facts", 1, {2}, nullptr}, JoinInput{"groups", 0, {1}, nullptr});
+        join.run([&matches](const HashJoin::Values&, const HashJoin::Values&) { ++matches; });
+        benchmark::DoNotOptimize(matches);
+    }
+    report(state, db.storage.buffer_pool_stats(), rows, rows, cache_frames);
+}
+
+struct BenchSpec {
+    const char* name;
+    void (*run)(benchmark::State& state, size_t rows, size_t cache_frames);
+    benchmark::TimeUnit unit;
+};
+
+const BenchSpec BENCHMARKS[] = {
+    {"bulk_insert", bench_bulk_insert, benchmark::kMillisecond},
+    {"point_lookup", bench_point_lookup, benchmark::kMicrosecond},
+    {"scan_filter", bench_scan_filter, benchmark::kMillisecond},
+    {"order_by_limit", bench_order_by_limit, benchmark::kMillisecond},
+    {"sum", bench_sum, benchmark::kMillisecond},
+    {"join", bench_join, benchmark::kMillisecond},
+};
+
+std::vector<size_t> parse_sizes(const std::string& list) {
+    std::vector<size_t> sizes;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) sizes.push_back(std::stoull(item));
+    }
+    if (sizes.empty()) throw std::invalid_argument("empty list: " + list);
+    return sizes;
+}
+
+// Take this program's flags out of argv, leaving the rest to Google Benchmark
+void parse_flags(int& argc, char** argv) {
+    int kept = 1;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto is_flag = [&arg](const char* flag) { return arg.rfind(flag, 0) == 0; };
+        const std::string value = arg.substr(arg.find('=') + 1);
+        if (is_flag("--rows=")) {
+            config.rows = parse_sizes(value);
+        } else if (is_flag("--cache_frames=")) {
+            config.cache_frames = parse_sizes(value);
+        } else if (is_flag("--scan_threads=")) {
+            config.scan_threads = std::max<size_t>(1, std::stoull(value));
+        } else if (is_flag("--bench_dir=")) {
+            config.dir = value;
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    argc = kept;
+}
+
+void register_benchmarks() {
+    for (const BenchSpec& spec : BENCHMARKS) {
+        for (size_t rows : config.rows) {
+            for (size_t frames : config.cache_frames) {
+                const std::string name = std::string(spec.name) + "/rows:" + std::to_string(rows) + "/frames:" + std::to_string(frames);
+                auto run = spec.run;
+                benchmark::RegisterBenchmark(name.c_str(), [run, rows, frames](benchmark::State& state) { run(state, rows, frames); })
+                    ->Unit(spec.unit)
+                    ->UseRealTime();
+            }
+        }
+    }
+}
+}
+
+int main(int argc, char** argv) {
+    try {
+        parse_flags(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << "Invalid argument: " << e.what() << std::endl;
+        return 1;
+    }
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    register_benchmarks();
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    fs::remove_all(config.dir);
+    return 0;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <sys/types.h>
+#include <vector>
+
+constexpr unsigned ASYNC_IO_QUEUE_DEPTH = 64; // Transfers in flight at once per file
+constexpr size_t ASYNC_IO_THREADS = 4;        // Workers of the thread-pool backend
+
+enum class IoBackend : uint8_t {
+    Auto = 0,   // io_uring when the kernel allows it, else threads
+    Uring = 1,  // io_uring only; creating it throws where it is unavailable
+    Threads = 2 // Blocking pread/pwrite on a small thread pool
+};
+
+/**
+ * One positioned transfer. done gets the bytes moved (size unless the read hit the end of the file)
+ * or -errno, and may run on another thread.
+ */
+struct IoRequest {
+    bool write = false;
+    uint64_t offset = 0;
+    uint8_t* buffer = nullptr; // Only read from for writes
+    size_t size = 0;
+    std::function<void(ssize_t result)> done;
+};
+
+/**
+ * Asynchronous reads and writes against one file descriptor, which must outlive the object.
+ * The io_uring backend drives the ring through raw system calls and completes requests on its own
+ * thread; the fallback runs each request on a thread pool. Callbacks must not submit more I/O;
+ * the destructor waits for everything in flight.
+ */
+class AsyncIo {
+public:
+    virtual ~AsyncIo() = default;
+
+    // Start every request, in order; blocks only while the queue is full
+    virtual void submit(std::vector<IoRequest> requests) = 0;
+    virtual const char* backend() const = 0;
+
+    // Run the requests and wait for all of them; their callbacks are replaced. Returns each result.
+    std::vector<ssize_t> run(std::vector<IoRequest> requests);
+
+    // @throws std::runtime_error if IoBackend::Uring was asked for and the kernel refuses a ring
+    static std::unique_ptr<AsyncIo> create(int fd, IoBackend backend = IoBackend::Auto, unsigned depth = ASYNC_IO_QUEUE_DEPTH);
+};
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "buffer_pool.h"
+#include "row_view.h"
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+constexpr uint32_t BTREE_MAX_KEY_SIZE = 512;
+// Each node is stored as a single record in an ordinary slotted page
+constexpr uint32_t BTREE_NODE_RECORD_ID = 0;
+constexpr uint32_t BTREE_NODE_CAPACITY = PAGE_DATA_CAPACITY - sizeof(Slot);
+
+struct BTreeNodeHeader {
+    uint8_t is_leaf;
+    uint8_t reserved;
+    uint16_t entry_count;
+    uint32_t next_leaf;   // Right sibling of a leaf, INVALID_PAGE_ID at the end
+    uint32_t first_child; // Internal nodes: child holding every entry below the first separator
+};
+
+// Encoded key bounds; a missing bound is open
+struct KeyRange {
+    std::optional<std::string> lower;
+    bool lower_inclusive = true;
+    std::optional<std::string> upper;
+    bool upper_inclusive = true;
+};
+
+/**
+ * Disk-resident B+-tree over the pages of a BufferPool, mapping a column value to record ids.
+ * Entries are ordered by (key, record id), so duplicate keys are allowed and every entry is unique.
+ * INT keys are compared as integers and TEXT keys bytewise. Deletes do not merge underfull nodes.
+ * Callers serialize writers; readers may run concurrently with each other.
+ */
+class BTreeIndex {
+public:
+    using PageAllocator = std::function<uint32_t()>;
+    // Called on every node page after it changes
+    using PageHook = std::function<void(Page& page)>;
+
+    BTreeIndex(BufferPool& pool, ColumnType key_type, uint32_t root_page_id, PageAllocator allocate, PageHook on_change = nullptr) :
+        pool_(pool), key_type_(key_type), root_page_id_(root_page_id), allocate_(std::move(allocate)), on_change_(std::move(on_change)) {}
+
+    /**
+     * Allocate an empty tree.
+     * @return Root page id to pass to the constructor
+     */
+    static uint32_t create(BufferPool& pool, const PageAllocator& allocate, const PageHook& on_change = nullptr);
+
+    // Key bytes of a value in the text form used by get() and insert()
+    static std::string encode_key(ColumnType type, const std::string& value);
+    // Key bytes of a field, read in place
+    static std::string key_of(const RowView& row, size_t column);
+
+    /**
+     * @throws std::runtime_error if the key is longer than BTREE_MAX_KEY_SIZE
+     */
+    void insert(std::string_view key, uint32_t record_id);
+    // Returns false when the entry was not in the tree
+    bool remove(std::string_view key, uint32_t record_id);
+
+    // Record ids whose keys fall in the range, in key order
+    std::vector<uint32_t> range(const KeyRange& range) const;
+
+    uint32_t root_page_id() const { return root_page_id_; }
+    ColumnType key_type() const { return key_type_; }
+
+    static int compare_keys(ColumnType type, std::string_view a, std::string_view b);
+    static bool in_range(ColumnType type, const KeyRange& range, std::string_view key);
+
+private:
+    struct Entry {
+        std::string key;
+        uint32_t record_id;
+        uint32_t child; // Internal nodes: subtree holding entries from this separator up to the next
+    };
+    struct Node {
+        bool is_leaf = true;
+        uint32_t next_leaf = INVALID_PAGE_ID;
+        uint32_t first_child = INVALID_PAGE_ID;
+        std::vector<Entry> entries;
+    };
+    // A node read in place: only entry offsets are decoded, so lookups and small edits skip copying keys
+    struct NodeView {
+        BTreeNodeHeader header;
+        const uint8_t* data = nullptr; // Start of the node record
+        size_t size = 0;
+        std::vector<uint16_t> offsets; // Entry starts, plus the end of the last entry
+
+        size_t count() const { return header.entry_count; }
+        std::string_view key(size_t i) const;
+        uint32_t record_id(size_t i) const;
+        // Child of an internal node at a slot from child_slot()
+        uint32_t child(size_t slot) const;
+    };
+
+    BufferPool& pool_;
+    ColumnType key_type_;
+    uint32_t root_page_id_;
+    PageAllocator allocate_;
+    PageHook on_change_;
+
+    int compare(std::string_view a, std::string_view b) const { return compare_keys(key_type_, a, b); }
+    static Node read_node(const Page& page);
+    static NodeView view_node(const Page& page);
+    static std::vector<uint8_t> encode_node(const Node& node);
+    void write_node(Page& page, const Node& node) const;
+    void write_bytes(Page& page, const std::vector<uint8_t>& bytes) const;
+    int compare_entry(std::string_view key, uint32_t record_id, const NodeView& node, size_t i) const;
+    // Number of entries at or before (key, record_id); for internal nodes, the slot of the covering child
+    size_t child_slot(const NodeView& node, std::string_view key, uint32_t record_id) const;
+    // Root-to-leaf page ids for (key, record_id)
+    std::vector<uint32_t> find_path(std::string_view key, uint32_t record_id, PageLatch latch) const;
+};
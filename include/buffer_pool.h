@@ -0,0 +1,194 @@
+#pragma once
+
+#include "frame_allocator.h"
+#include "page.h"
+#include <cstddef>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+constexpr size_t DEFAULT_BUFFER_POOL_FRAMES = 1024;
+constexpr size_t BUFFER_POOL_MAX_SHARDS = 16;
+constexpr size_t BUFFER_POOL_MIN_SHARD_FRAMES = 64; // Smaller pools use fewer shards so pins cannot strand a shard
+
+// Page latch a guard holds on top of its pin
+enum class PageLatch : uint8_t {
+    None = 0,      // Pin only; the caller synchronizes access itself
+    Shared = 1,    // Readers
+    Exclusive = 2  // Writers
+};
+
+struct BufferPoolStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t dirty_writebacks = 0;
+    uint64_t prefetches = 0; // Pages read ahead of a fetch
+    uint64_t background_writes = 0; // Dirty pages written by write_back()
+};
+
+class BufferPool;
+
+/**
+ * RAII pin on a buffer pool frame, optionally holding the frame's latch.
+ * The page stays resident until the guard is released or destroyed.
+ */
+class PageGuard {
+public:
+    PageGuard() = default;
+    PageGuard(BufferPool* pool, size_t frame_id, Page* page, std::shared_mutex* latch, PageLatch mode) :
+        pool_(pool), frame_id_(frame_id), page_(page), latch_(latch), mode_(mode) {}
+    PageGuard(const PageGuard&) = delete;
+    PageGuard& operator=(const PageGuard&) = delete;
+    PageGuard(PageGuard&& other) noexcept;
+    PageGuard& operator=(PageGuard&& other) noexcept;
+    ~PageGuard() { release(); }
+
+    Page* operator->() const { return page_; }
+    Page& operator*() const { return *page_; }
+    Page* get() const { return page_; }
+    explicit operator bool() const { return page_ != nullptr; }
+
+    void release();
+
+private:
+    BufferPool* pool_ = nullptr;
+    size_t frame_id_ = 0;
+    Page* page_ = nullptr;
+    std::shared_mutex* latch_ = nullptr;
+    PageLatch mode_ = PageLatch::None;
+};
+
+/**
+ * Fixed-size pool of page frames with pin counts and CLOCK replacement. Page images live in one
+ * FrameAllocator mapping made when the pool is built.
+ * Dirty victims are written back through the writer callback before their frame is reused.
+ * Frames are split into shards by page id, each with its own page table, CLOCK hand and mutex, so
+ * threads touching different pages rarely contend. Every frame also has a reader/writer latch that a
+ * guard can hold while it uses the page; latches are taken after the shard mutex is dropped.
+ * With an async reader, prefetch() puts pages in the page table before their bytes arrive; a fetch
+ * that finds such a frame waits for its read to land.
+ * Each shard lists the frames left dirty when unpinned, oldest first, so flushing and background
+ * write-back visit those rather than the whole page table.
+ */
+class BufferPool {
+public:
+    // Fills the page from disk; returns false when the page does not exist
+    using PageReader = std::function<bool(uint32_t page_id, Page& page)>;
+    using PageWriter = std::function<void(Page& page)>;
+    // Writes a batch of dirty pages and clears their dirty flags
+    using PageBatchWriter = std::function<void(const std::vector<Page*>& pages)>;
+    // loaded is false when the page does not exist or could not be read
+    struct PendingRead {
+        uint32_t page_id;
+        Page* page;
+        std::function<void(bool loaded)> done;
+    };
+    // Starts filling each page and returns; done must run exactly once per read, from any thread
+    using AsyncPageReader = std::function<void(std::vector<PendingRead> reads)>;
+
+    /**
+     * @param shards Number of shards; 0 picks one per BUFFER_POOL_MIN_SHARD_FRAMES frames, up to BUFFER_POOL_MAX_SHARDS
+     */
+    BufferPool(size_t capacity, PageReader reader, PageWriter writer, size_t shards = 0);
+
+    void set_async_reader(AsyncPageReader reader) { async_reader_ = std::move(reader); }
+    void set_batch_writer(PageBatchWriter writer) { batch_writer_ = std::move(writer); }
+
+    /**
+     * Pin a page, loading it through the reader on a miss, then take the requested latch.
+     * @throws std::runtime_error if the page does not exist or every frame of its shard is pinned
+     */
+    PageGuard fetch_page(uint32_t page_id, PageLatch latch = PageLatch::None);
+
+    /**
+     * Pin a frame holding a fresh, dirty page with the given id, replacing any cached copy.
+     * The guard holds the page exclusively.
+     */
+    PageGuard create_page(uint32_t page_id, uint32_t id_range_start);
+
+    /**
+     * Start async reads of the pages that are not resident. Only a hint: without an async reader, or
+     * when a shard has no frame to spare, pages are skipped.
+     */
+    void prefetch(const uint32_t* page_ids, size_t count);
+
+    /**
+     * Writes back every dirty page, holding each one's latch shared while it is written. With a batch
+     * writer the pages go out together, all latched at once, so callers must keep writers out meanwhile.
+     */
+    void flush_all();
+    /**
+     * Writes back up to max_pages listed dirty pages that nobody has pinned, oldest first, holding
+     * each one's latch shared while it is written; for a background writer. It pins at most half of
+     * a shard at once, and fetches that find the rest pinned wait for it instead of failing. Pages
+     * latched by someone else meanwhile are left for a later call. Returns the pages picked.
+     */
+    size_t write_back(size_t max_pages);
+    // Waits for reads in flight, then drops every unpinned frame without writing it back
+    void clear();
+
+    size_t capacity() const { return frames_.size(); }
+    bool huge_pages() const { return images_.huge_pages(); }
+    size_t shard_count() const { return shards_.size(); }
+    size_t resident_pages() const;
+    BufferPoolStats stats() const;
+    void reset_stats();
+
+private:
+    friend class PageGuard;
+
+    struct Frame {
+        explicit Frame(PageImage& image) : page(image) {}
+
+        Page page;
+        uint32_t page_id = INVALID_PAGE_ID;
+        uint32_t pin_count = 0;
+        bool referenced = false;
+        bool loading = false; // Pinned by a fetch or prefetch whose read has not landed yet
+        bool listed = false;  // In its shard's dirty list
+        size_t shard = 0;
+        std::shared_mutex latch;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<uint32_t, size_t> page_table;
+        std::vector<size_t> free_frames;
+        std::deque<size_t> dirty_frames; // May hold frames since cleaned or reused; they are skipped
+        size_t first_frame = 0;
+        size_t frame_count = 0;
+        size_t clock_hand = 0;
+        size_t loads = 0;  // Frames still loading
+        size_t writes = 0; // Frames pinned only while they are written back
+        std::condition_variable loaded; // Signalled when a load or a write finishes
+        BufferPoolStats stats;
+    };
+
+    FrameAllocator images_;
+    std::deque<Frame> frames_; // Never resized, so frames stay put
+    std::vector<Shard> shards_;
+    PageReader reader_;
+    PageWriter writer_;
+    AsyncPageReader async_reader_;
+    PageBatchWriter batch_writer_;
+
+    Shard& shard_for(uint32_t page_id) { return shards_[page_id % shards_.size()]; }
+    PageGuard make_guard(size_t frame_id, PageLatch latch);
+    // Caller holds shard.mutex through lock. It is released while a dirty victim is written and
+    // while waiting for writes to let frames go, so callers look the page up again afterwards.
+    size_t acquire_frame(Shard& shard, std::unique_lock<std::mutex>& lock);
+    void unpin(size_t frame_id);
+    // Caller holds the frame's shard mutex
+    void list_if_dirty(Shard& shard, size_t frame_id);
+    // Writes pinned frames back, unpins them and ends the writes counted for them; with a batch
+    // writer, in one batch. Without wait_for_latches, frames latched elsewhere are skipped and listed again.
+    void write_frames(const std::vector<size_t>& frame_ids, bool wait_for_latches);
+    void write_pinned(const std::vector<size_t>& frame_ids, bool wait_for_latches);
+    void finish_load(size_t frame_id, bool loaded);
+};
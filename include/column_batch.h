@@ -0,0 +1,105 @@
+#pragma once
+
+#include "page_ref.h"
+#include "read_ahead.h"
+#include "row_view.h"
+#include "storage_counters.h"
+#include "toast.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+constexpr size_t BATCH_CAPACITY = 1024; // Rows per batch; selection indexes fit in 16 bits
+
+enum class CompareOp : uint8_t { Eq, Ne, Lt, Le, Gt, Ge };
+
+/**
+ * Up to BATCH_CAPACITY rows of a table, stored column by column. Only the columns the scan asked
+ * for are filled: INT columns as int32_t vectors, TEXT columns as views into the rows' pages, or
+ * into the cursor's copies of values stored out of line.
+ */
+struct ColumnBatch {
+    size_t size = 0;
+    std::vector<uint32_t> record_ids;
+    std::vector<std::vector<int32_t>> ints;            // Indexed by table column; empty unless loaded
+    std::vector<std::vector<std::string_view>> texts;  // Valid until the cursor moves on
+    // For a TEXT column a PAX page dictionary-encodes: each row's code and the entries they index.
+    // Empty otherwise; texts is filled either way
+    std::vector<std::vector<uint8_t>> codes;
+    std::vector<std::vector<std::string_view>> dictionaries;
+
+    // Text form of row i's loaded columns, as returned by get() and scan()
+    std::vector<std::string> to_strings(size_t row, const std::vector<int>& columns) const;
+};
+
+/**
+ * Pull-based scan that decodes heap pages into ColumnBatches, in page order.
+ * Batches of INT columns span pages; once a TEXT column is loaded a batch stops at the end of its
+ * page, which stays pinned until the next call to next(). The same lifetime rules as ScanCursor apply.
+ * Rows of a PAX page are decoded a minipage at a time rather than row by row. Given counters, it adds
+ * the rows and bytes it decoded to them on close().
+ */
+class BatchCursor {
+public:
+    using PageFetcher = std::function<PageRef(uint32_t page_id)>;
+
+    BatchCursor() = default;
+    BatchCursor(const ColumnSchema* columns, uint32_t column_count, std::vector<int> load_columns,
+        std::vector<uint32_t> page_ids, PageFetcher fetch_page, ReadAhead read_ahead = ReadAhead(),
+        StorageCounters* counters = nullptr);
+    BatchCursor(BatchCursor&&) = default;
+    BatchCursor& operator=(BatchCursor&&) = default;
+
+    /**
+     * Fill the batch with the next rows.
+     * @return false once the scan is exhausted
+     */
+    bool next(ColumnBatch& batch);
+
+    const std::vector<int>& columns() const { return load_columns_; }
+    void close();
+
+private:
+    const ColumnSchema* columns_ = nullptr;
+    uint32_t column_count_ = 0;
+    std::vector<int> load_columns_;
+    bool loads_text_ = false;
+    std::vector<uint32_t> page_ids_;
+    size_t next_page_ = 0;
+    PageFetcher fetch_page_;
+    ReadAhead read_ahead_;
+    PageRef page_;
+    size_t slot_index_ = 0;
+    ToastReader toast_;
+    StorageCounters* counters_ = nullptr;
+    ScanTally tally_;
+
+    void load_pax_rows(ColumnBatch& batch);
+};
+
+// Selection kernels: write the indexes of rows whose value passes `value op rhs`, return the count.
+// `out` needs room for `count` (or `selected`) entries and may alias `selection`.
+size_t select_int(const int32_t* values, size_t count, CompareOp op, int32_t rhs, uint16_t* out);
+size_t refine_int(const int32_t* values, const uint16_t* selection, size_t selected, CompareOp op, int32_t rhs, uint16_t* out);
+
+// Copy the selected values into `out`, densely
+void gather_int(const int32_t* values, const uint16_t* selection, size_t selected, int32_t* out);
+
+// Aggregate kernels over dense values; min and max of an empty input are INT32_MAX and INT32_MIN
+int64_t sum_int(const int32_t* values, size_t count);
+int32_t min_int(const int32_t* values, size_t count);
+int32_t max_int(const int32_t* values, size_t count);
+
+// COUNT, SUM, MIN and MAX of one column, built up a batch at a time
+struct AggregateResult {
+    uint64_t count = 0;
+    int64_t sum = 0;
+    int32_t min = INT32_MAX;
+    int32_t max = INT32_MIN;
+
+    void add(const int32_t* values, size_t count);
+    void merge(const AggregateResult& other);
+};
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "async_io.h"
+#include "page.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+constexpr char PAGE_FILE_PREFIX[] = "page_";
+constexpr char PAGE_FILE_EXTENSION[] = ".dat";
+constexpr char SEGMENT_FILE_NAME[] = "segment.db";
+
+// On-disk layout of a storage directory
+enum class DiskLayout : uint8_t {
+    SingleFile = 0, // All pages in one segment file at offset page_id * PAGE_SIZE
+    PagePerFile = 1 // Legacy layout: one page_<id>.dat file per page
+};
+
+// A page read started by read_pages_async; done(found) may run on another thread
+struct PageRead {
+    uint32_t page_id;
+    uint8_t* buffer;
+    std::function<void(bool found)> done; // False for a page never written or a failed read
+};
+
+struct PageWrite {
+    uint32_t page_id;
+    const uint8_t* buffer;
+};
+
+/**
+ * Page-granular I/O against a storage directory. Buffers are always PAGE_SIZE bytes.
+ */
+class DiskManager {
+public:
+    virtual ~DiskManager() = default;
+
+    /**
+     * Read a page into buffer.
+     * @return false if the page has never been written
+     */
+    virtual bool read_page(uint32_t page_id, uint8_t* buffer) = 0;
+    virtual void write_page(uint32_t page_id, const uint8_t* buffer) = 0;
+    // Make every completed write durable
+    virtual void sync() = 0;
+    virtual DiskLayout layout() const = 0;
+
+    // Whether read_pages_async overlaps reads with the caller; the default reads them in place
+    virtual bool async_reads() const { return false; }
+    // Start the reads and return. A read that throws reports found = false.
+    virtual void read_pages_async(std::vector<PageRead> reads);
+    // Write every page, several at a time where the backend can; returns once all are written
+    virtual void write_pages(const std::vector<PageWrite>& writes);
+
+    /**
+     * Open the storage directory at path, keeping the layout it already uses.
+     * A fresh directory gets preferred_layout; a segment file does its batched I/O through io.
+     */
+    static std::unique_ptr<DiskManager> open(const std::string& path, DiskLayout preferred_layout, IoBackend io = IoBackend::Auto);
+};
+
+class PagePerFileDiskManager : public DiskManager {
+public:
+    explicit PagePerFileDiskManager(std::string path) : path_(std::move(path)) {}
+
+    bool read_page(uint32_t page_id, uint8_t* buffer) override;
+    void write_page(uint32_t page_id, const uint8_t* buffer) override;
+    void sync() override {}
+    DiskLayout layout() const override { return DiskLayout::PagePerFile; }
+
+private:
+    std::string path_;
+
+    std::string get_page_path(uint32_t page_id) const;
+};
+
+/**
+ * Single segment file addressed by page_id * PAGE_SIZE through one persistent descriptor and pread/pwrite.
+ * Read-ahead and batched write-back go through an AsyncIo queue on the same descriptor.
+ */
+class SegmentDiskManager : public DiskManager {
+public:
+    explicit SegmentDiskManager(const std::string& path, IoBackend io = IoBackend::Auto);
+    ~SegmentDiskManager() override;
+    SegmentDiskManager(const SegmentDiskManager&) = delete;
+    SegmentDiskManager& operator=(const SegmentDiskManager&) = delete;
+
+    bool read_page(uint32_t page_id, uint8_t* buffer) override;
+    void write_page(uint32_t page_id, const uint8_t* buffer) override;
+    void sync() override;
+    DiskLayout layout() const override { return DiskLayout::SingleFile; }
+    bool async_reads() const override { return true; }
+    void read_pages_async(std::vector<PageRead> reads) override;
+    // @throws std::runtime_error naming the first page that could not be written
+    void write_pages(const std::vector<PageWrite>& writes) override;
+
+    const char* io_backend() const { return io_->backend(); }
+
+private:
+    int fd_ = -1;
+    std::atomic<uint64_t> file_size_{0}; // Pages are read and written from several threads
+    std::unique_ptr<AsyncIo> io_;        // Drained by the destructor before the descriptor closes
+
+    void grow_to(uint64_t end);
+};
+
+/**
+ * Read-only view of a segment file mapped into memory. Heap pages can be read straight from
+ * page_image() without a copy; read_page() copies out of the mapping for the buffer pool.
+ * The mapping covers the file as it was opened, so nothing may write to the file meanwhile.
+ */
+class MappedSegmentDiskManager : public DiskManager {
+public:
+    // @throws std::runtime_error if the file is missing or cannot be mapped
+    explicit MappedSegmentDiskManager(const std::string& path);
+    ~MappedSegmentDiskManager() override;
+    MappedSegmentDiskManager(const MappedSegmentDiskManager&) = delete;
+    MappedSegmentDiskManager& operator=(const MappedSegmentDiskManager&) = delete;
+
+    bool read_page(uint32_t page_id, uint8_t* buffer) override;
+    // @throws std::runtime_error always; the mapping is read-only
+    void write_page(uint32_t page_id, const uint8_t* buffer) override;
+    void sync() override {}
+    DiskLayout layout() const override { return DiskLayout::SingleFile; }
+
+    // The page's PAGE_SIZE bytes inside the mapping, or nullptr past the end of the file
+    const uint8_t* page_image(uint32_t page_id) const {
+        const uint64_t offset = static_cast<uint64_t>(page_id) * PAGE_SIZE;
+        return offset + PAGE_SIZE <= size_ ? base_ + offset : nullptr;
+    }
+    // Ask the kernel to start paging these pages in; consecutive ids share one call
+    void will_need(const uint32_t* page_ids, size_t count) const;
+
+private:
+    const uint8_t* base_ = nullptr;
+    uint64_t size_ = 0;
+};
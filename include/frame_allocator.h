@@ -0,0 +1,31 @@
+#pragma once
+
+#include "page.h"
+#include <cstddef>
+
+constexpr size_t HUGE_PAGE_SIZE = 2 << 20;
+
+/**
+ * Page-aligned PAGE_SIZE frames carved out of one anonymous mapping made up front, so a buffer pool
+ * never allocates per page. The mapping asks for explicit huge pages first; when none are reserved it
+ * falls back to ordinary pages and advises the kernel to back them with transparent huge pages.
+ */
+class FrameAllocator {
+public:
+    // @throws std::runtime_error if the mapping cannot be made
+    explicit FrameAllocator(size_t frames);
+    ~FrameAllocator();
+    FrameAllocator(const FrameAllocator&) = delete;
+    FrameAllocator& operator=(const FrameAllocator&) = delete;
+
+    PageImage& frame(size_t index) const { return frames_[index]; }
+    size_t size() const { return count_; }
+    // True when the frames sit on explicitly reserved huge pages
+    bool huge_pages() const { return huge_pages_; }
+
+private:
+    PageImage* frames_ = nullptr;
+    size_t count_ = 0;
+    size_t bytes_ = 0;
+    bool huge_pages_ = false;
+};
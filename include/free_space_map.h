@@ -0,0 +1,44 @@
+#pragma once
+
+#include "page_chain.h"
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+constexpr uint32_t FSM_BUCKET_BYTES = 32;
+constexpr uint32_t FSM_MAX_BUCKET = 255;
+
+/**
+ * Free-space map of a table: one byte per id block holding the owning page's reclaimable space
+ * in FSM_BUCKET_BYTES units. A max-tree over the buckets finds the first page with room in
+ * O(log pages); the buckets are persisted to a chain of dedicated FSM pages.
+ */
+class FreeSpaceMap {
+public:
+    static uint8_t bucket_for(uint32_t free_bytes);
+
+    void set(uint32_t block, uint32_t free_bytes);
+    uint8_t bucket(uint32_t block) const { return block < buckets_.size() ? buckets_[block] : 0; }
+
+    /**
+     * Find the lowest block whose page is known to have at least required_bytes of room.
+     */
+    std::optional<uint32_t> find_block(uint32_t required_bytes) const;
+
+    size_t block_count() const { return buckets_.size(); }
+    bool is_dirty() const { return dirty_; }
+
+    void load(DiskManager& disk, uint32_t head_page_id);
+    uint32_t save(DiskManager& disk, const std::function<uint32_t()>& allocate_page);
+
+private:
+    std::vector<uint8_t> buckets_;
+    // tree_[1] is the root, leaves start at leaf_capacity_; each node holds the max bucket below it
+    std::vector<uint8_t> tree_;
+    size_t leaf_capacity_ = 0;
+    std::vector<uint32_t> storage_pages_;
+    bool dirty_ = false;
+
+    void rebuild_tree(size_t min_leaves);
+};
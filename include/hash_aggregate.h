@@ -0,0 +1,72 @@
+#pragma once
+
+#include "column_batch.h"
+#include "row_view.h"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+enum class AggregateFn : uint8_t { Count, Sum, Min, Max, Avg };
+
+// COUNT, SUM, MIN, MAX or AVG in any case; nullopt for other functions
+std::optional<AggregateFn> parse_aggregate_fn(const std::string& name);
+
+struct AggregateSpec {
+    AggregateFn fn;
+    int column; // Input column, or -1 for COUNT(*)
+};
+
+/**
+ * GROUP BY as a hash aggregate. Each group is found by its group values packed into a byte key and
+ * holds one typed AggregateResult per aggregate. Inputs are column batches with a selection vector,
+ * or decoded rows for operators that only produce text (joins). Scan workers each fill their own
+ * HashAggregate and merge() combines the partials. Without group columns every row lands in one
+ * group, whose values are folded with the batch kernels.
+ */
+class HashAggregate {
+public:
+    /**
+     * @param types Column types of the input, indexed like its columns
+     * @throws std::runtime_error for an invalid column, or SUM, MIN, MAX or AVG over a TEXT column
+     */
+    HashAggregate(std::vector<ColumnType> types, std::vector<int> group_columns, std::vector<AggregateSpec> aggregates);
+
+    // Columns a batch must have loaded
+    std::vector<int> columns() const;
+    const std::vector<int>& group_columns() const { return group_columns_; }
+    ColumnType type(int column) const { return types_[column]; }
+
+    void add(const ColumnBatch& batch, const uint16_t* selection, size_t selected);
+    void add(const std::vector<std::string_view>& row);
+    void merge(HashAggregate&& other);
+
+    size_t group_count() const { return groups_.size(); }
+    /**
+     * One row per group: its group values, then each aggregate. MIN, MAX and AVG over no rows are "NULL";
+     * with no group columns there is always exactly one row.
+     */
+    std::vector<std::vector<std::string>> rows() const;
+
+private:
+    struct Group {
+        std::string key;
+        std::vector<std::string> values;
+        std::vector<AggregateResult> results;
+    };
+
+    std::vector<ColumnType> types_;
+    std::vector<int> group_columns_;
+    std::vector<AggregateSpec> aggregates_;
+    std::unordered_map<std::string, uint32_t> index_; // Packed group values -> group
+    std::vector<Group> groups_;
+    std::string key_;
+    std::vector<uint32_t> row_groups_; // Group of each selected batch row
+    std::vector<int32_t> gathered_;
+
+    // Index of the group with this key; `inserted` says whose values the caller must fill in
+    uint32_t group_for(const std::string& key, bool& inserted);
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "query_arena.h"
+#include "spill_file.h"
+#include "storage_layer.h"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+constexpr size_t HASH_JOIN_MEMORY_BUDGET = 64 << 20; // Build-side bytes kept in memory before partitioning
+constexpr uint32_t HASH_JOIN_RADIX_BITS = 6;          // Spilled joins split both inputs into 2^bits partitions
+
+// One input of a join
+struct JoinInput {
+    std::string table;
+    int key_column;
+    std::vector<int> columns;                          // Columns to hand to the caller, in this order
+    std::shared_ptr<const PredicateProgram> filter;    // WHERE clauses on this table alone, applied while scanning
+};
+
+struct HashJoinStats {
+    bool build_left = false;
+    size_t build_rows = 0;
+    size_t probe_rows = 0;
+    size_t partitions = 0;    // 0 when the build side fit in memory
+    size_t spilled_bytes = 0;
+    std::chrono::nanoseconds build_time{0}; // Reading the build side into the hash table, or into its partitions
+    std::chrono::nanoseconds probe_time{0}; // Everything after: the probe side, and each partition pair when spilled
+};
+
+/**
+ * Equi-join of two tables. The input with fewer rows is the build side; both are read as column
+ * batches with their filters pushed into the scan, and only the key and the requested columns are
+ * kept. Keys join as int32 when both columns are INT, otherwise by their printed values.
+ * When the build side outgrows the memory budget, both inputs are radix-partitioned on the key hash
+ * into temporary files and joined one partition pair at a time.
+ */
+class HashJoin {
+public:
+    // Values stay valid only during the call; INT values are printed into the join's arenas, TEXT values
+    // point into the tuple they came from
+    using Values = std::vector<std::string_view>;
+    using Emit = std::function<void(const Values& left, const Values& right)>;
+
+    HashJoin(FileStorageLayer& storage, JoinInput left, JoinInput right, size_t memory_budget = HASH_JOIN_MEMORY_BUDGET);
+
+    // Call emit with the requested columns of every matching pair
+    void run(const Emit& emit);
+
+    const HashJoinStats& stats() const { return stats_; }
+
+private:
+    // Build side held in memory: tuples packed in one arena, chained by key hash
+    struct HashTable {
+        std::vector<uint8_t> arena;
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> next;
+        std::vector<uint32_t> buckets;
+        std::vector<uint64_t> hashes;
+
+        void add(const uint8_t* tuple, size_t size, uint64_t hash);
+        void finish(); // Size the buckets and link the chains
+        void clear();
+        size_t memory() const { return arena.size() + offsets.size() * (2 * sizeof(uint32_t) + sizeof(uint64_t)); }
+    };
+
+    FileStorageLayer& storage_;
+    JoinInput left_;
+    JoinInput right_;
+    size_t memory_budget_;
+    bool int_keys_ = false;
+    std::vector<ColumnType> left_types_;  // Of the requested columns
+    std::vector<ColumnType> right_types_;
+    std::vector<ColumnSchema> left_schema_;
+    std::vector<ColumnSchema> right_schema_;
+    HashJoinStats stats_;
+    // Printed INT values of the pair being emitted: the probe side's live for its tuple, the build side's for one match
+    QueryArena probe_arena_;
+    QueryArena build_arena_;
+    Values probe_values_;
+    Values build_values_;
+
+    // Scan an input and hand each qualifying row over as an encoded tuple:
+    // [u32 size][key][each column], INT columns as 4 bytes and text as [u16 size][bytes]
+    void scan_input(const JoinInput& input, const std::vector<ColumnSchema>& schema,
+        const std::function<void(const std::vector<uint8_t>& tuple, uint64_t hash)>& sink);
+    uint64_t key_hash(const uint8_t* tuple) const;
+    bool keys_equal(const uint8_t* a, const uint8_t* b) const;
+    void decode(const uint8_t* tuple, const std::vector<ColumnType>& types, QueryArena& arena, Values& values) const;
+    void probe(const HashTable& table, const std::vector<uint8_t>& tuple, uint64_t hash, const Emit& emit);
+};
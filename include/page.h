@@ -0,0 +1,241 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <optional>
+#include <bitset>
+#include <memory>
+#include "row_view.h"
+
+constexpr uint32_t PAGE_SIZE = 8192;
+constexpr uint32_t INVALID_PAGE_ID = UINT32_MAX;
+constexpr uint32_t MAX_PAGE_ID = UINT32_MAX - 1;
+constexpr uint32_t IDS_PER_PAGE = 1024;
+constexpr size_t PAGE_IMAGE_ALIGNMENT = 4096;
+
+// One page's bytes, aligned for direct I/O
+struct alignas(PAGE_IMAGE_ALIGNMENT) PageImage {
+    uint8_t bytes[PAGE_SIZE];
+};
+
+enum PageFlags : uint8_t {
+    PAGE_CLEAN = 0x00,
+    PAGE_DIRTY = 0x01,
+    PAGE_OVERFLOW = 0x02,
+    PAGE_IN_PLACE = 0x04, // Image uses the in-place layout; older images hold a packed heap after the slots
+    PAGE_PAX = 0x08       // Fields are stored in column minipages, see pax_page.h
+};
+
+enum SlotFlags : uint8_t {
+    SLOT_OCCUPIED = 0x01,
+    SLOT_DELETED = 0x02
+};
+
+struct PageHeader {
+    uint32_t page_id;
+    uint16_t slot_count;
+    uint16_t free_space;        // Contiguous bytes left between the slot array and the record heap
+    uint16_t free_space_offset; // Start of the record heap, which fills the page from here up to the bitmap
+    uint32_t next_page_id;
+    uint8_t flags;
+    uint32_t lsn;
+    // New: ID range for this page
+    uint32_t id_range_start;
+    uint32_t id_range_end; // exclusive
+
+    void initialize(uint32_t id);
+};
+
+// Layout, in memory and on disk: [PageHeader][Slot * slot_count ->][free][<- record heap][free_id_bitmap]
+// Slot offsets are from the start of the page.
+constexpr uint32_t PAGE_BITMAP_SIZE = IDS_PER_PAGE / 8;
+constexpr uint32_t PAGE_BITMAP_OFFSET = PAGE_SIZE - PAGE_BITMAP_SIZE;
+constexpr uint32_t PAGE_DATA_CAPACITY = PAGE_SIZE - sizeof(PageHeader) - PAGE_BITMAP_SIZE;
+// An overflow page holds one piece of a TEXT value stored out of line: [PageHeader][piece], with
+// free_space_offset at the end of the piece and next_page_id the page holding the next one
+constexpr uint32_t OVERFLOW_PAGE_CAPACITY = PAGE_SIZE - sizeof(PageHeader);
+// Dead record and slot bytes a delete may leave behind before the page is compacted
+constexpr uint32_t PAGE_COMPACT_THRESHOLD = PAGE_DATA_CAPACITY / 4;
+
+inline void PageHeader::initialize(uint32_t id) {
+    page_id = id;
+    slot_count = 0;
+    free_space = PAGE_DATA_CAPACITY;
+    free_space_offset = PAGE_BITMAP_OFFSET;
+    next_page_id = INVALID_PAGE_ID;
+    flags = PAGE_IN_PLACE;
+    lsn = 0;
+    id_range_start = id;
+    id_range_end = id + IDS_PER_PAGE;
+}
+
+struct Slot {
+    uint16_t offset;
+    uint16_t length;
+    uint8_t flags;
+    uint32_t record_id;
+
+    bool is_occupied() const { return flags & SLOT_OCCUPIED; }
+    bool is_deleted() const { return flags & SLOT_DELETED; }
+};
+
+struct PaxFields; // Fields of one tuple bound for a PAX page, in pax_page.cpp
+
+/**
+ * A heap page held as its own PAGE_SIZE image: the header, the slot directory growing after it and
+ * the records growing down from the bitmap all live in one aligned frame, so loading and storing a
+ * page is a single copy. Deleted records stay in place until the dead bytes pass
+ * PAGE_COMPACT_THRESHOLD, or until an insert or update needs their room.
+ * A page allocates its own frame unless it is given one, as buffer pool frames are.
+ * A page formatted for PAX keeps the same interface: records go in and come out encoded as tuples,
+ * but are stored column by column, possibly compressed (pax_page.cpp).
+ */
+class Page {
+public:
+    Page() : Page(INVALID_PAGE_ID, 0) {}
+    Page(uint32_t page_id);
+    Page(uint32_t page_id, uint32_t id_range_start);
+    // Empty page kept in frame, which must outlive it
+    explicit Page(PageImage& frame);
+    Page(const Page&) = delete;
+    Page& operator=(const Page&) = delete;
+    Page(Page&&) = default;
+    Page& operator=(Page&&) = default;
+    // Turn this page into an empty one, in place
+    void reset(uint32_t page_id, uint32_t id_range_start);
+    /**
+     * Lay this empty page out in PAX form for tuples of column_count fields; bit c of text_columns
+     * marks TEXT fields. Columns start plain and take their encoding, if any, once the page fills.
+     * @throws std::runtime_error for more than PAX_MAX_COLUMNS columns
+     */
+    void format_pax(uint16_t column_count, uint16_t text_columns, const ColumnEncoding* encodings = nullptr);
+    bool is_pax() const { return header().flags & PAGE_PAX; }
+    /**
+     * Turn this empty page into an overflow page holding size bytes, at most OVERFLOW_PAGE_CAPACITY,
+     * of a value whose next piece is on next_page_id (INVALID_PAGE_ID for the last piece).
+     */
+    void format_overflow(const uint8_t* data, size_t size, uint32_t next_page_id);
+    bool is_overflow() const { return header().flags & PAGE_OVERFLOW; }
+
+    std::optional<uint32_t> insert_record(uint32_t record_id, const std::vector<uint8_t>& data) {
+        return insert_record(record_id, data.data(), data.size());
+    }
+    std::optional<uint32_t> insert_record(uint32_t record_id, const uint8_t* data, size_t size);
+    std::optional<std::vector<uint8_t>> get_record(uint32_t record_id) const;
+    bool update_record(uint32_t record_id, const std::vector<uint8_t>& new_data);
+    bool delete_record(uint32_t record_id);
+    bool has_record(uint32_t record_id) const { return find_slot(record_id) != nullptr; }
+    // Live slot holding record_id, or nullptr
+    const Slot* find_record(uint32_t record_id) const { return find_slot(record_id); }
+
+    bool is_dirty() const { return header().flags & PAGE_DIRTY; }
+    void mark_dirty() { mutable_header().flags |= PAGE_DIRTY; }
+    void clear_dirty() { mutable_header().flags &= ~PAGE_DIRTY; }
+    bool has_space(uint32_t required) const { return header().free_space >= required; }
+    /**
+     * Bytes available for new records once dead records are compacted away. A record costs
+     * sizeof(Slot) plus its tuple bytes, or on a PAX page at most its bytes without the TupleHeader;
+     * a compressed PAX page counts its live rows at their encoded size.
+     */
+    uint32_t reclaimable_space() const {
+        if (is_pax()) return pax_reclaimable_space();
+        return PAGE_DATA_CAPACITY - live_bytes_ - live_slots_ * sizeof(Slot);
+    }
+    // Lowest record id of the page's range that is not in use
+    std::optional<uint32_t> first_free_id() const;
+
+    const PageHeader& header() const { return *reinterpret_cast<const PageHeader*>(frame_); }
+    uint32_t get_page_id() const { return header().page_id; }
+    // LSN of the last logged change applied to this page
+    uint32_t get_lsn() const { return header().lsn; }
+    void set_lsn(uint32_t lsn) { mutable_header().lsn = lsn; mark_dirty(); }
+    uint32_t get_next_page_id() const { return header().next_page_id; }
+    void set_next_page_id(uint32_t next_page_id) { mutable_header().next_page_id = next_page_id; mark_dirty(); }
+    // Slot directory, live and dead slots alike; on a PAX page slot i is row i
+    const Slot* slots() const { return reinterpret_cast<const Slot*>(frame_ + sizeof(PageHeader)); }
+    size_t slot_count() const { return header().slot_count; }
+    // Record bytes of a slot, in place; not for PAX pages
+    const uint8_t* slot_data(const Slot& slot) const { return frame_ + slot.offset; }
+    // Typed view of a live slot's record, in place on either layout
+    RowView row_view(const ColumnSchema* columns, uint32_t column_count, const Slot& slot) const;
+
+    uint32_t get_id_range_start() const { return header().id_range_start; }
+    uint32_t get_id_range_end() const { return header().id_range_end; }
+    void set_id_range(uint32_t start, uint32_t end) {
+        mutable_header().id_range_start = start;
+        mutable_header().id_range_end = end;
+        rebuild_slot_index();
+    }
+    // Ids of the page's range that are in use; stored in the last PAGE_BITMAP_SIZE bytes of the image
+    std::bitset<IDS_PER_PAGE>& free_id_bitmap() {
+        return *reinterpret_cast<std::bitset<IDS_PER_PAGE>*>(frame_ + PAGE_BITMAP_OFFSET);
+    }
+    const std::bitset<IDS_PER_PAGE>& free_id_bitmap() const {
+        return *reinterpret_cast<const std::bitset<IDS_PER_PAGE>*>(frame_ + PAGE_BITMAP_OFFSET);
+    }
+
+    // The page's on-disk image, which is the page itself
+    const uint8_t* image() const { return frame_; }
+    // Buffer to read an image into directly; load_image() must follow
+    uint8_t* image_buffer() { return frame_; }
+    /**
+     * Check the image in the frame and rebuild the in-memory slot index, converting a legacy image.
+     * @throws std::runtime_error if the image is corrupt
+     */
+    void load_image();
+    std::vector<uint8_t> serialize() const { return std::vector<uint8_t>(frame_, frame_ + PAGE_SIZE); }
+    void deserialize(const std::vector<uint8_t>& data);
+
+    // True when a PAGE_SIZE image uses the in-place layout and can be read without loading it
+    static bool is_in_place_image(const uint8_t* image) {
+        return reinterpret_cast<const PageHeader*>(image)->flags & PAGE_IN_PLACE;
+    }
+    /**
+     * Bounds-check an in-place image's slot directory and records, or an overflow page's piece.
+     * @throws std::runtime_error if anything points outside the page
+     */
+    static void check_image(const uint8_t* image);
+
+private:
+    std::unique_ptr<PageImage> owned_frame_; // Set unless the frame was handed in
+    uint8_t* frame_;
+    // In-memory only: slot index + 1 for each id in the page's range, 0 when absent
+    std::array<uint16_t, IDS_PER_PAGE> slot_index_;
+    uint32_t live_bytes_ = 0;  // Record bytes of live slots; plain TEXT bytes on a PAX page
+    uint32_t live_slots_ = 0;
+
+    PageHeader& mutable_header() { return *reinterpret_cast<PageHeader*>(frame_); }
+    Slot* mutable_slots() { return reinterpret_cast<Slot*>(frame_ + sizeof(PageHeader)); }
+    // Bytes held by dead records and dead slots
+    uint32_t dead_bytes() const {
+        if (is_pax()) return pax_dead_bytes();
+        return PAGE_DATA_CAPACITY - header().free_space - live_bytes_ - live_slots_ * sizeof(Slot);
+    }
+    Slot* find_slot(uint32_t record_id);
+    const Slot* find_slot(uint32_t record_id) const;
+    // Copy a record into the heap, which must have room; returns its offset
+    uint16_t place_record(const uint8_t* data, size_t size);
+    void convert_legacy_image();
+    void rebuild_slot_index();
+    void compact_page();
+    void update_free_space();
+
+    // PAX layout, in pax_page.cpp
+    std::optional<uint32_t> pax_insert(uint32_t record_id, const uint8_t* data, size_t size);
+    std::vector<uint8_t> pax_get(const Slot& slot) const;
+    bool pax_update(uint32_t record_id, const uint8_t* data, size_t size);
+    // Whether the fields can go to row `row` under the current encodings and heap, without writing
+    bool pax_row_fits(const PaxFields& fields, uint16_t row, bool append) const;
+    void pax_store_row(const PaxFields& fields, uint16_t row, bool append);
+    /**
+     * Rewrite the live rows, plus the changed row when given (a new row when row is slot_count()),
+     * choosing each column's encoding again and the row capacity. False, leaving the page as it
+     * was, if they cannot fit.
+     */
+    bool pax_rebuild(const PaxFields* changed = nullptr, uint16_t row = 0, uint32_t record_id = 0);
+    uint32_t pax_dead_bytes() const;
+    uint32_t pax_reclaimable_space() const;
+    void pax_update_free_space();
+    static void check_pax_image(const uint8_t* image);
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "disk_manager.h"
+#include "page.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Header of a raw chain page; the rest of the page holds byte_count payload bytes
+struct ChainPageHeader {
+    uint32_t next_page_id;
+    uint32_t byte_count;
+};
+
+constexpr uint32_t CHAIN_PAGE_PAYLOAD = PAGE_SIZE - sizeof(ChainPageHeader);
+
+/**
+ * Read the payload of the chain starting at head_page_id, recording the pages it occupies.
+ */
+std::vector<uint8_t> read_page_chain(DiskManager& disk, uint32_t head_page_id, std::vector<uint32_t>& chain_pages);
+
+/**
+ * Write payload across chain_pages, allocating more pages when it grew. Surplus pages are kept, empty.
+ * @return Id of the first page of the chain
+ */
+uint32_t write_page_chain(DiskManager& disk, const uint8_t* payload, size_t size, std::vector<uint32_t>& chain_pages,
+    const std::function<uint32_t()>& allocate_page);
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "page_chain.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+ * Maps a table's record-id blocks (IDS_PER_PAGE ids each) to the heap page that owns them.
+ * The whole map is kept in memory and persisted as an array of uint32_t page ids in a chain of dedicated directory pages.
+ */
+class PageDirectory {
+public:
+    static uint32_t block_of(uint32_t record_id) { return record_id == 0 ? UINT32_MAX : (record_id - 1) / IDS_PER_PAGE; }
+    static uint32_t block_start(uint32_t block) { return block * IDS_PER_PAGE + 1; }
+
+    uint32_t page_for_block(uint32_t block) const {
+        return block < block_pages_.size() ? block_pages_[block] : INVALID_PAGE_ID;
+    }
+    uint32_t page_for_record(uint32_t record_id) const { return page_for_block(block_of(record_id)); }
+    void set_block_page(uint32_t block, uint32_t page_id);
+
+    size_t block_count() const { return block_pages_.size(); }
+    const std::vector<uint32_t>& block_pages() const { return block_pages_; }
+    bool is_dirty() const { return dirty_; }
+
+    /**
+     * Read the directory chain starting at head_page_id.
+     */
+    void load(DiskManager& disk, uint32_t head_page_id);
+
+    /**
+     * Write the directory back, reusing its existing pages and allocating more when it grew.
+     * @return Id of the first directory page
+     */
+    uint32_t save(DiskManager& disk, const std::function<uint32_t()>& allocate_page);
+
+private:
+    std::vector<uint32_t> block_pages_;
+    std::vector<uint32_t> storage_pages_;
+    bool dirty_ = false;
+};
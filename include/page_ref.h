@@ -0,0 +1,47 @@
+#pragma once
+
+#include "buffer_pool.h"
+#include "page.h"
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Read-only view of a heap page's header, slots and records. It either pins a buffer pool frame or
+ * points into a page image, such as one in a mapped segment file, which is then read in place
+ * without being loaded. A view of an image must not outlive the image.
+ */
+class PageRef {
+public:
+    PageRef() = default;
+    explicit PageRef(PageGuard guard);
+    /**
+     * View of a PAGE_SIZE page image in the in-place layout.
+     * @throws std::runtime_error for a legacy image, or if its slots or records run past the page
+     */
+    static PageRef from_image(const uint8_t* image);
+
+    PageRef(PageRef&&) = default;
+    PageRef& operator=(PageRef&&) = default;
+
+    explicit operator bool() const { return header_ != nullptr; }
+    const PageHeader& header() const { return *header_; }
+    // The page image, for the PAX batch kernels
+    const uint8_t* image() const { return image_; }
+    bool is_pax() const { return header_->flags & PAGE_PAX; }
+    uint32_t page_id() const { return header_->page_id; }
+    size_t slot_count() const { return slot_count_; }
+    const Slot& slot(size_t index) const { return slots_[index]; }
+    // Live slot holding record_id, or nullptr
+    const Slot* find_record(uint32_t record_id) const;
+    // Typed view of a live slot's record; only valid while the ref holds the page
+    RowView row_view(const ColumnSchema* columns, uint32_t column_count, const Slot& slot) const;
+
+    void release();
+
+private:
+    PageGuard guard_;
+    const PageHeader* header_ = nullptr;
+    const Slot* slots_ = nullptr;
+    size_t slot_count_ = 0;
+    const uint8_t* image_ = nullptr;
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "page.h"
+#include "row_view.h"
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+constexpr uint32_t PAX_MAX_COLUMNS = 16;
+constexpr uint32_t PAX_TEXT_ESTIMATE = 16;   // TEXT bytes per field assumed by the first layout of a page
+constexpr uint32_t PAX_DICTIONARY_MAX = 256; // Distinct values a dictionary minipage holds; codes are one byte
+
+/**
+ * PAX heap page, chosen per table. Fields are stored column by column in minipages instead of as
+ * encoded tuples:
+ *
+ *   [PageHeader][Slot * row_capacity][minipage 0]...[minipage n-1][free][<- text heap][PaxHeader][bitmap]
+ *
+ * Slot i describes row i: its record id, flags, and in `length` the row's plain TEXT bytes. Rows
+ * keep the slot order, so a run of live slots is a run of minipage entries. A minipage is one of:
+ *
+ *   plain INT         int32_t[row_capacity]
+ *   plain TEXT        PaxText[row_capacity], pointing into the heap
+ *   frame of ref.     PaxFrame, then each row's value - base in `width` bits, packed
+ *   run length        PaxRuns, then PaxRun[capacity] covering rows 0..slot_count-1 in order
+ *   dictionary        PaxDictionary, then PaxText[capacity] entries, then a uint8_t code per row
+ *
+ * A page starts with every column plain. When its rows or heap run out, or a value does not fit a
+ * column's encoding, the page is laid out again: each column takes the encoding its table asks for
+ * if that is no larger than plain for the rows it holds, and the capacity is split by those rows.
+ */
+struct PaxHeader {
+    uint16_t row_capacity;
+    uint16_t column_count;
+    uint16_t text_columns;                // Bit c set for a TEXT column
+    uint16_t reserved;
+    uint16_t minipages[PAX_MAX_COLUMNS];  // Offset of each column's minipage from the page start
+    uint8_t requested[PAX_MAX_COLUMNS];   // ColumnEncoding the table asks for
+    uint8_t encodings[PAX_MAX_COLUMNS];   // ColumnEncoding the minipage uses; never Auto
+};
+
+struct PaxText {
+    uint16_t offset; // From the page start
+    uint16_t length;
+};
+
+struct PaxFrame {
+    int32_t base;
+    uint8_t width; // Bits per row, 0 to 32
+    uint8_t reserved[3];
+};
+
+struct PaxRuns {
+    uint16_t count;
+    uint16_t capacity;
+};
+
+struct PaxRun {
+    uint16_t end; // One past the run's last row
+    uint16_t reserved;
+    int32_t value;
+};
+
+struct PaxDictionary {
+    uint16_t count;
+    uint16_t capacity;
+};
+
+constexpr uint32_t PAX_HEADER_OFFSET = PAGE_BITMAP_OFFSET - sizeof(PaxHeader);
+constexpr uint32_t PAX_DATA_CAPACITY = PAGE_DATA_CAPACITY - sizeof(PaxHeader);
+constexpr size_t PAX_FIELD_SIZE = 4; // Bytes per row in a plain minipage
+static_assert(sizeof(PaxText) == PAX_FIELD_SIZE && PAX_FIELD_SIZE == INT_SIZE, "RowView reads PAX fields as 4-byte words");
+
+inline const PaxHeader& pax_header(const uint8_t* image) {
+    return *reinterpret_cast<const PaxHeader*>(image + PAX_HEADER_OFFSET);
+}
+
+// Bytes a plain PAX page spends on each row besides its TEXT bytes
+inline uint32_t pax_row_overhead(uint32_t column_count) {
+    return sizeof(Slot) + column_count * PAX_FIELD_SIZE;
+}
+
+// Typed view of a live slot's record in a page image of either layout
+inline RowView slot_view(const uint8_t* image, const ColumnSchema* columns, uint32_t column_count, const Slot& slot) {
+    if (reinterpret_cast<const PageHeader*>(image)->flags & PAGE_PAX) {
+        const PaxHeader& pax = pax_header(image);
+        return RowView::pax(columns, column_count, image, pax.minipages, pax.encodings, slot.offset, slot.record_id);
+    }
+    return RowView(columns, column_count, image + slot.offset, slot.length, slot.record_id);
+}
+
+// Batch kernels over one column of a PAX page image; `rows` are row indexes in ascending order
+// Values of an INT column, decoded a minipage at a time
+void pax_gather_ints(const uint8_t* image, size_t column, const uint16_t* rows, size_t count, int32_t* out);
+// Entries of a dictionary-encoded TEXT column, returning their count; 0 when the column is not one
+size_t pax_dictionary(const uint8_t* image, size_t column, std::string_view* entries);
+// Dictionary codes of a dictionary-encoded TEXT column
+void pax_gather_codes(const uint8_t* image, size_t column, const uint16_t* rows, size_t count, uint8_t* out);
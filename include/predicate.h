@@ -0,0 +1,68 @@
+#pragma once
+
+#include "column_batch.h"
+#include "row_view.h"
+#include "zone_map.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// A WHERE clause bound to a column: index, operator and literal
+using FilterClause = std::tuple<int, std::string, std::string>;
+
+// The literal as an INT, when it is exactly how an INT field prints
+std::optional<int32_t> exact_int(const std::string& value);
+
+// One clause, specialized for its operator and column type
+struct CompiledClause {
+    int column;
+    ColumnType type;
+    CompareOp op;
+    int32_t int_value;      // Parsed literal, compared numerically by INT equality and every ordering
+    std::string text_value; // Literal as written, compared by equality on printed values
+    bool (*eval)(const RowView& row, const CompiledClause& clause);
+};
+
+/**
+ * WHERE clauses compiled once into typed checks. Literals are parsed up front, each clause gets a
+ * comparison for its operator and column type, and cheap integer checks run before text ones.
+ * Encoded rows are checked in place; joined rows, which only exist as text, are checked with the
+ * same semantics against their printed values.
+ */
+class PredicateProgram {
+public:
+    /**
+     * @param columns Schema the clause column indexes refer to
+     * @throws std::invalid_argument for an ordering comparison against a non-numeric literal
+     */
+    PredicateProgram(const std::vector<FilterClause>& clauses, const std::vector<ColumnSchema>& columns);
+
+    bool matches(const RowView& row) const;
+    bool matches(const std::vector<std::string>& row) const;
+
+    /**
+     * Select the batch rows that match, running the INT clauses through the SIMD kernels.
+     * @param out Room for batch.size indexes
+     * @return Number of selected rows
+     */
+    size_t select(const ColumnBatch& batch, uint16_t* out) const;
+    /**
+     * Whether a page whose INT columns span these zones can hold a matching row. Only INT clauses
+     * are checked against them; TEXT clauses never rule a page out.
+     * @param zones Indexed by column; nullptr when the page's zones are unknown
+     */
+    bool may_match(const Zone* zones) const;
+    // Columns the clauses read, which a batch must have loaded
+    std::vector<int> columns() const;
+
+    // True when some clause can never hold: an unknown operator, or an INT column equal to '007'
+    bool always_false() const { return never_; }
+    size_t size() const { return clauses_.size(); }
+
+private:
+    std::vector<CompiledClause> clauses_;
+    size_t min_columns_ = 0; // Rows with fewer fields never match
+    bool never_ = false;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+constexpr size_t QUERY_ARENA_BLOCK = 64 << 10; // First block; each further block doubles
+
+/**
+ * Monotonic allocator for the short-lived values of one query. Allocations bump a pointer through a
+ * few geometrically growing blocks and are only given back all at once by reset(), which keeps the
+ * blocks. An operator that resets per row or per batch stops allocating once it has seen its largest
+ * row, however many rows follow.
+ */
+class QueryArena {
+public:
+    explicit QueryArena(size_t first_block = QUERY_ARENA_BLOCK) : next_block_(first_block) {}
+    QueryArena(const QueryArena&) = delete;
+    QueryArena& operator=(const QueryArena&) = delete;
+
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+    // Copies of values, valid until the next reset()
+    std::string_view copy(std::string_view text);
+    std::string_view print(int64_t value);
+
+    // Forget every allocation, keeping the blocks for reuse
+    void reset();
+
+    // Blocks taken from the heap so far
+    size_t blocks() const { return blocks_.size(); }
+
+private:
+    struct Block {
+        std::unique_ptr<uint8_t[]> data;
+        size_t size;
+    };
+    std::vector<Block> blocks_;
+    size_t current_ = 0; // Block being filled
+    size_t used_ = 0;    // Bytes used in it
+    size_t next_block_;
+};
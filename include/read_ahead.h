@@ -0,0 +1,35 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+constexpr size_t DEFAULT_READ_AHEAD_PAGES = 8; // Pages a sequential scan keeps requested ahead of itself
+
+/**
+ * Read-ahead window over the page list of a cursor. Before the cursor fetches a page it asks for the
+ * next `window` pages, refilling once half of them are used, so reads land while rows are consumed.
+ */
+class ReadAhead {
+public:
+    using Prefetch = std::function<void(const uint32_t* page_ids, size_t count)>;
+
+    ReadAhead() = default;
+    ReadAhead(Prefetch prefetch, size_t window) : prefetch_(std::move(prefetch)), window_(window) {}
+
+    // Call before fetching page_ids[next]
+    void advance(const std::vector<uint32_t>& page_ids, size_t next) {
+        if (!prefetch_ || window_ == 0 || requested_ > next + window_ / 2) return;
+        const size_t begin = std::max(requested_, next + 1);
+        const size_t end = std::min(page_ids.size(), next + 1 + window_);
+        if (begin < end) prefetch_(page_ids.data() + begin, end - begin);
+        requested_ = std::max(requested_, end);
+    }
+
+private:
+    Prefetch prefetch_;
+    size_t window_ = 0;
+    size_t requested_ = 0; // Pages before this index have been asked for
+};
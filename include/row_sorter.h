@@ -0,0 +1,91 @@
+#pragma once
+
+#include "row_view.h"
+#include "spill_file.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+constexpr size_t SORT_MEMORY_BUDGET = 64 << 20; // Bytes of buffered rows before a sorted run is spilled
+
+struct SortColumn {
+    int column;     // Field the key is read from
+    bool ascending;
+    ColumnType type;
+};
+
+/**
+ * Encodes ORDER BY columns into one byte string whose memcmp order is the sort order.
+ * INT fields become 4 big-endian bytes with the sign bit flipped; TEXT fields are their bytes with
+ * 0x00 escaped as 0x00 0xFF and a 0x00 0x00 terminator. Descending columns invert their bytes.
+ * Types come from the schema, so nothing is parsed per comparison.
+ */
+class SortKeyEncoder {
+public:
+    SortKeyEncoder() = default;
+    explicit SortKeyEncoder(std::vector<SortColumn> columns) : columns_(std::move(columns)) {}
+
+    // Key of a row read in place; `column` names table columns
+    void encode(const RowView& row, std::string& key) const;
+    // Key of a decoded row; `column` names positions in the row. INT fields are parsed once here.
+    void encode(const std::vector<std::string>& row, std::string& key) const;
+
+    const std::vector<SortColumn>& columns() const { return columns_; }
+
+private:
+    std::vector<SortColumn> columns_;
+};
+
+/**
+ * Sorts decoded rows by their encoded keys. With a limit it keeps a bounded top-N heap; without one
+ * it buffers rows and, past the memory budget, spills sorted runs to temporary files that finish()
+ * merges back. Rows with equal keys come out in no particular order.
+ */
+class RowSorter {
+public:
+    RowSorter(SortKeyEncoder encoder, std::optional<size_t> limit = std::nullopt, size_t memory_budget = SORT_MEMORY_BUDGET);
+
+    const SortKeyEncoder& encoder() const { return encoder_; }
+
+    // False when a full top-N heap would drop a row with this key, so callers can skip decoding it
+    bool admits(const std::string& key) const;
+    void add(std::string key, std::vector<std::string> row);
+    void add(std::vector<std::string> row);
+
+    // Sort what is buffered into a run; lets parallel producers sort their own rows before merging
+    void seal();
+    // Take over another sorter's rows; both must share the encoder and limit
+    void merge(RowSorter&& other);
+    // All rows in key order, up to the limit
+    std::vector<std::vector<std::string>> finish();
+
+    size_t spilled_runs() const { return spilled_.size(); }
+
+private:
+    struct Entry {
+        uint64_t prefix;  // First key bytes, big-endian, so most comparisons never touch the string
+        std::string key;
+        std::vector<std::string> row;
+    };
+    struct EntryLess {
+        bool operator()(const Entry& a, const Entry& b) const {
+            if (a.prefix != b.prefix) return a.prefix < b.prefix;
+            return a.key < b.key;
+        }
+    };
+
+    SortKeyEncoder encoder_;
+    std::optional<size_t> limit_;
+    size_t memory_budget_;
+    std::vector<Entry> pending_;           // Unsorted rows, or the top-N max-heap when limited
+    size_t pending_bytes_ = 0;
+    std::vector<std::vector<Entry>> runs_; // Sorted runs held in memory
+    std::vector<std::unique_ptr<SpillFile>> spilled_;
+
+    static uint64_t key_prefix(const std::string& key);
+    static size_t entry_bytes(const Entry& entry);
+    void spill();
+};
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+constexpr uint32_t INT_SIZE = 4;
+constexpr uint32_t MAX_COLUMNS = 16;
+
+// New: Supported column types
+enum class ColumnType : uint8_t {
+    INT = 0, // 4 bytes
+    TEXT = 1 // variable size
+};
+
+/**
+ * Compression a PAX table asks for on a column. Each page applies it when it is laid out again
+ * after filling up, and keeps a column plain where the encoding does not fit its values.
+ */
+enum class ColumnEncoding : uint8_t {
+    Plain = 0,
+    Auto = 1,             // Whichever encoding below makes the page's column smallest
+    Dictionary = 2,       // TEXT: up to 256 distinct values per page, one byte code per row
+    FrameOfReference = 3, // INT: offsets from the page minimum, bit-packed
+    RunLength = 4         // INT: (end row, value) runs
+};
+
+// New: Column schema definition
+struct ColumnSchema {
+    char name[32];
+    ColumnType type;
+    uint32_t size; // Only used for INT (fixed size), ignored for TEXT
+    ColumnEncoding encoding = ColumnEncoding::Plain; // Only used by PAX tables
+};
+
+// Tuple header for variable-length fields
+struct TupleHeader {
+    uint16_t field_count;
+    uint16_t offsets[16]; // Offset of each field in the tuple (for TEXT fields, points to start of data)
+};
+
+// High bit of a TEXT field's length word: the field holds a ToastPointer instead of the value
+constexpr uint32_t TOAST_FLAG = 0x80000000u;
+
+// Where a TEXT value stored out of line lives: a chain of overflow pages, see toast.h
+struct ToastPointer {
+    uint32_t first_page;
+    uint32_t length;
+};
+
+class ToastReader;
+// Value behind a field's ToastPointer, read through reader; in toast.cpp
+std::string_view toast_read(ToastReader* reader, const uint8_t* pointer);
+
+// Field of a compressed PAX minipage, in pax_page.cpp
+int32_t pax_encoded_int(const uint8_t* image, size_t column, uint16_t row);
+std::string_view pax_encoded_text(const uint8_t* image, size_t column, uint16_t row);
+
+/**
+ * Typed, read-only access to an encoded row without copying it.
+ * The view points into the page buffer, so it is only valid while that page stays pinned.
+ * A view of a PAX page row reads each field from its column's minipage instead; data() is then the page.
+ * TEXT values stored out of line are read through the view's ToastReader, and only when asked for.
+ */
+class RowView {
+public:
+    RowView(const ColumnSchema* columns, uint32_t column_count, const uint8_t* data, size_t size, uint32_t record_id = 0) :
+        columns_(columns), column_count_(column_count), data_(data), size_(size), record_id_(record_id) {}
+    // Row `row` of a PAX page image, whose minipage offsets and encodings are given
+    static RowView pax(const ColumnSchema* columns, uint32_t column_count, const uint8_t* image,
+        const uint16_t* minipages, const uint8_t* encodings, uint16_t row, uint32_t record_id) {
+        RowView view(columns, column_count, image, sizeof(TupleHeader), record_id);
+        view.minipages_ = minipages;
+        view.encodings_ = encodings;
+        view.row_ = row;
+        return view;
+    }
+
+    // Reader for TEXT values stored out of line; a view without one cannot read them
+    void set_toast_reader(ToastReader* reader) { toast_ = reader; }
+
+    uint32_t record_id() const { return record_id_; }
+    size_t column_count() const { return size_ < sizeof(TupleHeader) ? 0 : column_count_; }
+    ColumnType type(size_t column) const { return columns_[column].type; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    int32_t get_int(size_t column) const {
+        if (minipages_ && encodings_[column] != static_cast<uint8_t>(ColumnEncoding::Plain)) {
+            return pax_encoded_int(data_, column, row_);
+        }
+        int32_t value;
+        std::memcpy(&value, minipages_ ? pax_field(column) : data_ + field_offset(column), INT_SIZE);
+        return value;
+    }
+    std::string_view get_text(size_t column) const {
+        if (minipages_) {
+            if (encodings_[column] != static_cast<uint8_t>(ColumnEncoding::Plain)) return pax_encoded_text(data_, column, row_);
+            // Heap offset and length, both from the page start
+            uint16_t text[2];
+            std::memcpy(text, pax_field(column), sizeof(text));
+            return std::string_view(reinterpret_cast<const char*>(data_ + text[0]), text[1]);
+        }
+        const size_t offset = field_offset(column);
+        uint32_t length;
+        std::memcpy(&length, data_ + offset, INT_SIZE);
+        if (length & TOAST_FLAG) return toast_read(toast_, data_ + offset + INT_SIZE);
+        return std::string_view(reinterpret_cast<const char*>(data_ + offset + INT_SIZE), length);
+    }
+
+    // Where a TEXT field stored out of line lives; nullopt for values kept in the row and for PAX rows
+    std::optional<ToastPointer> external(size_t column) const {
+        if (minipages_ || columns_[column].type != ColumnType::TEXT) return std::nullopt;
+        const size_t offset = field_offset(column);
+        uint32_t length;
+        std::memcpy(&length, data_ + offset, INT_SIZE);
+        if (!(length & TOAST_FLAG)) return std::nullopt;
+        ToastPointer pointer;
+        std::memcpy(&pointer, data_ + offset + INT_SIZE, sizeof(pointer));
+        return pointer;
+    }
+
+    // Text form of a field, as returned by get() and scan()
+    std::string to_string(size_t column) const;
+    std::vector<std::string> to_strings() const;
+
+private:
+    const ColumnSchema* columns_;
+    uint32_t column_count_;
+    const uint8_t* data_;
+    size_t size_;
+    uint32_t record_id_;
+    const uint16_t* minipages_ = nullptr;
+    const uint8_t* encodings_ = nullptr;
+    uint16_t row_ = 0;
+    ToastReader* toast_ = nullptr;
+
+    const uint8_t* pax_field(size_t column) const { return data_ + minipages_[column] + row_ * INT_SIZE; }
+    size_t field_offset(size_t column) const {
+        uint16_t offset;
+        std::memcpy(&offset, data_ + offsetof(TupleHeader, offsets) + column * sizeof(uint16_t), sizeof(offset));
+        return offset;
+    }
+};
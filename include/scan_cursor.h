@@ -0,0 +1,58 @@
+#pragma once
+
+#include "page_ref.h"
+#include "read_ahead.h"
+#include "row_view.h"
+#include "storage_counters.h"
+#include "toast.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+ * Pull-based scan over a list of heap pages, in order. At most one page is held at a time,
+ * and the page is released as soon as the cursor moves past it.
+ * The cursor must be closed (or destroyed) before the storage it came from is closed, and the table
+ * must not be modified while it is open. Given counters, it adds the rows it visited to them on close().
+ */
+class ScanCursor {
+public:
+    using PageFetcher = std::function<PageRef(uint32_t page_id)>;
+
+    ScanCursor() = default;
+    ScanCursor(const ColumnSchema* columns, uint32_t column_count, std::vector<uint32_t> page_ids, PageFetcher fetch_page,
+        ReadAhead read_ahead = ReadAhead(), StorageCounters* counters = nullptr) :
+        columns_(columns), column_count_(column_count), page_ids_(std::move(page_ids)), fetch_page_(std::move(fetch_page)),
+        read_ahead_(std::move(read_ahead)), toast_(fetch_page_), counters_(counters) {}
+    ScanCursor(ScanCursor&&) = default;
+    ScanCursor& operator=(ScanCursor&&) = default;
+
+    /**
+     * Advance to the next live row.
+     * @return false once the scan is exhausted
+     */
+    bool next();
+
+    // Current row; only valid until the next call to next() or close(), as are values read out of line
+    RowView row() const {
+        RowView view = page_.row_view(columns_, column_count_, *slot_);
+        view.set_toast_reader(&toast_);
+        return view;
+    }
+
+    void close();
+
+private:
+    const ColumnSchema* columns_ = nullptr;
+    uint32_t column_count_ = 0;
+    std::vector<uint32_t> page_ids_;
+    size_t next_page_ = 0;
+    PageFetcher fetch_page_;
+    ReadAhead read_ahead_;
+    PageRef page_;
+    size_t slot_index_ = 0;
+    const Slot* slot_ = nullptr;
+    mutable ToastReader toast_;
+    StorageCounters* counters_ = nullptr;
+    ScanTally tally_;
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+/**
+ * Append-only temporary file for operators that outgrow memory (hash join partitions, sort runs).
+ * Records are written a page at a time and read back in order; each record starts with its own
+ * total size as a u32. The file is removed when the object is destroyed.
+ */
+class SpillFile {
+public:
+    SpillFile();
+    ~SpillFile();
+    SpillFile(const SpillFile&) = delete;
+    SpillFile& operator=(const SpillFile&) = delete;
+
+    void append(const uint8_t* record, size_t size);
+    // Switch to reading from the start
+    void rewind();
+    // Next record, size header included; false after the last one
+    bool read(std::vector<uint8_t>& record);
+    size_t bytes() const { return bytes_; }
+
+private:
+    std::FILE* file_;
+    std::vector<uint8_t> page_; // Writes go out a page at a time
+    size_t bytes_ = 0;
+
+    void write_page();
+};
@@ -1,8 +1,83 @@
 #pragma once
+#include "sql_lexer.h"
 #include "sql_parser.h"
 #include "storage_layer.h"
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
+// Plans an executor keeps, least recently used first out
+constexpr size_t PLAN_CACHE_CAPACITY = 256;
+
+struct QueryPlan; // A statement resolved against the schema, in sql_executor.cpp
+
+struct PlanCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+};
+
+/**
+ * A statement parsed and planned once, to be executed many times. Each ? in a WHERE or SET value
+ * is a parameter, numbered from 0 in the order they appear, and all must be bound before it runs.
+ * Bindings stay in place across executions.
+ */
+class PreparedStatement {
+public:
+    size_t param_count() const { return params_.size(); }
+    /**
+     * Give a parameter its value, written as it would be in the SQL text, without quotes.
+     * @throws std::out_of_range for an index past param_count()
+     */
+    void bind(size_t index, std::string value);
+    // The statement as planned, with SELECT * expanded
+    const SqlAst& ast() const;
+
+private:
+    friend class SqlExecutor;
+    explicit PreparedStatement(std::shared_ptr<const QueryPlan> plan);
+
+    std::shared_ptr<const QueryPlan> plan_;
+    std::vector<std::string> params_;
+    std::vector<bool> bound_;
+};
+
+/**
+ * Runs SELECT, DELETE and UPDATE statements against a storage. prepare() keeps the plans it makes
+ * in a cache keyed by the statement's text with its whitespace normalized, so a statement seen
+ * before skips lexing, parsing, name resolution and predicate compilation. A plan is made again
+ * once the storage's schema_version() moves on. Not safe to share between threads.
+ */
 class SqlExecutor {
 public:
+    /**
+     * Plan and run a parsed statement, bypassing the cache.
+     * @throws std::runtime_error if the statement has parameters
+     */
     void execute(const SqlAst& ast, FileStorageLayer& storage);
-}; 
\ No newline at end of file
+
+    /**
+     * Parse and plan sql, or take its plan from the cache.
+     * @throws std::runtime_error for a syntax error or a table or column that does not exist
+     */
+    PreparedStatement prepare(const std::string& sql, FileStorageLayer& storage);
+    /**
+     * Run a prepared statement with its bound parameters, planning it again first if the schema changed.
+     * @throws std::runtime_error if a parameter is not bound
+     */
+    void execute(PreparedStatement& statement, FileStorageLayer& storage);
+
+    const PlanCacheStats& plan_cache_stats() const { return stats_; }
+    size_t cached_plans() const { return plans_.size(); }
+
+private:
+    SqlLexer lexer_;
+    SqlParser parser_;
+    // Most recently used first, with an index from normalized text into the list
+    std::list<std::pair<std::string, std::shared_ptr<const QueryPlan>>> plans_;
+    std::unordered_map<std::string, std::list<std::pair<std::string, std::shared_ptr<const QueryPlan>>>::iterator> plan_index_;
+    PlanCacheStats stats_;
+};
@@ -7,26 +7,46 @@
 #include <ostream>
 
 enum class SqlAstType {
-    Select
+    Select,
+    Delete,
+    Update
 };
 
 struct WhereClause {
     std::string col;
     std::string op;
     std::string val;
+    int param = -1; // Index of the ? standing for val, or -1 for a literal
+};
+
+// One SET col = val of an UPDATE
+struct Assignment {
+    std::string col;
+    std::string val;
+    int param = -1; // Index of the ? standing for val, or -1 for a literal
+};
+
+// A function call in the select list, such as SUM(col) or COUNT(*)
+struct AggregateCall {
+    std::string fn;     // Upper case: COUNT, SUM, MIN, MAX, AVG, or the per-row ABS
+    std::string column; // "*" for COUNT(*)
 };
 
 struct SqlAst {
     SqlAstType type;
     std::vector<std::string> select_columns;
-    std::string from_table;
+    std::string from_table; // Also the table a DELETE or UPDATE changes
     std::string join_table;
     std::string join_left_col;
     std::string join_right_col;
     std::vector<WhereClause> where_clauses;
+    std::vector<std::string> group_by;
     std::vector<std::pair<std::string, bool>> order_by;
     std::optional<int> limit;
-    std::optional<std::pair<std::string, std::string>> aggregate; // op, col
+    std::vector<AggregateCall> aggregates; // Calls in the select list, in select order
+    std::vector<Assignment> assignments; // UPDATE's SET list, in order
+    size_t param_count = 0;              // Number of ? placeholders, numbered in the order they appear
+    bool explain_analyze = false;        // EXPLAIN ANALYZE: run the statement and report what it cost instead of its rows
     void pretty_print(std::ostream& os) const;
 };
 
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Rows and bytes one scan has read so far, counted without synchronization
+struct ScanTally {
+    uint64_t rows_scanned = 0;  // Live rows visited, before any filter
+    uint64_t rows_emitted = 0;  // Rows handed back or folded into an aggregate, after filters and limits
+    uint64_t bytes_decoded = 0; // Field bytes decoded: the text of each value returned, 4 for an INT read as a number
+};
+
+/**
+ * Running totals of a storage's work. Scans tally on their own and add the tally once, when they
+ * finish, so a row costs a plain increment; the atomics are touched per scan and per page I/O.
+ */
+struct StorageCounters {
+    std::atomic<uint64_t> pages_read{0};
+    std::atomic<uint64_t> pages_written{0};
+    std::atomic<uint64_t> rows_scanned{0};
+    std::atomic<uint64_t> rows_emitted{0};
+    std::atomic<uint64_t> bytes_decoded{0};
+    std::atomic<uint64_t> scan_nanos{0};
+    std::atomic<uint64_t> sort_nanos{0};
+
+    // Add the tally, then clear it so closing a scan twice counts it once
+    void add(ScanTally& tally) {
+        rows_scanned.fetch_add(tally.rows_scanned, std::memory_order_relaxed);
+        rows_emitted.fetch_add(tally.rows_emitted, std::memory_order_relaxed);
+        bytes_decoded.fetch_add(tally.bytes_decoded, std::memory_order_relaxed);
+        tally = ScanTally();
+    }
+    static void add_time(std::atomic<uint64_t>& counter, std::chrono::steady_clock::duration elapsed) {
+        counter.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()),
+            std::memory_order_relaxed);
+    }
+    void reset() {
+        for (auto* counter : {&pages_read, &pages_written, &rows_scanned, &rows_emitted, &bytes_decoded, &scan_nanos, &sort_nanos}) {
+            counter->store(0, std::memory_order_relaxed);
+        }
+    }
+};
@@ -9,43 +9,42 @@
 #include <stdexcept>
 #include <unordered_map>
 #include <bitset>
+#include "page.h"
+#include "buffer_pool.h"
+#include "disk_manager.h"
+#include "page_directory.h"
+#include "free_space_map.h"
+#include "zone_map.h"
+#include "wal.h"
+#include "row_view.h"
+#include "scan_cursor.h"
+#include "column_batch.h"
+#include "hash_aggregate.h"
+#include "predicate.h"
+#include "thread_pool.h"
+#include "btree_index.h"
+#include "toast.h"
+#include "storage_counters.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
 
-constexpr uint32_t PAGE_SIZE = 8192;
-constexpr uint32_t INVALID_PAGE_ID = UINT32_MAX;
 constexpr uint32_t MAX_TABLES = 256;
-constexpr uint32_t MAX_PAGE_ID = UINT32_MAX - 1;
 constexpr uint32_t CATALOG_PAGE_ID = 0;
 constexpr uint32_t MAX_TABLE_NAME_LEN = 63;
-constexpr uint32_t IDS_PER_PAGE = 1024;
-constexpr uint32_t INT_SIZE = 4;
-constexpr uint32_t MAX_COLUMNS = 16;
-constexpr char PAGE_FILE_PREFIX[] = "page_";
-constexpr char PAGE_FILE_EXTENSION[] = ".dat";
 constexpr uint32_t FIRST_ID_BLOCK = 1;
 constexpr char VALUE_DELIMITER = ',';
+constexpr size_t PARALLEL_SCAN_MIN_PAGES = 16; // Pages each scan worker should get at least
+constexpr std::chrono::milliseconds BACKGROUND_WRITER_PERIOD{100}; // Time between background writer rounds
 
-// New: Supported column types
-enum class ColumnType : uint8_t {
-    INT = 0, // 4 bytes
-    TEXT = 1 // variable size
-};
-
-// New: Column schema definition
-struct ColumnSchema {
-    char name[32];
-    ColumnType type;
-    uint32_t size; // Only used for INT (fixed size), ignored for TEXT
-};
-
-enum PageFlags : uint8_t {
-    PAGE_CLEAN = 0x00,
-    PAGE_DIRTY = 0x01,
-    PAGE_OVERFLOW = 0x02
-};
-
-enum SlotFlags : uint8_t {
-    SLOT_OCCUPIED = 0x01,
-    SLOT_DELETED = 0x02
+// How a table's heap pages store their rows, fixed when the table is created
+enum class TableLayout : uint32_t {
+    Row = 0, // Encoded tuples in a slotted page
+    Pax = 1  // Column minipages, see pax_page.h; scans touch only the columns they read
 };
 
 enum CatalogFlags : uint8_t {
@@ -53,99 +52,56 @@ enum CatalogFlags : uint8_t {
 	CATALOG_DIRTY = 0x01
 };
 
-struct PageHeader {
-    uint32_t page_id;
-    uint16_t slot_count;
-    uint16_t free_space;
-    uint16_t free_space_offset;
-    uint32_t next_page_id;
-    uint8_t flags;
-    uint32_t lsn;
-    // New: ID range for this page
-    uint32_t id_range_start;
-    uint32_t id_range_end; // exclusive
-
-    void initialize(uint32_t id) {
-        page_id = id;
-        slot_count = 0;
-        free_space = PAGE_SIZE - sizeof(PageHeader);
-        free_space_offset = sizeof(PageHeader);
-        next_page_id = INVALID_PAGE_ID;
-        flags = PAGE_CLEAN;
-        lsn = 0;
-        id_range_start = id;
-        id_range_end = id + IDS_PER_PAGE;
-    }
-};
-
-struct Slot {
-    uint16_t offset;
-    uint16_t length;
-    uint8_t flags;
-    uint32_t record_id;
-
-    bool is_occupied() const { return flags & SLOT_OCCUPIED; }
-    bool is_deleted() const { return flags & SLOT_DELETED; }
-};
-
-class Page {
-public:
-    Page() : Page(INVALID_PAGE_ID, 0) {}
-    Page(uint32_t page_id);
-    Page(uint32_t page_id, uint32_t id_range_start);
-
-    std::optional<uint32_t> insert_record(uint32_t record_id, const std::vector<uint8_t>& data);
-    std::optional<std::vector<uint8_t>> get_record(uint32_t record_id) const;
-    bool update_record(uint32_t record_id, const std::vector<uint8_t>& new_data);
-    bool delete_record(uint32_t record_id);
-
-    bool is_dirty() const { return header_.flags & PAGE_DIRTY; }
-    bool has_space(uint32_t required) const { return header_.free_space >= required; }
-
-    uint32_t get_page_id() const { return header_.page_id; }
-    uint32_t get_next_page_id() const { return header_.next_page_id; }
-    std::vector<Slot>& get_slots() { return slots_; }
-	void set_next_page_id(uint32_t next_page_id) { header_.next_page_id = next_page_id; }
-
-    // Getters/setters for id range
-    uint32_t get_id_range_start() const { return header_.id_range_start; }
-    uint32_t get_id_range_end() const { return header_.id_range_end; }
-    void set_id_range(uint32_t start, uint32_t end) { header_.id_range_start = start; header_.id_range_end = end; }
-    // Getters/setters for free_id_bitmap
-    std::bitset<IDS_PER_PAGE>& free_id_bitmap() { return free_id_bitmap_; }
-    const std::bitset<IDS_PER_PAGE>& free_id_bitmap() const { return free_id_bitmap_; }
-
-    std::vector<uint8_t> serialize();
-    void deserialize(const std::vector<uint8_t>& data);
-
-private:
-    PageHeader header_;
-    std::vector<Slot> slots_;
-    std::vector<uint8_t> data_;
-    // New: Bitmap for free IDs in this page
-    std::bitset<IDS_PER_PAGE> free_id_bitmap_;
-
-    void compact_page();
-};
-
-// Tuple header for variable-length fields
-struct TupleHeader {
-    uint16_t field_count;
-    uint16_t offsets[16]; // Offset of each field in the tuple (for TEXT fields, points to start of data)
-};
-
 struct TableMetadata {
     char name[64];
     uint32_t first_data_page;
     uint32_t last_data_page;
     uint32_t record_count;
     // Removed: uint32_t next_record_id;
-    uint32_t free_space_head;
+    uint32_t free_space_head; // First page of the free-space map
     // New: Schema
     uint32_t column_count;
     ColumnSchema columns[16]; // Max 16 columns per table for simplicity
     // New: Next available id block for new pages
     uint32_t next_id_block;
+    // First page of the id-block -> heap page directory
+    uint32_t directory_page;
+    // Bit per column that has a B+-tree index
+    uint32_t indexed_columns;
+    // Root page of each column's index; INVALID_PAGE_ID while it still has to be built
+    uint32_t index_roots[16];
+    // Layout of every heap page of the table
+    TableLayout layout;
+    // First page of the zone map
+    uint32_t zone_map_head;
+};
+
+/**
+ * Bounds on one column for an index-driven scan, in the text form values are inserted with.
+ * A missing bound is open.
+ */
+struct IndexRange {
+    int column;
+    std::optional<std::string> lower;
+    bool lower_inclusive = true;
+    std::optional<std::string> upper;
+    bool upper_inclusive = true;
+};
+
+/**
+ * What FileStorageLayer::scan() reads from a table and how it shapes the result. Every part is optional;
+ * the default spec returns every row with all its columns.
+ */
+struct ScanSpec {
+    std::optional<std::vector<int>> projection; // Column indices to return
+    // WHERE on the decoded row; called from several threads when scans run in parallel
+    std::optional<std::function<bool(const std::vector<std::string>&)>> filter_func;
+    std::optional<std::vector<std::pair<int, bool>>> order_by; // (column index, ascending) pairs
+    std::optional<size_t> limit; // Maximum number of rows to return
+    std::optional<std::pair<std::string, int>> aggregate; // (operation, column index), e.g. ("SUM", 0)
+    std::optional<std::function<bool(const RowView&)>> row_filter; // Filter on the encoded row, applied before any value is decoded
+    std::optional<IndexRange> index_range; // Bounds on one column; the column's index finds the rows when it has one
+    const PredicateProgram* where = nullptr; // Compiled WHERE clauses; pages the zone maps rule out are never fetched
 };
 
 struct CatalogHeader {
@@ -154,15 +110,25 @@ struct CatalogHeader {
     uint32_t system_page_count;
     uint8_t flags;
     uint32_t lsn;
+    uint32_t next_page_id; // Chain holding the image past the catalog page (page_chain.h); INVALID_PAGE_ID if none
 };
 
+/**
+ * The table list. Its image is the CatalogHeader followed by every TableMetadata; the first
+ * PAGE_SIZE bytes live in the catalog page and the rest, once there are more tables than fit, in a
+ * page chain. Names are looked up through a hash index. Tables changed since the last
+ * clear_changes() are tracked so the log can carry just those entries.
+ */
 class CatalogPage {
 public:
     CatalogPage();
     bool add_table(const std::string& table_name);
     std::optional<TableMetadata> get_table(const std::string& table_name) const;
     bool update_table(const TableMetadata& metadata);
+    // Store only the record count of the table named in metadata, for per-row maintenance
+    bool update_record_count(const TableMetadata& metadata);
     bool remove_table(const std::string& table_name);
+    const std::vector<TableMetadata>& tables() const { return tables_; }
 
     uint32_t get_table_count() const { return header_.table_count; }
     uint32_t get_lsn() const { return header_.lsn; }
@@ -171,18 +137,41 @@ public:
 	uint32_t get_system_page_count() const { return header_.system_page_count; }
 	void set_system_page_count(uint32_t count) { header_.system_page_count = count; }
 	void set_dirty() { catalog_dirty_ = true; }
+	void clear_dirty() { catalog_dirty_ = false; header_.flags = CATALOG_CLEAN; }
     bool is_dirty() const { return catalog_dirty_; }
 	void increment_lsn() { header_.lsn++; }
 	void increment_system_page_count() { header_.system_page_count++; }
+    uint32_t get_next_page_id() const { return header_.next_page_id; }
+    void set_next_page_id(uint32_t page_id) { header_.next_page_id = page_id; }
 
+    // The whole image, at least PAGE_SIZE bytes
     std::vector<uint8_t> serialize() const;
+    // Bytes of serialize() that are actually used
+    size_t serialized_size() const { return sizeof(CatalogHeader) + tables_.size() * sizeof(TableMetadata); }
     void deserialize(const std::vector<uint8_t>& data);
 
+    // False once tables were added or removed since clear_changes(); only a full image covers that
+    bool changes_are_partial() const { return !tables_moved_; }
+    // The header, then each table changed since clear_changes()
+    std::vector<uint8_t> serialize_changes() const;
+    // Apply serialize_changes() output: take its header and replace or add its tables
+    void apply_changes(const std::vector<uint8_t>& data);
+    void clear_changes();
+
 private:
     CatalogHeader header_;
     std::vector<TableMetadata> tables_;
+    std::unordered_map<std::string, size_t> positions_; // Table name -> index in tables_
+    std::vector<size_t> changed_tables_;
+    std::vector<bool> table_changed_;                    // Indexed like tables_
+    bool tables_moved_ = false;
 
     bool catalog_dirty_ = false;
+
+    static std::string key_of(const char* name) { return std::string(name, strnlen(name, MAX_TABLE_NAME_LEN)); }
+    const TableMetadata* find(const std::string& table_name) const;
+    void mark_changed(size_t position);
+    void reindex();
 };
 
 /**
@@ -216,6 +205,14 @@ public:
      */
     virtual uint32_t insert(const std::string& table, const std::vector<std::string>& values) = 0;
 
+    /**
+     * Insert many records with a single metadata update. Rows are validated before any is stored.
+     * @param table Table name
+     * @param rows Rows of string values (each must match schema)
+     * @return Record IDs in row order
+     */
+    virtual std::vector<uint32_t> insert_batch(const std::string& table, const std::vector<std::vector<std::string>>& rows) = 0;
+
     /**
      * Retrieve a record by its unique ID from the specified table.
      * @param table Table name
@@ -237,6 +234,25 @@ public:
      */
     virtual void delete_record(const std::string& table, uint32_t record_id) = 0;
 
+    /**
+     * Delete every row that passes the WHERE clauses in one pass over the table, on each page while it is pinned.
+     * @param where Optional compiled WHERE clauses; every row is deleted without them
+     * @param index_range Optional bounds on one column, as for scan(); its index finds the rows when it has one
+     * @return Rows deleted
+     */
+    virtual size_t delete_where(const std::string& table, const PredicateProgram* where = nullptr,
+        const std::optional<IndexRange>& index_range = std::nullopt) = 0;
+
+    /**
+     * Set columns of every row that passes the WHERE clauses, in place in one pass over the table.
+     * @param assignments Pairs of (column index, new value)
+     * @return Rows updated
+     * @throws std::runtime_error for an invalid column or INT value, or when an updated row no longer
+     * fits in its page; rows updated before it keep their new values
+     */
+    virtual size_t update_where(const std::string& table, const std::vector<std::pair<int, std::string>>& assignments,
+        const PredicateProgram* where = nullptr, const std::optional<IndexRange>& index_range = std::nullopt) = 0;
+
     /**
      * Scan records in a table with support for projection, filter, order by, limit, and aggregation.
      * @param table Table name
@@ -255,28 +271,164 @@ public:
         const std::optional<size_t>& limit = std::nullopt,
         const std::optional<std::pair<std::string, int>>& aggregate = std::nullopt) = 0;
 
+    /**
+     * Visit every live row of a table in place. Views are only valid during the callback.
+     * @param visitor Returns false to stop the scan
+     */
+    virtual void scan_rows(const std::string& table, const std::function<bool(const RowView&)>& visitor) = 0;
+
+    /**
+     * Open a pull-based cursor over the table's rows.
+     */
+    virtual ScanCursor open_scan(const std::string& table) = 0;
+
+    /**
+     * Open a cursor that decodes the given columns of the table's rows a batch at a time.
+     * @param filter Optional clauses the caller selects with; pages the zone maps rule out are skipped
+     */
+    virtual BatchCursor open_batch_scan(const std::string& table, const std::vector<int>& columns,
+        const PredicateProgram* filter = nullptr) = 0;
+
+    /**
+     * COUNT, SUM, MIN and MAX of an INT column over the rows that pass the filter, computed on column batches.
+     * @param column INT column to aggregate, or -1 to only count rows
+     * @throws std::runtime_error if the column is not an INT column
+     */
+    virtual AggregateResult aggregate(const std::string& table, int column, const PredicateProgram* filter = nullptr) = 0;
+
+    /**
+     * GROUP BY over the rows that pass the filter. Each scan worker aggregates its page range into
+     * its own hash table, and the partials are merged.
+     * @param group_columns Table columns to group by; empty for one group over the whole table
+     * @throws std::runtime_error for an invalid column, or an aggregate other than COUNT on a TEXT column
+     */
+    virtual HashAggregate group_aggregate(const std::string& table, const std::vector<int>& group_columns,
+        const std::vector<AggregateSpec>& aggregates, const PredicateProgram* filter = nullptr) = 0;
+
     /**
      * Persist all buffered data immediately to disk.
      */
     virtual void flush() = 0;
+
+    /**
+     * Make every change so far durable. Cheaper than flush() when the implementation logs changes.
+     */
+    virtual void commit() = 0;
     virtual std::vector<std::string> get_column_names(const std::string& table) = 0;
+    virtual std::vector<ColumnSchema> get_schema(const std::string& table) = 0;
+    // Live rows in the table, from its metadata
+    virtual size_t row_count(const std::string& table) = 0;
+
+    /**
+     * Build a B+-tree index on a column and keep it up to date on every change.
+     * @throws std::runtime_error if the column does not exist or is already indexed
+     */
+    virtual void create_index(const std::string& table, const std::string& column) = 0;
+    virtual bool has_index(const std::string& table, int column) = 0;
+};
+
+// Runtime state of an open table: its catalog entry plus structures derived from it
+struct TableHandle {
+    TableMetadata metadata;
+    PageDirectory directory;
+    FreeSpaceMap free_space;
+    ZoneMap zones;
+    // One entry per column, set for indexed columns
+    std::vector<std::unique_ptr<BTreeIndex>> indexes;
+    // Writers hold it exclusively for the whole change, readers only while they look up pages
+    std::shared_mutex latch;
+};
+
+// How FileStorageLayer::open accesses the storage directory
+enum class OpenMode : uint8_t {
+    ReadWrite = 0,
+    /**
+     * Maps the segment file and reads heap pages in place, leaving caching to the OS page cache.
+     * Needs the single-file layout and a checkpointed log; every change throws.
+     */
+    ReadOnlyMmap = 1
+};
+
+/**
+ * Work a storage has done since it was constructed or since reset_stats(). Page counts cover the
+ * buffer pool's disk traffic; rows, bytes and times cover the read paths: get(), scan(), the
+ * aggregates and the cursors, which count on close. Subtract two snapshots to see what one query cost.
+ */
+struct StorageStats {
+    uint64_t pages_read = 0;    // Pages read from disk into the pool, read-ahead included
+    uint64_t pages_written = 0; // Pages written back from the pool
+    uint64_t cache_hits = 0;    // Page fetches the pool answered without a read
+    uint64_t rows_scanned = 0;  // Live rows visited, before filters
+    uint64_t rows_emitted = 0;  // Rows returned or folded into an aggregate
+    uint64_t bytes_decoded = 0; // Field bytes decoded out of tuples
+    std::chrono::nanoseconds scan_time{0}; // In scan(), aggregate() and group_aggregate(), less sort_time
+    std::chrono::nanoseconds sort_time{0}; // Merging and emitting ORDER BY rows at the end of scan()
+};
+
+inline StorageStats operator-(const StorageStats& a, const StorageStats& b) {
+    StorageStats d;
+    d.pages_read = a.pages_read - b.pages_read;
+    d.pages_written = a.pages_written - b.pages_written;
+    d.cache_hits = a.cache_hits - b.cache_hits;
+    d.rows_scanned = a.rows_scanned - b.rows_scanned;
+    d.rows_emitted = a.rows_emitted - b.rows_emitted;
+    d.bytes_decoded = a.bytes_decoded - b.bytes_decoded;
+    d.scan_time = a.scan_time - b.scan_time;
+    d.sort_time = a.sort_time - b.sort_time;
+    return d;
+}
+
+/**
+ * Tunables for FileStorageLayer.
+ */
+struct StorageOptions {
+    size_t buffer_pool_frames = DEFAULT_BUFFER_POOL_FRAMES; // Frame budget of the page cache
+    DiskLayout layout = DiskLayout::SingleFile;             // Layout for new directories; existing ones keep theirs
+    bool enable_wal = true;                                 // Without a log, commit() falls back to flush()
+    std::chrono::microseconds wal_commit_delay{0};          // Time a committer waits for others to share its sync
+    uint64_t wal_checkpoint_bytes = 64ull << 20;            // commit() checkpoints once the log grows past this
+    size_t scan_threads = 1;                                // Workers per scan; filters must then be thread-safe
+    size_t read_ahead_pages = DEFAULT_READ_AHEAD_PAGES;     // Pages a scan requests ahead of itself; 0 disables it
+    IoBackend io_backend = IoBackend::Auto;                 // Queue for read-ahead and batched write-back
+    size_t background_write_pages = 1024;                   // Dirty pages a second the background writer trickles out; 0 disables it
+    std::chrono::milliseconds checkpoint_interval{30000};   // Time between background checkpoints; 0 disables them
 };
 
 /**
  * Example implementation of the StorageLayer interface.
  * Students should fill in the method implementations.
+ *
+ * Safe to call from several threads once open. Lock order, outermost first: the storage latch
+ * (exclusive only for open, close and flush), a table's latch, page latches in the order the pages
+ * are fetched, buffer pool shards, then the catalog mutex, which is never held across a pool call.
+ *
+ * While a writable storage is open a background thread writes dirty pages out a few at a time,
+ * rate-limited by StorageOptions::background_write_pages, and checkpoints every checkpoint_interval
+ * so the log, and with it recovery time, stays bounded. flush() remains the explicit sync point.
+ * Pages written this way or on eviction may hold changes no commit() covers yet; the log reaches
+ * disk first but stays uncommitted, and open() rolls such changes back after a crash.
  */
 class FileStorageLayer : public StorageLayer {
 public:
     FileStorageLayer();
+    explicit FileStorageLayer(const StorageOptions& options);
     ~FileStorageLayer() override;
 
     void open(const std::string& path) override;
+    /**
+     * @throws std::runtime_error in ReadOnlyMmap mode when the directory has no segment file or its log
+     * holds changes that were never checkpointed
+     */
+    void open(const std::string& path, OpenMode mode);
     void close() override;
     void create(const std::string& table, const std::vector<ColumnSchema>& schema) override;
+    // Create a table whose heap pages use the given layout
+    void create(const std::string& table, const std::vector<ColumnSchema>& schema, TableLayout layout);
     uint32_t  insert(const std::string& table, const std::vector<std::string>& values) override;
+    std::vector<uint32_t> insert_batch(const std::string& table, const std::vector<std::vector<std::string>>& rows) override;
     std::vector<std::string> get(const std::string& table, uint32_t  record_id) override;
     void update(const std::string& table, uint32_t  record_id, const std::vector<std::string>& values) override;
+    // Forwards to the ScanSpec overload; filter_func is called from several threads when scans run in parallel
     std::vector<std::vector<std::string>> scan(
         const std::string& table,
         const std::optional<std::vector<int>>& projection = std::nullopt,
@@ -284,27 +436,159 @@ public:
         const std::optional<std::vector<std::pair<int, bool>>>& order_by = std::nullopt,
         const std::optional<size_t>& limit = std::nullopt,
         const std::optional<std::pair<std::string, int>>& aggregate = std::nullopt) override;
+    // Scan with the filters only this layer understands: encoded-row filters, index ranges and compiled WHERE clauses
+    std::vector<std::vector<std::string>> scan(const std::string& table, const ScanSpec& spec);
+    void scan_rows(const std::string& table, const std::function<bool(const RowView&)>& visitor) override;
+    ScanCursor open_scan(const std::string& table) override;
+    BatchCursor open_batch_scan(const std::string& table, const std::vector<int>& columns,
+        const PredicateProgram* filter = nullptr) override;
+    AggregateResult aggregate(const std::string& table, int column, const PredicateProgram* filter = nullptr) override;
+    HashAggregate group_aggregate(const std::string& table, const std::vector<int>& group_columns,
+        const std::vector<AggregateSpec>& aggregates, const PredicateProgram* filter = nullptr) override;
     void flush() override;
+    void commit() override;
     std::vector<std::string> get_column_names(const std::string& table) override;
+    std::vector<ColumnSchema> get_schema(const std::string& table) override;
+    size_t row_count(const std::string& table) override;
+    void create_index(const std::string& table, const std::string& column) override;
+    bool has_index(const std::string& table, int column) override;
 
     void delete_record(const std::string& table, uint32_t record_id) override;
+    size_t delete_where(const std::string& table, const PredicateProgram* where = nullptr,
+        const std::optional<IndexRange>& index_range = std::nullopt) override;
+    size_t update_where(const std::string& table, const std::vector<std::pair<int, std::string>>& assignments,
+        const PredicateProgram* where = nullptr, const std::optional<IndexRange>& index_range = std::nullopt) override;
+
+    BufferPoolStats buffer_pool_stats() const { return buffer_pool_.stats(); }
+    StorageStats stats() const;
+    // Zero stats(), and the buffer pool's counters with them
+    void reset_stats();
+    DiskLayout disk_layout() const { return disk_ ? disk_->layout() : options_.layout; }
+    size_t buffer_pool_capacity() const { return buffer_pool_.capacity(); }
+    WalStats wal_stats() const { return wal_ ? wal_->stats() : WalStats(); }
+    bool read_only() const { return read_only_; }
+    // Changes whenever the storage is opened or a table or index is created, so plans made against
+    // an older version can tell they must be made again
+    uint64_t schema_version() const { return schema_version_.load(std::memory_order_acquire); }
 
 private:
     bool is_open;
     std::string storage_path;
+    StorageOptions options_;
+    std::unique_ptr<DiskManager> disk_;
+    std::unique_ptr<WriteAheadLog> wal_;
+    bool read_only_ = false;
+    MappedSegmentDiskManager* mapped_ = nullptr; // disk_ when the segment is mapped read-only
+    uint32_t logged_catalog_lsn_ = 0; // Catalog version last written to the log or to disk
+    std::atomic<uint64_t> schema_version_{0};
+    StorageCounters counters_;
 
     CatalogPage catalog_;
-    std::unordered_map<uint32_t, Page> page_cache_;
-    std::unordered_map<std::string, TableMetadata> table_cache_;
-
-    std::string get_page_path(uint32_t page_id) const;
+    std::vector<uint32_t> catalog_pages_; // Chain holding the catalog image past its first page
+    BufferPool buffer_pool_;
+    std::unordered_map<std::string, std::unique_ptr<TableHandle>> table_cache_;
+    std::unique_ptr<ThreadPool> scan_pool_;
+
+    std::shared_mutex state_latch_;   // Shared by every operation, exclusive while checkpointing
+    std::shared_mutex tables_mutex_;  // Guards table_cache_
+    std::mutex table_load_mutex_;     // Held while a handle missing from table_cache_ is built
+    std::mutex catalog_mutex_;        // Guards catalog_ and logged_catalog_lsn_
+    std::mutex scan_pool_mutex_;
+
+    // Overflow chains no row points to any more. Kept in memory only, so chains still free at close are not reused
+    std::mutex overflow_mutex_;
+    std::vector<ToastPointer> released_overflow_; // Waiting for the commit that makes their release final
+    std::vector<ToastPointer> free_overflow_;     // Ready for write_overflow
+
+    std::thread background_writer_;
+    std::mutex background_mutex_;             // Guards background_stop_
+    std::condition_variable background_wake_;
+    bool background_stop_ = false;
+
+    // @throws std::runtime_error when the storage is open read-only
+    void check_writable() const;
     uint32_t allocate_new_page();
+    void save_table_metadata(const TableMetadata& metadata);
+    // For row changes, which leave everything but the record count as the catalog has it
+    void save_record_count(const TableMetadata& metadata);
+    void flush_locked();
+    // The background writer runs while a writable storage is open; stop it before taking the storage latch
+    void start_background_writer();
+    void stop_background_writer();
+    void run_background_writer();
     void write_page_to_disk(Page& page);
-    Page& get_or_load_page(uint32_t page_id);
-    Page& get_or_create_page(uint32_t page_id);
-    Page& get_or_create_page(uint32_t page_id, uint32_t id_range_start);
+    bool read_page_from_disk(uint32_t page_id, Page& page);
+    // Batch writer and async reader of the buffer pool
+    void write_pages_to_disk(const std::vector<Page*>& pages);
+    void read_pages_from_disk(std::vector<BufferPool::PendingRead> reads);
+    // Read-ahead for a heap scan: pool prefetches, madvise on a mapped segment, or nothing
+    ReadAhead heap_read_ahead();
+    PageGuard get_or_load_page(uint32_t page_id, PageLatch latch = PageLatch::Exclusive);
+    // Heap page for readers: in place from the mapping when there is one, else through the pool
+    PageRef read_heap_page(uint32_t page_id);
+    PageGuard get_or_create_page(uint32_t page_id);
+    PageGuard get_or_create_page(uint32_t page_id, uint32_t id_range_start);
 
     TableMetadata& get_table_metadata(const std::string& table_name);
-    Page& get_last_page_for_table(const std::string& table_name);
-    Page& find_free_page_for_table(const std::string& table_name, uint32_t record_size);
+    TableHandle& get_table_handle(const std::string& table_name);
+    PageGuard get_record_page(TableHandle& handle, uint32_t record_id, PageLatch latch);
+    PageGuard append_data_page(TableHandle& handle);
+    uint32_t insert_record(TableHandle& handle, const uint8_t* record, size_t size, PageGuard& page);
+    // Append the encoded row to out, moving TEXT values of a row-layout table out of line if it is long.
+    // Columns whose entry in kept names a page stay out of line on that chain; their values are not read
+    void encode_row(const TableMetadata& metadata, const std::vector<std::string>& values, std::vector<uint8_t>& out,
+        const ToastPointer* kept = nullptr);
+    // Write a value to a chain of overflow pages, imaged in the log since nothing else can redo them.
+    // Pages of freed chains are used before new ones are allocated
+    ToastPointer write_overflow(std::string_view value);
+    // Queue the chains old_record points to and record (nullptr for a delete) does not; they are freed
+    // by the next commit, since until then recovery may roll the row back to them
+    void release_overflow(const TableMetadata& metadata, const std::vector<uint8_t>& old_record,
+        const std::vector<uint8_t>* record);
+    ToastReader toast_reader();
+    void update_free_space(TableHandle& handle, const Page& page);
+    // Row changes on a page latched exclusively and prepared with prepare_page_change. They log the
+    // change and keep zones and indexes current; free space and the record count are left to the caller
+    bool erase_row(TableHandle& handle, Page& page, uint32_t record_id);
+    // @throws std::runtime_error if the record no longer fits in its page
+    void replace_row(TableHandle& handle, Page& page, uint32_t record_id, const std::vector<uint8_t>& record);
+    /**
+     * Hand each page holding rows that pass the WHERE clauses and the index range to mutate, latched
+     * exclusively, with the ids of those rows. Callers hold the table latch exclusively.
+     */
+    void mutate_matches(TableHandle& handle, const PredicateProgram* where, const std::optional<IndexRange>& index_range,
+        const std::function<void(Page& page, const std::vector<uint32_t>& record_ids)>& mutate);
+
+    // Index maintenance; callers hold the table latch exclusively
+    BTreeIndex& open_index(TableHandle& handle, int column, uint32_t root_page_id);
+    void build_index(TableHandle& handle, int column);
+    void index_row(TableHandle& handle, const RowView& row);
+    void unindex_row(TableHandle& handle, const RowView& row);
+    void save_index_roots(TableHandle& handle);
+    void flush_table_maps();
+
+    // Logging: images a page on its first change after a checkpoint, then stamps each logged change
+    void prepare_page_change(Page& page);
+    void log_page_change(Page& page, WalRecordType type, uint32_t arg, const uint8_t* data = nullptr, size_t size = 0);
+    void commit_log();
+    void recover_from_log();
+    void replay_log_record(const WalRecord& record);
+    // Recovery: undo changes no commit record covers, newest first, logging each undo as a change
+    void roll_back_log_records(const std::vector<WalRecord>& records);
+    void undo_log_record(const WalRecord& record);
+
+    // Heap pages of the table in chain order, without those whose zones rule out the filter
+    std::vector<uint32_t> table_pages(TableHandle& handle, const PredicateProgram* filter = nullptr);
+    // table_pages() for callers that hold the table latch
+    std::vector<uint32_t> table_pages_locked(const TableHandle& handle, const PredicateProgram* filter) const;
+    ThreadPool& get_scan_pool();
+    // Workers a scan over this many pages should use, at least one
+    size_t scan_workers(size_t page_count) const;
+    // Split pages into contiguous ranges and run work(worker, range) for each, in parallel when workers > 1
+    void run_page_ranges(const std::vector<uint32_t>& pages, size_t workers,
+        const std::function<void(size_t worker, std::vector<uint32_t> range)>& work);
+
+    PageGuard get_last_page_for_table(const std::string& table_name);
+    // A page of the table with `required` bytes of room, as record_cost counts them
+    PageGuard find_free_page_for_table(TableHandle& handle, uint32_t required);
 }; 
\ No newline at end of file
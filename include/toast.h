@@ -0,0 +1,38 @@
+#pragma once
+
+#include "page_ref.h"
+#include "row_view.h"
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <string_view>
+
+// Encoded rows of a row-layout table longer than this move their longest TEXT values out of line
+constexpr uint32_t TOAST_THRESHOLD = PAGE_DATA_CAPACITY / 4;
+
+/**
+ * Reads TEXT values stored out of line. A field whose length word has TOAST_FLAG set holds a
+ * ToastPointer; the value is split across a chain of overflow pages (page.h), which are only
+ * fetched when the field is read. Values read stay valid until clear().
+ */
+class ToastReader {
+public:
+    using PageFetcher = std::function<PageRef(uint32_t page_id)>;
+
+    ToastReader() = default;
+    explicit ToastReader(PageFetcher fetch_page) : fetch_page_(std::move(fetch_page)) {}
+    ToastReader(ToastReader&&) = default;
+    ToastReader& operator=(ToastReader&&) = default;
+
+    /**
+     * Assemble the value behind pointer from its overflow chain.
+     * @throws std::runtime_error if the chain is broken or shorter than the value
+     */
+    std::string_view read(const ToastPointer& pointer);
+    void clear() { values_.clear(); }
+
+private:
+    PageFetcher fetch_page_;
+    std::deque<std::string> values_; // Deque elements stay put, so earlier views survive later reads
+};
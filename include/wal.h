@@ -0,0 +1,119 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+constexpr char WAL_FILE_NAME[] = "wal.log";
+constexpr uint32_t WAL_MAGIC = 0x4C415757; // "WWAL"
+constexpr uint32_t WAL_VERSION = 2; // 2: changes carry the bytes they replace
+
+// Record kinds. Page records are physiological: they name a page and a logical change to it. A change
+// also carries what it replaces, so recovery can roll back the changes no commit record covers.
+enum class WalRecordType : uint8_t {
+    PageImage = 1,  // Full page image, logged on the first change to a page after a checkpoint
+    PageInit = 2,   // Fresh heap page; payload is the id range start, then column count, TEXT mask and encodings for PAX
+    Insert = 3,     // payload: record id + record bytes; also sets the id bit
+    Update = 4,     // payload: record id + new record length + new record bytes + old record bytes
+    Delete = 5,     // payload: record id + old record bytes; also clears the id bit
+    SetNextPage = 6, // payload: next page id + the next page id it replaces
+    Catalog = 7,    // Catalog image
+    Commit = 8,     // Everything up to here is durable once this record is
+    CatalogTables = 9 // Catalog header plus the tables changed since the previous catalog record
+};
+
+struct WalFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t start_lsn; // LSN of the first record after the last checkpoint
+    uint32_t reserved;
+};
+
+struct WalRecordHeader {
+    uint32_t crc;     // CRC-32 of the rest of the header and the payload
+    uint32_t lsn;
+    uint32_t page_id;
+    uint32_t length;  // Payload bytes
+    WalRecordType type;
+    uint8_t reserved[3];
+};
+
+struct WalRecord {
+    WalRecordType type;
+    uint32_t lsn;
+    uint32_t page_id;
+    std::vector<uint8_t> payload;
+};
+
+struct WalStats {
+    uint64_t records = 0;
+    uint64_t commits = 0; // flush requests
+    uint64_t syncs = 0;   // fdatasync calls actually issued
+    uint64_t bytes = 0;
+};
+
+/**
+ * Append-only redo log. LSNs are dense and start at 1; a page or catalog change is stamped with the LSN that logged it.
+ * flush() implements group commit: one caller writes and syncs everything buffered so far while
+ * concurrent callers whose records are covered just wait for it.
+ */
+class WriteAheadLog {
+public:
+    /**
+     * Open or create the log file at path.
+     * @param commit_delay How long a committing leader waits for others to join its sync
+     */
+    WriteAheadLog(const std::string& path, std::chrono::microseconds commit_delay = std::chrono::microseconds(0));
+    ~WriteAheadLog();
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    /**
+     * Read the committed records of the log, dropping any torn tail. Must be called once before new
+     * records are appended.
+     * @param uncommitted Receives the intact records after the last commit record, which stay in the
+     *        log for the caller to roll back; without it they are dropped
+     */
+    std::vector<WalRecord> recover(std::vector<WalRecord>* uncommitted = nullptr);
+
+    /**
+     * Buffer a record; prefix, payload and suffix are written in that order so callers need not build one buffer.
+     * @return LSN of the record
+     */
+    uint32_t append(WalRecordType type, uint32_t page_id, const void* prefix, size_t prefix_size,
+        const void* payload = nullptr, size_t payload_size = 0, const void* suffix = nullptr, size_t suffix_size = 0);
+
+    // Buffer a commit record unless the last record is one; returns the LSN to flush to
+    uint32_t append_commit();
+
+    // Make every record up to lsn durable
+    void flush(uint32_t lsn);
+
+    // Empty the log after a checkpoint; LSNs keep counting up
+    void truncate();
+
+    uint32_t start_lsn() const { return start_lsn_; }
+    uint32_t last_lsn() const;
+    uint32_t durable_lsn() const;
+    uint64_t size_bytes() const;
+    WalStats stats() const;
+
+private:
+    int fd_ = -1;
+    std::chrono::microseconds commit_delay_;
+    mutable std::mutex mutex_;
+    std::condition_variable synced_;
+    std::vector<uint8_t> buffer_;
+    uint64_t file_end_ = 0;
+    uint32_t start_lsn_ = 1;
+    uint32_t next_lsn_ = 1;
+    uint32_t durable_lsn_ = 0;
+    uint32_t commit_lsn_ = 0; // Last commit record, or start_lsn_ - 1 before the first one
+    bool syncing_ = false;
+    WalStats stats_;
+
+    void write_header();
+};
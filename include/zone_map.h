@@ -0,0 +1,53 @@
+#pragma once
+
+#include "page_chain.h"
+#include "row_view.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Smallest and largest value of an INT column over a page's rows; min > max while it has none
+struct Zone {
+    int32_t min = INT32_MAX;
+    int32_t max = INT32_MIN;
+
+    bool empty() const { return min > max; }
+    void add(int32_t value) {
+        if (value < min) min = value;
+        if (value > max) max = value;
+    }
+};
+
+/**
+ * Zone map of a table: per id block, the Zone of every INT column over the rows its page has held.
+ * Zones only widen, since deletes and updates leave the old bounds in place, so a page they rule
+ * out never holds a matching row. The whole map is kept in memory and persisted as an array of
+ * Zones in a chain of dedicated pages.
+ */
+class ZoneMap {
+public:
+    explicit ZoneMap(uint32_t column_count = 0) : column_count_(column_count) {}
+
+    // Zones of the block's columns, indexed by column; nullptr when the block is not covered
+    const Zone* zones(uint32_t block) const {
+        return block < block_count() ? zones_.data() + static_cast<size_t>(block) * column_count_ : nullptr;
+    }
+    // Widen the block's zones to the row's INT fields
+    void add_row(uint32_t block, const RowView& row);
+    // Cover the block with empty zones, for a new page or one whose zones are about to be rebuilt
+    void clear_block(uint32_t block);
+
+    size_t block_count() const { return column_count_ == 0 ? 0 : zones_.size() / column_count_; }
+    bool is_dirty() const { return dirty_; }
+
+    void load(DiskManager& disk, uint32_t head_page_id);
+    uint32_t save(DiskManager& disk, const std::function<uint32_t()>& allocate_page);
+
+private:
+    uint32_t column_count_;
+    std::vector<Zone> zones_;
+    std::vector<uint32_t> storage_pages_;
+    bool dirty_ = false;
+
+    Zone* block_zones(uint32_t block);
+};
@@ -0,0 +1,267 @@
+#include "async_io.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+// Blocking transfer of whatever is left after the first `done` bytes; stops early at the end of the file
+ssize_t transfer(int fd, const IoRequest& request, size_t done) {
+    while (done < request.size) {
+        ssize_t n = request.write
+            ? ::pwrite(fd, request.buffer + done, request.size - done, static_cast<off_t>(request.offset + done))
+            : ::pread(fd, request.buffer + done, request.size - done, static_cast<off_t>(request.offset + done));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return -errno;
+        if (n == 0) break;
+        done += static_cast<size_t>(n);
+    }
+    return static_cast<ssize_t>(done);
+}
+
+class ThreadIo : public AsyncIo {
+public:
+    explicit ThreadIo(int fd) : fd_(fd), pool_(ASYNC_IO_THREADS) {}
+
+    void submit(std::vector<IoRequest> requests) override {
+        for (auto& request : requests) {
+            pool_.submit([this, request = std::move(request)] { request.done(transfer(fd_, request, 0)); });
+        }
+    }
+    const char* backend() const override { return "threads"; }
+
+private:
+    int fd_;
+    ThreadPool pool_; // Destroyed first; its destructor drains the queue
+};
+
+/**
+ * io_uring without liburing: the rings are mapped by hand and driven with io_uring_setup/io_uring_enter.
+ * Submitters share the submission queue under a mutex; one reaper thread waits on the completion queue.
+ * At most sq_entries requests are in flight, so neither ring can overflow.
+ */
+class UringIo : public AsyncIo {
+public:
+    UringIo(int fd, unsigned depth);
+    ~UringIo() override;
+    UringIo(const UringIo&) = delete;
+    UringIo& operator=(const UringIo&) = delete;
+
+    void submit(std::vector<IoRequest> requests) override;
+    const char* backend() const override { return "io_uring"; }
+
+private:
+    int fd_;
+    int ring_fd_ = -1;
+    void* sq_ring_ = MAP_FAILED;
+    void* cq_ring_ = MAP_FAILED;
+    size_t sq_ring_bytes_ = 0;
+    size_t cq_ring_bytes_ = 0;
+    io_uring_sqe* sqes_ = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqes_bytes_ = 0;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+
+    std::mutex mutex_;
+    std::condition_variable space_;
+    unsigned in_flight_ = 0; // Queued or running, not yet reaped
+    std::thread reaper_;
+
+    // Caller holds mutex_; a null request queues the NOP that stops the reaper
+    void push(IoRequest* request);
+    void enter(unsigned to_submit);
+    void reap();
+    void complete(IoRequest* request, int result);
+    void unmap();
+};
+
+UringIo::UringIo(int fd, unsigned depth) : fd_(fd) {
+    io_uring_params params {};
+    ring_fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, depth, &params));
+    if (ring_fd_ < 0) throw std::runtime_error(std::string("io_uring_setup failed: ") + std::strerror(errno));
+    auto fail = [this](const char* what) {
+        const int error = errno;
+        unmap();
+        ::close(ring_fd_);
+        throw std::runtime_error(std::string(what) + ": " + std::strerror(error));
+    };
+
+    sq_ring_bytes_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_bytes_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) sq_ring_bytes_ = cq_ring_bytes_ = std::max(sq_ring_bytes_, cq_ring_bytes_);
+    sq_ring_ = ::mmap(nullptr, sq_ring_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) fail("Cannot map io_uring submission ring");
+    cq_ring_ = single_mmap ? sq_ring_
+        : ::mmap(nullptr, cq_ring_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+    if (cq_ring_ == MAP_FAILED) fail("Cannot map io_uring completion ring");
+    sqes_bytes_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe*>(
+        ::mmap(nullptr, sqes_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES));
+    if (sqes_ == MAP_FAILED) fail("Cannot map io_uring submission entries");
+
+    auto* sq = static_cast<uint8_t*>(sq_ring_);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_entries_ = params.sq_entries;
+    auto* cq = static_cast<uint8_t*>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    reaper_ = std::thread([this] { reap(); });
+}
+
+UringIo::~UringIo() {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        space_.wait(lock, [this] { return in_flight_ == 0; });
+        push(nullptr);
+        enter(1);
+    }
+    reaper_.join();
+    unmap();
+    ::close(ring_fd_);
+}
+
+void UringIo::unmap() {
+    if (sqes_ != MAP_FAILED) ::munmap(sqes_, sqes_bytes_);
+    if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) ::munmap(cq_ring_, cq_ring_bytes_);
+    if (sq_ring_ != MAP_FAILED) ::munmap(sq_ring_, sq_ring_bytes_);
+}
+
+void UringIo::push(IoRequest* request) {
+    // Only submitters move the tail, and they hold mutex_
+    const unsigned tail = *sq_tail_;
+    const unsigned index = tail & sq_mask_;
+    io_uring_sqe& sqe = sqes_[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    if (request == nullptr) {
+        sqe.opcode = IORING_OP_NOP;
+    } else {
+        sqe.opcode = request->write ? IORING_OP_WRITE : IORING_OP_READ;
+        sqe.fd = fd_;
+        sqe.off = request->offset;
+        sqe.addr = reinterpret_cast<uint64_t>(request->buffer);
+        sqe.len = static_cast<uint32_t>(request->size);
+    }
+    sqe.user_data = reinterpret_cast<uint64_t>(request);
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    in_flight_++;
+}
+
+void UringIo::enter(unsigned to_submit) {
+    while (to_submit > 0) {
+        int submitted = static_cast<int>(::syscall(__NR_io_uring_enter, ring_fd_, to_submit, 0, 0, nullptr, 0));
+        if (submitted < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+            throw std::runtime_error(std::string("io_uring_enter failed: ") + std::strerror(errno));
+        }
+        to_submit -= static_cast<unsigned>(submitted);
+    }
+}
+
+void UringIo::submit(std::vector<IoRequest> requests) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    unsigned queued = 0;
+    for (auto& request : requests) {
+        if (in_flight_ == sq_entries_) {
+            // Hand the kernel what is queued before waiting, or nothing would ever complete
+            enter(queued);
+            queued = 0;
+            space_.wait(lock, [this] { return in_flight_ < sq_entries_; });
+        }
+        push(new IoRequest(std::move(request)));
+        queued++;
+    }
+    enter(queued);
+}
+
+void UringIo::reap() {
+    bool stopping = false;
+    while (!stopping) {
+        ::syscall(__NR_io_uring_enter, ring_fd_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        unsigned head = *cq_head_;
+        const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        unsigned reaped = 0;
+        for (; head != tail; ++head, ++reaped) {
+            const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+            auto* request = reinterpret_cast<IoRequest*>(cqe.user_data);
+            if (request == nullptr) {
+                stopping = true;
+            } else {
+                complete(request, cqe.res);
+            }
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        if (reaped > 0) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            in_flight_ -= reaped;
+            space_.notify_all();
+        }
+    }
+}
+
+void UringIo::complete(IoRequest* raw, int result) {
+    std::unique_ptr<IoRequest> request(raw);
+    ssize_t transferred = result;
+    if (result == -EINTR || result == -EAGAIN) {
+        transferred = transfer(fd_, *request, 0);
+    } else if (result >= 0 && static_cast<size_t>(result) < request->size) {
+        // Short transfers are rare on regular files; finish them in place
+        transferred = transfer(fd_, *request, static_cast<size_t>(result));
+    }
+    try {
+        request->done(transferred);
+    } catch (...) {
+        // Nobody could catch it on this thread
+    }
+}
+}
+
+std::vector<ssize_t> AsyncIo::run(std::vector<IoRequest> requests) {
+    std::vector<ssize_t> results(requests.size());
+    std::mutex mutex;
+    std::condition_variable finished;
+    size_t remaining = requests.size();
+    for (size_t i = 0; i < requests.size(); ++i) {
+        requests[i].done = [&, i](ssize_t result) {
+            std::lock_guard<std::mutex> lock(mutex);
+            results[i] = result;
+            if (--remaining == 0) finished.notify_all();
+        };
+    }
+    submit(std::move(requests));
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&] { return remaining == 0; });
+    return results;
+}
+
+std::unique_ptr<AsyncIo> AsyncIo::create(int fd, IoBackend backend, unsigned depth) {
+    if (backend != IoBackend::Threads) {
+        try {
+            return std::make_unique<UringIo>(fd, depth);
+        } catch (const std::runtime_error&) {
+            // Old kernels and sandboxes that filter io_uring get the thread pool instead
+            if (backend == IoBackend::Uring) throw;
+        }
+    }
+    return std::make_unique<ThreadIo>(fd);
+}
@@ -0,0 +1,325 @@
+#include "btree_index.h"
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+static size_t entry_size(const std::string& key, bool is_leaf) {
+    return sizeof(uint16_t) + key.size() + sizeof(uint32_t) + (is_leaf ? 0 : sizeof(uint32_t));
+}
+
+uint32_t BTreeIndex::create(BufferPool& pool, const PageAllocator& allocate, const PageHook& on_change) {
+    uint32_t page_id = allocate();
+    PageGuard page = pool.create_page(page_id, BTREE_NODE_RECORD_ID);
+    auto bytes = encode_node(Node());
+    page->insert_record(BTREE_NODE_RECORD_ID, bytes);
+    if (on_change) on_change(*page);
+    return page_id;
+}
+
+std::string BTreeIndex::encode_key(ColumnType type, const std::string& value) {
+    if (type == ColumnType::INT) {
+        int32_t v = std::stoi(value);
+        return std::string(reinterpret_cast<const char*>(&v), sizeof(v));
+    }
+    return value;
+}
+
+std::string BTreeIndex::key_of(const RowView& row, size_t column) {
+    if (row.type(column) == ColumnType::INT) {
+        int32_t v = row.get_int(column);
+        return std::string(reinterpret_cast<const char*>(&v), sizeof(v));
+    }
+    return std::string(row.get_text(column));
+}
+
+int BTreeIndex::compare_keys(ColumnType type, std::string_view a, std::string_view b) {
+    if (type == ColumnType::INT) {
+        int32_t x;
+        int32_t y;
+        std::memcpy(&x, a.data(), sizeof(x));
+        std::memcpy(&y, b.data(), sizeof(y));
+        return x < y ? -1 : (x > y ? 1 : 0);
+    }
+    int c = a.compare(b);
+    return c < 0 ? -1 : (c > 0 ? 1 : 0);
+}
+
+std::string_view BTreeIndex::NodeView::key(size_t i) const {
+    uint16_t key_size;
+    std::memcpy(&key_size, data + offsets[i], sizeof(key_size));
+    return std::string_view(reinterpret_cast<const char*>(data + offsets[i] + sizeof(key_size)), key_size);
+}
+
+uint32_t BTreeIndex::NodeView::record_id(size_t i) const {
+    uint32_t record_id;
+    std::memcpy(&record_id, data + offsets[i] + sizeof(uint16_t) + key(i).size(), sizeof(record_id));
+    return record_id;
+}
+
+uint32_t BTreeIndex::NodeView::child(size_t slot) const {
+    if (slot == 0) return header.first_child;
+    uint32_t child;
+    std::memcpy(&child, data + offsets[slot] - sizeof(child), sizeof(child));
+    return child;
+}
+
+int BTreeIndex::compare_entry(std::string_view key, uint32_t record_id, const NodeView& node, size_t i) const {
+    int c = compare(key, node.key(i));
+    if (c != 0) return c;
+    uint32_t other = node.record_id(i);
+    return record_id < other ? -1 : (record_id > other ? 1 : 0);
+}
+
+BTreeIndex::NodeView BTreeIndex::view_node(const Page& page) {
+    const Slot* slot = page.find_record(BTREE_NODE_RECORD_ID);
+    if (slot == nullptr || slot->length < sizeof(BTreeNodeHeader)) {
+        throw std::runtime_error("Corrupt index node on page " + std::to_string(page.get_page_id()));
+    }
+    NodeView node;
+    node.data = page.slot_data(*slot);
+    node.size = slot->length;
+    std::memcpy(&node.header, node.data, sizeof(node.header));
+    const size_t value_bytes = sizeof(uint32_t) * (node.header.is_leaf ? 1 : 2);
+    node.offsets.reserve(node.header.entry_count + 1);
+    size_t offset = sizeof(BTreeNodeHeader);
+    for (uint16_t i = 0; i < node.header.entry_count; ++i) {
+        uint16_t key_size;
+        if (offset + sizeof(key_size) > node.size) throw std::runtime_error("Corrupt index node: truncated entry");
+        std::memcpy(&key_size, node.data + offset, sizeof(key_size));
+        node.offsets.push_back(static_cast<uint16_t>(offset));
+        offset += sizeof(key_size) + key_size + value_bytes;
+        if (offset > node.size) throw std::runtime_error("Corrupt index node: truncated entry");
+    }
+    node.offsets.push_back(static_cast<uint16_t>(offset));
+    return node;
+}
+
+BTreeIndex::Node BTreeIndex::read_node(const Page& page) {
+    NodeView view = view_node(page);
+    Node node;
+    node.is_leaf = view.header.is_leaf != 0;
+    node.next_leaf = view.header.next_leaf;
+    node.first_child = view.header.first_child;
+    node.entries.resize(view.count());
+    for (size_t i = 0; i < view.count(); ++i) {
+        Entry& entry = node.entries[i];
+        entry.key.assign(view.key(i));
+        entry.record_id = view.record_id(i);
+        entry.child = node.is_leaf ? INVALID_PAGE_ID : view.child(i + 1);
+    }
+    return node;
+}
+
+std::vector<uint8_t> BTreeIndex::encode_node(const Node& node) {
+    size_t size = sizeof(BTreeNodeHeader);
+    for (const auto& entry : node.entries) size += entry_size(entry.key, node.is_leaf);
+    std::vector<uint8_t> bytes(size);
+    BTreeNodeHeader header{};
+    header.is_leaf = node.is_leaf ? 1 : 0;
+    header.entry_count = static_cast<uint16_t>(node.entries.size());
+    header.next_leaf = node.next_leaf;
+    header.first_child = node.first_child;
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    uint8_t* out = bytes.data() + sizeof(header);
+    for (const auto& entry : node.entries) {
+        uint16_t key_size = static_cast<uint16_t>(entry.key.size());
+        std::memcpy(out, &key_size, sizeof(key_size));
+        out += sizeof(key_size);
+        std::memcpy(out, entry.key.data(), key_size);
+        out += key_size;
+        std::memcpy(out, &entry.record_id, sizeof(uint32_t));
+        out += sizeof(uint32_t);
+        if (!node.is_leaf) {
+            std::memcpy(out, &entry.child, sizeof(uint32_t));
+            out += sizeof(uint32_t);
+        }
+    }
+    return bytes;
+}
+
+void BTreeIndex::write_bytes(Page& page, const std::vector<uint8_t>& bytes) const {
+    bool stored = page.has_record(BTREE_NODE_RECORD_ID) ? page.update_record(BTREE_NODE_RECORD_ID, bytes)
+                                                        : page.insert_record(BTREE_NODE_RECORD_ID, bytes).has_value();
+    if (!stored) throw std::runtime_error("Index node does not fit its page");
+    if (on_change_) on_change_(page);
+}
+
+void BTreeIndex::write_node(Page& page, const Node& node) const {
+    write_bytes(page, encode_node(node));
+}
+
+size_t BTreeIndex::child_slot(const NodeView& node, std::string_view key, uint32_t record_id) const {
+    // Entries equal to a separator live to its right
+    size_t lo = 0;
+    size_t hi = node.count();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (compare_entry(key, record_id, node, mid) >= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+std::vector<uint32_t> BTreeIndex::find_path(std::string_view key, uint32_t record_id, PageLatch latch) const {
+    std::vector<uint32_t> path;
+    uint32_t page_id = root_page_id_;
+    while (true) {
+        path.push_back(page_id);
+        PageGuard page = pool_.fetch_page(page_id, latch);
+        NodeView node = view_node(*page);
+        if (node.header.is_leaf) return path;
+        page_id = node.child(child_slot(node, key, record_id));
+    }
+}
+
+void BTreeIndex::insert(std::string_view key, uint32_t record_id) {
+    if (key.size() > BTREE_MAX_KEY_SIZE) throw std::runtime_error("Index key too long");
+    std::vector<uint32_t> path = find_path(key, record_id, PageLatch::Shared);
+
+    // Insert into the leaf, then push separators up for as long as nodes keep splitting
+    Entry pending{std::string(key), record_id, INVALID_PAGE_ID};
+    for (size_t level = path.size(); level-- > 0;) {
+        PageGuard page = pool_.fetch_page(path[level], PageLatch::Exclusive);
+        size_t pos;
+        {
+            NodeView view = view_node(*page);
+            const bool is_leaf = view.header.is_leaf != 0;
+            pos = child_slot(view, pending.key, pending.record_id);
+            if (is_leaf && pos > 0 && compare_entry(pending.key, pending.record_id, view, pos - 1) == 0) {
+                return;
+            }
+            const size_t added = entry_size(pending.key, is_leaf);
+            if (view.size + added <= BTREE_NODE_CAPACITY) {
+                // Common case: splice the entry into the node bytes
+                std::vector<uint8_t> bytes(view.size + added);
+                BTreeNodeHeader header = view.header;
+                header.entry_count++;
+                std::memcpy(bytes.data(), &header, sizeof(header));
+                const size_t at = view.offsets[pos];
+                std::memcpy(bytes.data() + sizeof(header), view.data + sizeof(header), at - sizeof(header));
+                uint8_t* out = bytes.data() + at;
+                uint16_t key_size = static_cast<uint16_t>(pending.key.size());
+                std::memcpy(out, &key_size, sizeof(key_size));
+                out += sizeof(key_size);
+                std::memcpy(out, pending.key.data(), key_size);
+                out += key_size;
+                std::memcpy(out, &pending.record_id, sizeof(uint32_t));
+                out += sizeof(uint32_t);
+                if (!is_leaf) {
+                    std::memcpy(out, &pending.child, sizeof(uint32_t));
+                    out += sizeof(uint32_t);
+                }
+                std::memcpy(out, view.data + at, view.size - at);
+                write_bytes(*page, bytes);
+                return;
+            }
+        }
+
+        Node node = read_node(*page);
+        node.entries.insert(node.entries.begin() + pos, std::move(pending));
+        size_t total = sizeof(BTreeNodeHeader);
+        for (const auto& entry : node.entries) total += entry_size(entry.key, node.is_leaf);
+
+        // Split by bytes so variable-length keys leave both halves well under a page
+        size_t split = 0;
+        size_t left_bytes = sizeof(BTreeNodeHeader);
+        while (split + 1 < node.entries.size() && left_bytes < total / 2) {
+            left_bytes += entry_size(node.entries[split++].key, node.is_leaf);
+        }
+        if (split == 0) split = 1;
+        uint32_t right_id = allocate_();
+        Node right;
+        right.is_leaf = node.is_leaf;
+        if (node.is_leaf) {
+            right.entries.assign(std::make_move_iterator(node.entries.begin() + split), std::make_move_iterator(node.entries.end()));
+            right.next_leaf = node.next_leaf;
+            node.next_leaf = right_id;
+            pending = Entry{right.entries.front().key, right.entries.front().record_id, right_id};
+        } else {
+            // The middle separator moves up; its child becomes the right node's first child
+            Entry middle = std::move(node.entries[split]);
+            right.first_child = middle.child;
+            right.entries.assign(std::make_move_iterator(node.entries.begin() + split + 1), std::make_move_iterator(node.entries.end()));
+            pending = Entry{std::move(middle.key), middle.record_id, right_id};
+        }
+        node.entries.resize(split);
+        PageGuard right_page = pool_.create_page(right_id, BTREE_NODE_RECORD_ID);
+        write_node(*right_page, right);
+        write_node(*page, node);
+    }
+
+    // The root split: grow the tree by one level
+    uint32_t new_root_id = allocate_();
+    Node root;
+    root.is_leaf = false;
+    root.first_child = root_page_id_;
+    root.entries.push_back(std::move(pending));
+    PageGuard root_page = pool_.create_page(new_root_id, BTREE_NODE_RECORD_ID);
+    write_node(*root_page, root);
+    root_page_id_ = new_root_id;
+}
+
+bool BTreeIndex::remove(std::string_view key, uint32_t record_id) {
+    std::vector<uint32_t> path = find_path(key, record_id, PageLatch::Shared);
+    PageGuard page = pool_.fetch_page(path.back(), PageLatch::Exclusive);
+    NodeView view = view_node(*page);
+    size_t pos = child_slot(view, key, record_id);
+    if (pos == 0 || compare_entry(key, record_id, view, pos - 1) != 0) return false;
+    // Cut the entry's bytes out of the node
+    const size_t from = view.offsets[pos - 1];
+    const size_t to = view.offsets[pos];
+    std::vector<uint8_t> bytes(view.size - (to - from));
+    BTreeNodeHeader header = view.header;
+    header.entry_count--;
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    std::memcpy(bytes.data() + sizeof(header), view.data + sizeof(header), from - sizeof(header));
+    std::memcpy(bytes.data() + from, view.data + to, view.size - to);
+    write_bytes(*page, bytes);
+    return true;
+}
+
+bool BTreeIndex::in_range(ColumnType type, const KeyRange& range, std::string_view key) {
+    if (range.lower) {
+        int c = compare_keys(type, key, *range.lower);
+        if (c < 0 || (c == 0 && !range.lower_inclusive)) return false;
+    }
+    if (range.upper) {
+        int c = compare_keys(type, key, *range.upper);
+        if (c > 0 || (c == 0 && !range.upper_inclusive)) return false;
+    }
+    return true;
+}
+
+std::vector<uint32_t> BTreeIndex::range(const KeyRange& range) const {
+    std::vector<uint32_t> record_ids;
+    // Descend to the leaf holding the first entry at or after the lower bound
+    uint32_t page_id = root_page_id_;
+    while (true) {
+        PageGuard page = pool_.fetch_page(page_id, PageLatch::Shared);
+        NodeView node = view_node(*page);
+        if (node.header.is_leaf) break;
+        if (!range.lower) {
+            page_id = node.header.first_child;
+        } else {
+            page_id = node.child(child_slot(node, *range.lower, range.lower_inclusive ? 0 : UINT32_MAX));
+        }
+    }
+    // Walk the leaf chain; empty leaves left behind by deletes are skipped over
+    while (page_id != INVALID_PAGE_ID) {
+        PageGuard page = pool_.fetch_page(page_id, PageLatch::Shared);
+        NodeView node = view_node(*page);
+        for (size_t i = 0; i < node.count(); ++i) {
+            std::string_view key = node.key(i);
+            if (range.upper) {
+                int c = compare(key, *range.upper);
+                if (c > 0 || (c == 0 && !range.upper_inclusive)) return record_ids;
+            }
+            if (in_range(key_type_, range, key)) record_ids.push_back(node.record_id(i));
+        }
+        page_id = node.header.next_leaf;
+    }
+    return record_ids;
+}
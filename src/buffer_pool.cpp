@@ -0,0 +1,440 @@
+#include "buffer_pool.h"
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <utility>
+
+PageGuard::PageGuard(PageGuard&& other) noexcept :
+    pool_(std::exchange(other.pool_, nullptr)),
+    frame_id_(other.frame_id_),
+    page_(std::exchange(other.page_, nullptr)),
+    latch_(std::exchange(other.latch_, nullptr)),
+    mode_(std::exchange(other.mode_, PageLatch::None)) {}
+
+PageGuard& PageGuard::operator=(PageGuard&& other) noexcept {
+    if (this != &other) {
+        release();
+        pool_ = std::exchange(other.pool_, nullptr);
+        frame_id_ = other.frame_id_;
+        page_ = std::exchange(other.page_, nullptr);
+        latch_ = std::exchange(other.latch_, nullptr);
+        mode_ = std::exchange(other.mode_, PageLatch::None);
+    }
+    return *this;
+}
+
+void PageGuard::release() {
+    if (pool_ != nullptr) {
+        // Unlatch before unpinning so an unpinned frame is never latched
+        if (mode_ == PageLatch::Shared) {
+            latch_->unlock_shared();
+        } else if (mode_ == PageLatch::Exclusive) {
+            latch_->unlock();
+        }
+        pool_->unpin(frame_id_);
+        pool_ = nullptr;
+        page_ = nullptr;
+        latch_ = nullptr;
+        mode_ = PageLatch::None;
+    }
+}
+
+BufferPool::BufferPool(size_t capacity, PageReader reader, PageWriter writer, size_t shards) :
+    images_(capacity), reader_(std::move(reader)), writer_(std::move(writer)) {
+    if (capacity == 0) throw std::runtime_error("Buffer pool needs at least one frame");
+    for (size_t i = 0; i < capacity; ++i) frames_.emplace_back(images_.frame(i));
+    if (shards == 0) {
+        shards = std::clamp<size_t>(capacity / BUFFER_POOL_MIN_SHARD_FRAMES, 1, BUFFER_POOL_MAX_SHARDS);
+    }
+    shards = std::min(shards, capacity);
+    shards_ = std::vector<Shard>(shards);
+    // Frames are split into contiguous ranges; the first capacity % shards shards get one extra
+    size_t next_frame = 0;
+    for (size_t s = 0; s < shards; ++s) {
+        Shard& shard = shards_[s];
+        shard.first_frame = next_frame;
+        shard.frame_count = capacity / shards + (s < capacity % shards ? 1 : 0);
+        next_frame += shard.frame_count;
+        shard.free_frames.reserve(shard.frame_count);
+        for (size_t i = shard.first_frame + shard.frame_count; i > shard.first_frame; --i) {
+            frames_[i - 1].shard = s;
+            shard.free_frames.push_back(i - 1);
+        }
+    }
+}
+
+PageGuard BufferPool::make_guard(size_t frame_id, PageLatch latch) {
+    Frame& frame = frames_[frame_id];
+    if (latch == PageLatch::Shared) {
+        frame.latch.lock_shared();
+    } else if (latch == PageLatch::Exclusive) {
+        frame.latch.lock();
+    }
+    return PageGuard(this, frame_id, &frame.page, &frame.latch, latch);
+}
+
+PageGuard BufferPool::fetch_page(uint32_t page_id, PageLatch latch) {
+    Shard& shard = shard_for(page_id);
+    size_t frame_id;
+    {
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        bool resident = false;
+        while (!resident) {
+            auto it = shard.page_table.find(page_id);
+            if (it == shard.page_table.end()) {
+                frame_id = acquire_frame(shard, lock);
+                // Someone else may have loaded the page while acquire_frame() waited
+                if (shard.page_table.count(page_id) == 0) break;
+                shard.free_frames.push_back(frame_id);
+                continue;
+            }
+            frame_id = it->second;
+            Frame& frame = frames_[frame_id];
+            frame.pin_count++;
+            frame.referenced = true;
+            if (frame.loading) {
+                shard.loaded.wait(lock, [&] { return !frame.loading; });
+                if (frame.page_id != page_id) {
+                    // The read failed and gave the frame up; read the page ourselves
+                    frame.pin_count--;
+                    continue;
+                }
+            }
+            shard.stats.hits++;
+            resident = true;
+        }
+        if (!resident) {
+            shard.stats.misses++;
+            // Published as loading, like a read-ahead, and read with the mutex dropped so lookups of other
+            // pages in the shard do not wait on the disk; fetches of this page wait on shard.loaded
+            Frame& frame = frames_[frame_id];
+            frame.page.reset(page_id, 0);
+            frame.page_id = page_id;
+            frame.pin_count = 1;
+            frame.referenced = true;
+            frame.loading = true;
+            shard.page_table[page_id] = frame_id;
+            lock.unlock();
+            bool found = false;
+            std::exception_ptr error;
+            try {
+                found = reader_(page_id, frame.page);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            lock.lock();
+            frame.loading = false;
+            if (!found) {
+                shard.page_table.erase(page_id);
+                frame.page_id = INVALID_PAGE_ID;
+                frame.referenced = false;
+                // Fetches that waited on the load still hold pins; CLOCK reclaims the frame once they let go
+                if (--frame.pin_count == 0) shard.free_frames.push_back(frame_id);
+            }
+            lock.unlock();
+            shard.loaded.notify_all();
+            if (error) std::rethrow_exception(error);
+            if (!found) throw std::runtime_error("Page not found");
+        }
+    }
+    // The pin keeps the frame ours; waiting for its latch must not block the whole shard
+    return make_guard(frame_id, latch);
+}
+
+PageGuard BufferPool::create_page(uint32_t page_id, uint32_t id_range_start) {
+    Shard& shard = shard_for(page_id);
+    size_t frame_id;
+    {
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        while (true) {
+            auto it = shard.page_table.find(page_id);
+            if (it != shard.page_table.end()) {
+                frame_id = it->second;
+                if (frames_[frame_id].pin_count > 0) throw std::runtime_error("Cannot recreate a pinned page");
+                break;
+            }
+            frame_id = acquire_frame(shard, lock);
+            if (shard.page_table.count(page_id) == 0) {
+                shard.page_table[page_id] = frame_id;
+                break;
+            }
+            shard.free_frames.push_back(frame_id);
+        }
+        Frame& frame = frames_[frame_id];
+        frame.page.reset(page_id, id_range_start);
+        frame.page.mark_dirty();
+        frame.page_id = page_id;
+        frame.pin_count = 1;
+        frame.referenced = true;
+    }
+    return make_guard(frame_id, PageLatch::Exclusive);
+}
+
+void BufferPool::prefetch(const uint32_t* page_ids, size_t count) {
+    if (!async_reader_) return;
+    std::vector<PendingRead> reads;
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t page_id = page_ids[i];
+        Shard& shard = shard_for(page_id);
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        // Loading frames stay pinned, so read-ahead may hold at most half of a shard
+        if (shard.page_table.count(page_id) || shard.loads >= shard.frame_count / 2) continue;
+        size_t frame_id;
+        try {
+            frame_id = acquire_frame(shard, lock);
+        } catch (const std::runtime_error&) {
+            continue;
+        }
+        if (shard.page_table.count(page_id) || shard.loads >= shard.frame_count / 2) {
+            shard.free_frames.push_back(frame_id);
+            continue;
+        }
+        Frame& frame = frames_[frame_id];
+        frame.page.reset(page_id, 0);
+        frame.page_id = page_id;
+        frame.pin_count = 1;
+        frame.referenced = true;
+        frame.loading = true;
+        shard.page_table[page_id] = frame_id;
+        shard.loads++;
+        shard.stats.prefetches++;
+        reads.push_back(PendingRead{page_id, &frame.page, [this, frame_id](bool loaded) { finish_load(frame_id, loaded); }});
+    }
+    if (!reads.empty()) async_reader_(std::move(reads));
+}
+
+void BufferPool::finish_load(size_t frame_id, bool loaded) {
+    Frame& frame = frames_[frame_id];
+    Shard& shard = shards_[frame.shard];
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (!loaded) {
+            // Left for CLOCK to reclaim once the waiters have dropped their pins
+            shard.page_table.erase(frame.page_id);
+            frame.page_id = INVALID_PAGE_ID;
+            frame.referenced = false;
+        }
+        frame.loading = false;
+        frame.pin_count--;
+        shard.loads--;
+    }
+    shard.loaded.notify_all();
+}
+
+size_t BufferPool::acquire_frame(Shard& shard, std::unique_lock<std::mutex>& lock) {
+    while (true) {
+        if (!shard.free_frames.empty()) {
+            size_t frame_id = shard.free_frames.back();
+            shard.free_frames.pop_back();
+            return frame_id;
+        }
+        // CLOCK: two full sweeps are enough to clear every reference bit once
+        for (size_t step = 0; step < shard.frame_count * 2; ++step) {
+            size_t frame_id = shard.first_frame + shard.clock_hand;
+            shard.clock_hand = (shard.clock_hand + 1) % shard.frame_count;
+            Frame& frame = frames_[frame_id];
+            if (frame.pin_count > 0) continue;
+            if (frame.referenced) {
+                frame.referenced = false;
+                continue;
+            }
+            if (frame.page.is_dirty()) {
+                // Written with the shard mutex dropped, pinned as write_back() does; waiting for a
+                // latch here could deadlock with its holder, so a latched page is passed over
+                std::shared_lock<std::shared_mutex> latch(frame.latch, std::try_to_lock);
+                if (!latch.owns_lock()) continue;
+                frame.pin_count++;
+                shard.writes++;
+                lock.unlock();
+                auto finish = [&] {
+                    lock.lock();
+                    frame.pin_count--;
+                    shard.writes--;
+                    shard.loaded.notify_all();
+                };
+                try {
+                    writer_(frame.page);
+                } catch (...) {
+                    finish();
+                    throw;
+                }
+                latch.unlock();
+                finish();
+                shard.stats.dirty_writebacks++;
+                // Fetched or changed again meanwhile, so no longer a victim
+                if (frame.pin_count > 0 || frame.referenced || frame.page.is_dirty()) continue;
+            }
+            shard.page_table.erase(frame.page_id);
+            frame.page_id = INVALID_PAGE_ID;
+            shard.stats.evictions++;
+            return frame_id;
+        }
+        // Pins held by writes are let go shortly; any others may be held by the caller itself
+        if (shard.writes == 0) break;
+        shard.loaded.wait(lock, [&] { return shard.writes == 0; });
+    }
+    throw std::runtime_error("Buffer pool exhausted: all frames are pinned");
+}
+
+void BufferPool::unpin(size_t frame_id) {
+    Frame& frame = frames_[frame_id];
+    Shard& shard = shards_[frame.shard];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (frame.pin_count > 0) {
+        frame.pin_count--;
+    }
+    list_if_dirty(shard, frame_id);
+}
+
+void BufferPool::list_if_dirty(Shard& shard, size_t frame_id) {
+    Frame& frame = frames_[frame_id];
+    if (frame.listed || frame.page_id == INVALID_PAGE_ID || !frame.page.is_dirty()) return;
+    frame.listed = true;
+    shard.dirty_frames.push_back(frame_id);
+}
+
+void BufferPool::write_frames(const std::vector<size_t>& frame_ids, bool wait_for_latches) {
+    auto finish = [&] {
+        // Only once the pins are gone, so a waiting acquire_frame() finds the frames free
+        for (size_t frame_id : frame_ids) {
+            Shard& shard = shards_[frames_[frame_id].shard];
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                shard.writes--;
+            }
+            shard.loaded.notify_all();
+        }
+    };
+    try {
+        write_pinned(frame_ids, wait_for_latches);
+    } catch (...) {
+        finish();
+        throw;
+    }
+    finish();
+}
+
+void BufferPool::write_pinned(const std::vector<size_t>& frame_ids, bool wait_for_latches) {
+    std::vector<PageGuard> guards;
+    guards.reserve(frame_ids.size());
+    for (size_t frame_id : frame_ids) guards.emplace_back(this, frame_id, &frames_[frame_id].page, nullptr, PageLatch::None);
+    auto latch = [&](size_t frame_id) {
+        return wait_for_latches ? std::shared_lock<std::shared_mutex>(frames_[frame_id].latch)
+                                : std::shared_lock<std::shared_mutex>(frames_[frame_id].latch, std::try_to_lock);
+    };
+    if (!batch_writer_) {
+        for (size_t i = 0; i < frame_ids.size(); ++i) {
+            std::shared_lock<std::shared_mutex> held = latch(frame_ids[i]);
+            if (held.owns_lock() && guards[i]->is_dirty()) writer_(*guards[i]);
+        }
+        return;
+    }
+    std::vector<std::shared_lock<std::shared_mutex>> latches;
+    std::vector<Page*> pages;
+    latches.reserve(frame_ids.size());
+    for (size_t frame_id : frame_ids) {
+        latches.push_back(latch(frame_id));
+        if (latches.back().owns_lock() && frames_[frame_id].page.is_dirty()) pages.push_back(&frames_[frame_id].page);
+    }
+    if (!pages.empty()) batch_writer_(pages);
+}
+
+void BufferPool::flush_all() {
+    std::vector<size_t> dirty;
+    for (Shard& shard : shards_) {
+        // Pin the dirty frames, then write them outside the shard mutex so other threads keep going
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (size_t frame_id : shard.dirty_frames) {
+            Frame& frame = frames_[frame_id];
+            frame.listed = false;
+            if (frame.page_id != INVALID_PAGE_ID && frame.page.is_dirty()) {
+                frame.pin_count++;
+                shard.writes++;
+                dirty.push_back(frame_id);
+            }
+        }
+        shard.dirty_frames.clear();
+    }
+    write_frames(dirty, true);
+}
+
+size_t BufferPool::write_back(size_t max_pages) {
+    std::vector<size_t> dirty;
+    for (Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        size_t taken = 0;
+        // An even share per shard, so one busy shard cannot starve the rest, and never more than half
+        // of a shard, so its fetches still find frames to evict
+        const size_t share = std::min((max_pages + shards_.size() - 1) / shards_.size(), std::max<size_t>(1, shard.frame_count / 2));
+        while (!shard.dirty_frames.empty() && taken < share && dirty.size() < max_pages) {
+            const size_t frame_id = shard.dirty_frames.front();
+            shard.dirty_frames.pop_front();
+            Frame& frame = frames_[frame_id];
+            frame.listed = false;
+            // A pinned page is listed again when its last user lets go
+            if (frame.pin_count > 0 || frame.page_id == INVALID_PAGE_ID || !frame.page.is_dirty()) continue;
+            frame.pin_count++;
+            shard.writes++;
+            dirty.push_back(frame_id);
+            shard.stats.background_writes++;
+            taken++;
+        }
+    }
+    // Writers may hold a latch while waiting for another page, so a latched page is left for later
+    write_frames(dirty, false);
+    return dirty.size();
+}
+
+void BufferPool::clear() {
+    for (Shard& shard : shards_) {
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        shard.loaded.wait(lock, [&] { return shard.loads == 0; });
+        for (auto it = shard.page_table.begin(); it != shard.page_table.end();) {
+            Frame& frame = frames_[it->second];
+            if (frame.pin_count > 0) {
+                ++it;
+                continue;
+            }
+            frame.page_id = INVALID_PAGE_ID;
+            frame.referenced = false;
+            shard.free_frames.push_back(it->second);
+            it = shard.page_table.erase(it);
+        }
+        auto dropped = std::remove_if(shard.dirty_frames.begin(), shard.dirty_frames.end(), [&](size_t frame_id) {
+            const bool drop = frames_[frame_id].page_id == INVALID_PAGE_ID;
+            if (drop) frames_[frame_id].listed = false;
+            return drop;
+        });
+        shard.dirty_frames.erase(dropped, shard.dirty_frames.end());
+    }
+}
+
+size_t BufferPool::resident_pages() const {
+    size_t pages = 0;
+    for (const Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        pages += shard.page_table.size();
+    }
+    return pages;
+}
+
+BufferPoolStats BufferPool::stats() const {
+    BufferPoolStats total;
+    for (const Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total.hits += shard.stats.hits;
+        total.misses += shard.stats.misses;
+        total.evictions += shard.stats.evictions;
+        total.dirty_writebacks += shard.stats.dirty_writebacks;
+        total.prefetches += shard.stats.prefetches;
+        total.background_writes += shard.stats.background_writes;
+    }
+    return total;
+}
+
+void BufferPool::reset_stats() {
+    for (Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.stats = BufferPoolStats();
+    }
+}
@@ -0,0 +1,285 @@
+#include "column_batch.h"
+#include "pax_page.h"
+#include <algorithm>
+#include <stdexcept>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+std::vector<std::string> ColumnBatch::to_strings(size_t row, const std::vector<int>& columns) const {
+    std::vector<std::string> values;
+    values.reserve(columns.size());
+    for (int c : columns) {
+        if (!ints[c].empty()) {
+            values.push_back(std::to_string(ints[c][row]));
+        } else {
+            values.emplace_back(texts[c][row]);
+        }
+    }
+    return values;
+}
+
+BatchCursor::BatchCursor(const ColumnSchema* columns, uint32_t column_count, std::vector<int> load_columns,
+    std::vector<uint32_t> page_ids, PageFetcher fetch_page, ReadAhead read_ahead, StorageCounters* counters) :
+    columns_(columns), column_count_(column_count), load_columns_(std::move(load_columns)),
+    page_ids_(std::move(page_ids)), fetch_page_(std::move(fetch_page)), read_ahead_(std::move(read_ahead)),
+    toast_(fetch_page_), counters_(counters) {
+    for (int c : load_columns_) {
+        if (c < 0 || static_cast<uint32_t>(c) >= column_count_) throw std::runtime_error("Invalid column index for batch scan");
+        loads_text_ |= columns_[c].type == ColumnType::TEXT;
+    }
+}
+
+bool BatchCursor::next(ColumnBatch& batch) {
+    batch.size = 0;
+    batch.record_ids.clear();
+    batch.ints.resize(column_count_);
+    batch.texts.resize(column_count_);
+    batch.codes.resize(column_count_);
+    batch.dictionaries.resize(column_count_);
+    for (int c : load_columns_) {
+        batch.ints[c].clear();
+        batch.texts[c].clear();
+        batch.codes[c].clear();
+        batch.dictionaries[c].clear();
+    }
+    // The previous batch's text views die with its page
+    if (page_ && slot_index_ >= page_.slot_count()) page_.release();
+    toast_.clear();
+    while (batch.size < BATCH_CAPACITY) {
+        if (!page_) {
+            if (next_page_ >= page_ids_.size()) break;
+            read_ahead_.advance(page_ids_, next_page_);
+            page_ = fetch_page_(page_ids_[next_page_++]);
+            slot_index_ = 0;
+        }
+        if (page_.is_pax()) load_pax_rows(batch);
+        while (slot_index_ < page_.slot_count() && batch.size < BATCH_CAPACITY) {
+            const Slot& slot = page_.slot(slot_index_++);
+            if (!slot.is_occupied()) continue;
+            RowView row = page_.row_view(columns_, column_count_, slot);
+            if (row.column_count() == 0) continue;
+            row.set_toast_reader(&toast_);
+            batch.record_ids.push_back(slot.record_id);
+            for (int c : load_columns_) {
+                if (columns_[c].type == ColumnType::INT) {
+                    batch.ints[c].push_back(row.get_int(c));
+                } else {
+                    batch.texts[c].push_back(row.get_text(c));
+                }
+            }
+            batch.size++;
+        }
+        if (slot_index_ < page_.slot_count()) break;
+        // Text views keep the page pinned, so the batch ends with it
+        if (loads_text_ && batch.size > 0) break;
+        page_.release();
+    }
+    tally_.rows_scanned += batch.size;
+    for (int c : load_columns_) {
+        if (columns_[c].type == ColumnType::INT) {
+            tally_.bytes_decoded += batch.size * INT_SIZE;
+            continue;
+        }
+        for (std::string_view text : batch.texts[c]) tally_.bytes_decoded += text.size();
+    }
+    return batch.size > 0;
+}
+
+void BatchCursor::load_pax_rows(ColumnBatch& batch) {
+    const size_t start = batch.size;
+    uint16_t rows[BATCH_CAPACITY];
+    size_t count = 0;
+    while (slot_index_ < page_.slot_count() && start + count < BATCH_CAPACITY) {
+        const Slot& slot = page_.slot(slot_index_);
+        if (slot.is_occupied()) {
+            rows[count++] = static_cast<uint16_t>(slot_index_);
+            batch.record_ids.push_back(slot.record_id);
+        }
+        slot_index_++;
+    }
+    const uint8_t* image = page_.image();
+    for (int c : load_columns_) {
+        if (columns_[c].type == ColumnType::INT) {
+            batch.ints[c].resize(start + count);
+            pax_gather_ints(image, c, rows, count, batch.ints[c].data() + start);
+            continue;
+        }
+        for (size_t i = 0; i < count; ++i) batch.texts[c].push_back(pax_encoded_text(image, c, rows[i]));
+        // A batch with TEXT holds one page's rows, so the codes index a single dictionary
+        std::string_view entries[PAX_DICTIONARY_MAX];
+        const size_t entry_count = pax_dictionary(image, c, entries);
+        if (entry_count == 0) continue;
+        batch.dictionaries[c].assign(entries, entries + entry_count);
+        batch.codes[c].resize(start + count);
+        pax_gather_codes(image, c, rows, count, batch.codes[c].data() + start);
+    }
+    batch.size += count;
+}
+
+void BatchCursor::close() {
+    page_.release();
+    toast_.clear();
+    next_page_ = page_ids_.size();
+    if (counters_) counters_->add(tally_);
+}
+
+namespace {
+template <CompareOp Op>
+inline bool compare(int32_t a, int32_t b) {
+    switch (Op) {
+    case CompareOp::Eq: return a == b;
+    case CompareOp::Ne: return a != b;
+    case CompareOp::Lt: return a < b;
+    case CompareOp::Le: return a <= b;
+    case CompareOp::Gt: return a > b;
+    case CompareOp::Ge: return a >= b;
+    }
+    return false;
+}
+
+#if defined(__SSE2__)
+// One bit per lane that passes; Ne, Le and Ge invert the mask of their opposite
+template <CompareOp Op>
+inline int compare_mask(__m128i v, __m128i rhs) {
+    __m128i m;
+    switch (Op) {
+    case CompareOp::Eq:
+    case CompareOp::Ne: m = _mm_cmpeq_epi32(v, rhs); break;
+    case CompareOp::Lt:
+    case CompareOp::Ge: m = _mm_cmplt_epi32(v, rhs); break;
+    default: m = _mm_cmpgt_epi32(v, rhs); break;
+    }
+    int bits = _mm_movemask_ps(_mm_castsi128_ps(m));
+    const bool invert = Op == CompareOp::Ne || Op == CompareOp::Ge || Op == CompareOp::Le;
+    return invert ? ~bits & 0xF : bits;
+}
+#endif
+
+template <CompareOp Op>
+size_t select_typed(const int32_t* values, size_t count, int32_t rhs, uint16_t* out) {
+    size_t n = 0;
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i r = _mm_set1_epi32(rhs);
+    for (; i + 4 <= count; i += 4) {
+        int bits = compare_mask<Op>(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i)), r);
+        // Write every lane and advance only past the ones that passed, so there is no branch to mispredict
+        for (int lane = 0; lane < 4; ++lane) {
+            out[n] = static_cast<uint16_t>(i + lane);
+            n += (bits >> lane) & 1;
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        out[n] = static_cast<uint16_t>(i);
+        n += compare<Op>(values[i], rhs);
+    }
+    return n;
+}
+
+template <CompareOp Op>
+size_t refine_typed(const int32_t* values, const uint16_t* selection, size_t selected, int32_t rhs, uint16_t* out) {
+    size_t n = 0;
+    for (size_t k = 0; k < selected; ++k) {
+        uint16_t row = selection[k];
+        out[n] = row;
+        n += compare<Op>(values[row], rhs);
+    }
+    return n;
+}
+}
+
+size_t select_int(const int32_t* values, size_t count, CompareOp op, int32_t rhs, uint16_t* out) {
+    switch (op) {
+    case CompareOp::Eq: return select_typed<CompareOp::Eq>(values, count, rhs, out);
+    case CompareOp::Ne: return select_typed<CompareOp::Ne>(values, count, rhs, out);
+    case CompareOp::Lt: return select_typed<CompareOp::Lt>(values, count, rhs, out);
+    case CompareOp::Le: return select_typed<CompareOp::Le>(values, count, rhs, out);
+    case CompareOp::Gt: return select_typed<CompareOp::Gt>(values, count, rhs, out);
+    case CompareOp::Ge: return select_typed<CompareOp::Ge>(values, count, rhs, out);
+    }
+    return 0;
+}
+
+size_t refine_int(const int32_t* values, const uint16_t* selection, size_t selected, CompareOp op, int32_t rhs, uint16_t* out) {
+    switch (op) {
+    case CompareOp::Eq: return refine_typed<CompareOp::Eq>(values, selection, selected, rhs, out);
+    case CompareOp::Ne: return refine_typed<CompareOp::Ne>(values, selection, selected, rhs, out);
+    case CompareOp::Lt: return refine_typed<CompareOp::Lt>(values, selection, selected, rhs, out);
+    case CompareOp::Le: return refine_typed<CompareOp::Le>(values, selection, selected, rhs, out);
+    case CompareOp::Gt: return refine_typed<CompareOp::Gt>(values, selection, selected, rhs, out);
+    case CompareOp::Ge: return refine_typed<CompareOp::Ge>(values, selection, selected, rhs, out);
+    }
+    return 0;
+}
+
+void gather_int(const int32_t* values, const uint16_t* selection, size_t selected, int32_t* out) {
+    for (size_t k = 0; k < selected; ++k) out[k] = values[selection[k]];
+}
+
+int64_t sum_int(const int32_t* values, size_t count) {
+    int64_t sum = 0;
+    size_t i = 0;
+#if defined(__SSE2__)
+    // Sign-extend each lane to 64 bits so the running sums cannot overflow
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+        __m128i sign = _mm_srai_epi32(v, 31);
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(v, sign));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(v, sign));
+    }
+    int64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+    sum = lanes[0] + lanes[1];
+#endif
+    for (; i < count; ++i) sum += values[i];
+    return sum;
+}
+
+namespace {
+// SSE2 has no 32-bit min/max, so blend with a compare mask
+template <bool Min>
+int32_t extreme_int(const int32_t* values, size_t count) {
+    int32_t best = Min ? INT32_MAX : INT32_MIN;
+    size_t i = 0;
+#if defined(__SSE2__)
+    if (count >= 4) {
+        __m128i acc = _mm_set1_epi32(best);
+        for (; i + 4 <= count; i += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+            __m128i take = Min ? _mm_cmplt_epi32(v, acc) : _mm_cmpgt_epi32(v, acc);
+            acc = _mm_or_si128(_mm_and_si128(take, v), _mm_andnot_si128(take, acc));
+        }
+        int32_t lanes[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+        for (int32_t lane : lanes) best = Min ? std::min(best, lane) : std::max(best, lane);
+    }
+#endif
+    for (; i < count; ++i) best = Min ? std::min(best, values[i]) : std::max(best, values[i]);
+    return best;
+}
+}
+
+int32_t min_int(const int32_t* values, size_t count) {
+    return extreme_int<true>(values, count);
+}
+
+int32_t max_int(const int32_t* values, size_t count) {
+    return extreme_int<false>(values, count);
+}
+
+void AggregateResult::add(const int32_t* values, size_t n) {
+    count += n;
+    sum += sum_int(values, n);
+    min = std::min(min, min_int(values, n));
+    max = std::max(max, max_int(values, n));
+}
+
+void AggregateResult::merge(const AggregateResult& other) {
+    count += other.count;
+    sum += other.sum;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+}
@@ -0,0 +1,212 @@
+#include "disk_manager.h"
+#include "page.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+void DiskManager::read_pages_async(std::vector<PageRead> reads) {
+    for (auto& read : reads) {
+        bool found = false;
+        try {
+            found = read_page(read.page_id, read.buffer);
+        } catch (const std::exception&) {
+        }
+        read.done(found);
+    }
+}
+
+void DiskManager::write_pages(const std::vector<PageWrite>& writes) {
+    for (const auto& write : writes) write_page(write.page_id, write.buffer);
+}
+
+std::unique_ptr<DiskManager> DiskManager::open(const std::string& path, DiskLayout preferred_layout, IoBackend io) {
+    if (!fs::exists(path)) {
+        fs::create_directory(path);
+    }
+    DiskLayout layout = preferred_layout;
+    if (fs::exists(fs::path(path) / SEGMENT_FILE_NAME)) {
+        layout = DiskLayout::SingleFile;
+    } else if (fs::exists(fs::path(path) / (std::string(PAGE_FILE_PREFIX) + "0" + PAGE_FILE_EXTENSION))) {
+        layout = DiskLayout::PagePerFile;
+    }
+    if (layout == DiskLayout::PagePerFile) {
+        return std::make_unique<PagePerFileDiskManager>(path);
+    }
+    return std::make_unique<SegmentDiskManager>((fs::path(path) / SEGMENT_FILE_NAME).string(), io);
+}
+
+std::string PagePerFileDiskManager::get_page_path(uint32_t page_id) const {
+    return path_ + "/" + PAGE_FILE_PREFIX + std::to_string(page_id) + PAGE_FILE_EXTENSION;
+}
+
+bool PagePerFileDiskManager::read_page(uint32_t page_id, uint8_t* buffer) {
+    std::ifstream in(get_page_path(page_id), std::ios::binary);
+    if (!in) return false;
+    in.read(reinterpret_cast<char*>(buffer), PAGE_SIZE);
+    return true;
+}
+
+void PagePerFileDiskManager::write_page(uint32_t page_id, const uint8_t* buffer) {
+    std::ofstream out(get_page_path(page_id), std::ios::binary);
+    out.write(reinterpret_cast<const char*>(buffer), PAGE_SIZE);
+    if (!out) throw std::runtime_error("Failed to write page " + std::to_string(page_id));
+}
+
+SegmentDiskManager::SegmentDiskManager(const std::string& path, IoBackend io) {
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0) throw std::runtime_error("Cannot open segment file " + path + ": " + std::strerror(errno));
+    struct stat st {};
+    if (fstat(fd_, &st) != 0) {
+        ::close(fd_);
+        throw std::runtime_error("Cannot stat segment file " + path + ": " + std::strerror(errno));
+    }
+    file_size_ = static_cast<uint64_t>(st.st_size);
+    try {
+        io_ = AsyncIo::create(fd_, io);
+    } catch (...) {
+        ::close(fd_);
+        throw;
+    }
+}
+
+SegmentDiskManager::~SegmentDiskManager() {
+    io_.reset();
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+bool SegmentDiskManager::read_page(uint32_t page_id, uint8_t* buffer) {
+    const uint64_t offset = static_cast<uint64_t>(page_id) * PAGE_SIZE;
+    if (offset + PAGE_SIZE > file_size_) return false;
+    size_t done = 0;
+    while (done < PAGE_SIZE) {
+        ssize_t n = ::pread(fd_, buffer + done, PAGE_SIZE - done, offset + done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) throw std::runtime_error("Failed to read page " + std::to_string(page_id));
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void SegmentDiskManager::write_page(uint32_t page_id, const uint8_t* buffer) {
+    const uint64_t offset = static_cast<uint64_t>(page_id) * PAGE_SIZE;
+    size_t done = 0;
+    while (done < PAGE_SIZE) {
+        ssize_t n = ::pwrite(fd_, buffer + done, PAGE_SIZE - done, offset + done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) throw std::runtime_error("Failed to write page " + std::to_string(page_id));
+        done += static_cast<size_t>(n);
+    }
+    grow_to(offset + PAGE_SIZE);
+}
+
+void SegmentDiskManager::grow_to(uint64_t end) {
+    uint64_t size = file_size_.load();
+    while (end > size && !file_size_.compare_exchange_weak(size, end)) {}
+}
+
+void SegmentDiskManager::read_pages_async(std::vector<PageRead> reads) {
+    std::vector<IoRequest> requests;
+    requests.reserve(reads.size());
+    for (auto& read : reads) {
+        const uint64_t offset = static_cast<uint64_t>(read.page_id) * PAGE_SIZE;
+        if (offset + PAGE_SIZE > file_size_) {
+            read.done(false);
+            continue;
+        }
+        IoRequest request;
+        request.offset = offset;
+        request.buffer = read.buffer;
+        request.size = PAGE_SIZE;
+        request.done = [done = std::move(read.done)](ssize_t result) { done(result == static_cast<ssize_t>(PAGE_SIZE)); };
+        requests.push_back(std::move(request));
+    }
+    if (!requests.empty()) io_->submit(std::move(requests));
+}
+
+void SegmentDiskManager::write_pages(const std::vector<PageWrite>& writes) {
+    std::vector<IoRequest> requests(writes.size());
+    uint64_t end = 0;
+    for (size_t i = 0; i < writes.size(); ++i) {
+        requests[i].write = true;
+        requests[i].offset = static_cast<uint64_t>(writes[i].page_id) * PAGE_SIZE;
+        requests[i].buffer = const_cast<uint8_t*>(writes[i].buffer);
+        requests[i].size = PAGE_SIZE;
+        end = std::max(end, requests[i].offset + PAGE_SIZE);
+    }
+    std::vector<ssize_t> results = io_->run(std::move(requests));
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (results[i] != static_cast<ssize_t>(PAGE_SIZE)) {
+            throw std::runtime_error("Failed to write page " + std::to_string(writes[i].page_id));
+        }
+    }
+    grow_to(end);
+}
+
+void SegmentDiskManager::sync() {
+    if (::fdatasync(fd_) != 0) throw std::runtime_error(std::string("fdatasync failed: ") + std::strerror(errno));
+}
+
+MappedSegmentDiskManager::MappedSegmentDiskManager(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Cannot open segment file " + path + ": " + std::strerror(errno));
+    struct stat st {};
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Cannot stat segment file " + path + ": " + std::strerror(errno));
+    }
+    size_ = static_cast<uint64_t>(st.st_size);
+    if (size_ > 0) {
+        void* base = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("Cannot map segment file " + path + ": " + std::strerror(errno));
+        }
+        base_ = static_cast<const uint8_t*>(base);
+    }
+    // The mapping stays valid without the descriptor
+    ::close(fd);
+}
+
+MappedSegmentDiskManager::~MappedSegmentDiskManager() {
+    if (base_ != nullptr) {
+        ::munmap(const_cast<uint8_t*>(base_), size_);
+    }
+}
+
+bool MappedSegmentDiskManager::read_page(uint32_t page_id, uint8_t* buffer) {
+    const uint8_t* image = page_image(page_id);
+    if (image == nullptr) return false;
+    std::memcpy(buffer, image, PAGE_SIZE);
+    return true;
+}
+
+void MappedSegmentDiskManager::will_need(const uint32_t* page_ids, size_t count) const {
+    size_t i = 0;
+    while (i < count) {
+        size_t run = 1;
+        while (i + run < count && page_ids[i + run] == page_ids[i] + run) ++run;
+        const uint8_t* first = page_image(page_ids[i]);
+        if (first != nullptr) {
+            // Pages are PAGE_SIZE-aligned inside a page-aligned mapping; the last may be cut short by the file end
+            const uint64_t offset = static_cast<uint64_t>(page_ids[i]) * PAGE_SIZE;
+            const uint64_t length = std::min<uint64_t>(run * PAGE_SIZE, size_ - offset);
+            ::madvise(const_cast<uint8_t*>(first), length, MADV_WILLNEED);
+        }
+        i += run;
+    }
+}
+
+void MappedSegmentDiskManager::write_page(uint32_t page_id, const uint8_t*) {
+    throw std::runtime_error("Cannot write page " + std::to_string(page_id) + ": segment is mapped read-only");
+}
@@ -0,0 +1,34 @@
+#include "frame_allocator.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+
+FrameAllocator::FrameAllocator(size_t frames) : count_(frames) {
+    const size_t wanted = frames * sizeof(PageImage);
+    if (wanted == 0) return;
+#ifdef MAP_HUGETLB
+    // Huge page mappings must cover whole huge pages
+    bytes_ = (wanted + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    void* huge = ::mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (huge != MAP_FAILED) {
+        frames_ = static_cast<PageImage*>(huge);
+        huge_pages_ = true;
+        return;
+    }
+#endif
+    bytes_ = wanted;
+    void* base = ::mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) throw std::runtime_error(std::string("Cannot map buffer pool frames: ") + std::strerror(errno));
+#ifdef MADV_HUGEPAGE
+    if (bytes_ >= HUGE_PAGE_SIZE) ::madvise(base, bytes_, MADV_HUGEPAGE);
+#endif
+    frames_ = static_cast<PageImage*>(base);
+}
+
+FrameAllocator::~FrameAllocator() {
+    if (frames_ != nullptr) {
+        ::munmap(frames_, bytes_);
+    }
+}
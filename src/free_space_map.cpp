@@ -0,0 +1,61 @@
+#include "free_space_map.h"
+#include <algorithm>
+
+uint8_t FreeSpaceMap::bucket_for(uint32_t free_bytes) {
+    return static_cast<uint8_t>(std::min(free_bytes / FSM_BUCKET_BYTES, FSM_MAX_BUCKET));
+}
+
+void FreeSpaceMap::rebuild_tree(size_t min_leaves) {
+    size_t capacity = std::max<size_t>(leaf_capacity_, 64);
+    while (capacity < min_leaves) capacity *= 2;
+    leaf_capacity_ = capacity;
+    tree_.assign(capacity * 2, 0);
+    std::copy(buckets_.begin(), buckets_.end(), tree_.begin() + capacity);
+    for (size_t node = capacity - 1; node > 0; --node) {
+        tree_[node] = std::max(tree_[node * 2], tree_[node * 2 + 1]);
+    }
+}
+
+void FreeSpaceMap::set(uint32_t block, uint32_t free_bytes) {
+    uint8_t value = bucket_for(free_bytes);
+    if (block >= buckets_.size()) {
+        buckets_.resize(block + 1, 0);
+    }
+    if (block >= leaf_capacity_) {
+        rebuild_tree(block + 1);
+    }
+    if (buckets_[block] == value && tree_[leaf_capacity_ + block] == value) return;
+    buckets_[block] = value;
+    size_t node = leaf_capacity_ + block;
+    tree_[node] = value;
+    for (node /= 2; node > 0; node /= 2) {
+        uint8_t max_child = std::max(tree_[node * 2], tree_[node * 2 + 1]);
+        if (tree_[node] == max_child) break;
+        tree_[node] = max_child;
+    }
+    dirty_ = true;
+}
+
+std::optional<uint32_t> FreeSpaceMap::find_block(uint32_t required_bytes) const {
+    uint32_t needed = (required_bytes + FSM_BUCKET_BYTES - 1) / FSM_BUCKET_BYTES;
+    if (needed == 0) needed = 1;
+    if (needed > FSM_MAX_BUCKET || leaf_capacity_ == 0 || tree_[1] < needed) return std::nullopt;
+    size_t node = 1;
+    while (node < leaf_capacity_) {
+        node = tree_[node * 2] >= needed ? node * 2 : node * 2 + 1;
+    }
+    return static_cast<uint32_t>(node - leaf_capacity_);
+}
+
+void FreeSpaceMap::load(DiskManager& disk, uint32_t head_page_id) {
+    buckets_ = read_page_chain(disk, head_page_id, storage_pages_);
+    leaf_capacity_ = 0;
+    rebuild_tree(buckets_.size());
+    dirty_ = false;
+}
+
+uint32_t FreeSpaceMap::save(DiskManager& disk, const std::function<uint32_t()>& allocate_page) {
+    uint32_t head = write_page_chain(disk, buckets_.data(), buckets_.size(), storage_pages_, allocate_page);
+    dirty_ = false;
+    return head;
+}
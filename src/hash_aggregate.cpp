@@ -0,0 +1,200 @@
+#include "hash_aggregate.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+void append_int(std::string& key, int32_t value) {
+    key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void append_text(std::string& key, std::string_view text) {
+    const uint32_t size = static_cast<uint32_t>(text.size());
+    key.append(reinterpret_cast<const char*>(&size), sizeof(size));
+    key.append(text);
+}
+
+int32_t parse_int(std::string_view text) {
+    int32_t value = 0;
+    std::from_chars(text.data(), text.data() + text.size(), value);
+    return value;
+}
+
+inline void accumulate(AggregateResult& result, int32_t value) {
+    result.count++;
+    result.sum += value;
+    result.min = std::min(result.min, value);
+    result.max = std::max(result.max, value);
+}
+}
+
+std::optional<AggregateFn> parse_aggregate_fn(const std::string& name) {
+    std::string upper = name;
+    for (auto& c : upper) c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+    if (upper == "COUNT") return AggregateFn::Count;
+    if (upper == "SUM") return AggregateFn::Sum;
+    if (upper == "MIN") return AggregateFn::Min;
+    if (upper == "MAX") return AggregateFn::Max;
+    if (upper == "AVG") return AggregateFn::Avg;
+    return std::nullopt;
+}
+
+HashAggregate::HashAggregate(std::vector<ColumnType> types, std::vector<int> group_columns, std::vector<AggregateSpec> aggregates) :
+    types_(std::move(types)), group_columns_(std::move(group_columns)), aggregates_(std::move(aggregates)) {
+    auto valid = [&](int c) { return c >= 0 && static_cast<size_t>(c) < types_.size(); };
+    for (int c : group_columns_) {
+        if (!valid(c)) throw std::runtime_error("Invalid column index for GROUP BY");
+    }
+    for (const auto& agg : aggregates_) {
+        if (agg.column < 0 && agg.fn == AggregateFn::Count) continue;
+        if (!valid(agg.column)) throw std::runtime_error("Invalid column index for aggregation");
+        if (agg.fn != AggregateFn::Count && types_[agg.column] != ColumnType::INT) {
+            throw std::runtime_error("Aggregate needs an INT column");
+        }
+    }
+    if (group_columns_.empty()) {
+        bool inserted;
+        group_for(std::string(), inserted);
+    }
+}
+
+std::vector<int> HashAggregate::columns() const {
+    std::vector<int> columns = group_columns_;
+    for (const auto& agg : aggregates_) {
+        // COUNT reads no values, so its column never has to be decoded
+        if (agg.fn != AggregateFn::Count) columns.push_back(agg.column);
+    }
+    std::sort(columns.begin(), columns.end());
+    columns.erase(std::unique(columns.begin(), columns.end()), columns.end());
+    return columns;
+}
+
+uint32_t HashAggregate::group_for(const std::string& key, bool& inserted) {
+    auto [it, added] = index_.try_emplace(key, static_cast<uint32_t>(groups_.size()));
+    inserted = added;
+    if (added) {
+        Group group;
+        group.key = key;
+        group.results.resize(aggregates_.size());
+        groups_.push_back(std::move(group));
+    }
+    return it->second;
+}
+
+void HashAggregate::add(const ColumnBatch& batch, const uint16_t* selection, size_t selected) {
+    if (selected == 0) return;
+    if (group_columns_.empty()) {
+        Group& group = groups_[0];
+        gathered_.resize(BATCH_CAPACITY);
+        for (size_t a = 0; a < aggregates_.size(); ++a) {
+            if (aggregates_[a].fn == AggregateFn::Count) {
+                group.results[a].count += selected;
+                continue;
+            }
+            gather_int(batch.ints[aggregates_[a].column].data(), selection, selected, gathered_.data());
+            group.results[a].add(gathered_.data(), selected);
+        }
+        return;
+    }
+
+    // Find every selected row's group first, then fold each aggregate column in one pass
+    row_groups_.resize(selected);
+    for (size_t k = 0; k < selected; ++k) {
+        const uint16_t row = selection[k];
+        key_.clear();
+        for (int c : group_columns_) {
+            if (types_[c] == ColumnType::INT) {
+                append_int(key_, batch.ints[c][row]);
+            } else {
+                append_text(key_, batch.texts[c][row]);
+            }
+        }
+        bool inserted;
+        const uint32_t g = group_for(key_, inserted);
+        if (inserted) groups_[g].values = batch.to_strings(row, group_columns_);
+        row_groups_[k] = g;
+    }
+    for (size_t a = 0; a < aggregates_.size(); ++a) {
+        if (aggregates_[a].fn == AggregateFn::Count) {
+            for (size_t k = 0; k < selected; ++k) groups_[row_groups_[k]].results[a].count++;
+            continue;
+        }
+        const int32_t* values = batch.ints[aggregates_[a].column].data();
+        for (size_t k = 0; k < selected; ++k) accumulate(groups_[row_groups_[k]].results[a], values[selection[k]]);
+    }
+}
+
+void HashAggregate::add(const std::vector<std::string_view>& row) {
+    uint32_t g = 0;
+    if (!group_columns_.empty()) {
+        key_.clear();
+        for (int c : group_columns_) {
+            if (types_[c] == ColumnType::INT) {
+                append_int(key_, parse_int(row[c]));
+            } else {
+                append_text(key_, row[c]);
+            }
+        }
+        bool inserted;
+        g = group_for(key_, inserted);
+        if (inserted) {
+            for (int c : group_columns_) groups_[g].values.emplace_back(row[c]);
+        }
+    }
+    Group& group = groups_[g];
+    for (size_t a = 0; a < aggregates_.size(); ++a) {
+        if (aggregates_[a].fn == AggregateFn::Count) {
+            group.results[a].count++;
+        } else {
+            accumulate(group.results[a], parse_int(row[aggregates_[a].column]));
+        }
+    }
+}
+
+void HashAggregate::merge(HashAggregate&& other) {
+    for (auto& theirs : other.groups_) {
+        bool inserted;
+        const uint32_t g = group_for(theirs.key, inserted);
+        Group& ours = groups_[g];
+        if (inserted) {
+            ours.values = std::move(theirs.values);
+            ours.results = std::move(theirs.results);
+            continue;
+        }
+        for (size_t a = 0; a < aggregates_.size(); ++a) ours.results[a].merge(theirs.results[a]);
+    }
+    other.groups_.clear();
+    other.index_.clear();
+}
+
+std::vector<std::vector<std::string>> HashAggregate::rows() const {
+    std::vector<std::vector<std::string>> rows;
+    rows.reserve(groups_.size());
+    for (const auto& group : groups_) {
+        std::vector<std::string> row = group.values;
+        for (size_t a = 0; a < aggregates_.size(); ++a) {
+            const AggregateResult& result = group.results[a];
+            switch (aggregates_[a].fn) {
+            case AggregateFn::Count: row.push_back(std::to_string(result.count)); break;
+            case AggregateFn::Sum: row.push_back(std::to_string(result.sum)); break;
+            case AggregateFn::Min: row.push_back(result.count ? std::to_string(result.min) : "NULL"); break;
+            case AggregateFn::Max: row.push_back(result.count ? std::to_string(result.max) : "NULL"); break;
+            case AggregateFn::Avg: {
+                if (result.count == 0) {
+                    row.push_back("NULL");
+                    break;
+                }
+                std::ostringstream os;
+                os << std::setprecision(15) << static_cast<double>(result.sum) / static_cast<double>(result.count);
+                row.push_back(os.str());
+                break;
+            }
+            }
+        }
+        rows.push_back(std::move(row));
+    }
+    return rows;
+}
@@ -0,0 +1,263 @@
+#include "hash_join.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+constexpr uint32_t NO_TUPLE = UINT32_MAX;
+constexpr size_t TUPLE_HEADER = sizeof(uint32_t);
+
+uint64_t mix(uint64_t h) {
+    // Finalizer from MurmurHash3, so both the bucket bits and the radix bits are well spread
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+template <typename T>
+void append_value(std::vector<uint8_t>& out, const T& value) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+void append_text(std::vector<uint8_t>& out, std::string_view text) {
+    append_value(out, static_cast<uint16_t>(text.size()));
+    out.insert(out.end(), text.begin(), text.end());
+}
+
+std::string_view read_text(const uint8_t*& in) {
+    uint16_t size;
+    std::memcpy(&size, in, sizeof(size));
+    std::string_view text(reinterpret_cast<const char*>(in + sizeof(size)), size);
+    in += sizeof(size) + size;
+    return text;
+}
+
+size_t partition_of(uint64_t hash) {
+    return static_cast<size_t>(hash >> (64 - HASH_JOIN_RADIX_BITS));
+}
+}
+
+void HashJoin::HashTable::add(const uint8_t* tuple, size_t size, uint64_t hash) {
+    offsets.push_back(static_cast<uint32_t>(arena.size()));
+    hashes.push_back(hash);
+    arena.insert(arena.end(), tuple, tuple + size);
+}
+
+void HashJoin::HashTable::finish() {
+    size_t bucket_count = 1;
+    while (bucket_count < offsets.size()) bucket_count <<= 1;
+    buckets.assign(bucket_count, NO_TUPLE);
+    next.assign(offsets.size(), NO_TUPLE);
+    for (uint32_t i = 0; i < offsets.size(); ++i) {
+        size_t bucket = hashes[i] & (bucket_count - 1);
+        next[i] = buckets[bucket];
+        buckets[bucket] = i;
+    }
+}
+
+void HashJoin::HashTable::clear() {
+    arena.clear();
+    offsets.clear();
+    next.clear();
+    buckets.clear();
+    hashes.clear();
+}
+
+HashJoin::HashJoin(FileStorageLayer& storage, JoinInput left, JoinInput right, size_t memory_budget) :
+    storage_(storage), left_(std::move(left)), right_(std::move(right)), memory_budget_(memory_budget) {
+    left_schema_ = storage_.get_schema(left_.table);
+    right_schema_ = storage_.get_schema(right_.table);
+    auto check = [](const JoinInput& input, const std::vector<ColumnSchema>& schema, std::vector<ColumnType>& types) {
+        auto valid = [&](int c) { return c >= 0 && static_cast<size_t>(c) < schema.size(); };
+        if (!valid(input.key_column)) throw std::runtime_error("Invalid join column for " + input.table);
+        for (int c : input.columns) {
+            if (!valid(c)) throw std::runtime_error("Invalid column index for " + input.table);
+            types.push_back(schema[c].type);
+        }
+    };
+    check(left_, left_schema_, left_types_);
+    check(right_, right_schema_, right_types_);
+    int_keys_ = left_schema_[left_.key_column].type == ColumnType::INT && right_schema_[right_.key_column].type == ColumnType::INT;
+}
+
+void HashJoin::scan_input(const JoinInput& input, const std::vector<ColumnSchema>& schema,
+    const std::function<void(const std::vector<uint8_t>& tuple, uint64_t hash)>& sink) {
+    std::vector<int> load = input.columns;
+    load.push_back(input.key_column);
+    if (input.filter) {
+        for (int c : input.filter->columns()) load.push_back(c);
+    }
+    std::sort(load.begin(), load.end());
+    load.erase(std::unique(load.begin(), load.end()), load.end());
+
+    BatchCursor cursor = storage_.open_batch_scan(input.table, load, input.filter.get());
+    ColumnBatch batch;
+    std::vector<uint16_t> selection(BATCH_CAPACITY);
+    std::vector<uint8_t> tuple;
+    const bool int_key_column = schema[input.key_column].type == ColumnType::INT;
+    while (cursor.next(batch)) {
+        size_t selected = batch.size;
+        if (input.filter) {
+            selected = input.filter->select(batch, selection.data());
+        } else {
+            std::iota(selection.begin(), selection.begin() + batch.size, 0);
+        }
+        for (size_t k = 0; k < selected; ++k) {
+            const uint16_t row = selection[k];
+            tuple.assign(TUPLE_HEADER, 0);
+            if (int_keys_) {
+                append_value(tuple, batch.ints[input.key_column][row]);
+            } else if (int_key_column) {
+                append_text(tuple, std::to_string(batch.ints[input.key_column][row]));
+            } else {
+                append_text(tuple, batch.texts[input.key_column][row]);
+            }
+            for (int c : input.columns) {
+                if (schema[c].type == ColumnType::INT) {
+                    append_value(tuple, batch.ints[c][row]);
+                } else {
+                    append_text(tuple, batch.texts[c][row]);
+                }
+            }
+            const uint32_t size = static_cast<uint32_t>(tuple.size());
+            std::memcpy(tuple.data(), &size, sizeof(size));
+            sink(tuple, key_hash(tuple.data()));
+        }
+    }
+    cursor.close();
+}
+
+uint64_t HashJoin::key_hash(const uint8_t* tuple) const {
+    const uint8_t* key = tuple + TUPLE_HEADER;
+    if (int_keys_) {
+        int32_t value;
+        std::memcpy(&value, key, sizeof(value));
+        return mix(static_cast<uint32_t>(value));
+    }
+    return mix(std::hash<std::string_view>()(read_text(key)));
+}
+
+bool HashJoin::keys_equal(const uint8_t* a, const uint8_t* b) const {
+    a += TUPLE_HEADER;
+    b += TUPLE_HEADER;
+    if (int_keys_) return std::memcmp(a, b, sizeof(int32_t)) == 0;
+    return read_text(a) == read_text(b);
+}
+
+void HashJoin::decode(const uint8_t* tuple, const std::vector<ColumnType>& types, QueryArena& arena, Values& values) const {
+    const uint8_t* in = tuple + TUPLE_HEADER;
+    if (int_keys_) {
+        in += sizeof(int32_t);
+    } else {
+        read_text(in);
+    }
+    values.clear();
+    for (ColumnType type : types) {
+        if (type == ColumnType::INT) {
+            int32_t value;
+            std::memcpy(&value, in, sizeof(value));
+            in += sizeof(value);
+            values.push_back(arena.print(value));
+        } else {
+            values.push_back(read_text(in));
+        }
+    }
+}
+
+void HashJoin::probe(const HashTable& table, const std::vector<uint8_t>& tuple, uint64_t hash, const Emit& emit) {
+    if (table.buckets.empty()) return;
+    const auto& build_types = stats_.build_left ? left_types_ : right_types_;
+    const auto& probe_types = stats_.build_left ? right_types_ : left_types_;
+    bool decoded = false;
+    for (uint32_t i = table.buckets[hash & (table.buckets.size() - 1)]; i != NO_TUPLE; i = table.next[i]) {
+        const uint8_t* build_tuple = table.arena.data() + table.offsets[i];
+        if (table.hashes[i] != hash || !keys_equal(build_tuple, tuple.data())) continue;
+        if (!decoded) {
+            probe_arena_.reset();
+            decode(tuple.data(), probe_types, probe_arena_, probe_values_);
+            decoded = true;
+        }
+        build_arena_.reset();
+        decode(build_tuple, build_types, build_arena_, build_values_);
+        if (stats_.build_left) {
+            emit(build_values_, probe_values_);
+        } else {
+            emit(probe_values_, build_values_);
+        }
+    }
+}
+
+void HashJoin::run(const Emit& emit) {
+    stats_ = HashJoinStats();
+    const auto started = std::chrono::steady_clock::now();
+    // Build on the smaller table; ties keep the right table as the build side
+    stats_.build_left = storage_.row_count(left_.table) < storage_.row_count(right_.table);
+    const JoinInput& build = stats_.build_left ? left_ : right_;
+    const JoinInput& probe_input = stats_.build_left ? right_ : left_;
+    const auto& build_schema = stats_.build_left ? left_schema_ : right_schema_;
+    const auto& probe_schema = stats_.build_left ? right_schema_ : left_schema_;
+
+    HashTable table;
+    std::vector<std::unique_ptr<SpillFile>> build_parts;
+    auto make_partitions = [] {
+        std::vector<std::unique_ptr<SpillFile>> parts;
+        for (size_t p = 0; p < (size_t(1) << HASH_JOIN_RADIX_BITS); ++p) parts.push_back(std::make_unique<SpillFile>());
+        return parts;
+    };
+    scan_input(build, build_schema, [&](const std::vector<uint8_t>& tuple, uint64_t hash) {
+        stats_.build_rows++;
+        if (!build_parts.empty()) {
+            build_parts[partition_of(hash)]->append(tuple.data(), tuple.size());
+            return;
+        }
+        table.add(tuple.data(), tuple.size(), hash);
+        if (table.memory() > memory_budget_) {
+            // Over budget: move what was built so far into the partitions and keep going there
+            build_parts = make_partitions();
+            for (size_t i = 0; i < table.offsets.size(); ++i) {
+                const uint8_t* held = table.arena.data() + table.offsets[i];
+                uint32_t size;
+                std::memcpy(&size, held, sizeof(size));
+                build_parts[partition_of(table.hashes[i])]->append(held, size);
+            }
+            table.clear();
+        }
+    });
+
+    if (build_parts.empty()) table.finish();
+    const auto built = std::chrono::steady_clock::now();
+    stats_.build_time = built - started;
+    if (build_parts.empty()) {
+        scan_input(probe_input, probe_schema, [&](const std::vector<uint8_t>& tuple, uint64_t hash) {
+            stats_.probe_rows++;
+            probe(table, tuple, hash, emit);
+        });
+        stats_.probe_time = std::chrono::steady_clock::now() - built;
+        return;
+    }
+
+    auto probe_parts = make_partitions();
+    scan_input(probe_input, probe_schema, [&](const std::vector<uint8_t>& tuple, uint64_t hash) {
+        stats_.probe_rows++;
+        probe_parts[partition_of(hash)]->append(tuple.data(), tuple.size());
+    });
+    stats_.partitions = build_parts.size();
+    std::vector<uint8_t> tuple;
+    for (size_t p = 0; p < build_parts.size(); ++p) {
+        stats_.spilled_bytes += build_parts[p]->bytes() + probe_parts[p]->bytes();
+        if (build_parts[p]->bytes() == 0 || probe_parts[p]->bytes() == 0) continue;
+        table.clear();
+        build_parts[p]->rewind();
+        while (build_parts[p]->read(tuple)) table.add(tuple.data(), tuple.size(), key_hash(tuple.data()));
+        table.finish();
+        probe_parts[p]->rewind();
+        while (probe_parts[p]->read(tuple)) probe(table, tuple, key_hash(tuple.data()), emit);
+    }
+    stats_.probe_time = std::chrono::steady_clock::now() - built;
+}
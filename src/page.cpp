@@ -0,0 +1,301 @@
+#include "page.h"
+#include "pax_page.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+static_assert(sizeof(std::bitset<IDS_PER_PAGE>) == PAGE_BITMAP_SIZE, "free_id_bitmap must be stored densely");
+static_assert(PAGE_BITMAP_OFFSET % alignof(std::bitset<IDS_PER_PAGE>) == 0, "free_id_bitmap must be aligned in the image");
+static_assert(sizeof(PageHeader) % alignof(Slot) == 0, "slot directory must be aligned in the image");
+
+Page::Page(uint32_t page_id) : Page(page_id, 0) {}
+Page::Page(uint32_t page_id, uint32_t id_range_start) :
+    owned_frame_(std::make_unique<PageImage>()), frame_(owned_frame_->bytes) {
+    reset(page_id, id_range_start);
+}
+
+Page::Page(PageImage& frame) : frame_(frame.bytes) {
+    reset(INVALID_PAGE_ID, 0);
+}
+
+void Page::reset(uint32_t page_id, uint32_t id_range_start) {
+    std::memset(frame_, 0, PAGE_SIZE);
+    PageHeader& header = mutable_header();
+    header.initialize(page_id);
+    header.id_range_start = id_range_start;
+    header.id_range_end = id_range_start + IDS_PER_PAGE;
+    slot_index_.fill(0);
+    live_bytes_ = 0;
+    live_slots_ = 0;
+}
+
+void Page::format_overflow(const uint8_t* data, size_t size, uint32_t next_page_id) {
+    if (size > OVERFLOW_PAGE_CAPACITY) throw std::runtime_error("Overflow piece larger than a page");
+    std::memcpy(frame_ + sizeof(PageHeader), data, size);
+    PageHeader& header = mutable_header();
+    header.free_space = 0;
+    header.free_space_offset = static_cast<uint16_t>(sizeof(PageHeader) + size);
+    header.next_page_id = next_page_id;
+    header.flags |= PAGE_OVERFLOW | PAGE_DIRTY;
+}
+
+void Page::rebuild_slot_index() {
+    slot_index_.fill(0);
+    live_bytes_ = 0;
+    live_slots_ = 0;
+    const PageHeader& header = this->header();
+    const Slot* slot_array = slots();
+    for (size_t i = 0; i < header.slot_count; ++i) {
+        const Slot& slot = slot_array[i];
+        if (!slot.is_occupied()) continue;
+        live_bytes_ += slot.length;
+        live_slots_++;
+        uint32_t idx = slot.record_id - header.id_range_start;
+        if (slot.record_id >= header.id_range_start && idx < IDS_PER_PAGE) {
+            slot_index_[idx] = static_cast<uint16_t>(i + 1);
+        }
+    }
+}
+
+std::optional<uint32_t> Page::first_free_id() const {
+#if defined(__GLIBCXX__)
+    size_t idx = (~free_id_bitmap())._Find_first();
+#else
+    size_t idx = 0;
+    while (idx < IDS_PER_PAGE && free_id_bitmap().test(idx)) ++idx;
+#endif
+    if (idx >= IDS_PER_PAGE) return std::nullopt;
+    return header().id_range_start + static_cast<uint32_t>(idx);
+}
+
+const Slot* Page::find_slot(uint32_t record_id) const {
+    const PageHeader& header = this->header();
+    if (record_id >= header.id_range_start && record_id - header.id_range_start < IDS_PER_PAGE) {
+        uint16_t entry = slot_index_[record_id - header.id_range_start];
+        return entry != 0 ? &slots()[entry - 1] : nullptr;
+    }
+    // Ids outside the assigned range are never indexed
+    for (size_t i = 0; i < header.slot_count; ++i) {
+        const Slot& slot = slots()[i];
+        if (slot.record_id == record_id && slot.is_occupied()) return &slot;
+    }
+    return nullptr;
+}
+
+Slot* Page::find_slot(uint32_t record_id) {
+    return const_cast<Slot*>(static_cast<const Page*>(this)->find_slot(record_id));
+}
+
+RowView Page::row_view(const ColumnSchema* columns, uint32_t column_count, const Slot& slot) const {
+    return slot_view(frame_, columns, column_count, slot);
+}
+
+void Page::update_free_space() {
+    if (is_pax()) {
+        pax_update_free_space();
+        return;
+    }
+    PageHeader& header = mutable_header();
+    const size_t slots_end = sizeof(PageHeader) + header.slot_count * sizeof(Slot);
+    header.free_space = header.free_space_offset > slots_end ? header.free_space_offset - slots_end : 0;
+}
+
+uint16_t Page::place_record(const uint8_t* data, size_t size) {
+    PageHeader& header = mutable_header();
+    header.free_space_offset -= static_cast<uint16_t>(size);
+    std::memcpy(frame_ + header.free_space_offset, data, size);
+    return header.free_space_offset;
+}
+
+std::optional<uint32_t> Page::insert_record(uint32_t record_id, const uint8_t* data, size_t size) {
+    if (is_pax()) return pax_insert(record_id, data, size);
+    const uint32_t required_space = sizeof(Slot) + size;
+
+    if (!has_space(required_space)) {
+        // Compacting only helps when dead records free enough room
+        if (reclaimable_space() < required_space) return std::nullopt;
+        compact_page();
+    }
+
+    Slot new_slot;
+    new_slot.offset = place_record(data, size);
+    new_slot.length = size;
+    new_slot.flags = SLOT_OCCUPIED;
+    new_slot.record_id = record_id;
+
+    PageHeader& header = mutable_header();
+    std::memcpy(mutable_slots() + header.slot_count, &new_slot, sizeof(Slot));
+    header.slot_count++;
+    if (record_id >= header.id_range_start && record_id - header.id_range_start < IDS_PER_PAGE) {
+        slot_index_[record_id - header.id_range_start] = header.slot_count;
+    }
+
+    update_free_space();
+    live_bytes_ += size;
+    live_slots_++;
+    header.flags |= PAGE_DIRTY;
+
+    return record_id;
+}
+
+std::optional<std::vector<uint8_t>> Page::get_record(uint32_t record_id) const {
+    const Slot* slot = find_slot(record_id);
+    if (slot == nullptr) {
+        return std::nullopt;
+    }
+    if (is_pax()) return pax_get(*slot);
+    const uint8_t* data = slot_data(*slot);
+    return std::vector<uint8_t>(data, data + slot->length);
+}
+
+bool Page::update_record(uint32_t record_id, const std::vector<uint8_t>& new_data) {
+    if (is_pax()) return pax_update(record_id, new_data.data(), new_data.size());
+    Slot* slot_it = find_slot(record_id);
+
+    if (slot_it == nullptr) {
+        return false;
+    }
+
+    const uint32_t space_needed = new_data.size();
+
+    if (space_needed <= slot_it->length) {
+        std::memcpy(frame_ + slot_it->offset, new_data.data(), new_data.size());
+        live_bytes_ -= slot_it->length - new_data.size();
+        slot_it->length = new_data.size();
+        mark_dirty();
+        return true;
+    }
+    if (!has_space(space_needed)) {
+        // Only compact when dropping the old copy and the dead bytes actually makes room
+        if (live_bytes_ - slot_it->length + space_needed + live_slots_ * sizeof(Slot) > PAGE_DATA_CAPACITY) {
+            return false;
+        }
+        slot_it->length = 0;
+        compact_page();
+        slot_it = find_slot(record_id);
+    }
+    live_bytes_ += new_data.size() - slot_it->length;
+    slot_it->offset = place_record(new_data.data(), new_data.size());
+    slot_it->length = new_data.size();
+    update_free_space();
+    mark_dirty();
+    return true;
+}
+
+bool Page::delete_record(uint32_t record_id) {
+    Slot* slot = find_slot(record_id);
+    if (slot == nullptr) {
+        return false;
+    }
+    slot->flags = SLOT_DELETED;
+    live_bytes_ -= slot->length;
+    live_slots_--;
+    const PageHeader& header = this->header();
+    if (record_id >= header.id_range_start && record_id - header.id_range_start < IDS_PER_PAGE) {
+        slot_index_[record_id - header.id_range_start] = 0;
+    }
+    mark_dirty();
+    if (dead_bytes() > PAGE_COMPACT_THRESHOLD) compact_page();
+    return true;
+}
+
+void Page::compact_page() {
+    if (is_pax()) {
+        pax_rebuild();
+        return;
+    }
+    // Live records move to the end of the page in slot order; the sources are read from a copy
+    // because a record can overlap its own destination
+    std::array<uint8_t, PAGE_SIZE> old_frame;
+    std::memcpy(old_frame.data(), frame_, PAGE_SIZE);
+    PageHeader& header = mutable_header();
+    Slot* slot_array = mutable_slots();
+    size_t kept = 0;
+    header.free_space_offset = PAGE_BITMAP_OFFSET;
+    for (size_t i = 0; i < header.slot_count; ++i) {
+        Slot slot = slot_array[i];
+        if (!slot.is_occupied()) continue;
+        slot.offset = place_record(old_frame.data() + slot.offset, slot.length);
+        slot_array[kept++] = slot;
+    }
+    header.slot_count = static_cast<uint16_t>(kept);
+    std::memset(frame_ + sizeof(PageHeader) + kept * sizeof(Slot), 0,
+        header.free_space_offset - sizeof(PageHeader) - kept * sizeof(Slot));
+    update_free_space();
+    rebuild_slot_index();
+    header.flags |= PAGE_DIRTY;
+}
+
+void Page::deserialize(const std::vector<uint8_t>& data) {
+    if (data.size() < PAGE_SIZE) throw std::runtime_error("Corrupt page: too small");
+    std::memcpy(frame_, data.data(), PAGE_SIZE);
+    load_image();
+}
+
+void Page::check_image(const uint8_t* image) {
+    const auto* header = reinterpret_cast<const PageHeader*>(image);
+    if (header->slot_count > IDS_PER_PAGE) throw std::runtime_error("Corrupt page: too many slots");
+    if (header->flags & PAGE_OVERFLOW) {
+        if (header->slot_count != 0 || header->free_space_offset < sizeof(PageHeader) || header->free_space_offset > PAGE_SIZE) {
+            throw std::runtime_error("Corrupt page: overflow piece out of bounds");
+        }
+        return;
+    }
+    if (header->flags & PAGE_PAX) {
+        check_pax_image(image);
+        return;
+    }
+    const size_t slots_end = sizeof(PageHeader) + header->slot_count * sizeof(Slot);
+    if (header->free_space_offset < slots_end || header->free_space_offset > PAGE_BITMAP_OFFSET) {
+        throw std::runtime_error("Corrupt page: data out of bounds");
+    }
+    const auto* slot_array = reinterpret_cast<const Slot*>(image + sizeof(PageHeader));
+    for (size_t i = 0; i < header->slot_count; ++i) {
+        const Slot& slot = slot_array[i];
+        if (slot.is_occupied() && (slot.offset < header->free_space_offset || slot.offset + slot.length > PAGE_BITMAP_OFFSET)) {
+            throw std::runtime_error("Corrupt page: record out of bounds");
+        }
+    }
+}
+
+void Page::load_image() {
+    const PageHeader& header = this->header();
+    if (header.slot_count > IDS_PER_PAGE) throw std::runtime_error("Corrupt page: too many slots");
+    if (!(header.flags & PAGE_IN_PLACE)) {
+        convert_legacy_image();
+        return;
+    }
+    check_image(frame_);
+    // An overflow page has no slots; its free space fields describe the piece
+    if (!is_overflow()) update_free_space();
+    rebuild_slot_index();
+}
+
+void Page::convert_legacy_image() {
+    // Legacy images pack live records right after the slots, with offsets relative to the heap start
+    std::array<uint8_t, PAGE_SIZE> legacy;
+    std::memcpy(legacy.data(), frame_, PAGE_SIZE);
+    PageHeader header;
+    std::memcpy(&header, legacy.data(), sizeof(PageHeader));
+    const size_t heap_start = sizeof(PageHeader) + header.slot_count * sizeof(Slot);
+    if (heap_start + header.free_space_offset > PAGE_BITMAP_OFFSET) {
+        throw std::runtime_error("Corrupt page: data out of bounds");
+    }
+    std::vector<Slot> legacy_slots(header.slot_count);
+    std::memcpy(legacy_slots.data(), legacy.data() + sizeof(PageHeader), header.slot_count * sizeof(Slot));
+
+    std::memset(frame_ + sizeof(PageHeader), 0, PAGE_BITMAP_OFFSET - sizeof(PageHeader));
+    header.flags |= PAGE_IN_PLACE;
+    header.free_space_offset = PAGE_BITMAP_OFFSET;
+    header.slot_count = 0;
+    std::memcpy(frame_, &header, sizeof(PageHeader));
+    for (Slot slot : legacy_slots) {
+        if (!slot.is_occupied()) continue;
+        if (slot.offset + slot.length > PAGE_BITMAP_OFFSET - heap_start) throw std::runtime_error("Corrupt page: record out of bounds");
+        slot.offset = place_record(legacy.data() + heap_start + slot.offset, slot.length);
+        PageHeader& current = mutable_header();
+        mutable_slots()[current.slot_count++] = slot;
+    }
+    update_free_space();
+    rebuild_slot_index();
+}
@@ -0,0 +1,46 @@
+#include "page_chain.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+std::vector<uint8_t> read_page_chain(DiskManager& disk, uint32_t head_page_id, std::vector<uint32_t>& chain_pages) {
+    std::vector<uint8_t> payload;
+    std::vector<uint8_t> buffer(PAGE_SIZE);
+    chain_pages.clear();
+    uint32_t page_id = head_page_id;
+    while (page_id != INVALID_PAGE_ID) {
+        if (!disk.read_page(page_id, buffer.data())) throw std::runtime_error("Corrupt page chain: missing page");
+        ChainPageHeader header;
+        std::memcpy(&header, buffer.data(), sizeof(ChainPageHeader));
+        if (header.byte_count > CHAIN_PAGE_PAYLOAD) throw std::runtime_error("Corrupt page chain: payload out of bounds");
+        if (chain_pages.size() > MAX_PAGE_ID / 2) throw std::runtime_error("Corrupt page chain: cycle");
+        const uint8_t* begin = buffer.data() + sizeof(ChainPageHeader);
+        payload.insert(payload.end(), begin, begin + header.byte_count);
+        chain_pages.push_back(page_id);
+        page_id = header.next_page_id;
+    }
+    return payload;
+}
+
+uint32_t write_page_chain(DiskManager& disk, const uint8_t* payload, size_t size, std::vector<uint32_t>& chain_pages,
+    const std::function<uint32_t()>& allocate_page) {
+    size_t pages_needed = std::max<size_t>(1, (size + CHAIN_PAGE_PAYLOAD - 1) / CHAIN_PAGE_PAYLOAD);
+    while (chain_pages.size() < pages_needed) {
+        chain_pages.push_back(allocate_page());
+    }
+    std::vector<uint8_t> buffer(PAGE_SIZE);
+    for (size_t i = 0; i < chain_pages.size(); ++i) {
+        std::fill(buffer.begin(), buffer.end(), 0);
+        size_t first = i * CHAIN_PAGE_PAYLOAD;
+        size_t count = first < size ? std::min<size_t>(CHAIN_PAGE_PAYLOAD, size - first) : 0;
+        ChainPageHeader header;
+        header.next_page_id = i + 1 < chain_pages.size() ? chain_pages[i + 1] : INVALID_PAGE_ID;
+        header.byte_count = count;
+        std::memcpy(buffer.data(), &header, sizeof(ChainPageHeader));
+        if (count > 0) {
+            std::memcpy(buffer.data() + sizeof(ChainPageHeader), payload + first, count);
+        }
+        disk.write_page(chain_pages[i], buffer.data());
+    }
+    return chain_pages.front();
+}
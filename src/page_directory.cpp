@@ -0,0 +1,28 @@
+#include "page_directory.h"
+#include <cstring>
+#include <stdexcept>
+
+void PageDirectory::set_block_page(uint32_t block, uint32_t page_id) {
+    if (block >= block_pages_.size()) {
+        block_pages_.resize(block + 1, INVALID_PAGE_ID);
+    }
+    block_pages_[block] = page_id;
+    dirty_ = true;
+}
+
+void PageDirectory::load(DiskManager& disk, uint32_t head_page_id) {
+    std::vector<uint8_t> payload = read_page_chain(disk, head_page_id, storage_pages_);
+    if (payload.size() % sizeof(uint32_t) != 0) throw std::runtime_error("Corrupt directory: truncated entry");
+    block_pages_.resize(payload.size() / sizeof(uint32_t));
+    if (!payload.empty()) {
+        std::memcpy(block_pages_.data(), payload.data(), payload.size());
+    }
+    dirty_ = false;
+}
+
+uint32_t PageDirectory::save(DiskManager& disk, const std::function<uint32_t()>& allocate_page) {
+    uint32_t head = write_page_chain(disk, reinterpret_cast<const uint8_t*>(block_pages_.data()),
+        block_pages_.size() * sizeof(uint32_t), storage_pages_, allocate_page);
+    dirty_ = false;
+    return head;
+}
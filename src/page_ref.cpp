@@ -0,0 +1,43 @@
+#include "page_ref.h"
+#include "pax_page.h"
+#include <stdexcept>
+
+PageRef::PageRef(PageGuard guard) : guard_(std::move(guard)) {
+    if (!guard_) return;
+    const Page& page = *guard_;
+    header_ = &page.header();
+    slots_ = page.slots();
+    slot_count_ = page.slot_count();
+    image_ = page.image();
+}
+
+PageRef PageRef::from_image(const uint8_t* image) {
+    if (!Page::is_in_place_image(image)) throw std::runtime_error("Page image must be loaded before it can be read in place");
+    Page::check_image(image);
+    PageRef ref;
+    ref.header_ = reinterpret_cast<const PageHeader*>(image);
+    ref.slots_ = reinterpret_cast<const Slot*>(image + sizeof(PageHeader));
+    ref.slot_count_ = ref.header_->slot_count;
+    ref.image_ = image;
+    return ref;
+}
+
+const Slot* PageRef::find_record(uint32_t record_id) const {
+    if (guard_) return guard_->find_record(record_id);
+    for (size_t i = 0; i < slot_count_; ++i) {
+        if (slots_[i].is_occupied() && slots_[i].record_id == record_id) return &slots_[i];
+    }
+    return nullptr;
+}
+
+RowView PageRef::row_view(const ColumnSchema* columns, uint32_t column_count, const Slot& slot) const {
+    return slot_view(image_, columns, column_count, slot);
+}
+
+void PageRef::release() {
+    guard_.release();
+    header_ = nullptr;
+    slots_ = nullptr;
+    slot_count_ = 0;
+    image_ = nullptr;
+}
@@ -0,0 +1,783 @@
+#include "pax_page.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+// Fields of one encoded tuple, read in place
+struct PaxFields {
+    int32_t ints[PAX_MAX_COLUMNS];
+    std::string_view texts[PAX_MAX_COLUMNS];
+};
+
+namespace {
+bool is_text(const PaxHeader& pax, size_t column) {
+    return (pax.text_columns >> column) & 1u;
+}
+
+ColumnEncoding encoding_of(const PaxHeader& pax, size_t column) {
+    return static_cast<ColumnEncoding>(pax.encodings[column]);
+}
+
+PaxHeader& mutable_pax_header(uint8_t* image) {
+    return *reinterpret_cast<PaxHeader*>(image + PAX_HEADER_OFFSET);
+}
+
+uint32_t align4(uint32_t bytes) {
+    return (bytes + 3) & ~3u;
+}
+
+uint32_t bit_width(uint32_t range) {
+    return range == 0 ? 0 : 32 - __builtin_clz(range);
+}
+
+// Packed values are read and written through an 8-byte window, hence the slack at the end
+uint32_t packed_bytes(uint32_t rows, uint32_t width) {
+    return align4((rows * width + 7) / 8) + sizeof(uint64_t);
+}
+
+uint32_t unpack(const uint8_t* bits, uint32_t row, uint32_t width) {
+    const uint64_t bit = static_cast<uint64_t>(row) * width;
+    uint64_t word;
+    std::memcpy(&word, bits + bit / 8, sizeof(word));
+    return static_cast<uint32_t>((word >> (bit % 8)) & ((uint64_t(1) << width) - 1));
+}
+
+void pack(uint8_t* bits, uint32_t row, uint32_t width, uint32_t value) {
+    const uint64_t bit = static_cast<uint64_t>(row) * width;
+    const uint64_t mask = ((uint64_t(1) << width) - 1) << (bit % 8);
+    uint64_t word;
+    std::memcpy(&word, bits + bit / 8, sizeof(word));
+    word = (word & ~mask) | (static_cast<uint64_t>(value) << (bit % 8));
+    std::memcpy(bits + bit / 8, &word, sizeof(word));
+}
+
+// Bytes of a minipage holding `rows` rows; `entries` is its run or dictionary capacity
+uint32_t minipage_size(ColumnEncoding encoding, uint32_t rows, uint32_t width, uint32_t entries) {
+    switch (encoding) {
+    case ColumnEncoding::FrameOfReference: return sizeof(PaxFrame) + packed_bytes(rows, width);
+    case ColumnEncoding::RunLength: return sizeof(PaxRuns) + entries * sizeof(PaxRun);
+    case ColumnEncoding::Dictionary: return sizeof(PaxDictionary) + entries * sizeof(PaxText) + align4(rows);
+    default: return rows * PAX_FIELD_SIZE;
+    }
+}
+
+// Bit width of a frame, or the entry count and capacity of runs and dictionaries
+struct MinipageParams {
+    uint32_t width = 0;
+    uint32_t count = 0;
+    uint32_t capacity = 0;
+};
+
+MinipageParams params_of(const uint8_t* image, const PaxHeader& pax, size_t column) {
+    const uint8_t* minipage = image + pax.minipages[column];
+    MinipageParams params;
+    switch (encoding_of(pax, column)) {
+    case ColumnEncoding::FrameOfReference: {
+        PaxFrame frame;
+        std::memcpy(&frame, minipage, sizeof(frame));
+        params.width = frame.width;
+        break;
+    }
+    case ColumnEncoding::RunLength:
+    case ColumnEncoding::Dictionary: {
+        // PaxRuns and PaxDictionary share their layout
+        PaxRuns runs;
+        std::memcpy(&runs, minipage, sizeof(runs));
+        params.count = runs.count;
+        params.capacity = runs.capacity;
+        break;
+    }
+    default:
+        break;
+    }
+    return params;
+}
+
+uint32_t laid_out_size(const uint8_t* image, const PaxHeader& pax, size_t column) {
+    const MinipageParams params = params_of(image, pax, column);
+    return minipage_size(encoding_of(pax, column), pax.row_capacity, params.width, params.capacity);
+}
+
+// End of the last minipage, where the free space starts
+uint32_t fixed_end(const uint8_t* image, const PaxHeader& pax) {
+    const size_t last = pax.column_count - 1;
+    return pax.minipages[last] + laid_out_size(image, pax, last);
+}
+
+const PaxRun* runs_of(const uint8_t* minipage) {
+    return reinterpret_cast<const PaxRun*>(minipage + sizeof(PaxRuns));
+}
+
+const uint8_t* entries_of(const uint8_t* minipage) {
+    return minipage + sizeof(PaxDictionary);
+}
+
+const uint8_t* codes_of(const uint8_t* minipage) {
+    PaxDictionary dictionary;
+    std::memcpy(&dictionary, minipage, sizeof(dictionary));
+    return entries_of(minipage) + dictionary.capacity * sizeof(PaxText);
+}
+
+PaxText entry_at(const uint8_t* minipage, size_t code) {
+    PaxText text;
+    std::memcpy(&text, entries_of(minipage) + code * sizeof(PaxText), sizeof(text));
+    return text;
+}
+
+std::string_view text_at(const uint8_t* image, const PaxText& text) {
+    return std::string_view(reinterpret_cast<const char*>(image + text.offset), text.length);
+}
+
+int32_t read_int(const uint8_t* image, const PaxHeader& pax, size_t column, uint16_t row) {
+    const uint8_t* minipage = image + pax.minipages[column];
+    switch (encoding_of(pax, column)) {
+    case ColumnEncoding::FrameOfReference: {
+        PaxFrame frame;
+        std::memcpy(&frame, minipage, sizeof(frame));
+        return static_cast<int32_t>(static_cast<uint32_t>(frame.base) + unpack(minipage + sizeof(PaxFrame), row, frame.width));
+    }
+    case ColumnEncoding::RunLength: {
+        PaxRuns runs;
+        std::memcpy(&runs, minipage, sizeof(runs));
+        const PaxRun* first = runs_of(minipage);
+        return std::partition_point(first, first + runs.count, [row](const PaxRun& run) { return run.end <= row; })->value;
+    }
+    default: {
+        int32_t value;
+        std::memcpy(&value, minipage + row * PAX_FIELD_SIZE, sizeof(value));
+        return value;
+    }
+    }
+}
+
+std::string_view read_text(const uint8_t* image, const PaxHeader& pax, size_t column, uint16_t row) {
+    const uint8_t* minipage = image + pax.minipages[column];
+    if (encoding_of(pax, column) == ColumnEncoding::Dictionary) {
+        return text_at(image, entry_at(minipage, codes_of(minipage)[row]));
+    }
+    PaxText text;
+    std::memcpy(&text, minipage + row * PAX_FIELD_SIZE, sizeof(text));
+    return text_at(image, text);
+}
+
+// Heap bytes a row takes: its plain TEXT fields, as counted in Slot::length
+uint32_t plain_text_bytes(const PaxHeader& pax, const PaxFields& fields) {
+    uint32_t bytes = 0;
+    for (size_t c = 0; c < pax.column_count; ++c) {
+        if (is_text(pax, c) && encoding_of(pax, c) == ColumnEncoding::Plain) bytes += static_cast<uint32_t>(fields.texts[c].size());
+    }
+    return bytes;
+}
+
+// Heap bytes held by dictionary entries
+uint32_t dictionary_bytes(const uint8_t* image, const PaxHeader& pax) {
+    uint32_t bytes = 0;
+    for (size_t c = 0; c < pax.column_count; ++c) {
+        if (encoding_of(pax, c) != ColumnEncoding::Dictionary) continue;
+        const uint8_t* minipage = image + pax.minipages[c];
+        const MinipageParams params = params_of(image, pax, c);
+        for (size_t e = 0; e < params.count; ++e) bytes += entry_at(minipage, e).length;
+    }
+    return bytes;
+}
+
+// False unless the tuple has exactly the page's fields, all inside its bytes
+bool decode_tuple(const PaxHeader& pax, const uint8_t* data, size_t size, PaxFields& fields) {
+    if (size < sizeof(TupleHeader)) return false;
+    TupleHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (header.field_count != pax.column_count) return false;
+    for (size_t c = 0; c < pax.column_count; ++c) {
+        const size_t offset = header.offsets[c];
+        if (offset + INT_SIZE > size) return false;
+        std::memcpy(&fields.ints[c], data + offset, INT_SIZE);
+        if (!is_text(pax, c)) continue;
+        const uint32_t length = static_cast<uint32_t>(fields.ints[c]);
+        if (length > size - offset - INT_SIZE) return false;
+        fields.texts[c] = std::string_view(reinterpret_cast<const char*>(data + offset + INT_SIZE), length);
+    }
+    return true;
+}
+
+// How a rebuilt page stores one column
+struct ColumnPlan {
+    ColumnEncoding encoding = ColumnEncoding::Plain;
+    uint32_t width = 0;
+    int32_t base = 0;
+    uint32_t entries = 0;    // Runs or distinct values in use
+    uint32_t heap = 0;       // Heap bytes of the rows' values
+    uint32_t plain_text = 0; // TEXT bytes the rows would take stored plain
+    std::vector<std::string_view> distinct; // Dictionary entries in code order
+    std::vector<uint8_t> codes;             // Dictionary code of each row
+};
+
+ColumnPlan plan_int(ColumnEncoding requested, const std::vector<int32_t>& values) {
+    ColumnPlan plan;
+    const uint32_t rows = static_cast<uint32_t>(values.size());
+    if (rows == 0 || requested == ColumnEncoding::Plain || requested == ColumnEncoding::Dictionary) return plan;
+    const auto [min, max] = std::minmax_element(values.begin(), values.end());
+    uint32_t runs = 1;
+    for (size_t i = 1; i < values.size(); ++i) runs += values[i] != values[i - 1];
+    const uint32_t width = bit_width(static_cast<uint32_t>(static_cast<int64_t>(*max) - *min));
+    // Stay plain unless the encoding is smaller for these rows
+    uint32_t best = minipage_size(ColumnEncoding::Plain, rows, 0, 0);
+    if (requested != ColumnEncoding::RunLength && minipage_size(ColumnEncoding::FrameOfReference, rows, width, 0) < best) {
+        best = minipage_size(ColumnEncoding::FrameOfReference, rows, width, 0);
+        plan.encoding = ColumnEncoding::FrameOfReference;
+        plan.width = width;
+        plan.base = *min;
+    }
+    if (requested != ColumnEncoding::FrameOfReference && minipage_size(ColumnEncoding::RunLength, rows, 0, runs) < best) {
+        plan.encoding = ColumnEncoding::RunLength;
+        plan.entries = runs;
+    }
+    return plan;
+}
+
+ColumnPlan plan_text(ColumnEncoding requested, const std::vector<std::string_view>& values) {
+    ColumnPlan plan;
+    const uint32_t rows = static_cast<uint32_t>(values.size());
+    for (std::string_view value : values) plan.plain_text += static_cast<uint32_t>(value.size());
+    plan.heap = plan.plain_text;
+    if (rows == 0 || (requested != ColumnEncoding::Auto && requested != ColumnEncoding::Dictionary)) return plan;
+    std::unordered_map<std::string_view, uint8_t> codes;
+    std::vector<uint8_t> row_codes;
+    row_codes.reserve(rows);
+    uint32_t distinct_bytes = 0;
+    for (std::string_view value : values) {
+        auto it = codes.find(value);
+        if (it == codes.end()) {
+            if (plan.distinct.size() == PAX_DICTIONARY_MAX) return plan;
+            it = codes.emplace(value, static_cast<uint8_t>(plan.distinct.size())).first;
+            plan.distinct.push_back(value);
+            distinct_bytes += static_cast<uint32_t>(value.size());
+        }
+        row_codes.push_back(it->second);
+    }
+    const uint32_t entries = static_cast<uint32_t>(plan.distinct.size());
+    if (minipage_size(ColumnEncoding::Dictionary, rows, 0, entries) + distinct_bytes >=
+        minipage_size(ColumnEncoding::Plain, rows, 0, 0) + plan.plain_text) {
+        plan.distinct.clear();
+        return plan;
+    }
+    plan.encoding = ColumnEncoding::Dictionary;
+    plan.entries = entries;
+    plan.heap = distinct_bytes;
+    plan.codes = std::move(row_codes);
+    return plan;
+}
+
+// Runs or dictionary entries to make room for when `rows` rows are laid out with capacity for `capacity`
+uint32_t entry_capacity(const ColumnPlan& plan, uint32_t rows, uint32_t capacity) {
+    uint32_t headroom = 0;
+    if (capacity > rows) headroom = std::max<uint32_t>(1, ((capacity - rows) * plan.entries + rows - 1) / rows);
+    const uint32_t limit = plan.encoding == ColumnEncoding::Dictionary ? PAX_DICTIONARY_MAX : capacity;
+    return std::min(plan.entries + headroom, limit);
+}
+}
+
+int32_t pax_encoded_int(const uint8_t* image, size_t column, uint16_t row) {
+    return read_int(image, pax_header(image), column, row);
+}
+
+std::string_view pax_encoded_text(const uint8_t* image, size_t column, uint16_t row) {
+    return read_text(image, pax_header(image), column, row);
+}
+
+void pax_gather_ints(const uint8_t* image, size_t column, const uint16_t* rows, size_t count, int32_t* out) {
+    const PaxHeader& pax = pax_header(image);
+    const uint8_t* minipage = image + pax.minipages[column];
+    switch (encoding_of(pax, column)) {
+    case ColumnEncoding::FrameOfReference: {
+        PaxFrame frame;
+        std::memcpy(&frame, minipage, sizeof(frame));
+        const uint8_t* bits = minipage + sizeof(PaxFrame);
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = static_cast<int32_t>(static_cast<uint32_t>(frame.base) + unpack(bits, rows[i], frame.width));
+        }
+        break;
+    }
+    case ColumnEncoding::RunLength: {
+        // Rows ascend, so the runs are walked once
+        const PaxRun* run = runs_of(minipage);
+        for (size_t i = 0; i < count; ++i) {
+            while (run->end <= rows[i]) ++run;
+            out[i] = run->value;
+        }
+        break;
+    }
+    default:
+        for (size_t i = 0; i < count; ++i) std::memcpy(&out[i], minipage + rows[i] * PAX_FIELD_SIZE, sizeof(int32_t));
+        break;
+    }
+}
+
+size_t pax_dictionary(const uint8_t* image, size_t column, std::string_view* entries) {
+    const PaxHeader& pax = pax_header(image);
+    if (encoding_of(pax, column) != ColumnEncoding::Dictionary) return 0;
+    const uint8_t* minipage = image + pax.minipages[column];
+    const MinipageParams params = params_of(image, pax, column);
+    for (size_t e = 0; e < params.count; ++e) entries[e] = text_at(image, entry_at(minipage, e));
+    return params.count;
+}
+
+void pax_gather_codes(const uint8_t* image, size_t column, const uint16_t* rows, size_t count, uint8_t* out) {
+    const PaxHeader& pax = pax_header(image);
+    const uint8_t* codes = codes_of(image + pax.minipages[column]);
+    for (size_t i = 0; i < count; ++i) out[i] = codes[rows[i]];
+}
+
+void Page::format_pax(uint16_t column_count, uint16_t text_columns, const ColumnEncoding* encodings) {
+    if (column_count == 0 || column_count > PAX_MAX_COLUMNS) {
+        throw std::runtime_error("A PAX page holds 1 to " + std::to_string(PAX_MAX_COLUMNS) + " columns");
+    }
+    PageHeader& header = mutable_header();
+    header.flags |= PAGE_PAX;
+    PaxHeader& pax = mutable_pax_header(frame_);
+    pax = PaxHeader {};
+    pax.column_count = column_count;
+    pax.text_columns = static_cast<uint16_t>(text_columns & ((1u << column_count) - 1));
+    const uint32_t per_row = pax_row_overhead(column_count) + __builtin_popcount(pax.text_columns) * PAX_TEXT_ESTIMATE;
+    pax.row_capacity = static_cast<uint16_t>(std::min<uint32_t>(IDS_PER_PAGE, PAX_DATA_CAPACITY / per_row));
+    const uint32_t first = sizeof(PageHeader) + pax.row_capacity * sizeof(Slot);
+    for (uint32_t c = 0; c < column_count; ++c) {
+        pax.minipages[c] = static_cast<uint16_t>(first + c * pax.row_capacity * PAX_FIELD_SIZE);
+        pax.requested[c] = static_cast<uint8_t>(encodings ? encodings[c] : ColumnEncoding::Plain);
+        pax.encodings[c] = static_cast<uint8_t>(ColumnEncoding::Plain);
+    }
+    header.free_space_offset = PAX_HEADER_OFFSET;
+    update_free_space();
+    mark_dirty();
+}
+
+void Page::pax_update_free_space() {
+    PageHeader& header = mutable_header();
+    const uint32_t end = fixed_end(frame_, pax_header(frame_));
+    header.free_space = header.free_space_offset > end ? static_cast<uint16_t>(header.free_space_offset - end) : 0;
+}
+
+uint32_t Page::pax_reclaimable_space() const {
+    // What the live rows would take laid out again with the encodings they have now
+    const PaxHeader& pax = pax_header(frame_);
+    uint32_t used = live_slots_ * sizeof(Slot) + live_bytes_ + dictionary_bytes(frame_, pax);
+    for (size_t c = 0; c < pax.column_count; ++c) {
+        const MinipageParams params = params_of(frame_, pax, c);
+        used += minipage_size(encoding_of(pax, c), live_slots_, params.width, params.count);
+    }
+    return used < PAX_DATA_CAPACITY ? PAX_DATA_CAPACITY - used : 0;
+}
+
+uint32_t Page::pax_dead_bytes() const {
+    const PageHeader& header = this->header();
+    const PaxHeader& pax = pax_header(frame_);
+    uint32_t row_bytes = sizeof(Slot);
+    for (size_t c = 0; c < pax.column_count; ++c) {
+        switch (encoding_of(pax, c)) {
+        case ColumnEncoding::Plain: row_bytes += PAX_FIELD_SIZE; break;
+        case ColumnEncoding::Dictionary: row_bytes += 1; break;
+        case ColumnEncoding::FrameOfReference: row_bytes += params_of(frame_, pax, c).width / 8; break;
+        default: break;
+        }
+    }
+    const uint32_t heap_bytes = PAX_HEADER_OFFSET - header.free_space_offset;
+    return (header.slot_count - live_slots_) * row_bytes + heap_bytes - live_bytes_ - dictionary_bytes(frame_, pax);
+}
+
+bool Page::pax_row_fits(const PaxFields& fields, uint16_t row, bool append) const {
+    const PaxHeader& pax = pax_header(frame_);
+    uint32_t heap = 0;
+    for (size_t c = 0; c < pax.column_count; ++c) {
+        const uint8_t* minipage = frame_ + pax.minipages[c];
+        switch (encoding_of(pax, c)) {
+        case ColumnEncoding::FrameOfReference: {
+            PaxFrame frame;
+            std::memcpy(&frame, minipage, sizeof(frame));
+            const int64_t offset = static_cast<int64_t>(fields.ints[c]) - frame.base;
+            if (offset < 0 || offset > static_cast<int64_t>((uint64_t(1) << frame.width) - 1)) return false;
+            break;
+        }
+        case ColumnEncoding::RunLength: {
+            PaxRuns runs;
+            std::memcpy(&runs, minipage, sizeof(runs));
+            const bool extends = runs.count > 0 && runs_of(minipage)[runs.count - 1].value == fields.ints[c];
+            // A changed value inside a run would split it
+            if (append ? !extends && runs.count == runs.capacity : read_int(frame_, pax, c, row) != fields.ints[c]) return false;
+            break;
+        }
+        case ColumnEncoding::Dictionary: {
+            PaxDictionary dictionary;
+            std::memcpy(&dictionary, minipage, sizeof(dictionary));
+            bool found = false;
+            for (size_t e = 0; e < dictionary.count && !found; ++e) found = text_at(frame_, entry_at(minipage, e)) == fields.texts[c];
+            if (found) break;
+            if (dictionary.count == dictionary.capacity) return false;
+            heap += static_cast<uint32_t>(fields.texts[c].size());
+            break;
+        }
+        default:
+            if (!is_text(pax, c)) break;
+            if (append) {
+                heap += static_cast<uint32_t>(fields.texts[c].size());
+            } else {
+                PaxText text;
+                std::memcpy(&text, minipage + row * PAX_FIELD_SIZE, sizeof(text));
+                // Text that does not grow is rewritten in place
+                if (fields.texts[c].size() > text.length) heap += static_cast<uint32_t>(fields.texts[c].size());
+            }
+            break;
+        }
+    }
+    return heap <= header().free_space;
+}
+
+void Page::pax_store_row(const PaxFields& fields, uint16_t row, bool append) {
+    const PaxHeader& pax = pax_header(frame_);
+    for (size_t c = 0; c < pax.column_count; ++c) {
+        uint8_t* minipage = frame_ + pax.minipages[c];
+        switch (encoding_of(pax, c)) {
+        case ColumnEncoding::FrameOfReference: {
+            PaxFrame frame;
+            std::memcpy(&frame, minipage, sizeof(frame));
+            pack(minipage + sizeof(PaxFrame), row, frame.width, static_cast<uint32_t>(fields.ints[c]) - static_cast<uint32_t>(frame.base));
+            break;
+        }
+        case ColumnEncoding::RunLength: {
+            // An update only gets here with the value the row already has
+            if (!append) break;
+            PaxRuns runs;
+            std::memcpy(&runs, minipage, sizeof(runs));
+            auto* run_array = reinterpret_cast<PaxRun*>(minipage + sizeof(PaxRuns));
+            if (runs.count > 0 && run_array[runs.count - 1].value == fields.ints[c]) {
+                run_array[runs.count - 1].end = static_cast<uint16_t>(row + 1);
+                break;
+            }
+            run_array[runs.count++] = PaxRun {static_cast<uint16_t>(row + 1), 0, fields.ints[c]};
+            std::memcpy(minipage, &runs, sizeof(runs));
+            break;
+        }
+        case ColumnEncoding::Dictionary: {
+            PaxDictionary dictionary;
+            std::memcpy(&dictionary, minipage, sizeof(dictionary));
+            size_t code = 0;
+            while (code < dictionary.count && text_at(frame_, entry_at(minipage, code)) != fields.texts[c]) ++code;
+            if (code == dictionary.count) {
+                const auto* bytes = reinterpret_cast<const uint8_t*>(fields.texts[c].data());
+                const PaxText entry = {place_record(bytes, fields.texts[c].size()), static_cast<uint16_t>(fields.texts[c].size())};
+                std::memcpy(minipage + sizeof(PaxDictionary) + code * sizeof(PaxText), &entry, sizeof(entry));
+                dictionary.count++;
+                std::memcpy(minipage, &dictionary, sizeof(dictionary));
+            }
+            minipage[sizeof(PaxDictionary) + dictionary.capacity * sizeof(PaxText) + row] = static_cast<uint8_t>(code);
+            break;
+        }
+        default: {
+            uint8_t* field = minipage + row * PAX_FIELD_SIZE;
+            if (!is_text(pax, c)) {
+                std::memcpy(field, &fields.ints[c], PAX_FIELD_SIZE);
+                break;
+            }
+            PaxText text {};
+            if (!append) std::memcpy(&text, field, sizeof(text));
+            const auto* bytes = reinterpret_cast<const uint8_t*>(fields.texts[c].data());
+            if (!append && fields.texts[c].size() <= text.length) {
+                std::memmove(frame_ + text.offset, bytes, fields.texts[c].size());
+            } else {
+                text.offset = place_record(bytes, fields.texts[c].size());
+            }
+            text.length = static_cast<uint16_t>(fields.texts[c].size());
+            std::memcpy(field, &text, sizeof(text));
+            break;
+        }
+        }
+    }
+}
+
+std::optional<uint32_t> Page::pax_insert(uint32_t record_id, const uint8_t* data, size_t size) {
+    const PaxHeader& pax = pax_header(frame_);
+    PaxFields fields;
+    if (!decode_tuple(pax, data, size, fields)) return std::nullopt;
+    PageHeader& header = mutable_header();
+    const uint16_t row = header.slot_count;
+    if (row == pax.row_capacity || !pax_row_fits(fields, row, true)) {
+        if (!pax_rebuild(&fields, row, record_id)) return std::nullopt;
+        return record_id;
+    }
+
+    pax_store_row(fields, row, true);
+    Slot slot;
+    slot.offset = row;
+    slot.length = static_cast<uint16_t>(plain_text_bytes(pax, fields));
+    slot.flags = SLOT_OCCUPIED;
+    slot.record_id = record_id;
+    std::memcpy(mutable_slots() + row, &slot, sizeof(Slot));
+    header.slot_count++;
+    if (record_id >= header.id_range_start && record_id - header.id_range_start < IDS_PER_PAGE) {
+        slot_index_[record_id - header.id_range_start] = header.slot_count;
+    }
+    update_free_space();
+    live_bytes_ += slot.length;
+    live_slots_++;
+    header.flags |= PAGE_DIRTY;
+    return record_id;
+}
+
+std::vector<uint8_t> Page::pax_get(const Slot& slot) const {
+    // Rebuild the tuple exactly as it was encoded for insert
+    const PaxHeader& pax = pax_header(frame_);
+    std::string_view texts[PAX_MAX_COLUMNS];
+    size_t size = sizeof(TupleHeader) + pax.column_count * INT_SIZE;
+    for (size_t c = 0; c < pax.column_count; ++c) {
+        if (!is_text(pax, c)) continue;
+        texts[c] = read_text(frame_, pax, c, slot.offset);
+        size += texts[c].size();
+    }
+    std::vector<uint8_t> tuple(size);
+    TupleHeader header {};
+    header.field_count = pax.column_count;
+    size_t offset = sizeof(TupleHeader);
+    for (size_t c = 0; c < pax.column_count; ++c) {
+        header.offsets[c] = static_cast<uint16_t>(offset);
+        if (!is_text(pax, c)) {
+            const int32_t value = read_int(frame_, pax, c, slot.offset);
+            std::memcpy(tuple.data() + offset, &value, INT_SIZE);
+            offset += INT_SIZE;
+            continue;
+        }
+        const uint32_t length = static_cast<uint32_t>(texts[c].size());
+        std::memcpy(tuple.data() + offset, &length, INT_SIZE);
+        std::memcpy(tuple.data() + offset + INT_SIZE, texts[c].data(), length);
+        offset += INT_SIZE + length;
+    }
+    std::memcpy(tuple.data(), &header, sizeof(header));
+    return tuple;
+}
+
+bool Page::pax_update(uint32_t record_id, const uint8_t* data, size_t size) {
+    Slot* slot = find_slot(record_id);
+    if (slot == nullptr) return false;
+    const PaxHeader& pax = pax_header(frame_);
+    PaxFields fields;
+    if (!decode_tuple(pax, data, size, fields)) return false;
+    if (!pax_row_fits(fields, slot->offset, false)) return pax_rebuild(&fields, slot->offset, record_id);
+
+    pax_store_row(fields, slot->offset, false);
+    const uint32_t length = plain_text_bytes(pax, fields);
+    live_bytes_ = live_bytes_ - slot->length + length;
+    slot->length = static_cast<uint16_t>(length);
+    update_free_space();
+    mark_dirty();
+    return true;
+}
+
+bool Page::pax_rebuild(const PaxFields* changed, uint16_t row, uint32_t record_id) {
+    // Sources are read from a copy, since the new minipages overlap the old ones
+    std::array<uint8_t, PAGE_SIZE> old_frame;
+    std::memcpy(old_frame.data(), frame_, PAGE_SIZE);
+    const PaxHeader& old_pax = pax_header(old_frame.data());
+    const auto* old_slots = reinterpret_cast<const Slot*>(old_frame.data() + sizeof(PageHeader));
+    const size_t columns = old_pax.column_count;
+
+    // Decode the rows that stay, with the change applied
+    std::vector<Slot> slots;
+    std::vector<std::vector<int32_t>> ints(columns);
+    std::vector<std::vector<std::string_view>> texts(columns);
+    auto add_row = [&](const Slot& slot, const PaxFields* fields, uint16_t from) {
+        slots.push_back(slot);
+        for (size_t c = 0; c < columns; ++c) {
+            if (is_text(old_pax, c)) {
+                texts[c].push_back(fields ? fields->texts[c] : read_text(old_frame.data(), old_pax, c, from));
+            } else {
+                ints[c].push_back(fields ? fields->ints[c] : read_int(old_frame.data(), old_pax, c, from));
+            }
+        }
+    };
+    const uint16_t old_count = header().slot_count;
+    for (uint16_t i = 0; i < old_count; ++i) {
+        if (old_slots[i].is_occupied()) add_row(old_slots[i], changed && i == row ? changed : nullptr, i);
+    }
+    if (changed && row == old_count) add_row(Slot {0, 0, SLOT_OCCUPIED, record_id}, changed, 0);
+    const uint32_t rows = static_cast<uint32_t>(slots.size());
+    if (rows > IDS_PER_PAGE) return false;
+
+    std::vector<ColumnPlan> plans(columns);
+    uint32_t heap = 0;
+    uint32_t plain_text = 0;
+    uint32_t plain_text_columns = 0;
+    for (size_t c = 0; c < columns; ++c) {
+        const auto requested = static_cast<ColumnEncoding>(old_pax.requested[c]);
+        plans[c] = is_text(old_pax, c) ? plan_text(requested, texts[c]) : plan_int(requested, ints[c]);
+        heap += plans[c].heap;
+        if (is_text(old_pax, c) && plans[c].encoding == ColumnEncoding::Plain) {
+            plain_text += plans[c].plain_text;
+            plain_text_columns++;
+        }
+    }
+    // Bytes the page needs with room for `capacity` rows, counting on the text the rows so far average
+    const uint32_t text_per_row = rows > 0 ? plain_text / rows : plain_text_columns * PAX_TEXT_ESTIMATE;
+    auto needed = [&](uint32_t capacity) {
+        uint32_t bytes = capacity * sizeof(Slot) + heap + (capacity - rows) * text_per_row;
+        for (const auto& plan : plans) {
+            bytes += minipage_size(plan.encoding, capacity, plan.width, entry_capacity(plan, rows, capacity));
+        }
+        return bytes;
+    };
+    if (needed(rows) > PAX_DATA_CAPACITY) return false;
+    uint32_t low = rows;
+    uint32_t high = IDS_PER_PAGE;
+    while (low < high) {
+        const uint32_t mid = (low + high + 1) / 2;
+        if (needed(mid) <= PAX_DATA_CAPACITY) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    const uint32_t capacity = low;
+
+    std::memset(frame_ + sizeof(PageHeader), 0, PAX_HEADER_OFFSET - sizeof(PageHeader));
+    PaxHeader& pax = mutable_pax_header(frame_);
+    pax.row_capacity = static_cast<uint16_t>(capacity);
+    PageHeader& header = mutable_header();
+    header.free_space_offset = PAX_HEADER_OFFSET;
+    uint32_t offset = sizeof(PageHeader) + capacity * sizeof(Slot);
+    for (size_t c = 0; c < columns; ++c) {
+        const ColumnPlan& plan = plans[c];
+        pax.minipages[c] = static_cast<uint16_t>(offset);
+        pax.encodings[c] = static_cast<uint8_t>(plan.encoding);
+        uint8_t* minipage = frame_ + offset;
+        const uint32_t entries = entry_capacity(plan, rows, capacity);
+        offset += minipage_size(plan.encoding, capacity, plan.width, entries);
+        if (plan.encoding == ColumnEncoding::FrameOfReference) {
+            const PaxFrame frame = {plan.base, static_cast<uint8_t>(plan.width), {}};
+            std::memcpy(minipage, &frame, sizeof(frame));
+        } else if (plan.encoding == ColumnEncoding::RunLength) {
+            const PaxRuns runs = {0, static_cast<uint16_t>(entries)};
+            std::memcpy(minipage, &runs, sizeof(runs));
+        } else if (plan.encoding == ColumnEncoding::Dictionary) {
+            const PaxDictionary dictionary = {static_cast<uint16_t>(plan.entries), static_cast<uint16_t>(entries)};
+            std::memcpy(minipage, &dictionary, sizeof(dictionary));
+            for (size_t e = 0; e < plan.distinct.size(); ++e) {
+                const auto* bytes = reinterpret_cast<const uint8_t*>(plan.distinct[e].data());
+                const PaxText entry = {place_record(bytes, plan.distinct[e].size()), static_cast<uint16_t>(plan.distinct[e].size())};
+                std::memcpy(minipage + sizeof(PaxDictionary) + e * sizeof(PaxText), &entry, sizeof(entry));
+            }
+            std::memcpy(minipage + sizeof(PaxDictionary) + entries * sizeof(PaxText), plan.codes.data(), rows);
+        }
+    }
+
+    // Dictionary codes are in place already; every other column is written row by row
+    for (uint32_t i = 0; i < rows; ++i) {
+        uint32_t text_bytes = 0;
+        for (size_t c = 0; c < columns; ++c) {
+            uint8_t* minipage = frame_ + pax.minipages[c];
+            switch (plans[c].encoding) {
+            case ColumnEncoding::FrameOfReference:
+                pack(minipage + sizeof(PaxFrame), i, plans[c].width, static_cast<uint32_t>(ints[c][i]) - static_cast<uint32_t>(plans[c].base));
+                break;
+            case ColumnEncoding::RunLength: {
+                PaxRuns runs;
+                std::memcpy(&runs, minipage, sizeof(runs));
+                auto* run_array = reinterpret_cast<PaxRun*>(minipage + sizeof(PaxRuns));
+                if (runs.count == 0 || run_array[runs.count - 1].value != ints[c][i]) run_array[runs.count++] = PaxRun {0, 0, ints[c][i]};
+                run_array[runs.count - 1].end = static_cast<uint16_t>(i + 1);
+                std::memcpy(minipage, &runs, sizeof(runs));
+                break;
+            }
+            case ColumnEncoding::Dictionary:
+                break;
+            default:
+                if (is_text(pax, c)) {
+                    const auto* bytes = reinterpret_cast<const uint8_t*>(texts[c][i].data());
+                    const PaxText text = {place_record(bytes, texts[c][i].size()), static_cast<uint16_t>(texts[c][i].size())};
+                    std::memcpy(minipage + i * PAX_FIELD_SIZE, &text, sizeof(text));
+                    text_bytes += text.length;
+                } else {
+                    std::memcpy(minipage + i * PAX_FIELD_SIZE, &ints[c][i], PAX_FIELD_SIZE);
+                }
+                break;
+            }
+        }
+        Slot slot = slots[i];
+        slot.offset = static_cast<uint16_t>(i);
+        slot.length = static_cast<uint16_t>(text_bytes);
+        mutable_slots()[i] = slot;
+    }
+    header.slot_count = static_cast<uint16_t>(rows);
+    update_free_space();
+    rebuild_slot_index();
+    header.flags |= PAGE_DIRTY;
+    return true;
+}
+
+void Page::check_pax_image(const uint8_t* image) {
+    const auto* header = reinterpret_cast<const PageHeader*>(image);
+    const PaxHeader& pax = pax_header(image);
+    if (pax.column_count == 0 || pax.column_count > PAX_MAX_COLUMNS || pax.row_capacity > IDS_PER_PAGE ||
+        header->slot_count > pax.row_capacity) {
+        throw std::runtime_error("Corrupt page: bad PAX header");
+    }
+    uint32_t end = sizeof(PageHeader) + pax.row_capacity * sizeof(Slot);
+    for (uint32_t c = 0; c < pax.column_count; ++c) {
+        const auto encoding = encoding_of(pax, c);
+        const bool valid = is_text(pax, c)
+            ? encoding == ColumnEncoding::Plain || encoding == ColumnEncoding::Dictionary
+            : encoding == ColumnEncoding::Plain || encoding == ColumnEncoding::FrameOfReference || encoding == ColumnEncoding::RunLength;
+        if (!valid || pax.requested[c] > static_cast<uint8_t>(ColumnEncoding::RunLength) || pax.minipages[c] != end ||
+            end + sizeof(PaxFrame) > PAX_HEADER_OFFSET) {
+            throw std::runtime_error("Corrupt page: bad PAX minipage");
+        }
+        const MinipageParams params = params_of(image, pax, c);
+        if (params.width > 32 || params.count > params.capacity ||
+            (encoding == ColumnEncoding::Dictionary && params.capacity > PAX_DICTIONARY_MAX)) {
+            throw std::runtime_error("Corrupt page: bad PAX minipage");
+        }
+        end += laid_out_size(image, pax, c);
+        if (end > PAX_HEADER_OFFSET) throw std::runtime_error("Corrupt page: bad PAX minipage");
+    }
+    if (header->free_space_offset < end || header->free_space_offset > PAX_HEADER_OFFSET) {
+        throw std::runtime_error("Corrupt page: data out of bounds");
+    }
+    auto check_text = [&](const PaxText& text) {
+        if (text.offset < header->free_space_offset || text.offset + text.length > PAX_HEADER_OFFSET) {
+            throw std::runtime_error("Corrupt page: record out of bounds");
+        }
+    };
+    for (uint32_t c = 0; c < pax.column_count; ++c) {
+        const uint8_t* minipage = image + pax.minipages[c];
+        const MinipageParams params = params_of(image, pax, c);
+        if (encoding_of(pax, c) == ColumnEncoding::RunLength) {
+            // Runs cover exactly the page's rows, in order
+            uint32_t previous = 0;
+            for (size_t r = 0; r < params.count; ++r) {
+                if (runs_of(minipage)[r].end <= previous) throw std::runtime_error("Corrupt page: bad PAX run");
+                previous = runs_of(minipage)[r].end;
+            }
+            if (previous != header->slot_count) throw std::runtime_error("Corrupt page: bad PAX run");
+        } else if (encoding_of(pax, c) == ColumnEncoding::Dictionary) {
+            for (size_t e = 0; e < params.count; ++e) check_text(entry_at(minipage, e));
+        }
+    }
+    const auto* slot_array = reinterpret_cast<const Slot*>(image + sizeof(PageHeader));
+    for (size_t i = 0; i < header->slot_count; ++i) {
+        const Slot& slot = slot_array[i];
+        if (!slot.is_occupied()) continue;
+        if (slot.offset != i) throw std::runtime_error("Corrupt page: PAX row out of order");
+        uint32_t text_bytes = 0;
+        for (size_t c = 0; c < pax.column_count; ++c) {
+            if (!is_text(pax, c)) continue;
+            const uint8_t* minipage = image + pax.minipages[c];
+            if (encoding_of(pax, c) == ColumnEncoding::Dictionary) {
+                if (codes_of(minipage)[i] >= params_of(image, pax, c).count) throw std::runtime_error("Corrupt page: bad PAX code");
+                continue;
+            }
+            PaxText text;
+            std::memcpy(&text, minipage + i * PAX_FIELD_SIZE, sizeof(text));
+            check_text(text);
+            text_bytes += text.length;
+        }
+        if (text_bytes != slot.length) throw std::runtime_error("Corrupt page: PAX row length mismatch");
+    }
+}
@@ -0,0 +1,216 @@
+#include "predicate.h"
+#include "pax_page.h"
+#include <algorithm>
+#include <functional>
+
+std::optional<int32_t> exact_int(const std::string& value) {
+    try {
+        int parsed = std::stoi(value);
+        if (std::to_string(parsed) == value) return parsed;
+    } catch (...) {}
+    return std::nullopt;
+}
+
+namespace {
+using ClauseEval = bool (*)(const RowView&, const CompiledClause&);
+
+std::optional<CompareOp> parse_op(const std::string& op) {
+    if (op == "=") return CompareOp::Eq;
+    if (op == "!=") return CompareOp::Ne;
+    if (op == "<") return CompareOp::Lt;
+    if (op == "<=") return CompareOp::Le;
+    if (op == ">") return CompareOp::Gt;
+    if (op == ">=") return CompareOp::Ge;
+    return std::nullopt;
+}
+
+template <typename Cmp>
+bool int_field(const RowView& row, const CompiledClause& clause) {
+    return Cmp()(row.get_int(clause.column), clause.int_value);
+}
+
+// Ordering on a TEXT column compares its value as a number, as the text filters always have
+template <typename Cmp>
+bool text_field_as_int(const RowView& row, const CompiledClause& clause) {
+    return Cmp()(std::stoi(std::string(row.get_text(clause.column))), clause.int_value);
+}
+
+template <typename Cmp>
+bool text_field(const RowView& row, const CompiledClause& clause) {
+    return Cmp()(row.get_text(clause.column), std::string_view(clause.text_value));
+}
+
+ClauseEval select_eval(ColumnType type, CompareOp op) {
+    if (type == ColumnType::INT) {
+        switch (op) {
+        case CompareOp::Eq: return int_field<std::equal_to<>>;
+        case CompareOp::Ne: return int_field<std::not_equal_to<>>;
+        case CompareOp::Lt: return int_field<std::less<>>;
+        case CompareOp::Le: return int_field<std::less_equal<>>;
+        case CompareOp::Gt: return int_field<std::greater<>>;
+        case CompareOp::Ge: return int_field<std::greater_equal<>>;
+        }
+    }
+    switch (op) {
+    case CompareOp::Eq: return text_field<std::equal_to<>>;
+    case CompareOp::Ne: return text_field<std::not_equal_to<>>;
+    case CompareOp::Lt: return text_field_as_int<std::less<>>;
+    case CompareOp::Le: return text_field_as_int<std::less_equal<>>;
+    case CompareOp::Gt: return text_field_as_int<std::greater<>>;
+    case CompareOp::Ge: return text_field_as_int<std::greater_equal<>>;
+    }
+    return nullptr;
+}
+
+bool text_passes(const CompiledClause& clause, std::string_view value) {
+    switch (clause.op) {
+    case CompareOp::Eq: return value == clause.text_value;
+    case CompareOp::Ne: return value != clause.text_value;
+    case CompareOp::Lt: return std::stoi(std::string(value)) < clause.int_value;
+    case CompareOp::Le: return std::stoi(std::string(value)) <= clause.int_value;
+    case CompareOp::Gt: return std::stoi(std::string(value)) > clause.int_value;
+    case CompareOp::Ge: return std::stoi(std::string(value)) >= clause.int_value;
+    }
+    return false;
+}
+
+// Lower runs first: fixed-width compares, then text equality, then parsing text as a number
+int clause_cost(const CompiledClause& clause) {
+    if (clause.type == ColumnType::INT) return 0;
+    return clause.op == CompareOp::Eq || clause.op == CompareOp::Ne ? 1 : 2;
+}
+}
+
+PredicateProgram::PredicateProgram(const std::vector<FilterClause>& clauses, const std::vector<ColumnSchema>& columns) {
+    for (const auto& [column, op_text, value] : clauses) {
+        auto op = parse_op(op_text);
+        if (!op || column < 0 || static_cast<size_t>(column) >= columns.size()) {
+            never_ = true;
+            continue;
+        }
+        min_columns_ = std::max(min_columns_, static_cast<size_t>(column) + 1);
+        CompiledClause clause{column, columns[column].type, *op, 0, value, select_eval(columns[column].type, *op)};
+        if (*op == CompareOp::Eq || *op == CompareOp::Ne) {
+            if (clause.type == ColumnType::INT) {
+                // Equality is on the printed value, so an INT only equals a literal it prints as
+                auto parsed = exact_int(value);
+                if (!parsed) {
+                    if (*op == CompareOp::Eq) never_ = true;
+                    continue;
+                }
+                clause.int_value = *parsed;
+            }
+        } else {
+            clause.int_value = std::stoi(value);
+        }
+        clauses_.push_back(std::move(clause));
+    }
+    std::stable_sort(clauses_.begin(), clauses_.end(), [](const CompiledClause& a, const CompiledClause& b) {
+        return clause_cost(a) < clause_cost(b);
+    });
+}
+
+bool PredicateProgram::matches(const RowView& row) const {
+    if (never_ || row.column_count() < min_columns_) return false;
+    for (const auto& clause : clauses_) {
+        if (!clause.eval(row, clause)) return false;
+    }
+    return true;
+}
+
+bool PredicateProgram::matches(const std::vector<std::string>& row) const {
+    if (never_ || row.size() < min_columns_) return false;
+    for (const auto& clause : clauses_) {
+        const std::string& field = row[clause.column];
+        bool ok = false;
+        switch (clause.op) {
+        case CompareOp::Eq: ok = field == clause.text_value; break;
+        case CompareOp::Ne: ok = field != clause.text_value; break;
+        case CompareOp::Lt: ok = std::stoi(field) < clause.int_value; break;
+        case CompareOp::Le: ok = std::stoi(field) <= clause.int_value; break;
+        case CompareOp::Gt: ok = std::stoi(field) > clause.int_value; break;
+        case CompareOp::Ge: ok = std::stoi(field) >= clause.int_value; break;
+        }
+        if (!ok) return false;
+    }
+    return true;
+}
+
+size_t PredicateProgram::select(const ColumnBatch& batch, uint16_t* out) const {
+    if (never_) return 0;
+    size_t selected = batch.size;
+    bool dense = true; // Nothing written to out yet: every row is selected
+    for (const auto& clause : clauses_) {
+        if (clause.type == ColumnType::INT) {
+            const int32_t* values = batch.ints[clause.column].data();
+            selected = dense ? select_int(values, batch.size, clause.op, clause.int_value, out)
+                             : refine_int(values, out, selected, clause.op, clause.int_value, out);
+        } else {
+            if (dense) {
+                for (size_t i = 0; i < batch.size; ++i) out[i] = static_cast<uint16_t>(i);
+            }
+            // Batches built by hand carry no dictionaries
+            const bool coded = static_cast<size_t>(clause.column) < batch.dictionaries.size() &&
+                !batch.dictionaries[clause.column].empty();
+            size_t n = 0;
+            if (coded && (clause.op == CompareOp::Eq || clause.op == CompareOp::Ne)) {
+                // Compare each distinct value once, then filter by code. Orderings stay per row, since
+                // parsing a value no selected row holds could throw
+                const auto& dictionary = batch.dictionaries[clause.column];
+                bool passes[PAX_DICTIONARY_MAX];
+                for (size_t e = 0; e < dictionary.size(); ++e) passes[e] = text_passes(clause, dictionary[e]);
+                const auto& codes = batch.codes[clause.column];
+                for (size_t k = 0; k < selected; ++k) {
+                    uint16_t row = out[k];
+                    out[n] = row;
+                    n += passes[codes[row]];
+                }
+            } else {
+                const auto& texts = batch.texts[clause.column];
+                for (size_t k = 0; k < selected; ++k) {
+                    uint16_t row = out[k];
+                    out[n] = row;
+                    n += text_passes(clause, texts[row]);
+                }
+            }
+            selected = n;
+        }
+        dense = false;
+        if (selected == 0) return 0;
+    }
+    if (dense) {
+        for (size_t i = 0; i < batch.size; ++i) out[i] = static_cast<uint16_t>(i);
+    }
+    return selected;
+}
+
+bool PredicateProgram::may_match(const Zone* zones) const {
+    if (never_) return false;
+    if (zones == nullptr) return true;
+    for (const auto& clause : clauses_) {
+        if (clause.type != ColumnType::INT) continue;
+        const Zone& zone = zones[clause.column];
+        // A page without rows has nothing to match
+        if (zone.empty()) return false;
+        const int32_t value = clause.int_value;
+        bool possible = true;
+        switch (clause.op) {
+        case CompareOp::Eq: possible = zone.min <= value && value <= zone.max; break;
+        case CompareOp::Ne: possible = zone.min != value || zone.max != value; break;
+        case CompareOp::Lt: possible = zone.min < value; break;
+        case CompareOp::Le: possible = zone.min <= value; break;
+        case CompareOp::Gt: possible = zone.max > value; break;
+        case CompareOp::Ge: possible = zone.max >= value; break;
+        }
+        if (!possible) return false;
+    }
+    return true;
+}
+
+std::vector<int> PredicateProgram::columns() const {
+    std::vector<int> columns;
+    for (const auto& clause : clauses_) {
+        if (std::find(columns.begin(), columns.end(), clause.column) == columns.end()) columns.push_back(clause.column);
+    }
+    return columns;
+}
@@ -0,0 +1,46 @@
+#include "query_arena.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+void* QueryArena::allocate(size_t size, size_t alignment) {
+    while (current_ < blocks_.size()) {
+        Block& block = blocks_[current_];
+        const auto base = reinterpret_cast<uintptr_t>(block.data.get());
+        const size_t offset = ((base + used_ + alignment - 1) & ~(alignment - 1)) - base;
+        if (offset + size <= block.size) {
+            used_ = offset + size;
+            return block.data.get() + offset;
+        }
+        // Later blocks are larger; whatever is left of this one goes unused until the next reset
+        ++current_;
+        used_ = 0;
+    }
+    const size_t block_size = std::max(next_block_, size + alignment);
+    next_block_ = block_size * 2;
+    blocks_.push_back(Block{std::make_unique<uint8_t[]>(block_size), block_size});
+    current_ = blocks_.size() - 1;
+    used_ = 0;
+    return allocate(size, alignment);
+}
+
+std::string_view QueryArena::copy(std::string_view text) {
+    if (text.empty()) return std::string_view();
+    auto* out = static_cast<char*>(allocate(text.size(), 1));
+    std::memcpy(out, text.data(), text.size());
+    return std::string_view(out, text.size());
+}
+
+std::string_view QueryArena::print(int64_t value) {
+    constexpr size_t MAX_DIGITS = 20; // "-9223372036854775808"
+    auto* out = static_cast<char*>(allocate(MAX_DIGITS, 1));
+    const auto result = std::to_chars(out, out + MAX_DIGITS, value);
+    // Give back the digits that were not needed
+    used_ -= MAX_DIGITS - static_cast<size_t>(result.ptr - out);
+    return std::string_view(out, static_cast<size_t>(result.ptr - out));
+}
+
+void QueryArena::reset() {
+    current_ = 0;
+    used_ = 0;
+}
@@ -0,0 +1,216 @@
+#include "row_sorter.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <queue>
+
+namespace {
+void append_int_key(std::string& key, int32_t value, bool ascending) {
+    uint32_t bits = static_cast<uint32_t>(value) ^ 0x80000000u;
+    if (!ascending) bits = ~bits;
+    for (int shift = 24; shift >= 0; shift -= 8) key.push_back(static_cast<char>((bits >> shift) & 0xFF));
+}
+
+void append_text_key(std::string& key, std::string_view text, bool ascending) {
+    const size_t start = key.size();
+    for (char c : text) {
+        key.push_back(c);
+        if (c == '\0') key.push_back('\xFF');
+    }
+    key.append(2, '\0');
+    if (!ascending) {
+        for (size_t i = start; i < key.size(); ++i) key[i] = static_cast<char>(~key[i]);
+    }
+}
+
+void append_u32(std::vector<uint8_t>& out, uint32_t value) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(value));
+}
+
+void append_bytes(std::vector<uint8_t>& out, const std::string& bytes) {
+    append_u32(out, static_cast<uint32_t>(bytes.size()));
+    out.insert(out.end(), bytes.begin(), bytes.end());
+}
+
+uint32_t read_u32(const uint8_t*& in) {
+    uint32_t value;
+    std::memcpy(&value, in, sizeof(value));
+    in += sizeof(value);
+    return value;
+}
+
+std::string read_bytes(const uint8_t*& in) {
+    const uint32_t size = read_u32(in);
+    std::string bytes(reinterpret_cast<const char*>(in), size);
+    in += size;
+    return bytes;
+}
+}
+
+void SortKeyEncoder::encode(const RowView& row, std::string& key) const {
+    key.clear();
+    for (const auto& col : columns_) {
+        if (col.type == ColumnType::INT) {
+            append_int_key(key, row.get_int(col.column), col.ascending);
+        } else {
+            append_text_key(key, row.get_text(col.column), col.ascending);
+        }
+    }
+}
+
+void SortKeyEncoder::encode(const std::vector<std::string>& row, std::string& key) const {
+    key.clear();
+    for (const auto& col : columns_) {
+        const std::string& field = row[col.column];
+        if (col.type == ColumnType::INT) {
+            int32_t value = INT32_MIN;
+            std::from_chars(field.data(), field.data() + field.size(), value);
+            append_int_key(key, value, col.ascending);
+        } else {
+            append_text_key(key, field, col.ascending);
+        }
+    }
+}
+
+RowSorter::RowSorter(SortKeyEncoder encoder, std::optional<size_t> limit, size_t memory_budget) :
+    encoder_(std::move(encoder)), limit_(limit), memory_budget_(memory_budget) {}
+
+uint64_t RowSorter::key_prefix(const std::string& key) {
+    uint64_t prefix = 0;
+    for (size_t i = 0; i < sizeof(prefix); ++i) {
+        prefix = (prefix << 8) | (i < key.size() ? static_cast<uint8_t>(key[i]) : 0);
+    }
+    return prefix;
+}
+
+size_t RowSorter::entry_bytes(const Entry& entry) {
+    size_t bytes = sizeof(Entry) + entry.key.size();
+    for (const auto& field : entry.row) bytes += sizeof(std::string) + field.size();
+    return bytes;
+}
+
+bool RowSorter::admits(const std::string& key) const {
+    if (!limit_ || pending_.size() < *limit_) return true;
+    if (*limit_ == 0) return false;
+    const Entry& last = pending_.front();
+    const uint64_t prefix = key_prefix(key);
+    if (prefix != last.prefix) return prefix < last.prefix;
+    return key < last.key;
+}
+
+void RowSorter::add(std::string key, std::vector<std::string> row) {
+    if (!admits(key)) return;
+    const uint64_t prefix = key_prefix(key);
+    pending_.push_back(Entry{prefix, std::move(key), std::move(row)});
+    if (limit_) {
+        // Bounded top-N: a max-heap whose front is the row that would sort last
+        std::push_heap(pending_.begin(), pending_.end(), EntryLess());
+        if (pending_.size() > *limit_) {
+            std::pop_heap(pending_.begin(), pending_.end(), EntryLess());
+            pending_.pop_back();
+        }
+        return;
+    }
+    pending_bytes_ += entry_bytes(pending_.back());
+    if (pending_bytes_ > memory_budget_) spill();
+}
+
+void RowSorter::add(std::vector<std::string> row) {
+    std::string key;
+    encoder_.encode(row, key);
+    add(std::move(key), std::move(row));
+}
+
+void RowSorter::spill() {
+    std::sort(pending_.begin(), pending_.end(), EntryLess());
+    auto file = std::make_unique<SpillFile>();
+    std::vector<uint8_t> record;
+    for (const auto& entry : pending_) {
+        // [u32 size][key][u32 field count][fields], strings as [u32 size][bytes]
+        record.assign(sizeof(uint32_t), 0);
+        append_bytes(record, entry.key);
+        append_u32(record, static_cast<uint32_t>(entry.row.size()));
+        for (const auto& field : entry.row) append_bytes(record, field);
+        const uint32_t size = static_cast<uint32_t>(record.size());
+        std::memcpy(record.data(), &size, sizeof(size));
+        file->append(record.data(), record.size());
+    }
+    file->rewind();
+    spilled_.push_back(std::move(file));
+    pending_.clear();
+    pending_bytes_ = 0;
+}
+
+void RowSorter::seal() {
+    if (pending_.empty()) return;
+    if (limit_) {
+        std::sort_heap(pending_.begin(), pending_.end(), EntryLess());
+    } else {
+        std::sort(pending_.begin(), pending_.end(), EntryLess());
+    }
+    runs_.push_back(std::move(pending_));
+    pending_.clear();
+    pending_bytes_ = 0;
+}
+
+void RowSorter::merge(RowSorter&& other) {
+    other.seal();
+    for (auto& run : other.runs_) runs_.push_back(std::move(run));
+    for (auto& file : other.spilled_) spilled_.push_back(std::move(file));
+    other.runs_.clear();
+    other.spilled_.clear();
+}
+
+std::vector<std::vector<std::string>> RowSorter::finish() {
+    seal();
+    std::vector<std::vector<std::string>> rows;
+    const size_t wanted = limit_ ? *limit_ : SIZE_MAX;
+    if (runs_.size() == 1 && spilled_.empty()) {
+        auto& run = runs_[0];
+        rows.reserve(std::min(run.size(), wanted));
+        for (size_t i = 0; i < run.size() && rows.size() < wanted; ++i) rows.push_back(std::move(run[i].row));
+        runs_.clear();
+        return rows;
+    }
+
+    // k-way merge, one cursor per run; spilled runs are read back record by record
+    struct Cursor {
+        std::vector<Entry>* run = nullptr;
+        size_t next = 0;
+        SpillFile* file = nullptr;
+        Entry current;
+    };
+    std::vector<uint8_t> record;
+    auto advance = [&](Cursor& cursor) {
+        if (cursor.run) {
+            if (cursor.next >= cursor.run->size()) return false;
+            cursor.current = std::move((*cursor.run)[cursor.next++]);
+            return true;
+        }
+        if (!cursor.file->read(record)) return false;
+        const uint8_t* in = record.data() + sizeof(uint32_t);
+        cursor.current.key = read_bytes(in);
+        cursor.current.prefix = key_prefix(cursor.current.key);
+        cursor.current.row.resize(read_u32(in));
+        for (auto& field : cursor.current.row) field = read_bytes(in);
+        return true;
+    };
+    std::vector<Cursor> cursors(runs_.size() + spilled_.size());
+    for (size_t i = 0; i < runs_.size(); ++i) cursors[i].run = &runs_[i];
+    for (size_t i = 0; i < spilled_.size(); ++i) cursors[runs_.size() + i].file = spilled_[i].get();
+    auto greater = [&](size_t a, size_t b) { return EntryLess()(cursors[b].current, cursors[a].current); };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap(greater);
+    for (size_t i = 0; i < cursors.size(); ++i) {
+        if (advance(cursors[i])) heap.push(i);
+    }
+    while (!heap.empty() && rows.size() < wanted) {
+        const size_t i = heap.top();
+        heap.pop();
+        rows.push_back(std::move(cursors[i].current.row));
+        if (advance(cursors[i])) heap.push(i);
+    }
+    runs_.clear();
+    spilled_.clear();
+    return rows;
+}
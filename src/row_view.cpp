@@ -0,0 +1,18 @@
+#include "row_view.h"
+
+std::string RowView::to_string(size_t column) const {
+    if (type(column) == ColumnType::INT) {
+        return std::to_string(get_int(column));
+    }
+    return std::string(get_text(column));
+}
+
+std::vector<std::string> RowView::to_strings() const {
+    std::vector<std::string> values;
+    const size_t count = column_count();
+    values.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        values.push_back(to_string(i));
+    }
+    return values;
+}
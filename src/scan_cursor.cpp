@@ -0,0 +1,33 @@
+#include "scan_cursor.h"
+
+bool ScanCursor::next() {
+    toast_.clear();
+    while (true) {
+        if (!page_) {
+            if (next_page_ >= page_ids_.size()) {
+                slot_ = nullptr;
+                return false;
+            }
+            read_ahead_.advance(page_ids_, next_page_);
+            page_ = fetch_page_(page_ids_[next_page_++]);
+            slot_index_ = 0;
+        }
+        while (slot_index_ < page_.slot_count()) {
+            const Slot& slot = page_.slot(slot_index_++);
+            if (slot.is_occupied()) {
+                slot_ = &slot;
+                tally_.rows_scanned++;
+                return true;
+            }
+        }
+        page_.release();
+    }
+}
+
+void ScanCursor::close() {
+    page_.release();
+    toast_.clear();
+    slot_ = nullptr;
+    next_page_ = page_ids_.size();
+    if (counters_) counters_->add(tally_);
+}
@@ -0,0 +1,43 @@
+#include "spill_file.h"
+#include "page.h"
+#include <cstring>
+#include <stdexcept>
+
+SpillFile::SpillFile() : file_(std::tmpfile()) {
+    if (file_ == nullptr) throw std::runtime_error("Cannot create a temporary spill file");
+    page_.reserve(PAGE_SIZE);
+}
+
+SpillFile::~SpillFile() {
+    std::fclose(file_);
+}
+
+void SpillFile::write_page() {
+    if (!page_.empty() && std::fwrite(page_.data(), 1, page_.size(), file_) != page_.size()) {
+        throw std::runtime_error("Failed to write spill file");
+    }
+    page_.clear();
+}
+
+void SpillFile::append(const uint8_t* record, size_t size) {
+    if (page_.size() + size > PAGE_SIZE) write_page();
+    page_.insert(page_.end(), record, record + size);
+    bytes_ += size;
+}
+
+void SpillFile::rewind() {
+    write_page();
+    std::fflush(file_);
+    std::fseek(file_, 0, SEEK_SET);
+}
+
+bool SpillFile::read(std::vector<uint8_t>& record) {
+    uint32_t size;
+    if (std::fread(&size, sizeof(size), 1, file_) != 1) return false;
+    record.resize(size);
+    std::memcpy(record.data(), &size, sizeof(size));
+    if (std::fread(record.data() + sizeof(size), 1, size - sizeof(size), file_) != size - sizeof(size)) {
+        throw std::runtime_error("Truncated spill file");
+    }
+    return true;
+}
@@ -7,18 +7,24 @@
 #include <sstream>
 #include <vector>
 #include <algorithm>
+#include <thread>
 
 void print_sql_help() {
     std::cout << "\nSQL CLI Help:\n";
     std::cout << "  Supported commands (SQL-92 subset):\n";
     std::cout << "    CREATE TABLE table (col1 TYPE, col2 TYPE, ...);\n";
-    std::cout << "    INSERT INTO table VALUES (val1, val2, ...);\n";
+    std::cout << "    CREATE INDEX [name] ON table (col);\n";
+    std::cout << "    INSERT INTO table VALUES (val1, val2, ...)[, (...)];\n";
     std::cout << "    DELETE FROM table [WHERE col = val [AND ...]];\n";
+    std::cout << "    UPDATE table SET col = val [, ...] [WHERE col = val [AND ...]];\n";
     std::cout << "    SELECT col1, col2 FROM table [WHERE col = val [AND ...]] [ORDER BY col [ASC|DESC]] [LIMIT N];\n";
     std::cout << "    SELECT * FROM table ...\n";
     std::cout << "    SELECT SUM(col) FROM table ...\n";
+    std::cout << "    SELECT COUNT(*), MIN(col), MAX(col), AVG(col) FROM table ...\n";
+    std::cout << "    SELECT col, COUNT(*), SUM(col2) FROM table [WHERE ...] GROUP BY col [ORDER BY col] [LIMIT N];\n";
     std::cout << "    SELECT ... FROM t1 JOIN t2 ON t1.col = t2.col ...\n";
     std::cout << "    SELECT ABS(col) FROM table ...\n";
+    std::cout << "    EXPLAIN ANALYZE statement;  - Run a SELECT, DELETE or UPDATE and show what each step cost\n";
     std::cout << "  Type 'help' to see this message again.\n";
     std::cout << "  Type 'exit' or 'quit' to leave the SQL CLI.\n";
     std::cout << "  Type 'AST ON' or 'AST OFF' to enable/disable AST printing.\n";
@@ -30,22 +36,34 @@ std::string trim(const std::string& s) {
     size_t end = s.find_last_not_of(" \t\n\r");
     return (start == std::string::npos) ? "" : s.substr(start, end - start + 1);
 }
+// A value in matching quotes stands for the text between them, as the lexer reads a string literal
+std::string unquote(const std::string& s) {
+    if (s.size() >= 2 && (s.front() == '\'' || s.front() == '"') && s.back() == s.front()) return s.substr(1, s.size() - 2);
+    return s;
+}
 std::string to_upper(const std::string& s) {
     std::string r = s;
     std::transform(r.begin(), r.end(), r.begin(), ::toupper);
     return r;
 }
 
-int main() {
-    FileStorageLayer storage;
+int main(int argc, char** argv) {
+    // --read-only maps an existing storage and serves queries from it without a write path
+    const bool read_only = argc > 1 && std::string(argv[1]) == "--read-only";
+    StorageOptions options;
+    options.scan_threads = std::max(1u, std::thread::hardware_concurrency());
+    FileStorageLayer storage(options);
     std::string db_path;
     std::cout << "Enter storage path: ";
     std::getline(std::cin, db_path);
-    storage.open(db_path);
+    try {
+        storage.open(db_path, read_only ? OpenMode::ReadOnlyMmap : OpenMode::ReadWrite);
+    } catch (const std::exception& e) {
+        std::cout << "Error: " << e.what() << std::endl;
+        return 1;
+    }
     print_sql_help();
     std::cout << "SQL CLI. Type SQL queries, or 'exit' to quit." << std::endl;
-    SqlLexer lexer;
-    SqlParser parser;
     SqlExecutor executor;
     bool print_ast = false;
     while (true) {
@@ -78,7 +96,7 @@ int main() {
                 std::string ctype = trim(coldef.substr(space + 1));
                 if (cname.empty() || ctype.empty()) { std::cout << "Column name/type missing." << std::endl; col_error = true; break; }
                 ColumnSchema col{};
-                std::memset(&col, 0, sizeof(ColumnSchema));
+                std::memset(static_cast<void*>(&col), 0, sizeof(ColumnSchema));
                 size_t clen = std::min(cname.size(), sizeof(col.name) - 1);
                 std::memcpy(col.name, cname.c_str(), clen);
                 col.name[clen] = '\0';
@@ -94,7 +112,27 @@ int main() {
             try {
                 storage.create(trim(table), schema);
                 std::cout << "Table created: " << trim(table) << std::endl;
-                storage.flush();
+                storage.commit();
+            } catch (const std::exception& e) {
+                std::cout << "Error: " << e.what() << std::endl;
+            }
+            continue;
+        }
+        if (uline.find("CREATE INDEX") == 0) {
+            size_t on_pos = uline.find(" ON ");
+            size_t paren_start = line.find('(');
+            size_t paren_end = line.find(')');
+            if (on_pos == std::string::npos || paren_start == std::string::npos || paren_end == std::string::npos ||
+                paren_start < on_pos || paren_end < paren_start) {
+                std::cout << "Syntax error in CREATE INDEX." << std::endl;
+                continue;
+            }
+            std::string table = trim(line.substr(on_pos + 4, paren_start - on_pos - 4));
+            std::string column = trim(line.substr(paren_start + 1, paren_end - paren_start - 1));
+            try {
+                storage.create_index(table, column);
+                std::cout << "Index created on " << table << "(" << column << ")" << std::endl;
+                storage.commit();
             } catch (const std::exception& e) {
                 std::cout << "Error: " << e.what() << std::endl;
             }
@@ -105,17 +143,44 @@ int main() {
             size_t values_pos = uline.find("VALUES");
             if (values_pos == std::string::npos) { std::cout << "Syntax error in INSERT." << std::endl; continue; }
             std::string table = trim(line.substr(name_start, values_pos - name_start));
-            size_t paren_start = line.find('(', values_pos);
-            size_t paren_end = line.find(')', paren_start);
-            if (paren_start == std::string::npos || paren_end == std::string::npos) { std::cout << "Syntax error in INSERT." << std::endl; continue; }
-            std::string vals = line.substr(paren_start + 1, paren_end - paren_start - 1);
-            std::vector<std::string> values;
-            std::stringstream ss(vals);
-            std::string val;
-            while (std::getline(ss, val, ',')) values.push_back(trim(val));
+            // One parenthesised group per row; commas and parens inside quotes are part of the value
+            std::vector<std::vector<std::string>> rows;
+            bool syntax_ok = true;
+            size_t pos = values_pos + 6;
+            while (pos < line.size()) {
+                size_t paren_start = line.find_first_not_of(" \t,;", pos);
+                if (paren_start == std::string::npos) break;
+                if (line[paren_start] != '(') { syntax_ok = false; break; }
+                std::vector<std::string> values;
+                std::string val;
+                char quote = 0;
+                size_t i = paren_start + 1;
+                for (; i < line.size(); ++i) {
+                    char c = line[i];
+                    if (quote) {
+                        if (c == quote) quote = 0;
+                    } else if (c == '\'' || c == '"') {
+                        quote = c;
+                    } else if (c == ',' || c == ')') {
+                        values.push_back(unquote(trim(val)));
+                        val.clear();
+                        if (c == ')') break;
+                        continue;
+                    }
+                    val += c;
+                }
+                if (i >= line.size()) { syntax_ok = false; break; }
+                rows.push_back(std::move(values));
+                pos = i + 1;
+            }
+            if (!syntax_ok || rows.empty()) { std::cout << "Syntax error in INSERT." << std::endl; continue; }
             try {
                 auto col_names = storage.get_column_names(table);
-                if (col_names.size() != values.size()) {
+                bool counts_match = true;
+                for (const auto& values : rows) {
+                    if (col_names.size() != values.size()) counts_match = false;
+                }
+                if (!counts_match) {
                     std::cout << "INSERT failed: value count does not match column count." << std::endl;
                     continue;
                 }
@@ -124,104 +189,25 @@ int main() {
                 continue;
             }
             try {
-                int record_id = storage.insert(trim(table), values);
-                std::cout << "Inserted record with ID: " << record_id << std::endl;
-                storage.flush();
+                auto record_ids = storage.insert_batch(trim(table), rows);
+                if (record_ids.size() == 1) {
+                    std::cout << "Inserted record with ID: " << record_ids[0] << std::endl;
+                } else {
+                    std::cout << "Inserted " << record_ids.size() << " records" << std::endl;
+                }
+                storage.commit();
             } catch (const std::exception& e) {
                 std::cout << "Error: " << e.what() << std::endl;
             }
             continue;
         }
-        if (uline.find("DELETE FROM") == 0) {
-            size_t name_start = uline.find("FROM") + 4;
-            size_t where_pos = uline.find("WHERE");
-            std::string table = trim(line.substr(name_start, (where_pos == std::string::npos ? std::string::npos : where_pos - name_start)));
-            std::vector<std::string> col_names;
-            try {
-                col_names = storage.get_column_names(table);
-            } catch (...) {
-                std::cout << "DELETE failed: table does not exist." << std::endl;
-                continue;
-            }
-            std::vector<int> to_delete;
-            if (where_pos != std::string::npos) {
-                std::string conds = line.substr(where_pos + 5);
-                std::vector<std::pair<int, std::string>> filters;
-                std::stringstream ss(conds);
-                std::string cond;
-                while (std::getline(ss, cond, 'A')) {
-                    size_t eq = cond.find('=');
-                    if (eq == std::string::npos) continue;
-                    std::string col = trim(cond.substr(0, eq));
-                    std::string val = trim(cond.substr(eq + 1));
-                    auto it = std::find(col_names.begin(), col_names.end(), col);
-                    if (it != col_names.end()) filters.emplace_back(static_cast<int>(std::distance(col_names.begin(), it)), val);
-                }
-                auto rows = storage.scan(table);
-                for (size_t i = 0; i < rows.size(); ++i) {
-                    bool match = true;
-                    for (const auto& [idx, val] : filters) {
-                        if (idx < 0 || static_cast<size_t>(idx) >= rows[i].size() || rows[i][idx] != val) { match = false; break; }
-                    }
-                    if (match) to_delete.push_back(i + 1);
-                }
-            } else {
-                auto rows = storage.scan(table);
-                for (size_t i = 0; i < rows.size(); ++i) to_delete.push_back(i + 1);
-            }
-            int deleted = 0;
-            for (int rid : to_delete) {
-                try { storage.delete_record(table, rid); ++deleted; } catch (...) {}
-            }
-            std::cout << "Deleted " << deleted << " record(s) from " << table << std::endl;
-            storage.flush();
-            continue;
-        }
         try {
-            auto tokens = lexer.tokenize(line);
-            auto ast = parser.parse(tokens);
-            if (!ast->select_columns.empty() && ast->select_columns[0] == "*") {
-                if (!ast->join_table.empty()) {
-                    std::vector<std::string> left_cols, right_cols;
-                    try { left_cols = storage.get_column_names(ast->from_table); } catch (...) {
-                        std::cout << "SELECT failed: table '" << ast->from_table << "' does not exist." << std::endl; continue; }
-                    try { right_cols = storage.get_column_names(ast->join_table); } catch (...) {
-                        std::cout << "SELECT failed: table '" << ast->join_table << "' does not exist." << std::endl; continue; }
-                    ast->select_columns.clear();
-                    ast->select_columns.insert(ast->select_columns.end(), left_cols.begin(), left_cols.end());
-                    ast->select_columns.insert(ast->select_columns.end(), right_cols.begin(), right_cols.end());
-                } else {
-                    std::vector<std::string> cols;
-                    try { cols = storage.get_column_names(ast->from_table); } catch (...) {
-                        std::cout << "SELECT failed: table '" << ast->from_table << "' does not exist." << std::endl; continue; }
-                    ast->select_columns = cols;
-                }
-            } else {
-                std::vector<std::string> all_cols;
-                try { all_cols = storage.get_column_names(ast->from_table); } catch (...) {
-                    std::cout << "SELECT failed: table '" << ast->from_table << "' does not exist." << std::endl; continue; }
-                if (!ast->join_table.empty()) {
-                    std::vector<std::string> right_cols;
-                    try { right_cols = storage.get_column_names(ast->join_table); } catch (...) {
-                        std::cout << "SELECT failed: table '" << ast->join_table << "' does not exist." << std::endl; continue; }
-                    all_cols.insert(all_cols.end(), right_cols.begin(), right_cols.end());
-                }
-                for (const auto& col : ast->select_columns) {
-                    std::string cname = col;
-                    if (col.find("SUM(") == 0 || col.find("ABS(") == 0) {
-                        size_t l = col.find('(') + 1, r = col.find(')');
-                        if (l == std::string::npos || r == std::string::npos || r <= l) continue;
-                        cname = col.substr(l, r - l);
-                    }
-                    if (std::find(all_cols.begin(), all_cols.end(), cname) == all_cols.end()) {
-                        std::cout << "SELECT failed: column '" << cname << "' does not exist." << std::endl; goto select_end;
-                    }
-                }
-            }
-            if (print_ast) ast->pretty_print(std::cout);
-            executor.execute(*ast, storage);
-            storage.flush();
-select_end:;
+            // Statements seen before reuse their plan from the executor's cache
+            PreparedStatement statement = executor.prepare(line, storage);
+            if (print_ast) statement.ast().pretty_print(std::cout);
+            executor.execute(statement, storage);
+            // A SELECT changes nothing, so there is nothing to commit
+            if (statement.ast().type != SqlAstType::Select) storage.commit();
         } catch (const std::exception& e) {
             std::cout << "Error: " << e.what() << std::endl;
         }
@@ -1,14 +1,20 @@
-#include "sql_parser.h"
-#include "storage_layer.h"
+#include "sql_executor.h"
+#include "hash_aggregate.h"
+#include "hash_join.h"
+#include "predicate.h"
+#include "row_sorter.h"
 #include <iostream>
-#include <unordered_map>
 #include <functional>
+#include <memory>
 #include <algorithm>
-
-class SqlExecutor {
-public:
-    void execute(const SqlAst& ast, FileStorageLayer& storage);
-};
+#include <cctype>
+#include <chrono>
+#include <iomanip>
+#include <numeric>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
 
 namespace {
 int col_index(const std::vector<std::string>& cols, const std::string& name) {
@@ -16,217 +22,660 @@ int col_index(const std::vector<std::string>& cols, const std::string& name) {
     if (it == cols.end()) throw std::runtime_error("Column not found: " + name);
     return static_cast<int>(std::distance(cols.begin(), it));
 }
-}
 
-void SqlExecutor::execute(const SqlAst& ast, FileStorageLayer& storage) {
-    if (ast.type != SqlAstType::Select) {
-        std::cout << "Only SELECT supported." << std::endl;
-        return;
+/**
+ * Pick the WHERE clauses an index can answer: equality on any indexed column, else the bounds on one
+ * indexed INT column (TEXT ranges compare numerically in the row filter but bytewise in an index).
+ * The row filter still checks every clause, so the range only has to narrow the scan.
+ */
+std::optional<IndexRange> plan_index_range(FileStorageLayer& storage, const std::string& table,
+    const std::vector<FilterClause>& filters) {
+    const auto schema = storage.get_schema(table);
+    for (const auto& [idx, op, val] : filters) {
+        if (op != "=" || !storage.has_index(table, idx)) continue;
+        if (schema[idx].type == ColumnType::INT && !exact_int(val)) continue;
+        return IndexRange{idx, val, true, val, true};
     }
-    auto col_names = storage.get_column_names(ast.from_table);
-    std::vector<int> projection;
-    std::optional<std::pair<std::string, int>> aggregate;
-    for (const auto& col : ast.select_columns) {
-        if (col.find("SUM(") == 0) {
-            std::string cname = col.substr(4, col.size() - 5);
-            projection.push_back(col_index(col_names, cname));
-            aggregate = std::make_pair("SUM", projection.back());
-        } else if (col.find("ABS(") == 0) {
-            std::string cname = col.substr(4, col.size() - 5);
-            projection.push_back(col_index(col_names, cname));
-            aggregate = std::make_pair("ABS", projection.back());
+    auto is_bound = [](const std::string& op) { return op == "<" || op == "<=" || op == ">" || op == ">="; };
+    int column = -1;
+    for (const auto& [idx, op, val] : filters) {
+        if (is_bound(op) && exact_int(val) && schema[idx].type == ColumnType::INT && storage.has_index(table, idx)) {
+            column = idx;
+            break;
+        }
+    }
+    if (column < 0) return std::nullopt;
+    // Intersect every bound on the chosen column
+    std::optional<std::pair<int32_t, bool>> lower; // value, inclusive
+    std::optional<std::pair<int32_t, bool>> upper;
+    for (const auto& [idx, op, val] : filters) {
+        auto bound = exact_int(val);
+        if (idx != column || !is_bound(op) || !bound) continue;
+        const bool inclusive = op.size() == 2;
+        if (op[0] == '>') {
+            if (!lower || *bound > lower->first || (*bound == lower->first && !inclusive)) lower = std::make_pair(*bound, inclusive);
         } else {
-            projection.push_back(col_index(col_names, col));
-        }
-    }
-    std::optional<std::function<bool(const std::vector<std::string>&)>> filter_func;
-    if (!ast.where_clauses.empty()) {
-        std::vector<std::tuple<int, std::string, std::string>> filters;
-        for (const auto& w : ast.where_clauses) {
-            filters.emplace_back(col_index(col_names, w.col), w.op, w.val);
-        }
-        filter_func = [filters](const std::vector<std::string>& row) {
-            for (const auto& [idx, op, val] : filters) {
-                if (idx < 0 || static_cast<size_t>(idx) >= row.size()) return false;
-                if (op == "=") { if (row[idx] != val) return false; }
-                else if (op == ">") { if (!(std::stoi(row[idx]) > std::stoi(val))) return false; }
-                else if (op == "<") { if (!(std::stoi(row[idx]) < std::stoi(val))) return false; }
-                else if (op == ">=") { if (!(std::stoi(row[idx]) >= std::stoi(val))) return false; }
-                else if (op == "<=") { if (!(std::stoi(row[idx]) <= std::stoi(val))) return false; }
-                else if (op == "!=") { if (row[idx] == val) return false; }
-                else return false;
-            }
-            return true;
-        };
+            if (!upper || *bound < upper->first || (*bound == upper->first && !inclusive)) upper = std::make_pair(*bound, inclusive);
+        }
+    }
+    IndexRange range{column, std::nullopt, true, std::nullopt, true};
+    if (lower) {
+        range.lower = std::to_string(lower->first);
+        range.lower_inclusive = lower->second;
+    }
+    if (upper) {
+        range.upper = std::to_string(upper->first);
+        range.upper_inclusive = upper->second;
+    }
+    return range;
+}
+
+// SUM(col), COUNT(*) and friends: the upper-case function name and its argument
+std::optional<std::pair<std::string, std::string>> parse_call(const std::string& col) {
+    size_t open = col.find('(');
+    if (open == std::string::npos || open == 0 || col.back() != ')') return std::nullopt;
+    std::string fn = col.substr(0, open);
+    for (auto& c : fn) c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+    return std::make_pair(fn, col.substr(open + 1, col.size() - open - 2));
+}
+
+// GROUP BY, or any of COUNT, SUM, MIN, MAX and AVG, makes a query produce one row per group
+bool is_grouped(const SqlAst& ast) {
+    return !ast.group_by.empty() || std::any_of(ast.aggregates.begin(), ast.aggregates.end(),
+        [](const AggregateCall& call) { return parse_aggregate_fn(call.fn).has_value(); });
+}
+
+// Where each output column of a grouped query comes from
+struct GroupedPlan {
+    std::vector<int> group_columns; // Input columns, in GROUP BY order
+    std::vector<AggregateSpec> aggregates;
+    std::vector<size_t> outputs;    // Per select column: its field in HashAggregate::rows()
+};
+
+/**
+ * Resolve the select list of a grouped query; column_of maps a column name to an input column.
+ * @throws std::runtime_error for a plain column missing from GROUP BY, or a call that is not an aggregate
+ */
+GroupedPlan plan_grouped(const SqlAst& ast, const std::function<int(const std::string&)>& column_of) {
+    GroupedPlan plan;
+    for (const auto& col : ast.group_by) plan.group_columns.push_back(column_of(col));
+    for (const auto& col : ast.select_columns) {
+        auto call = parse_call(col);
+        if (!call) {
+            auto it = std::find(ast.group_by.begin(), ast.group_by.end(), col);
+            if (it == ast.group_by.end()) throw std::runtime_error("Column " + col + " must appear in GROUP BY");
+            plan.outputs.push_back(static_cast<size_t>(std::distance(ast.group_by.begin(), it)));
+            continue;
+        }
+        const auto& [name, arg] = *call;
+        auto fn = parse_aggregate_fn(name);
+        if (!fn) throw std::runtime_error(name + " cannot be combined with aggregates");
+        if (arg == "*" && *fn != AggregateFn::Count) throw std::runtime_error(name + "(*) is not supported");
+        plan.outputs.push_back(ast.group_by.size() + plan.aggregates.size());
+        plan.aggregates.push_back({*fn, arg == "*" ? -1 : column_of(arg)});
+    }
+    return plan;
+}
+
+/**
+ * Print a grouped result. Without GROUP BY its single row prints as "FN: value" lines; otherwise as a
+ * header and one line per group, ordered by ORDER BY on group columns and cut to the limit.
+ * Returns the rows printed.
+ */
+size_t print_grouped(const SqlAst& ast, const GroupedPlan& plan, const HashAggregate& result, const std::optional<size_t>& limit,
+    std::ostream& out) {
+    auto rows = result.rows();
+    if (ast.group_by.empty()) {
+        if (limit && *limit == 0) return 0;
+        for (size_t i = 0; i < plan.outputs.size(); ++i) {
+            out << parse_call(ast.select_columns[i])->first << ": " << rows[0][plan.outputs[i]] << std::endl;
+        }
+        return 1;
     }
-    std::optional<std::vector<std::pair<int, bool>>> order_by;
     if (!ast.order_by.empty()) {
-        std::vector<std::pair<int, bool>> order;
+        std::vector<SortColumn> order;
         for (const auto& [col, asc] : ast.order_by) {
-            order.emplace_back(col_index(col_names, col), asc);
+            auto it = std::find(ast.group_by.begin(), ast.group_by.end(), col);
+            if (it == ast.group_by.end()) throw std::runtime_error("ORDER BY column must appear in GROUP BY: " + col);
+            const int field = static_cast<int>(std::distance(ast.group_by.begin(), it));
+            order.push_back({field, asc, result.type(plan.group_columns[field])});
         }
-        order_by = order;
+        RowSorter sorter(SortKeyEncoder(std::move(order)), limit);
+        for (auto& row : rows) sorter.add(std::move(row));
+        rows = sorter.finish();
     }
-    std::optional<size_t> limit;
-    if (ast.limit) limit = *ast.limit;
-    if (!ast.join_table.empty()) {
-        auto join_col_names = storage.get_column_names(ast.join_table);
-        int left_idx = col_index(col_names, ast.join_left_col);
-        int right_idx = col_index(join_col_names, ast.join_right_col);
-        auto left_rows = storage.scan(ast.from_table);
-        auto right_rows = storage.scan(ast.join_table);
-        std::unordered_multimap<std::string, std::vector<std::string>> right_map;
-        for (const auto& row : right_rows) {
-            if (right_idx < 0 || static_cast<size_t>(right_idx) >= row.size()) continue;
-            right_map.emplace(row[right_idx], row);
-        }
-        std::vector<std::vector<std::string>> joined;
-        for (const auto& lrow : left_rows) {
-            if (left_idx < 0 || static_cast<size_t>(left_idx) >= lrow.size()) continue;
-            auto range = right_map.equal_range(lrow[left_idx]);
-            for (auto it = range.first; it != range.second; ++it) {
-                std::vector<std::string> combined = lrow;
-                combined.insert(combined.end(), it->second.begin(), it->second.end());
-                joined.push_back(std::move(combined));
-            }
+    if (limit && rows.size() > *limit) rows.resize(*limit);
+    for (size_t i = 0; i < ast.select_columns.size(); ++i) {
+        if (i > 0) out << " | ";
+        out << ast.select_columns[i];
+    }
+    out << std::endl;
+    for (const auto& row : rows) {
+        for (size_t i = 0; i < plan.outputs.size(); ++i) {
+            if (i > 0) out << " | ";
+            out << row[plan.outputs[i]];
         }
-        std::vector<std::string> all_cols = col_names;
-        all_cols.insert(all_cols.end(), join_col_names.begin(), join_col_names.end());
-        std::vector<int> join_proj;
+        out << std::endl;
+    }
+    return rows.size();
+}
+
+// Replace the field with its absolute value, as ABS(col) does
+void apply_abs(std::vector<std::vector<std::string>>& rows, int col) {
+    for (auto& row : rows) {
+        if (col < 0 || static_cast<size_t>(col) >= row.size()) continue;
+        try { int val = std::stoi(row[col]); row[col] = std::to_string(std::abs(val)); } catch (...) {}
+    }
+}
+
+// WHERE clauses bound to columns; a clause holding a ? takes its value when the plan runs
+struct FilterTemplate {
+    std::vector<FilterClause> clauses;
+    std::vector<std::pair<size_t, int>> params; // (clause, parameter)
+
+    void add(int column, const WhereClause& w) {
+        if (w.param >= 0) params.emplace_back(clauses.size(), w.param);
+        clauses.emplace_back(column, w.op, w.val);
+    }
+    std::vector<FilterClause> bind(const std::vector<std::string>& values) const {
+        std::vector<FilterClause> bound = clauses;
+        for (const auto& [clause, param] : params) std::get<2>(bound[clause]) = values[param];
+        return bound;
+    }
+};
+
+// Compiled WHERE of one table, with the index range that can narrow a scan of it
+struct WherePlan {
+    std::shared_ptr<const PredicateProgram> program;
+    std::optional<IndexRange> index_range;
+};
+
+WherePlan compile_where(FileStorageLayer& storage, const std::string& table, const std::vector<ColumnSchema>& schema,
+    const std::vector<FilterClause>& filters) {
+    WherePlan plan;
+    if (filters.empty()) return plan;
+    plan.program = std::make_shared<const PredicateProgram>(filters, schema);
+    plan.index_range = plan_index_range(storage, table, filters);
+    return plan;
+}
+
+std::shared_ptr<const PredicateProgram> compile_filter(const FilterTemplate& filters, const std::vector<ColumnSchema>& schema,
+    const std::vector<std::string>& params) {
+    if (filters.clauses.empty()) return nullptr;
+    return std::make_shared<const PredicateProgram>(filters.bind(params), schema);
+}
+
+// Where the rows of a join come from and how they are shaped
+struct JoinPlan {
+    JoinInput left;  // With its filter compiled, unless the filter takes parameters
+    JoinInput right;
+    FilterTemplate left_filters;
+    FilterTemplate right_filters;
+    std::vector<ColumnSchema> right_schema;
+    std::vector<ColumnType> row_types;            // Per row column
+    std::vector<std::pair<bool, size_t>> sources; // Per row column: from the right side, index in that side's columns
+    std::vector<SortColumn> order;                // ORDER BY over row columns
+    size_t visible_columns = 0;
+    std::optional<int> abs_column;                // Position of ABS's argument in the row
+};
+
+// The statement with runs of whitespace outside quotes made one space, and no trailing ';'
+std::string normalize_sql(const std::string& sql) {
+    std::string out;
+    out.reserve(sql.size());
+    char quote = 0;
+    bool space = false;
+    for (char c : sql) {
+        if (quote) {
+            out += c;
+            if (c == quote) quote = 0;
+            continue;
+        }
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            space = true;
+            continue;
+        }
+        if (space && !out.empty()) out += ' ';
+        space = false;
+        if (c == '\'' || c == '"') quote = c;
+        out += c;
+    }
+    while (!out.empty() && (out.back() == ';' || out.back() == ' ')) out.pop_back();
+    return out;
+}
+
+// What EXPLAIN ANALYZE reports: a line per operator, in the order they ran
+struct QueryProfile {
+    std::vector<std::string> operators;
+    size_t rows = 0; // Rows the statement returned, deleted or updated
+};
+
+std::string format_time(std::chrono::nanoseconds time) {
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(3) << static_cast<double>(time.count()) / 1e6 << " ms";
+    return os.str();
+}
+
+// How a statement reaches the rows of its table
+std::string access_path(const std::string& table, const std::vector<ColumnSchema>& schema, const WherePlan& where) {
+    std::string path = where.index_range ? "Index scan on " + table + " using " + schema[where.index_range->column].name
+        : "Seq scan on " + table;
+    return where.program ? path + " with filter" : path;
+}
+
+// The scan counters of what one storage call did
+std::string scan_counters(const StorageStats& used) {
+    std::ostringstream os;
+    os << "rows scanned=" << used.rows_scanned << " rows out=" << used.rows_emitted << " bytes decoded=" << used.bytes_decoded;
+    return os.str();
+}
+
+std::string order_by_list(const std::vector<std::pair<std::string, bool>>& order_by) {
+    std::string list;
+    for (const auto& [col, asc] : order_by) list += (list.empty() ? "" : ", ") + col + (asc ? " ASC" : " DESC");
+    return list;
+}
+}
+
+/**
+ * A statement resolved against the schema: names turned into column indexes, WHERE clauses bound to
+ * columns and compiled, and the access path chosen. Clauses holding parameters compile when it runs.
+ */
+struct QueryPlan {
+    SqlAst ast;                       // With SELECT * expanded
+    const FileStorageLayer* storage = nullptr;
+    uint64_t schema_version = 0;      // Of the storage when the plan was made
+    std::vector<ColumnSchema> schema; // Of ast.from_table
+    FilterTemplate filters;           // WHERE of a single-table statement
+    WherePlan where;                  // The filters compiled, unless they take parameters
+    std::optional<size_t> limit;
+    std::optional<GroupedPlan> grouped;
+    // UPDATE
+    std::vector<std::pair<int, std::string>> assignments;
+    std::vector<std::pair<size_t, int>> assignment_params; // (assignment, parameter)
+    // Single-table SELECT
+    bool select_star = false;
+    std::vector<int> projection;
+    size_t visible_columns = 0;       // Leading projection columns that are printed
+    std::optional<std::vector<std::pair<int, bool>>> order_by;
+    std::optional<std::pair<std::string, int>> abs_call; // ABS and its position in the projected row
+    std::vector<std::string> header;
+    std::optional<JoinPlan> join;
+};
+
+namespace {
+bool is_current(const QueryPlan& plan, const FileStorageLayer& storage) {
+    return plan.storage == &storage && plan.schema_version == storage.schema_version();
+}
+
+void plan_join(QueryPlan& plan, FileStorageLayer& storage, const std::vector<std::string>& col_names) {
+    SqlAst& ast = plan.ast;
+    auto join_col_names = storage.get_column_names(ast.join_table);
+    const int left_width = static_cast<int>(col_names.size());
+    std::vector<std::string> all_cols = col_names;
+    all_cols.insert(all_cols.end(), join_col_names.begin(), join_col_names.end());
+    JoinPlan join;
+    join.right_schema = storage.get_schema(ast.join_table);
+    std::vector<ColumnType> all_types;
+    for (const auto* schema : {&plan.schema, &join.right_schema}) {
+        for (const auto& column : *schema) all_types.push_back(column.type);
+    }
+    // The parser leaves the select list of SELECT * empty
+    if (ast.select_columns.empty() || ast.select_columns[0] == "*") ast.select_columns = all_cols;
+    std::vector<int> row_columns; // Columns of all_cols making up each joined row
+    auto row_column = [&](const std::string& name) {
+        int idx = col_index(all_cols, name);
+        auto it = std::find(row_columns.begin(), row_columns.end(), idx);
+        if (it == row_columns.end()) it = row_columns.insert(row_columns.end(), idx);
+        return static_cast<int>(std::distance(row_columns.begin(), it));
+    };
+    if (is_grouped(ast)) {
+        plan.grouped = plan_grouped(ast, row_column);
+    } else {
         for (const auto& col : ast.select_columns) {
-            if (col.find("SUM(") == 0 || col.find("ABS(") == 0) {
-                std::string cname = col.substr(col.find('(') + 1, col.size() - col.find('(') - 2);
-                join_proj.push_back(col_index(all_cols, cname));
-            } else {
-                join_proj.push_back(col_index(all_cols, col));
-            }
+            auto call = parse_call(col);
+            if (call && (call->first != "ABS" || call->second == "*")) throw std::runtime_error("Unsupported function: " + col);
+            row_columns.push_back(col_index(all_cols, call ? call->second : col));
+            if (call) join.abs_column = static_cast<int>(row_columns.size()) - 1;
         }
-        std::optional<std::function<bool(const std::vector<std::string>&)>> join_filter;
-        if (!ast.where_clauses.empty()) {
-            std::vector<std::tuple<int, std::string, std::string>> filters;
-            for (const auto& w : ast.where_clauses) {
-                filters.emplace_back(col_index(all_cols, w.col), w.op, w.val);
-            }
-            join_filter = [filters](const std::vector<std::string>& row) {
-                for (const auto& [idx, op, val] : filters) {
-                    if (idx < 0 || static_cast<size_t>(idx) >= row.size()) return false;
-                    if (op == "=") { if (row[idx] != val) return false; }
-                    else if (op == ">") { if (!(std::stoi(row[idx]) > std::stoi(val))) return false; }
-                    else if (op == "<") { if (!(std::stoi(row[idx]) < std::stoi(val))) return false; }
-                    else if (op == ">=") { if (!(std::stoi(row[idx]) >= std::stoi(val))) return false; }
-                    else if (op == "<=") { if (!(std::stoi(row[idx]) <= std::stoi(val))) return false; }
-                    else if (op == "!=") { if (row[idx] == val) return false; }
-                    else return false;
-                }
-                return true;
-            };
-        }
-        std::optional<std::vector<std::pair<int, bool>>> join_order_by;
-        if (!ast.order_by.empty()) {
-            std::vector<std::pair<int, bool>> order;
-            for (const auto& [col, asc] : ast.order_by) {
-                order.emplace_back(col_index(all_cols, col), asc);
-            }
-            join_order_by = order;
+        if (row_columns.empty()) {
+            row_columns.resize(all_cols.size());
+            std::iota(row_columns.begin(), row_columns.end(), 0);
+        }
+        join.visible_columns = row_columns.size();
+        // ORDER BY columns that are not selected ride along at the end of the row until the sort is done
+        for (const auto& [col, asc] : ast.order_by) {
+            const int pos = row_column(col);
+            join.order.push_back({pos, asc, all_types[row_columns[pos]]});
+        }
+    }
+
+    // Each side hands over only the columns the rows need, with its WHERE clauses pushed into its scan
+    join.left = JoinInput{ast.from_table, col_index(col_names, ast.join_left_col), {}, nullptr};
+    join.right = JoinInput{ast.join_table, col_index(join_col_names, ast.join_right_col), {}, nullptr};
+    for (int idx : row_columns) {
+        JoinInput& side = idx < left_width ? join.left : join.right;
+        join.sources.emplace_back(idx >= left_width, side.columns.size());
+        side.columns.push_back(idx < left_width ? idx : idx - left_width);
+        join.row_types.push_back(all_types[idx]);
+    }
+    for (const auto& w : ast.where_clauses) {
+        int idx = col_index(all_cols, w.col);
+        if (idx < left_width) {
+            join.left_filters.add(idx, w);
+        } else {
+            join.right_filters.add(idx - left_width, w);
         }
-        std::optional<std::pair<std::string, int>> join_agg;
+    }
+    if (join.left_filters.params.empty()) join.left.filter = compile_filter(join.left_filters, plan.schema, {});
+    if (join.right_filters.params.empty()) join.right.filter = compile_filter(join.right_filters, join.right_schema, {});
+    plan.join = std::move(join);
+}
+
+void plan_select(QueryPlan& plan, const std::vector<std::string>& col_names) {
+    SqlAst& ast = plan.ast;
+    if (is_grouped(ast)) {
+        plan.grouped = plan_grouped(ast, [&](const std::string& name) { return col_index(col_names, name); });
+        return;
+    }
+    if (ast.select_columns.empty() || ast.select_columns[0] == "*") {
+        ast.select_columns = col_names;
+        plan.select_star = true;
+    } else {
         for (const auto& col : ast.select_columns) {
-            if (col.find("SUM(") == 0) join_agg = std::make_pair("SUM", col_index(all_cols, col.substr(4, col.size() - 5)));
-            if (col.find("ABS(") == 0) join_agg = std::make_pair("ABS", col_index(all_cols, col.substr(4, col.size() - 5)));
-        }
-        std::vector<std::vector<std::string>> filtered;
-        for (const auto& row : joined) {
-            if (join_filter && !(*join_filter)(row)) continue;
-            if (!join_proj.empty()) {
-                std::vector<std::string> proj_row;
-                for (int idx : join_proj) {
-                    if (idx >= 0 && static_cast<size_t>(idx) < row.size()) proj_row.push_back(row[idx]);
-                }
-                filtered.push_back(std::move(proj_row));
-            } else {
-                filtered.push_back(row);
-            }
+            auto call = parse_call(col);
+            if (call && (call->first != "ABS" || call->second == "*")) throw std::runtime_error("Unsupported function: " + col);
+            plan.projection.push_back(col_index(col_names, call ? call->second : col));
+            if (call) plan.abs_call = std::make_pair(call->first, static_cast<int>(plan.projection.size()) - 1);
         }
-        if (join_order_by && !join_order_by->empty()) {
-            std::sort(filtered.begin(), filtered.end(), [&](const std::vector<std::string>& a, const std::vector<std::string>& b) {
-                for (const auto& [col, asc] : *join_order_by) {
-                    if (col < 0 || static_cast<size_t>(col) >= a.size() || static_cast<size_t>(col) >= b.size()) continue;
-                    try {
-                        int ai = std::stoi(a[col]);
-                        int bi = std::stoi(b[col]);
-                        if (ai != bi) return asc ? ai < bi : ai > bi;
-                    } catch (...) {
-                        if (a[col] != b[col]) return asc ? a[col] < b[col] : a[col] > b[col];
-                    }
-                }
-                return false;
-            });
-        }
-        if (limit && filtered.size() > *limit) filtered.resize(*limit);
-        if (join_agg) {
-            const std::string& op = join_agg->first;
-            int col = join_agg->second;
-            if (col < 0 || (filtered.empty() || static_cast<size_t>(col) >= filtered[0].size())) {
-                throw std::runtime_error("Invalid column index for aggregation");
-            }
-            if (op == "SUM") {
-                int64_t sum = 0;
-                for (const auto& row : filtered) {
-                    try { sum += std::stoll(row[col]); } catch (...) {}
-                }
-                std::cout << "SUM: " << sum << std::endl;
-                return;
-            } else if (op == "ABS") {
-                for (auto& row : filtered) {
-                    try { int val = std::stoi(row[col]); row[col] = std::to_string(std::abs(val)); } catch (...) {}
-                }
+    }
+    // ORDER BY names positions in the returned row; columns that are not selected are fetched, then dropped
+    plan.visible_columns = plan.projection.size();
+    if (!ast.order_by.empty()) {
+        std::vector<std::pair<int, bool>> order;
+        for (const auto& [col, asc] : ast.order_by) {
+            int idx = col_index(col_names, col);
+            if (!plan.select_star) {
+                auto it = std::find(plan.projection.begin(), plan.projection.end(), idx);
+                if (it == plan.projection.end()) it = plan.projection.insert(plan.projection.end(), idx);
+                idx = static_cast<int>(std::distance(plan.projection.begin(), it));
             }
+            order.emplace_back(idx, asc);
         }
-        for (size_t i = 0; i < ast.select_columns.size(); ++i) {
-            if (i > 0) std::cout << " | ";
-            std::cout << ast.select_columns[i];
+        plan.order_by = order;
+    }
+    if (plan.select_star) {
+        plan.header = col_names;
+        return;
+    }
+    for (size_t i = 0; i < plan.visible_columns; ++i) plan.header.push_back(col_names[plan.projection[i]]);
+    if (plan.header.empty()) plan.header = ast.select_columns;
+}
+
+/**
+ * Resolve a statement against the storage's schema.
+ * @throws std::runtime_error for a table, column or function that does not exist
+ */
+std::shared_ptr<const QueryPlan> plan_statement(const SqlAst& ast, FileStorageLayer& storage) {
+    auto plan = std::make_shared<QueryPlan>();
+    plan->storage = &storage;
+    // Read first, so a schema change racing with planning leaves the plan stale rather than wrong
+    plan->schema_version = storage.schema_version();
+    plan->ast = ast;
+    const auto col_names = storage.get_column_names(ast.from_table);
+    plan->schema = storage.get_schema(ast.from_table);
+    if (ast.limit) plan->limit = *ast.limit;
+    if (ast.type == SqlAstType::Select && !ast.join_table.empty()) {
+        plan_join(*plan, storage, col_names);
+        return plan;
+    }
+    for (const auto& w : ast.where_clauses) plan->filters.add(col_index(col_names, w.col), w);
+    if (plan->filters.params.empty()) plan->where = compile_where(storage, ast.from_table, plan->schema, plan->filters.clauses);
+    if (ast.type == SqlAstType::Update) {
+        for (const auto& assignment : ast.assignments) {
+            if (assignment.param >= 0) plan->assignment_params.emplace_back(plan->assignments.size(), assignment.param);
+            plan->assignments.emplace_back(col_index(col_names, assignment.col), assignment.val);
         }
-        std::cout << std::endl;
-        for (const auto& row : filtered) {
-            for (size_t i = 0; i < row.size(); ++i) {
-                if (i > 0) std::cout << " | ";
-                std::cout << row[i];
+    } else if (ast.type == SqlAstType::Select) {
+        plan_select(*plan, col_names);
+    }
+    return plan;
+}
+
+void print_rows(const std::vector<std::string>& header, const std::vector<std::vector<std::string>>& rows, std::ostream& out) {
+    for (size_t i = 0; i < header.size(); ++i) {
+        if (i > 0) out << " | ";
+        out << header[i];
+    }
+    out << std::endl;
+    for (const auto& row : rows) {
+        for (size_t i = 0; i < row.size(); ++i) {
+            if (i > 0) out << " | ";
+            out << row[i];
+        }
+        out << std::endl;
+    }
+}
+
+// Rows go to out; with a profile each operator's line is added to it
+void run_join(const QueryPlan& plan, const std::vector<std::string>& params, FileStorageLayer& storage, std::ostream& out,
+    QueryProfile* profile) {
+    const SqlAst& ast = plan.ast;
+    const JoinPlan& join_plan = *plan.join;
+    JoinInput left = join_plan.left;
+    JoinInput right = join_plan.right;
+    if (!join_plan.left_filters.params.empty()) left.filter = compile_filter(join_plan.left_filters, plan.schema, params);
+    if (!join_plan.right_filters.params.empty()) right.filter = compile_filter(join_plan.right_filters, join_plan.right_schema, params);
+    const auto& sources = join_plan.sources;
+    const StorageStats before = profile ? storage.stats() : StorageStats();
+    HashJoin join(storage, std::move(left), std::move(right));
+    auto profile_join = [&](size_t matches) {
+        const HashJoinStats& stats = join.stats();
+        const std::string& build_table = stats.build_left ? ast.from_table : ast.join_table;
+        const std::string& probe_table = stats.build_left ? ast.join_table : ast.from_table;
+        std::ostringstream line;
+        line << "Hash join on " << ast.from_table << "." << ast.join_left_col << " = " << ast.join_table << "." << ast.join_right_col << ": build " << build_table
+             << " rows=" << stats.build_rows << " time=" << format_time(stats.build_time) << "; probe " << probe_table
+             << " rows=" << stats.probe_rows << " time=" << format_time(stats.probe_time) << "; matches=" << matches;
+        if (stats.partitions > 0) line << " partitions=" << stats.partitions << " spilled bytes=" << stats.spilled_bytes;
+        const StorageStats used = storage.stats() - before;
+        profile->operators.push_back("Batch scans of " + ast.from_table + " and " + ast.join_table + ": rows scanned="
+            + std::to_string(used.rows_scanned) + " bytes decoded=" + std::to_string(used.bytes_decoded));
+        profile->operators.push_back(line.str());
+    };
+    if (plan.grouped) {
+        // Joined rows are folded into their groups as they come, never collected or copied
+        HashAggregate result(join_plan.row_types, plan.grouped->group_columns, plan.grouped->aggregates);
+        std::vector<std::string_view> row(sources.size());
+        size_t matches = 0;
+        join.run([&](const HashJoin::Values& left_values, const HashJoin::Values& right_values) {
+            for (size_t c = 0; c < sources.size(); ++c) {
+                row[c] = sources[c].first ? right_values[sources[c].second] : left_values[sources[c].second];
             }
-            std::cout << std::endl;
+            result.add(row);
+            ++matches;
+        });
+        const auto printing = std::chrono::steady_clock::now();
+        const size_t printed = print_grouped(ast, *plan.grouped, result, plan.limit, out);
+        if (profile) {
+            profile_join(matches);
+            profile->operators.push_back("Hash aggregate during the probe: groups=" + std::to_string(result.group_count())
+                + " time to order and emit=" + format_time(std::chrono::steady_clock::now() - printing));
+            profile->rows = printed;
         }
         return;
     }
-    bool is_select_star = (!ast.select_columns.empty() && ast.select_columns[0] == "*") || projection.empty();
-    std::vector<std::string> header_cols = col_names;
-    std::vector<std::vector<std::string>> rows;
-    if (is_select_star) {
-        header_cols = col_names;
-        rows = storage.scan(ast.from_table);
-    } else {
-        rows = storage.scan(ast.from_table, projection, filter_func, order_by, limit, aggregate);
-        header_cols.clear();
-        for (int idx : projection) {
-            if (idx >= 0 && static_cast<size_t>(idx) < col_names.size()) header_cols.push_back(col_names[idx]);
-        }
-        if (header_cols.empty()) header_cols = ast.select_columns;
-    }
-    bool is_sum = aggregate && aggregate->first == "SUM";
-    if (!is_sum) {
-        for (size_t i = 0; i < header_cols.size(); ++i) {
-            if (i > 0) std::cout << " | ";
-            std::cout << header_cols[i];
-        }
-        std::cout << std::endl;
-    }
-    if (!rows.empty() && !is_sum) {
-        for (const auto& row : rows) {
-            for (size_t i = 0; i < row.size(); ++i) {
-                if (i > 0) std::cout << " | ";
-                std::cout << row[i];
+    std::vector<std::vector<std::string>> filtered;
+    join.run([&](const HashJoin::Values& left_values, const HashJoin::Values& right_values) {
+        std::vector<std::string> row;
+        row.reserve(sources.size());
+        for (const auto& [from_right, i] : sources) row.emplace_back(from_right ? right_values[i] : left_values[i]);
+        filtered.push_back(std::move(row));
+    });
+    if (profile) profile_join(filtered.size());
+    if (!join_plan.order.empty()) {
+        const auto sort_started = std::chrono::steady_clock::now();
+        RowSorter sorter(SortKeyEncoder(join_plan.order), plan.limit);
+        for (auto& row : filtered) sorter.add(std::move(row));
+        filtered = sorter.finish();
+        for (auto& row : filtered) row.resize(join_plan.visible_columns);
+        if (profile) {
+            profile->operators.push_back(std::string(plan.limit ? "Top-N sort" : "Sort") + " by " + order_by_list(ast.order_by)
+                + ": rows out=" + std::to_string(filtered.size()) + " time=" + format_time(std::chrono::steady_clock::now() - sort_started));
+        }
+    }
+    if (plan.limit && filtered.size() > *plan.limit) filtered.resize(*plan.limit);
+    if (join_plan.abs_column) apply_abs(filtered, *join_plan.abs_column);
+    print_rows(ast.select_columns, filtered, out);
+    if (profile) profile->rows = filtered.size();
+}
+
+void run_plan(const QueryPlan& plan, const std::vector<std::string>& params, FileStorageLayer& storage, std::ostream& out,
+    QueryProfile* profile) {
+    const SqlAst& ast = plan.ast;
+    if (plan.join) {
+        run_join(plan, params, storage, out, profile);
+        return;
+    }
+    const WherePlan where = plan.filters.params.empty() ? plan.where
+        : compile_where(storage, ast.from_table, plan.schema, plan.filters.bind(params));
+    const StorageStats before = profile ? storage.stats() : StorageStats();
+    const auto started = std::chrono::steady_clock::now();
+    // DELETE and UPDATE change the matching rows in one pass of the table, or of the index entries in range
+    if (ast.type == SqlAstType::Delete || ast.type == SqlAstType::Update) {
+        size_t changed;
+        if (ast.type == SqlAstType::Delete) {
+            changed = storage.delete_where(ast.from_table, where.program.get(), where.index_range);
+            out << "Deleted " << changed << " record(s) from " << ast.from_table << std::endl;
+        } else {
+            auto assignments = plan.assignments;
+            for (const auto& [assignment, param] : plan.assignment_params) assignments[assignment].second = params[param];
+            changed = storage.update_where(ast.from_table, assignments, where.program.get(), where.index_range);
+            out << "Updated " << changed << " record(s) in " << ast.from_table << std::endl;
+        }
+        if (profile) {
+            profile->operators.push_back(std::string(ast.type == SqlAstType::Delete ? "Delete" : "Update") + " via "
+                + access_path(ast.from_table, plan.schema, where) + ": rows=" + std::to_string(changed)
+                + " time=" + format_time(std::chrono::steady_clock::now() - started));
+            profile->rows = changed;
+        }
+        return;
+    }
+    if (plan.grouped) {
+        // One pass over column batches computes every aggregate of every group
+        HashAggregate result = storage.group_aggregate(ast.from_table, plan.grouped->group_columns, plan.grouped->aggregates,
+            where.program.get());
+        const StorageStats used = profile ? storage.stats() - before : StorageStats();
+        const auto printing = std::chrono::steady_clock::now();
+        const size_t printed = print_grouped(ast, *plan.grouped, result, plan.limit, out);
+        if (profile) {
+            profile->operators.push_back("Seq scan and hash aggregate on " + ast.from_table + (where.program ? " with filter" : "")
+                + ": " + scan_counters(used) + " groups=" + std::to_string(result.group_count()) + " time=" + format_time(used.scan_time));
+            if (!ast.group_by.empty()) {
+                profile->operators.push_back("Order and emit groups: rows out=" + std::to_string(printed) + " time="
+                    + format_time(std::chrono::steady_clock::now() - printing));
             }
-            std::cout << std::endl;
+            profile->rows = printed;
+        }
+        return;
+    }
+    ScanSpec spec;
+    spec.order_by = plan.order_by;
+    spec.limit = plan.limit;
+    spec.index_range = where.index_range;
+    spec.where = where.program.get();
+    if (!plan.select_star) {
+        spec.projection = plan.projection;
+        spec.aggregate = plan.abs_call;
+    }
+    std::vector<std::vector<std::string>> rows = storage.scan(ast.from_table, spec);
+    if (!plan.select_star) {
+        for (auto& row : rows) {
+            if (row.size() > plan.visible_columns) row.resize(plan.visible_columns);
+        }
+    }
+    if (profile) {
+        const StorageStats used = storage.stats() - before;
+        profile->operators.push_back(access_path(ast.from_table, plan.schema, where) + ": " + scan_counters(used)
+            + " time=" + format_time(used.scan_time));
+        if (plan.order_by) {
+            profile->operators.push_back(std::string(plan.limit ? "Top-N sort" : "Sort") + " by " + order_by_list(ast.order_by)
+                + ": rows out=" + std::to_string(rows.size()) + " time=" + format_time(used.sort_time));
+        }
+        profile->rows = rows.size();
+    }
+    print_rows(plan.header, rows, out);
+}
+
+/**
+ * Run a plan, printing its rows. Under EXPLAIN ANALYZE the rows are produced but not printed;
+ * instead each operator's line comes out, then the page traffic, the rows and the time of the
+ * whole statement. Pages are counted storage-wide, so other work running meanwhile shows up there.
+ */
+void run_statement(const QueryPlan& plan, const std::vector<std::string>& params, FileStorageLayer& storage) {
+    if (!plan.ast.explain_analyze) {
+        run_plan(plan, params, storage, std::cout, nullptr);
+        return;
+    }
+    std::ostream discard(nullptr);
+    QueryProfile profile;
+    const StorageStats before = storage.stats();
+    const auto started = std::chrono::steady_clock::now();
+    run_plan(plan, params, storage, discard, &profile);
+    const auto elapsed = std::chrono::steady_clock::now() - started;
+    const StorageStats used = storage.stats() - before;
+    for (const auto& line : profile.operators) std::cout << line << std::endl;
+    std::cout << "Pages: read=" << used.pages_read << " written=" << used.pages_written << " cache hits=" << used.cache_hits << std::endl;
+    std::cout << "Rows: " << profile.rows << std::endl;
+    std::cout << "Execution time: " << format_time(elapsed) << std::endl;
+}
+}
+
+PreparedStatement::PreparedStatement(std::shared_ptr<const QueryPlan> plan) :
+    plan_(std::move(plan)), params_(plan_->ast.param_count), bound_(plan_->ast.param_count, false) {}
+
+void PreparedStatement::bind(size_t index, std::string value) {
+    if (index >= params_.size()) throw std::out_of_range("No parameter " + std::to_string(index));
+    params_[index] = std::move(value);
+    bound_[index] = true;
+}
+
+const SqlAst& PreparedStatement::ast() const {
+    return plan_->ast;
+}
+
+void SqlExecutor::execute(const SqlAst& ast, FileStorageLayer& storage) {
+    if (ast.param_count != 0) throw std::runtime_error("Statement has parameters; prepare it and bind them");
+    run_statement(*plan_statement(ast, storage), {}, storage);
+}
+
+PreparedStatement SqlExecutor::prepare(const std::string& sql, FileStorageLayer& storage) {
+    std::string key = normalize_sql(sql);
+    auto it = plan_index_.find(key);
+    if (it != plan_index_.end()) {
+        if (is_current(*it->second->second, storage)) {
+            ++stats_.hits;
+            plans_.splice(plans_.begin(), plans_, it->second);
+            return PreparedStatement(it->second->second);
         }
-    } else if (is_sum && !rows.empty()) {
-        std::cout << "SUM: " << rows[0][0] << std::endl;
+        plans_.erase(it->second);
+        plan_index_.erase(it);
+    }
+    ++stats_.misses;
+    auto plan = plan_statement(*parser_.parse(lexer_.tokenize(sql)), storage);
+    plans_.emplace_front(key, plan);
+    plan_index_.emplace(std::move(key), plans_.begin());
+    if (plans_.size() > PLAN_CACHE_CAPACITY) {
+        plan_index_.erase(plans_.back().first);
+        plans_.pop_back();
     }
-} 
\ No newline at end of file
+    return PreparedStatement(std::move(plan));
+}
+
+void SqlExecutor::execute(PreparedStatement& statement, FileStorageLayer& storage) {
+    for (size_t i = 0; i < statement.bound_.size(); ++i) {
+        if (!statement.bound_[i]) throw std::runtime_error("Parameter " + std::to_string(i) + " is not bound");
+    }
+    if (!is_current(*statement.plan_, storage)) statement.plan_ = plan_statement(statement.plan_->ast, storage);
+    run_statement(*statement.plan_, statement.params_, storage);
+}
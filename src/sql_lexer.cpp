@@ -5,7 +5,7 @@
 #include <unordered_set>
 
 static const std::unordered_set<std::string> keywords = {
-    "SELECT", "FROM", "WHERE", "ORDER", "BY", "LIMIT", "INSERT", "INTO", "VALUES", "UPDATE", "SET", "DELETE", "JOIN", "ON", "AS", "AND", "OR", "SUM", "ABS"
+    "SELECT", "FROM", "WHERE", "ORDER", "BY", "LIMIT", "INSERT", "INTO", "VALUES", "UPDATE", "SET", "DELETE", "JOIN", "ON", "AS", "AND", "OR", "SUM", "ABS", "GROUP", "ASC", "DESC", "EXPLAIN", "ANALYZE"
 };
 
 std::vector<Token> SqlLexer::tokenize(const std::string& input) {
@@ -1,4 +1,5 @@
 #include "sql_parser.h"
+#include <cctype>
 #include <stdexcept>
 #include <iostream>
 
@@ -7,17 +8,108 @@ static void expect(const std::vector<Token>& tokens, size_t& i, TokenType type,
         throw std::runtime_error("Unexpected token: " + (i < tokens.size() ? tokens[i].text : "<end>"));
 }
 
+// A literal value: a number, possibly negative, a quoted string or a bare word. A ? is a parameter:
+// it takes the next parameter index, which goes to param, and reads as "?"
+static std::string parse_value(const std::vector<Token>& tokens, size_t& i, SqlAst& ast, int& param) {
+    if (i >= tokens.size()) throw std::runtime_error("Unexpected token: <end>");
+    if (tokens[i].type == TokenType::Operator && tokens[i].text == "?") {
+        param = static_cast<int>(ast.param_count++);
+        return tokens[i++].text;
+    }
+    if (tokens[i].type == TokenType::Operator && tokens[i].text == "-" && i + 1 < tokens.size() &&
+        tokens[i + 1].type == TokenType::Number) {
+        i += 2;
+        return "-" + tokens[i - 1].text;
+    }
+    return tokens[i++].text;
+}
+
+// WHERE col op val [AND ...], if the next token starts one
+static void parse_where(const std::vector<Token>& tokens, size_t& i, SqlAst& ast) {
+    if (i >= tokens.size() || tokens[i].type != TokenType::Keyword || tokens[i].text != "WHERE") return;
+    ++i;
+    while (i < tokens.size() && tokens[i].type == TokenType::Identifier) {
+        std::string col = tokens[i++].text;
+        expect(tokens, i, TokenType::Operator);
+        std::string op = tokens[i++].text;
+        int param = -1;
+        std::string val = parse_value(tokens, i, ast, param);
+        ast.where_clauses.push_back({col, op, val, param});
+        if (i < tokens.size() && tokens[i].text == "AND") ++i;
+    }
+}
+
+// DELETE FROM table [WHERE ...]
+static std::unique_ptr<SqlAst> parse_delete(const std::vector<Token>& tokens, size_t i) {
+    auto ast = std::make_unique<SqlAst>();
+    ast->type = SqlAstType::Delete;
+    expect(tokens, i, TokenType::Keyword, "FROM");
+    ++i;
+    expect(tokens, i, TokenType::Identifier);
+    ast->from_table = tokens[i++].text;
+    parse_where(tokens, i, *ast);
+    return ast;
+}
+
+// UPDATE table SET col = val [, ...] [WHERE ...]
+static std::unique_ptr<SqlAst> parse_update(const std::vector<Token>& tokens, size_t i) {
+    auto ast = std::make_unique<SqlAst>();
+    ast->type = SqlAstType::Update;
+    expect(tokens, i, TokenType::Identifier);
+    ast->from_table = tokens[i++].text;
+    expect(tokens, i, TokenType::Keyword, "SET");
+    ++i;
+    while (i < tokens.size() && tokens[i].type == TokenType::Identifier) {
+        std::string col = tokens[i++].text;
+        expect(tokens, i, TokenType::Operator, "=");
+        ++i;
+        int param = -1;
+        std::string val = parse_value(tokens, i, *ast, param);
+        ast->assignments.push_back({col, val, param});
+        if (i < tokens.size() && tokens[i].text == ",") ++i;
+    }
+    if (ast->assignments.empty()) throw std::runtime_error("Expected SET column");
+    parse_where(tokens, i, *ast);
+    return ast;
+}
+
 std::unique_ptr<SqlAst> SqlParser::parse(const std::vector<Token>& tokens) {
     size_t i = 0;
+    if (!tokens.empty() && tokens[0].type == TokenType::Keyword && tokens[0].text == "EXPLAIN") {
+        // EXPLAIN ANALYZE statement
+        ++i;
+        expect(tokens, i, TokenType::Keyword, "ANALYZE");
+        auto ast = parse(std::vector<Token>(tokens.begin() + 2, tokens.end()));
+        ast->explain_analyze = true;
+        return ast;
+    }
+    if (!tokens.empty() && tokens[0].type == TokenType::Keyword) {
+        if (tokens[0].text == "DELETE") return parse_delete(tokens, 1);
+        if (tokens[0].text == "UPDATE") return parse_update(tokens, 1);
+    }
     expect(tokens, i, TokenType::Keyword, "SELECT");
     ++i;
     auto ast = std::make_unique<SqlAst>();
     ast->type = SqlAstType::Select;
-    while (i < tokens.size() && tokens[i].type != TokenType::Keyword) {
-        if (tokens[i].type == TokenType::Identifier) {
-            ast->select_columns.push_back(tokens[i].text);
+    while (i < tokens.size() && (tokens[i].type != TokenType::Keyword || tokens[i].text == "SUM" || tokens[i].text == "ABS")) {
+        if (i + 1 < tokens.size() && tokens[i + 1].text == "(" &&
+            (tokens[i].type == TokenType::Keyword || tokens[i].type == TokenType::Identifier)) {
+            // Function call such as SUM(col) or COUNT(*), kept as one select column
+            std::string fn = tokens[i].text;
+            for (auto& c : fn) c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+            i += 2;
+            if (i >= tokens.size()) throw std::runtime_error("Unexpected token: <end>");
+            std::string arg = tokens[i++].text;
+            expect(tokens, i, TokenType::Operator, ")");
+            ++i;
+            ast->select_columns.push_back(fn + "(" + arg + ")");
+            ast->aggregates.push_back({fn, arg});
+        } else {
+            if (tokens[i].type == TokenType::Identifier) {
+                ast->select_columns.push_back(tokens[i].text);
+            }
+            ++i;
         }
-        ++i;
         if (i < tokens.size() && tokens[i].text == ",") ++i;
     }
     expect(tokens, i, TokenType::Keyword, "FROM");
@@ -37,16 +129,16 @@ std::unique_ptr<SqlAst> SqlParser::parse(const std::vector<Token>& tokens) {
         if (tokens[i].type != TokenType::Identifier) throw std::runtime_error("Expected join column");
         ast->join_right_col = tokens[i++].text;
     }
-    if (i < tokens.size() && tokens[i].type == TokenType::Keyword && tokens[i].text == "WHERE") {
+    parse_where(tokens, i, *ast);
+    if (i < tokens.size() && tokens[i].type == TokenType::Keyword && tokens[i].text == "GROUP") {
+        ++i;
+        expect(tokens, i, TokenType::Keyword, "BY");
         ++i;
         while (i < tokens.size() && tokens[i].type == TokenType::Identifier) {
-            std::string col = tokens[i++].text;
-            expect(tokens, i, TokenType::Operator);
-            std::string op = tokens[i++].text;
-            std::string val = tokens[i++].text;
-            ast->where_clauses.push_back({col, op, val});
-            if (i < tokens.size() && tokens[i].text == "AND") ++i;
+            ast->group_by.push_back(tokens[i++].text);
+            if (i < tokens.size() && tokens[i].text == ",") ++i;
         }
+        if (ast->group_by.empty()) throw std::runtime_error("Expected GROUP BY column");
     }
     if (i < tokens.size() && tokens[i].type == TokenType::Keyword && tokens[i].text == "ORDER") {
         ++i;
@@ -67,20 +159,27 @@ std::unique_ptr<SqlAst> SqlParser::parse(const std::vector<Token>& tokens) {
         ++i;
         ast->limit = std::stoi(tokens[i++].text);
     }
-    for (auto& col : ast->select_columns) {
-        if (col.find("SUM(") == 0) ast->aggregate = {"SUM", col.substr(4, col.size() - 5)};
-        if (col.find("ABS(") == 0) ast->aggregate = {"ABS", col.substr(4, col.size() - 5)};
-    }
     return ast;
 }
 
 void SqlAst::pretty_print(std::ostream& os) const {
-    os << "SELECT ";
-    for (size_t i = 0; i < select_columns.size(); ++i) {
-        if (i > 0) os << ", ";
-        os << select_columns[i];
+    if (explain_analyze) os << "EXPLAIN ANALYZE ";
+    if (type == SqlAstType::Delete) {
+        os << "DELETE FROM " << from_table;
+    } else if (type == SqlAstType::Update) {
+        os << "UPDATE " << from_table << " SET ";
+        for (size_t i = 0; i < assignments.size(); ++i) {
+            if (i > 0) os << ", ";
+            os << assignments[i].col << " = " << assignments[i].val;
+        }
+    } else {
+        os << "SELECT ";
+        for (size_t i = 0; i < select_columns.size(); ++i) {
+            if (i > 0) os << ", ";
+            os << select_columns[i];
+        }
+        os << " FROM " << from_table;
     }
-    os << " FROM " << from_table;
     if (!join_table.empty()) {
         os << " JOIN " << join_table << " ON " << join_left_col << " = " << join_right_col;
     }
@@ -91,6 +190,13 @@ void SqlAst::pretty_print(std::ostream& os) const {
             os << where_clauses[i].col << " " << where_clauses[i].op << " " << where_clauses[i].val;
         }
     }
+    if (!group_by.empty()) {
+        os << " GROUP BY ";
+        for (size_t i = 0; i < group_by.size(); ++i) {
+            if (i > 0) os << ", ";
+            os << group_by[i];
+        }
+    }
     if (!order_by.empty()) {
         os << " ORDER BY ";
         for (size_t i = 0; i < order_by.size(); ++i) {
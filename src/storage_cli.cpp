@@ -1,3 +1,5 @@
+#include <chrono>
+#include <iomanip>
 #include <iostream>
 #include <string>
 #include <sstream>
@@ -14,6 +16,7 @@ constexpr char CMD_UPDATE[] = "update";
 constexpr char CMD_DELETE[] = "delete";
 constexpr char CMD_SCAN[] = "scan";
 constexpr char CMD_FLUSH[] = "flush";
+constexpr char CMD_STATS[] = "stats";
 constexpr char CMD_HELP[] = "help";
 constexpr char CMD_EXIT[] = "exit";
 constexpr char CMD_QUIT[] = "quit";
@@ -24,7 +27,8 @@ constexpr char HELP_MESSAGE[] =
     "Storage Layer CLI - Available commands:\n"
     "  open <path>                  - Open storage at specified path\n"
     "  close                        - Close the storage\n"
-    "  create <table> <col1>:<type1> ... - Create a table with schema\n"
+    "  create <table> [--pax] <col1>:<type1>[:<encoding>] ... - Create a table with schema; --pax stores it column-wise\n"
+    "    Encodings (PAX only): PLAIN, AUTO, DICT (TEXT), FOR, RLE (INT)\n"
     "  insert <table> <val1,val2,...>    - Insert a record\n"
     "  get <table> <record_id>            - Get a record by ID\n"
     "  update <table> <record_id> <val1,val2,...> - Update a record\n"
@@ -37,6 +41,7 @@ constexpr char HELP_MESSAGE[] =
     "      --limit <N>                          - Limit number of rows\n"
     "      --aggregate <SUM|ABS>:<col>          - Aggregate (SUM or ABS) on INT column\n"
     "  flush                        - Flush data to disk\n"
+    "  stats [reset]                - Show pages read and written, cache hits, rows, bytes decoded and time; reset zeroes them\n"
     "  help                         - Display this help message\n"
     "  exit/quit                    - Exit the program\n";
 
@@ -78,6 +83,22 @@ void print_table_row(const std::vector<std::string>& values) {
     std::cout << std::endl;
 }
 
+void print_stats(const StorageStats& stats) {
+    auto ms = [](std::chrono::nanoseconds time) {
+        std::ostringstream os;
+        os << std::fixed << std::setprecision(3) << static_cast<double>(time.count()) / 1e6 << " ms";
+        return os.str();
+    };
+    std::cout << COLOR_BOLD << "Pages read:    " << COLOR_RESET << stats.pages_read << std::endl;
+    std::cout << COLOR_BOLD << "Pages written: " << COLOR_RESET << stats.pages_written << std::endl;
+    std::cout << COLOR_BOLD << "Cache hits:    " << COLOR_RESET << stats.cache_hits << std::endl;
+    std::cout << COLOR_BOLD << "Rows scanned:  " << COLOR_RESET << stats.rows_scanned << std::endl;
+    std::cout << COLOR_BOLD << "Rows emitted:  " << COLOR_RESET << stats.rows_emitted << std::endl;
+    std::cout << COLOR_BOLD << "Bytes decoded: " << COLOR_RESET << stats.bytes_decoded << std::endl;
+    std::cout << COLOR_BOLD << "Scan time:     " << COLOR_RESET << ms(stats.scan_time) << std::endl;
+    std::cout << COLOR_BOLD << "Sort time:     " << COLOR_RESET << ms(stats.sort_time) << std::endl;
+}
+
 std::vector<uint8_t> string_to_bytes(const std::string& str) {
     return std::vector<uint8_t>(str.begin(), str.end());
 }
@@ -102,6 +123,15 @@ ColumnType parse_column_type(const std::string& s) {
     throw std::runtime_error("Unknown column type: " + s);
 }
 
+ColumnEncoding parse_column_encoding(const std::string& s) {
+    if (s == "PLAIN") return ColumnEncoding::Plain;
+    if (s == "AUTO") return ColumnEncoding::Auto;
+    if (s == "DICT") return ColumnEncoding::Dictionary;
+    if (s == "FOR") return ColumnEncoding::FrameOfReference;
+    if (s == "RLE") return ColumnEncoding::RunLength;
+    throw std::runtime_error("Unknown column encoding: " + s);
+}
+
 std::vector<std::string> parse_values(const std::string& s) {
     std::vector<std::string> vals;
     std::stringstream ss(s);
@@ -132,17 +162,24 @@ void run_command(Func&& f) {
 ColumnSchema parse_column_schema(const std::string& spec) {
     auto pos = spec.find(":");
     if (pos == std::string::npos) {
-        throw std::runtime_error("Column format must be name:TYPE");
+        throw std::runtime_error("Column format must be name:TYPE[:ENCODING]");
     }
     std::string cname = spec.substr(0, pos);
     std::string ctype = spec.substr(pos + 1);
+    std::string cencoding = "PLAIN";
+    auto encoding_pos = ctype.find(":");
+    if (encoding_pos != std::string::npos) {
+        cencoding = ctype.substr(encoding_pos + 1);
+        ctype = ctype.substr(0, encoding_pos);
+    }
     ColumnSchema col{};
-    std::memset(&col, 0, sizeof(ColumnSchema));
+    std::memset(static_cast<void*>(&col), 0, sizeof(ColumnSchema));
     size_t clen = std::min(cname.size(), sizeof(col.name) - 1);
     std::memcpy(col.name, cname.c_str(), clen);
     col.name[clen] = '\0';
     col.type = parse_column_type(ctype);
     col.size = (col.type == ColumnType::INT) ? INT_SIZE : 0;
+    col.encoding = parse_column_encoding(cencoding);
     return col;
 }
 
@@ -179,14 +216,19 @@ int main() {
                 print_success("Storage closed");
             });
         } else if (command == "create") {
-            if (!check_args(args, 3, "Error: Usage: create <table> <col1>:<type1> ...")) continue;
+            if (!check_args(args, 3, "Error: Usage: create <table> [--pax] <col1>:<type1> ...")) continue;
             std::vector<ColumnSchema> schema;
+            TableLayout layout = TableLayout::Row;
             try {
                 for (size_t i = 2; i < args.size(); ++i) {
+                    if (args[i] == "--pax") {
+                        layout = TableLayout::Pax;
+                        continue;
+                    }
                     schema.push_back(parse_column_schema(args[i]));
                 }
                 run_command([&] {
-                    storage.create(args[1], schema);
+                    storage.create(args[1], schema, layout);
                     print_success("Table created: " + args[1]);
                 });
             } catch (const std::exception& e) {
@@ -321,6 +363,15 @@ int main() {
                     std::cout << COLOR_BOLD << "SUM: " << rows[0][0] << COLOR_RESET << std::endl;
                 }
             });
+        } else if (command == CMD_STATS) {
+            run_command([&] {
+                if (args.size() > 1 && args[1] == "reset") {
+                    storage.reset_stats();
+                    print_success("Stats reset");
+                    return;
+                }
+                print_stats(storage.stats());
+            });
         } else if (command == CMD_FLUSH) {
             run_command([&] {
                 storage.flush();
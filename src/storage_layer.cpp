@@ -1,192 +1,19 @@
 #include "storage_layer.h"
+#include "pax_page.h"
+#include "row_sorter.h"
 #include <algorithm>
 #include <cstring>
 #include <chrono>
-#include <fstream>
 #include <filesystem>
+#include <future>
+#include <iterator>
+#include <numeric>
 #include <stdexcept>
 #include <sstream>
 
-namespace fs = std::filesystem;
-
-Page::Page(uint32_t page_id) : Page(page_id, 0) {}
-Page::Page(uint32_t page_id, uint32_t id_range_start) {
-    header_.initialize(page_id);
-    header_.id_range_start = id_range_start;
-    header_.id_range_end = id_range_start + IDS_PER_PAGE;
-    data_.resize(PAGE_SIZE - sizeof(PageHeader));
-    free_id_bitmap_.reset();
-}
-
-std::optional<uint32_t> Page::insert_record(uint32_t record_id, const std::vector<uint8_t>& data) {
-    const uint32_t required_space = sizeof(Slot) + data.size();
-
-    if (!has_space(required_space)) {
-        compact_page();
-        if (!has_space(required_space)) {
-            return std::nullopt;
-        }
-    }
-
-    Slot new_slot;
-    new_slot.offset = header_.free_space_offset;
-    new_slot.length = data.size();
-    new_slot.flags = SLOT_OCCUPIED;
-    new_slot.record_id = record_id;
-
-    std::memcpy(data_.data() + new_slot.offset, data.data(), data.size());
-
-    slots_.push_back(new_slot);
-
-    header_.free_space -= required_space;
-    header_.free_space_offset += data.size();
-    header_.slot_count++;
-    header_.flags |= PAGE_DIRTY;
-
-    return record_id;
-}
-
-std::optional<std::vector<uint8_t>> Page::get_record(uint32_t record_id) const {
-    for (const auto& slot : slots_) {
-        if (slot.record_id == record_id && slot.is_occupied()) {
-            return std::vector<uint8_t>(
-                data_.begin() + slot.offset,
-                data_.begin() + slot.offset + slot.length
-            );
-        }
-    }
-    return std::nullopt;
-}
-
-bool Page::update_record(uint32_t record_id, const std::vector<uint8_t>& new_data) {
-    auto slot_it = std::find_if(slots_.begin(), slots_.end(),
-        [record_id](const Slot& s) {
-            return s.record_id == record_id && s.is_occupied();
-        });
-
-    if (slot_it == slots_.end()) {
-        return false;
-    }
-
-    const uint32_t space_needed = new_data.size();
-    const uint32_t space_available = header_.free_space + slot_it->length;
-
-    if (space_needed <= slot_it->length) {
-        std::memcpy(data_.data() + slot_it->offset, new_data.data(), new_data.size());
-        if (space_needed < slot_it->length) {
-            header_.free_space += (slot_it->length - space_needed);
-            slot_it->length = new_data.size();
-        }
-        header_.flags |= PAGE_DIRTY;
-        return true;
-    }
-    else if (space_needed <= space_available) {
-        compact_page();
-        if (space_needed <= header_.free_space) {
-            slot_it->offset = header_.free_space_offset;
-            std::memcpy(data_.data() + slot_it->offset, new_data.data(), new_data.size());
-            slot_it->length = new_data.size();
-            header_.free_space -= new_data.size();
-            header_.free_space_offset += new_data.size();
-            header_.flags |= PAGE_DIRTY;
-            return true;
-        }
-    }
-    return false;
-}
-
-bool Page::delete_record(uint32_t record_id) {
-    for (auto& slot : slots_) {
-        if (slot.record_id == record_id && slot.is_occupied()) {
-            slot.flags = SLOT_DELETED;
-            header_.flags |= PAGE_DIRTY;
-            return true;
-        }
-    }
-    return false;
-}
-
-void Page::compact_page() {
-    std::vector<uint8_t> new_data(PAGE_SIZE - sizeof(PageHeader));
-    uint16_t current_offset = sizeof(PageHeader);
-
-    for (auto& slot : slots_) {
-        if (slot.is_occupied()) {
-            std::memcpy(
-                new_data.data() + current_offset,
-                data_.data() + slot.offset,
-                slot.length
-            );
-            slot.offset = current_offset;
-            current_offset += slot.length;
-        }
-    }
-
-    data_ = std::move(new_data);
-    header_.free_space_offset = current_offset;
-    header_.free_space = PAGE_SIZE - sizeof(PageHeader) - current_offset;
-    header_.flags |= PAGE_DIRTY;
-}
-
-std::vector<uint8_t> Page::serialize() {
-    std::vector<uint8_t> buffer(PAGE_SIZE);
-    compact_page();
-    std::memcpy(buffer.data(), &header_, sizeof(PageHeader));
-    uint32_t slots_offset = sizeof(PageHeader);
-    size_t slots_bytes = slots_.size() * sizeof(Slot);
-    if (slots_offset + slots_bytes > buffer.size()) throw std::runtime_error("Serialize error: slot data out of bounds");
-    std::memcpy(
-        buffer.data() + slots_offset,
-        slots_.data(),
-        slots_bytes
-    );
-    size_t data_offset = sizeof(PageHeader) + slots_bytes;
-    size_t data_length = header_.free_space_offset - data_offset;
-    if (data_offset + data_length > buffer.size()) throw std::runtime_error("Serialize error: data out of bounds");
-    std::memcpy(
-        buffer.data() + data_offset,
-        data_.data(),
-        data_length
-    );
-    size_t bitmap_offset = PAGE_SIZE - sizeof(free_id_bitmap_);
-    if (bitmap_offset + sizeof(free_id_bitmap_) > buffer.size()) throw std::runtime_error("Serialize error: free_id_bitmap out of bounds");
-    std::memcpy(buffer.data() + bitmap_offset, &free_id_bitmap_, sizeof(free_id_bitmap_));
-    return buffer;
-}
-
-void Page::deserialize(const std::vector<uint8_t>& data) {
-    if (data.size() < sizeof(PageHeader)) throw std::runtime_error("Corrupt page: too small");
-    std::memcpy(&header_, data.data(), sizeof(PageHeader));
-
-    if (header_.slot_count > IDS_PER_PAGE) throw std::runtime_error("Corrupt page: too many slots");
-    slots_.resize(header_.slot_count);
-
-    uint32_t slots_offset = sizeof(PageHeader);
-    size_t slots_bytes = header_.slot_count * sizeof(Slot);
-    if (data.size() < slots_offset + slots_bytes) throw std::runtime_error("Corrupt page: slot data out of bounds");
-    std::memcpy(
-        slots_.data(),
-        data.data() + slots_offset,
-        slots_bytes
-    );
-
-    data_.resize(PAGE_SIZE - sizeof(PageHeader));
-    if (header_.free_space_offset > data_.size()) throw std::runtime_error("Corrupt page: free_space_offset out of bounds");
-    if (data.size() < header_.free_space_offset + data_.size()) throw std::runtime_error("Corrupt page: data out of bounds");
-    std::memcpy(
-        data_.data(),
-        data.data() + header_.free_space_offset,
-        data_.size()
-    );
-
-    size_t bitmap_offset = PAGE_SIZE - sizeof(free_id_bitmap_);
-    if (data.size() < bitmap_offset + sizeof(free_id_bitmap_)) throw std::runtime_error("Corrupt page: free_id_bitmap out of bounds");
-    std::memcpy(&free_id_bitmap_, data.data() + bitmap_offset, sizeof(free_id_bitmap_));
-}
-
 static TableMetadata make_table_metadata(const std::string& table_name, const std::vector<ColumnSchema>& schema) {
     TableMetadata new_table{};
-    std::memset(&new_table, 0, sizeof(TableMetadata));
+    std::memset(static_cast<void*>(&new_table), 0, sizeof(TableMetadata));
     size_t copy_len = std::min(table_name.size(), static_cast<size_t>(MAX_TABLE_NAME_LEN));
     table_name.copy(new_table.name, copy_len);
     new_table.name[copy_len] = '\0';
@@ -199,6 +26,13 @@ static TableMetadata make_table_metadata(const std::string& table_name, const st
         new_table.columns[i] = schema[i];
     }
     new_table.next_id_block = 0;
+    new_table.directory_page = INVALID_PAGE_ID;
+    new_table.indexed_columns = 0;
+    for (auto& root : new_table.index_roots) {
+        root = INVALID_PAGE_ID;
+    }
+    new_table.layout = TableLayout::Row;
+    new_table.zone_map_head = INVALID_PAGE_ID;
     return new_table;
 }
 
@@ -208,6 +42,30 @@ CatalogPage::CatalogPage() {
     header_.system_page_count = 1;
     header_.flags = CATALOG_CLEAN;
     header_.lsn = 0;
+    header_.next_page_id = INVALID_PAGE_ID;
+}
+
+const TableMetadata* CatalogPage::find(const std::string& table_name) const {
+    auto it = positions_.find(table_name.substr(0, MAX_TABLE_NAME_LEN));
+    return it != positions_.end() ? &tables_[it->second] : nullptr;
+}
+
+void CatalogPage::mark_changed(size_t position) {
+    catalog_dirty_ = true;
+    header_.flags |= CATALOG_DIRTY;
+    header_.lsn++;
+    if (table_changed_[position]) return;
+    table_changed_[position] = true;
+    changed_tables_.push_back(position);
+}
+
+void CatalogPage::reindex() {
+    positions_.clear();
+    for (size_t i = 0; i < tables_.size(); ++i) {
+        positions_[key_of(tables_[i].name)] = i;
+    }
+    table_changed_.assign(tables_.size(), false);
+    changed_tables_.clear();
 }
 
 bool CatalogPage::add_table(const std::string& table_name) {
@@ -215,7 +73,7 @@ bool CatalogPage::add_table(const std::string& table_name) {
         return false;
     }
 
-    if (get_table(table_name).has_value()) {
+    if (find(table_name) != nullptr) {
         return false;
     }
 
@@ -225,69 +83,71 @@ bool CatalogPage::add_table(const std::string& table_name) {
     new_table.record_count = 0;
     new_table.free_space_head = INVALID_PAGE_ID;
 
+    positions_[key_of(new_table.name)] = tables_.size();
     tables_.push_back(new_table);
+    table_changed_.push_back(false);
     header_.table_count++;
-    catalog_dirty_ = true;
-    header_.flags |= CATALOG_DIRTY;
-    header_.lsn++;
+    tables_moved_ = true;
+    mark_changed(tables_.size() - 1);
 
     return true;
 }
 
 std::optional<TableMetadata> CatalogPage::get_table(const std::string& name) const {
-    auto it = std::find_if(tables_.begin(), tables_.end(),
-        [&name](const TableMetadata& tm) {
-            return strncmp(tm.name, name.c_str(), MAX_TABLE_NAME_LEN) == 0;
-        });
-
-    if (it != tables_.end()) {
-        return *it;
+    const TableMetadata* table = find(name);
+    if (table != nullptr) {
+        return *table;
     }
     return std::nullopt;
 }
 
 bool CatalogPage::update_table(const TableMetadata& metadata) {
-    auto it = std::find_if(tables_.begin(), tables_.end(),
-        [&metadata](const TableMetadata& tm) {
-            return strncmp(tm.name, metadata.name, MAX_TABLE_NAME_LEN) == 0;
-        });
+    auto it = positions_.find(key_of(metadata.name));
+    if (it == positions_.end()) {
+        return false;
+    }
+    TableMetadata& table = tables_[it->second];
+    if (std::memcmp(&table, &metadata, sizeof(TableMetadata)) != 0) {
+        table = metadata;
+        mark_changed(it->second);
+    }
+    return true;
+}
 
-    if (it != tables_.end()) {
-        *it = metadata;
-        catalog_dirty_ = true;
-        header_.flags |= CATALOG_DIRTY;
-        header_.lsn++;
-        return true;
+bool CatalogPage::update_record_count(const TableMetadata& metadata) {
+    auto it = positions_.find(key_of(metadata.name));
+    if (it == positions_.end()) {
+        return false;
+    }
+    TableMetadata& table = tables_[it->second];
+    if (table.record_count != metadata.record_count) {
+        table.record_count = metadata.record_count;
+        mark_changed(it->second);
     }
-    return false;
+    return true;
 }
 
 bool CatalogPage::remove_table(const std::string& table_name) {
-    auto it = std::remove_if(tables_.begin(), tables_.end(),
-        [&table_name](const TableMetadata& tm) {
-            return strncmp(tm.name, table_name.c_str(), MAX_TABLE_NAME_LEN) == 0;
-        });
-
-    if (it != tables_.end()) {
-        tables_.erase(it, tables_.end());
-        header_.table_count--;
-        catalog_dirty_ = true;
-        header_.flags |= CATALOG_DIRTY;
-        header_.lsn++;
-        return true;
+    auto it = positions_.find(table_name.substr(0, MAX_TABLE_NAME_LEN));
+    if (it == positions_.end()) {
+        return false;
     }
-    return false;
+    tables_.erase(tables_.begin() + it->second);
+    header_.table_count--;
+    // Later tables moved down, so positions and change marks are rebuilt; the next log record is a full image
+    reindex();
+    tables_moved_ = true;
+    catalog_dirty_ = true;
+    header_.flags |= CATALOG_DIRTY;
+    header_.lsn++;
+    return true;
 }
 
 std::vector<uint8_t> CatalogPage::serialize() const {
-    std::vector<uint8_t> buffer(PAGE_SIZE, 0);
-    if (sizeof(CatalogHeader) > buffer.size()) throw std::runtime_error("Catalog serialize: header out of bounds");
+    std::vector<uint8_t> buffer(std::max<size_t>(PAGE_SIZE, serialized_size()), 0);
     memcpy(buffer.data(), &header_, sizeof(CatalogHeader));
-    size_t offset = sizeof(CatalogHeader);
-    for (const auto& table : tables_) {
-        if (offset + sizeof(TableMetadata) > buffer.size()) throw std::runtime_error("Catalog serialize: table out of bounds");
-        memcpy(buffer.data() + offset, &table, sizeof(TableMetadata));
-        offset += sizeof(TableMetadata);
+    if (!tables_.empty()) {
+        memcpy(buffer.data() + sizeof(CatalogHeader), tables_.data(), tables_.size() * sizeof(TableMetadata));
     }
     CatalogHeader* serialized_header = reinterpret_cast<CatalogHeader*>(buffer.data());
     serialized_header->flags = CATALOG_CLEAN;
@@ -298,17 +158,73 @@ void CatalogPage::deserialize(const std::vector<uint8_t>& data) {
     if (data.size() < sizeof(CatalogHeader)) throw std::runtime_error("Corrupt catalog: too small");
     memcpy(&header_, data.data(), sizeof(CatalogHeader));
     if (header_.table_count > MAX_TABLES) throw std::runtime_error("Corrupt catalog: too many tables");
+    if (sizeof(CatalogHeader) + header_.table_count * sizeof(TableMetadata) > data.size()) {
+        throw std::runtime_error("Corrupt catalog: table out of bounds");
+    }
     tables_.resize(header_.table_count);
+    if (!tables_.empty()) {
+        memcpy(tables_.data(), data.data() + sizeof(CatalogHeader), tables_.size() * sizeof(TableMetadata));
+    }
+    reindex();
+    tables_moved_ = false;
+    catalog_dirty_ = false;
+}
+
+std::vector<uint8_t> CatalogPage::serialize_changes() const {
+    std::vector<uint8_t> buffer(sizeof(CatalogHeader) + changed_tables_.size() * sizeof(TableMetadata));
+    memcpy(buffer.data(), &header_, sizeof(CatalogHeader));
     size_t offset = sizeof(CatalogHeader);
-    for (size_t i = 0; i < header_.table_count; i++) {
-        if (offset + sizeof(TableMetadata) > data.size()) throw std::runtime_error("Corrupt catalog: table out of bounds");
-        memcpy(&tables_[i], data.data() + offset, sizeof(TableMetadata));
+    for (size_t position : changed_tables_) {
+        memcpy(buffer.data() + offset, &tables_[position], sizeof(TableMetadata));
         offset += sizeof(TableMetadata);
     }
-    catalog_dirty_ = false;
+    return buffer;
 }
 
-FileStorageLayer::FileStorageLayer() : is_open(false) {}
+void CatalogPage::apply_changes(const std::vector<uint8_t>& data) {
+    if (data.size() < sizeof(CatalogHeader) || (data.size() - sizeof(CatalogHeader)) % sizeof(TableMetadata) != 0) {
+        throw std::runtime_error("Corrupt catalog record");
+    }
+    CatalogHeader header;
+    memcpy(&header, data.data(), sizeof(CatalogHeader));
+    // The table count follows the tables themselves, and the chain is wherever this catalog last wrote it
+    header.table_count = header_.table_count;
+    header.next_page_id = header_.next_page_id;
+    header_ = header;
+    for (size_t offset = sizeof(CatalogHeader); offset < data.size(); offset += sizeof(TableMetadata)) {
+        TableMetadata table;
+        memcpy(&table, data.data() + offset, sizeof(TableMetadata));
+        auto it = positions_.find(key_of(table.name));
+        if (it != positions_.end()) {
+            tables_[it->second] = table;
+            continue;
+        }
+        if (header_.table_count >= MAX_TABLES) throw std::runtime_error("Corrupt catalog record: too many tables");
+        positions_[key_of(table.name)] = tables_.size();
+        tables_.push_back(table);
+        table_changed_.push_back(false);
+        header_.table_count++;
+    }
+    catalog_dirty_ = true;
+}
+
+void CatalogPage::clear_changes() {
+    for (size_t position : changed_tables_) table_changed_[position] = false;
+    changed_tables_.clear();
+    tables_moved_ = false;
+}
+
+FileStorageLayer::FileStorageLayer() : FileStorageLayer(StorageOptions()) {}
+
+FileStorageLayer::FileStorageLayer(const StorageOptions& options) :
+    is_open(false),
+    options_(options),
+    buffer_pool_(options.buffer_pool_frames,
+        [this](uint32_t page_id, Page& page) { return read_page_from_disk(page_id, page); },
+        [this](Page& page) { write_page_to_disk(page); }) {
+    buffer_pool_.set_async_reader([this](std::vector<BufferPool::PendingRead> reads) { read_pages_from_disk(std::move(reads)); });
+    buffer_pool_.set_batch_writer([this](const std::vector<Page*>& pages) { write_pages_to_disk(pages); });
+}
 
 FileStorageLayer::~FileStorageLayer() {
     if (is_open) {
@@ -317,219 +233,933 @@ FileStorageLayer::~FileStorageLayer() {
 }
 
 void FileStorageLayer::open(const std::string& path) {
-    storage_path = path;
+    open(path, OpenMode::ReadWrite);
+}
 
-    if (!fs::exists(storage_path)) {
-        fs::create_directory(storage_path);
+void FileStorageLayer::open(const std::string& path, OpenMode mode) {
+    std::unique_lock<std::shared_mutex> state(state_latch_);
+    storage_path = path;
+    read_only_ = mode == OpenMode::ReadOnlyMmap;
+    mapped_ = nullptr;
+    if (read_only_) {
+        const std::filesystem::path segment = std::filesystem::path(storage_path) / SEGMENT_FILE_NAME;
+        if (!std::filesystem::exists(segment)) {
+            throw std::runtime_error("Read-only open needs a single-file storage at " + storage_path);
+        }
+        // Nothing is replayed without a writer, so the pages must already hold every commit
+        const std::filesystem::path log = std::filesystem::path(storage_path) / WAL_FILE_NAME;
+        if (std::filesystem::exists(log) && std::filesystem::file_size(log) > sizeof(WalFileHeader)) {
+            throw std::runtime_error("Log in " + storage_path + " holds changes that are not checkpointed");
+        }
+        auto mapped = std::make_unique<MappedSegmentDiskManager>(segment.string());
+        mapped_ = mapped.get();
+        disk_ = std::move(mapped);
+    } else {
+        disk_ = DiskManager::open(storage_path, options_.layout, options_.io_backend);
     }
 
-    std::string catalog_path = get_page_path(CATALOG_PAGE_ID);
-    if (fs::exists(catalog_path)) {
-        std::ifstream in(catalog_path, std::ios::binary);
-        std::vector<uint8_t> data(PAGE_SIZE);
-        in.read(reinterpret_cast<char*>(data.data()), PAGE_SIZE);
+    std::vector<uint8_t> data(PAGE_SIZE);
+    catalog_pages_.clear();
+    if (disk_->read_page(CATALOG_PAGE_ID, data.data())) {
+        uint32_t next_page_id;
+        std::memcpy(&next_page_id, data.data() + offsetof(CatalogHeader, next_page_id), sizeof(next_page_id));
+        // A catalog page that was never written reads as zeros, and no chain starts at the catalog page
+        if (next_page_id != INVALID_PAGE_ID && next_page_id != CATALOG_PAGE_ID) {
+            std::vector<uint8_t> rest = read_page_chain(*disk_, next_page_id, catalog_pages_);
+            data.insert(data.end(), rest.begin(), rest.end());
+        }
         catalog_.deserialize(data);
     }
     else {
         catalog_ = CatalogPage();
     }
+    logged_catalog_lsn_ = catalog_.get_lsn();
 
     is_open = true;
+    ++schema_version_;
+    if (options_.enable_wal && !read_only_) {
+        wal_ = std::make_unique<WriteAheadLog>((std::filesystem::path(storage_path) / WAL_FILE_NAME).string(),
+            options_.wal_commit_delay);
+        recover_from_log();
+    }
+    if (!read_only_) start_background_writer();
 }
 
 void FileStorageLayer::close() {
+    // The writer takes the storage latch itself, so it must be gone before close takes it
+    stop_background_writer();
+    std::unique_lock<std::shared_mutex> state(state_latch_);
     if (!is_open) return;
 
-    flush();
+    flush_locked();
+    buffer_pool_.clear();
+    table_cache_.clear();
+    released_overflow_.clear();
+    free_overflow_.clear();
+    wal_.reset();
+    mapped_ = nullptr;
+    disk_.reset();
     is_open = false;
+    read_only_ = false;
+}
+
+void FileStorageLayer::check_writable() const {
+    if (read_only_) throw std::runtime_error("Storage is open read-only");
+}
+
+// Heap page bytes an encoded row of this size takes, slot included
+static uint32_t record_cost(const TableMetadata& metadata, size_t size) {
+    // A PAX page keeps the fields but drops the TupleHeader
+    const size_t header = metadata.layout == TableLayout::Pax ? sizeof(TupleHeader) : 0;
+    return static_cast<uint32_t>(size - header + sizeof(Slot));
+}
+
+// Bytes of a decoded row's values, as StorageStats::bytes_decoded counts them
+static size_t text_bytes(const std::vector<std::string>& row) {
+    size_t bytes = 0;
+    for (const auto& value : row) bytes += value.size();
+    return bytes;
 }
 
-static std::vector<uint8_t> serialize_row(const std::vector<ColumnSchema>& schema, const std::vector<std::string>& values) {
+/**
+ * Key bounds of an index range, in the column's key encoding.
+ * @throws std::runtime_error if the column is not in the table
+ */
+static KeyRange make_key_range(const TableMetadata& metadata, const IndexRange& index_range) {
+    const int col = index_range.column;
+    if (col < 0 || static_cast<uint32_t>(col) >= metadata.column_count) {
+        throw std::runtime_error("Invalid column index for index range");
+    }
+    const ColumnType type = metadata.columns[col].type;
+    KeyRange range;
+    if (index_range.lower) range.lower = BTreeIndex::encode_key(type, *index_range.lower);
+    range.lower_inclusive = index_range.lower_inclusive;
+    if (index_range.upper) range.upper = BTreeIndex::encode_key(type, *index_range.upper);
+    range.upper_inclusive = index_range.upper_inclusive;
+    return range;
+}
+
+// Appends the encoded row to out; returns the encoded length. Columns whose entry in external names
+// a page hold that ToastPointer instead of their value
+static size_t serialize_row(const TableMetadata& metadata, const std::vector<std::string>& values, std::vector<uint8_t>& out,
+    const ToastPointer* external = nullptr) {
+    auto is_external = [external](size_t i) { return external && external[i].first_page != INVALID_PAGE_ID; };
+    const size_t start = out.size();
+    size_t length = sizeof(TupleHeader);
+    for (size_t i = 0; i < metadata.column_count; ++i) {
+        if (metadata.columns[i].type == ColumnType::INT) {
+            length += INT_SIZE;
+        } else {
+            if (values[i].size() >= TOAST_FLAG) throw std::runtime_error("TEXT value too long");
+            length += INT_SIZE + (is_external(i) ? sizeof(ToastPointer) : values[i].size());
+        }
+    }
+    out.resize(start + length);
+    uint8_t* data = out.data() + start;
     TupleHeader header{};
-    header.field_count = schema.size();
-    std::vector<uint8_t> data;
+    header.field_count = metadata.column_count;
     size_t offset = sizeof(TupleHeader);
-    data.resize(sizeof(TupleHeader), 0);
-    for (size_t i = 0; i < schema.size(); ++i) {
+    for (size_t i = 0; i < metadata.column_count; ++i) {
         header.offsets[i] = offset;
-        const auto& col = schema[i];
+        const auto& col = metadata.columns[i];
         const auto& val = values[i];
         if (col.type == ColumnType::INT) {
             int32_t intval = std::stoi(val);
-            uint8_t buf[INT_SIZE];
-            std::memcpy(buf, &intval, INT_SIZE);
-            data.insert(data.end(), buf, buf + INT_SIZE);
+            std::memcpy(data + offset, &intval, INT_SIZE);
             offset += INT_SIZE;
+        } else if (is_external(i)) {
+            uint32_t len = TOAST_FLAG | sizeof(ToastPointer);
+            std::memcpy(data + offset, &len, INT_SIZE);
+            std::memcpy(data + offset + INT_SIZE, &external[i], sizeof(ToastPointer));
+            offset += INT_SIZE + sizeof(ToastPointer);
         } else if (col.type == ColumnType::TEXT) {
             uint32_t len = val.size();
-            data.insert(data.end(), reinterpret_cast<uint8_t*>(&len), reinterpret_cast<uint8_t*>(&len) + INT_SIZE);
-            data.insert(data.end(), val.begin(), val.end());
+            std::memcpy(data + offset, &len, INT_SIZE);
+            std::memcpy(data + offset + INT_SIZE, val.data(), len);
             offset += INT_SIZE + len;
         }
     }
-    std::memcpy(data.data(), &header, sizeof(TupleHeader));
-    return data;
+    std::memcpy(data, &header, sizeof(TupleHeader));
+    return length;
 }
 
-static std::vector<std::string> deserialize_row(const std::vector<ColumnSchema>& schema, const std::vector<uint8_t>& data) {
-    std::vector<std::string> values;
-    if (data.size() < sizeof(TupleHeader)) return values;
-    TupleHeader header;
-    std::memcpy(&header, data.data(), sizeof(TupleHeader));
-    for (size_t i = 0; i < schema.size(); ++i) {
-        const auto& col = schema[i];
-        size_t field_offset = header.offsets[i];
-        if (col.type == ColumnType::INT) {
-            int32_t intval;
-            std::memcpy(&intval, data.data() + field_offset, INT_SIZE);
-            values.push_back(std::to_string(intval));
-        } else if (col.type == ColumnType::TEXT) {
-            uint32_t len;
-            std::memcpy(&len, data.data() + field_offset, INT_SIZE);
-            std::string str(reinterpret_cast<const char*>(data.data() + field_offset + INT_SIZE), len);
-            values.push_back(str);
+void FileStorageLayer::encode_row(const TableMetadata& metadata, const std::vector<std::string>& values, std::vector<uint8_t>& out,
+    const ToastPointer* kept) {
+    const size_t start = out.size();
+    size_t length = serialize_row(metadata, values, out, kept);
+    // PAX pages store TEXT fields in their own minipages and keep every value inline
+    if (metadata.layout != TableLayout::Row || length <= TOAST_THRESHOLD) return;
+    ToastPointer external[MAX_COLUMNS];
+    for (size_t i = 0; i < MAX_COLUMNS; ++i) {
+        external[i] = kept && i < metadata.column_count ? kept[i] : ToastPointer{INVALID_PAGE_ID, 0};
+    }
+    // The row encoded, so its INT fields are valid: move the longest values out until it is short enough
+    std::vector<size_t> texts;
+    for (size_t i = 0; i < metadata.column_count; ++i) {
+        if (metadata.columns[i].type == ColumnType::TEXT && external[i].first_page == INVALID_PAGE_ID) texts.push_back(i);
+    }
+    std::stable_sort(texts.begin(), texts.end(), [&values](size_t a, size_t b) { return values[a].size() > values[b].size(); });
+    for (size_t col : texts) {
+        if (length <= TOAST_THRESHOLD || values[col].size() <= sizeof(ToastPointer)) break;
+        external[col] = write_overflow(values[col]);
+        length -= values[col].size() - sizeof(ToastPointer);
+    }
+    out.resize(start);
+    serialize_row(metadata, values, out, external);
+}
+
+// Pages in the chain of a value this long
+static size_t overflow_page_count(size_t length) {
+    return (length + OVERFLOW_PAGE_CAPACITY - 1) / OVERFLOW_PAGE_CAPACITY;
+}
+
+ToastPointer FileStorageLayer::write_overflow(std::string_view value) {
+    const size_t count = overflow_page_count(value.size());
+    std::vector<uint32_t> page_ids;
+    page_ids.reserve(count);
+    while (page_ids.size() < count) {
+        ToastPointer chain;
+        {
+            std::lock_guard<std::mutex> lock(overflow_mutex_);
+            if (free_overflow_.empty()) break;
+            chain = free_overflow_.back();
+            free_overflow_.pop_back();
+        }
+        // Walked outside the mutex; the links are read before the pages are rewritten below
+        uint32_t page_id = chain.first_page;
+        size_t pages = overflow_page_count(chain.length);
+        while (pages > 0 && page_ids.size() < count) {
+            page_ids.push_back(page_id);
+            if (--pages > 0) page_id = read_heap_page(page_id).header().next_page_id;
+        }
+        if (pages > 0) {
+            // The unused tail stays free as a chain of its own
+            std::lock_guard<std::mutex> lock(overflow_mutex_);
+            free_overflow_.push_back(ToastPointer{page_id, static_cast<uint32_t>(pages * OVERFLOW_PAGE_CAPACITY)});
         }
     }
-    return values;
+    while (page_ids.size() < count) page_ids.push_back(allocate_new_page());
+    for (size_t i = 0; i < count; ++i) {
+        const size_t offset = i * OVERFLOW_PAGE_CAPACITY;
+        PageGuard page = get_or_create_page(page_ids[i]);
+        page->format_overflow(reinterpret_cast<const uint8_t*>(value.data()) + offset,
+            std::min<size_t>(OVERFLOW_PAGE_CAPACITY, value.size() - offset), i + 1 < count ? page_ids[i + 1] : INVALID_PAGE_ID);
+        if (wal_) page->set_lsn(wal_->append(WalRecordType::PageImage, page_ids[i], page->image(), PAGE_SIZE));
+    }
+    return ToastPointer{page_ids[0], static_cast<uint32_t>(value.size())};
+}
+
+void FileStorageLayer::release_overflow(const TableMetadata& metadata, const std::vector<uint8_t>& old_record,
+    const std::vector<uint8_t>* record) {
+    if (metadata.layout != TableLayout::Row) return;
+    RowView old_row(metadata.columns, metadata.column_count, old_record.data(), old_record.size());
+    std::optional<RowView> new_row;
+    if (record) new_row.emplace(metadata.columns, metadata.column_count, record->data(), record->size());
+    for (size_t col = 0; col < metadata.column_count; ++col) {
+        const std::optional<ToastPointer> chain = old_row.external(col);
+        if (!chain) continue;
+        if (new_row) {
+            // Updates that leave a value alone keep its chain
+            const std::optional<ToastPointer> kept = new_row->external(col);
+            if (kept && kept->first_page == chain->first_page) continue;
+        }
+        std::lock_guard<std::mutex> lock(overflow_mutex_);
+        // Without a log nothing rolls the row back, so the chain is free at once
+        (wal_ ? released_overflow_ : free_overflow_).push_back(*chain);
+    }
+}
+
+ToastReader FileStorageLayer::toast_reader() {
+    return ToastReader([this](uint32_t page_id) { return read_heap_page(page_id); });
 }
 
 void FileStorageLayer::create(const std::string& table, const std::vector<ColumnSchema>& schema) {
-    if (catalog_.get_table(table).has_value()) {
-        throw std::runtime_error("Table already exists");
+    create(table, schema, TableLayout::Row);
+}
+
+void FileStorageLayer::create(const std::string& table, const std::vector<ColumnSchema>& schema, TableLayout layout) {
+    std::shared_lock<std::shared_mutex> state(state_latch_);
+    check_writable();
+    if (layout == TableLayout::Pax && (schema.empty() || schema.size() > PAX_MAX_COLUMNS)) {
+        throw std::runtime_error("A PAX table needs 1 to " + std::to_string(PAX_MAX_COLUMNS) + " columns");
+    }
+    for (const auto& column : schema) {
+        const ColumnEncoding encoding = column.encoding;
+        const bool valid = encoding == ColumnEncoding::Plain || encoding == ColumnEncoding::Auto ||
+            (encoding == ColumnEncoding::Dictionary && column.type == ColumnType::TEXT) ||
+            ((encoding == ColumnEncoding::FrameOfReference || encoding == ColumnEncoding::RunLength) && column.type == ColumnType::INT);
+        if (!valid) throw std::runtime_error("Unsupported encoding for column " + std::string(column.name));
+        if (encoding != ColumnEncoding::Plain && layout != TableLayout::Pax) {
+            throw std::runtime_error("Column encodings need a PAX table");
+        }
     }
     TableMetadata new_table = make_table_metadata(table, schema);
-    catalog_.add_table(table);
-    catalog_.update_table(new_table);
-    table_cache_[table] = new_table;
-    catalog_.set_dirty();
+    new_table.layout = layout;
+    {
+        std::lock_guard<std::mutex> lock(catalog_mutex_);
+        if (catalog_.get_table(table).has_value()) {
+            throw std::runtime_error("Table already exists");
+        }
+        catalog_.add_table(table);
+        catalog_.update_table(new_table);
+        catalog_.set_dirty();
+    }
+    auto handle = std::make_unique<TableHandle>();
+    handle->metadata = new_table;
+    handle->indexes.resize(new_table.column_count);
+    handle->zones = ZoneMap(new_table.column_count);
+    std::unique_lock<std::shared_mutex> tables(tables_mutex_);
+    table_cache_[table] = std::move(handle);
+    ++schema_version_;
 }
 
 uint32_t FileStorageLayer::insert(const std::string& table, const std::vector<std::string>& values) {
+    std::shared_lock<std::shared_mutex> state(state_latch_);
     if (!is_open) throw std::runtime_error("Storage not open");
-    TableMetadata& metadata = get_table_metadata(table);
+    check_writable();
+    TableHandle& handle = get_table_handle(table);
+    std::unique_lock<std::shared_mutex> table_lock(handle.latch);
+    TableMetadata& metadata = handle.metadata;
     if (values.size() != metadata.column_count) throw std::runtime_error("Column count mismatch");
-    std::vector<ColumnSchema> schema(metadata.columns, metadata.columns + metadata.column_count);
-    std::vector<uint8_t> record = serialize_row(schema, values);
-    uint32_t current_page_id = metadata.first_data_page;
-    while (current_page_id != INVALID_PAGE_ID) {
-        Page& page = get_or_load_page(current_page_id);
-        for (uint32_t i = 0; i < IDS_PER_PAGE; ++i) {
-            if (!page.free_id_bitmap().test(i)) {
-                uint32_t record_id = page.get_id_range_start() + i;
-                if (page.insert_record(record_id, record).has_value()) {
-                    page.free_id_bitmap().set(i);
-                    metadata.record_count++;
-                    catalog_.update_table(metadata);
-                    return record_id;
-                }
+    std::vector<uint8_t> record;
+    encode_row(metadata, values, record);
+    PageGuard page;
+    uint32_t record_id = insert_record(handle, record.data(), record.size(), page);
+    save_record_count(metadata);
+    return record_id;
+}
+
+std::vector<uint32_t> FileStorageLayer::insert_batch(const std::string& table, const std::vector<std::vector<std::string>>& rows) {
+    std::shared_lock<std::shared_mutex> state(state_latch_);
+    if (!is_open) throw std::runtime_error("Storage not open");
+    check_writable();
+    TableHandle& handle = get_table_handle(table);
+    std::unique_lock<std::shared_mutex> table_lock(handle.latch);
+    TableMetadata& metadata = handle.metadata;
+    // Check every row before any is encoded: encoding writes the overflow pages of long values, so a
+    // bad value found after them would leave those pages behind
+    for (const auto& values : rows) {
+        if (values.size() != metadata.column_count) throw std::runtime_error("Column count mismatch");
+        for (size_t col = 0; col < metadata.column_count; ++col) {
+            if (metadata.columns[col].type == ColumnType::INT && !exact_int(values[col])) {
+                throw std::runtime_error("Invalid INT value for column " + std::string(metadata.columns[col].name) + ": " + values[col]);
             }
+            if (values[col].size() >= TOAST_FLAG) throw std::runtime_error("TEXT value too long");
         }
-        current_page_id = page.get_next_page_id();
     }
-    uint32_t new_page_id = allocate_new_page();
-    uint32_t id_range_start = (metadata.next_id_block == 0) ? 1 : (metadata.next_id_block * IDS_PER_PAGE + 1);
-    Page& new_page = get_or_create_page(new_page_id, id_range_start);
-    new_page.set_id_range(id_range_start, id_range_start + IDS_PER_PAGE);
-    new_page.free_id_bitmap().reset();
-    uint32_t record_id = id_range_start;
-    if (!new_page.insert_record(record_id, record).has_value()) {
-        throw std::runtime_error("Failed to insert record in new page");
-    }
-    new_page.free_id_bitmap().set(0);
-    if (metadata.last_data_page == INVALID_PAGE_ID) {
-        metadata.first_data_page = new_page_id;
-    } else {
-        Page& prev_last = get_or_load_page(metadata.last_data_page);
-        prev_last.set_next_page_id(new_page_id);
-        page_cache_[metadata.last_data_page] = prev_last;
+    std::vector<uint8_t> records;
+    std::vector<size_t> offsets;
+    offsets.reserve(rows.size() + 1);
+    for (const auto& values : rows) {
+        offsets.push_back(records.size());
+        encode_row(metadata, values, records);
+    }
+    offsets.push_back(records.size());
+
+    std::vector<uint32_t> record_ids;
+    record_ids.reserve(rows.size());
+    PageGuard page;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        record_ids.push_back(insert_record(handle, records.data() + offsets[i], offsets[i + 1] - offsets[i], page));
+    }
+    if (!rows.empty()) {
+        save_record_count(metadata);
+    }
+    return record_ids;
+}
+
+uint32_t FileStorageLayer::insert_record(TableHandle& handle, const uint8_t* record, size_t size, PageGuard& page) {
+    const uint32_t required = record_cost(handle.metadata, size);
+    const uint32_t capacity = handle.metadata.layout == TableLayout::Pax ? PAX_DATA_CAPACITY : PAGE_DATA_CAPACITY;
+    if (required > capacity) throw std::runtime_error("Record too large for a page");
+    // Keep appending to the page the previous row went to while it still has room
+    if (page && !(page->first_free_id().has_value() && page->reclaimable_space() >= required)) {
+        page.release();
+    }
+    if (!page) {
+        page = find_free_page_for_table(handle, required);
+    }
+    bool appended = false;
+    if (!page) {
+        page = append_data_page(handle);
+        appended = true;
+    }
+    uint32_t record_id = page->first_free_id().value();
+    prepare_page_change(*page);
+    // A PAX page's free space is an estimate: values its encodings cannot take may still not fit
+    while (!page->insert_record(record_id, record, size).has_value()) {
+        if (appended) throw std::runtime_error("Failed to insert record in new page");
+        handle.free_space.set(PageDirectory::block_of(page->get_id_range_start()), 0);
+        page.release();
+        page = append_data_page(handle);
+        appended = true;
+        record_id = page->first_free_id().value();
+        prepare_page_change(*page);
+    }
+    log_page_change(*page, WalRecordType::Insert, record_id, record, size);
+    page->free_id_bitmap().set(record_id - page->get_id_range_start());
+    update_free_space(handle, *page);
+    handle.metadata.record_count++;
+    RowView row(handle.metadata.columns, handle.metadata.column_count, record, size, record_id);
+    handle.zones.add_row(PageDirectory::block_of(record_id), row);
+    if (handle.metadata.indexed_columns != 0) {
+        ToastReader toast = toast_reader();
+        row.set_toast_reader(&toast);
+        index_row(handle, row);
     }
-    metadata.last_data_page = new_page_id;
-    metadata.record_count++;
-    metadata.next_id_block++;
-    catalog_.update_table(metadata);
     return record_id;
 }
 
 std::vector<std::string> FileStorageLayer::get(const std::string& table, uint32_t record_id) {
+    std::shared_lock<std::shared_mutex> state(state_latch_);
     if (!is_open) throw std::runtime_error("Storage not open");
-    const TableMetadata& metadata = get_table_metadata(table);
-    std::vector<ColumnSchema> schema(metadata.columns, metadata.columns + metadata.column_count);
-    uint32_t current_page_id = metadata.first_data_page;
-    while (current_page_id != INVALID_PAGE_ID) {
-        Page& page = get_or_load_page(current_page_id);
-        auto record = page.get_record(record_id);
-        if (record.has_value()) {
-            return deserialize_row(schema, record.value());
-        }
-        current_page_id = page.get_next_page_id();
+    TableHandle& handle = get_table_handle(table);
+    const TableMetadata& metadata = handle.metadata;
+    uint32_t page_id;
+    {
+        std::shared_lock<std::shared_mutex> table_lock(handle.latch);
+        page_id = handle.directory.page_for_record(record_id);
     }
-    throw std::runtime_error("Record not found");
+    PageRef page = page_id != INVALID_PAGE_ID ? read_heap_page(page_id) : PageRef();
+    const Slot* slot = page ? page.find_record(record_id) : nullptr;
+    if (slot == nullptr) throw std::runtime_error("Record not found");
+    ToastReader toast = toast_reader();
+    RowView row = page.row_view(metadata.columns, metadata.column_count, *slot);
+    row.set_toast_reader(&toast);
+    std::vector<std::string> values = row.to_strings();
+    ScanTally tally{1, 1, text_bytes(values)};
+    counters_.add(tally);
+    return values;
 }
 
 void FileStorageLayer::update(const std::string& table, uint32_t record_id, const std::vector<std::string>& values) {
+    std::shared_lock<std::shared_mutex> state(state_latch_);
     if (!is_open) throw std::runtime_error("Storage not open");
-    TableMetadata& metadata = get_table_metadata(table);
+    check_writable();
+    TableHandle& handle = get_table_handle(table);
+    std::unique_lock<std::shared_mutex> table_lock(handle.latch);
+    const TableMetadata& metadata = handle.metadata;
     if (values.size() != metadata.column_count) throw std::runtime_error("Column count mismatch");
-    std::vector<ColumnSchema> schema(metadata.columns, metadata.columns + metadata.column_count);
-    std::vector<uint8_t> updated_record = serialize_row(schema, values);
-    uint32_t current_page_id = metadata.first_data_page;
-    while (current_page_id != INVALID_PAGE_ID) {
-        Page& page = get_or_load_page(current_page_id);
-        if (page.update_record(record_id, updated_record)) {
-            return;
-        }
-        current_page_id = page.get_next_page_id();
-    }
-    throw std::runtime_error("Record not found for update");
+    std::vector<uint8_t> updated_record;
+    encode_row(metadata, values, updated_record);
+    PageGuard page = get_record_page(handle, record_id, PageLatch::Exclusive);
+    if (!page || !page->has_record(record_id)) throw std::runtime_error("Record not found for update");
+    prepare_page_change(*page);
+    replace_row(handle, *page, record_id, updated_record);
+    update_free_space(handle, *page);
+    if (metadata.indexed_columns != 0) save_index_roots(handle);
 }
 
 void FileStorageLayer::delete_record(const std::string& table, uint32_t record_id) {
+    std::shared_lock<std::shared_mutex> state(state_latch_);
     if (!is_open) throw std::runtime_error("Storage not open");
-    TableMetadata& metadata = get_table_metadata(table);
-    uint32_t current_page_id = metadata.first_data_page;
-    while (current_page_id != INVALID_PAGE_ID) {
-        Page& page = get_or_load_page(current_page_id);
-        if (record_id >= page.get_id_range_start() && record_id < page.get_id_range_end()) {
-            uint32_t idx = record_id - page.get_id_range_start();
-            if (page.delete_record(record_id)) {
-                if (idx < IDS_PER_PAGE) {
-                    page.free_id_bitmap().reset(idx);
+    check_writable();
+    TableHandle& handle = get_table_handle(table);
+    std::unique_lock<std::shared_mutex> table_lock(handle.latch);
+    TableMetadata& metadata = handle.metadata;
+    PageGuard page = get_record_page(handle, record_id, PageLatch::Exclusive);
+    if (!page) throw std::runtime_error("Record not found for deletion");
+    prepare_page_change(*page);
+    if (!erase_row(handle, *page, record_id)) {
+        throw std::runtime_error("Delete failed: record not found or already deleted");
+    }
+    update_free_space(handle, *page);
+    if (metadata.record_count > 0) {
+        metadata.record_count--;
+    }
+    save_record_count(metadata);
+}
+
+size_t FileStorageLayer::delete_where(const std::string& table, const PredicateProgram* where,
+    const std::optional<IndexRange>& index_range) {
+    std::shared_lock<std::shared_mutex> state(state_latch_);
+    if (!is_open) throw std::runtime_error("Storage not open");
+    check_writable();
+    TableHandle& handle = get_table_handle(table);
+    std::unique_lock<std::shared_mutex> table_lock(handle.latch);
+    TableMetadata& metadata = handle.metadata;
+    size_t deleted = 0;
+    mutate_matches(handle, where, index_range, [&](Page& page, const std::vector<uint32_t>& record_ids) {
+        prepare_page_change(page);
+        for (uint32_t record_id : record_ids) {
+            if (erase_row(handle, page, record_id)) ++deleted;
+        }
+        update_free_space(handle, page);
+    });
+    if (deleted == 0) return 0;
+    metadata.record_count -= std::min<size_t>(deleted, metadata.record_count);
+    save_record_count(metadata);
+    return deleted;
+}
+
+size_t FileStorageLayer::update_where(const std::string& table, const std::vector<std::pair<int, std::string>>& assignments,
+    const PredicateProgram* where, const std::optional<IndexRange>& index_range) {
+    std::shared_lock<std::shared_mutex> state(state_latch_);
+    if (!is_open) throw std::runtime_error("Storage not open");
+    check_writable();
+    TableHandle& handle = get_table_handle(table);
+    std::unique_lock<std::shared_mutex> table_lock(handle.latch);
+    const TableMetadata& metadata = handle.metadata;
+    // Reject bad values before any row changes
+    for (const auto& [col, value] : assignments) {
+        if (col < 0 || static_cast<uint32_t>(col) >= metadata.column_count) {
+            throw std::runtime_error("Invalid column index for update");
+        }
+        if (metadata.columns[col].type == ColumnType::INT && !exact_int(value)) {
+            throw std::runtime_error("Invalid INT value for column " + std::string(metadata.columns[col].name) + ": " + value);
+        }
+    }
+    std::vector<bool> assigned(metadata.column_count, false);
+    for (const auto& assignment : assignments) assigned[assignment.first] = true;
+    size_t updated = 0;
+    std::vector<uint8_t> record;
+    mutate_matches(handle, where, index_range, [&](Page& page, const std::vector<uint32_t>& record_ids) {
+        prepare_page_change(page);
+        ToastReader toast = toast_reader();
+        std::vector<std::string> values(metadata.column_count);
+        ToastPointer kept[MAX_COLUMNS];
+        for (uint32_t record_id : record_ids) {
+            RowView row = page.row_view(metadata.columns, metadata.column_count, *page.find_record(record_id));
+            toast.clear();
+            row.set_toast_reader(&toast);
+            for (size_t col = 0; col < metadata.column_count; ++col) {
+                kept[col] = ToastPointer{INVALID_PAGE_ID, 0};
+                if (assigned[col]) continue;
+                // Values left alone keep their overflow chain instead of being read and written to a new one
+                if (std::optional<ToastPointer> chain = row.external(col)) {
+                    kept[col] = *chain;
+                    values[col].clear();
+                } else {
+                    values[col] = row.to_string(col);
                 }
-                if (metadata.record_count > 0) {
-                    metadata.record_count--;
+            }
+            for (const auto& [col, value] : assignments) values[col] = value;
+            record.clear();
+            encode_row(metadata, values, record, kept);
+            replace_row(handle, page, record_id, record);
+            ++updated;
+        }
+        update_free_space(handle, page);
+    });
+    if (metadata.indexed_columns != 0) save_index_roots(handle);
+    return updated;
+}
+
+bool FileStorageLayer::erase_row(TableHandle& handle, Page& page, uint32_t record_id) {
+    const TableMetadata& metadata = handle.metadata;
+    // Logged with the delete, so recovery can put the row back
+    std::optional<std::vector<uint8_t>> old_record = page.get_record(record_id);
+    if (!old_record || !page.delete_record(record_id)) return false;
+    if (metadata.indexed_columns != 0) {
+        ToastReader toast = toast_reader();
+        RowView old_row(metadata.columns, metadata.column_count, old_record->data(), old_record->size(), record_id);
+        old_row.set_toast_reader(&toast);
+        unindex_row(handle, old_row);
+    }
+    log_page_change(page, WalRecordType::Delete, record_id, old_record->data(), old_record->size());
+    release_overflow(metadata, *old_record, nullptr);
+    page.free_id_bitmap().reset(record_id - page.get_id_range_start());
+    return true;
+}
+
+void FileStorageLayer::replace_row(TableHandle& handle, Page& page, uint32_t record_id, const std::vector<uint8_t>& record) {
+    const TableMetadata& metadata = handle.metadata;
+    // The old bytes are logged for recovery to restore, and the old keys find the entries to replace
+    std::optional<std::vector<uint8_t>> old_record = page.get_record(record_id);
+    if (!old_record || !page.update_record(record_id, record)) {
+        throw std::runtime_error("Update failed: record no longer fits in its page");
+    }
+    if (wal_) {
+        const uint32_t prefix[2] = {record_id, static_cast<uint32_t>(record.size())};
+        page.set_lsn(wal_->append(WalRecordType::Update, page.get_page_id(), prefix, sizeof(prefix), record.data(),
+            record.size(), old_record->data(), old_record->size()));
+    }
+    release_overflow(metadata, *old_record, &record);
+    RowView new_row(metadata.columns, metadata.column_count, record.data(), record.size(), record_id);
+    handle.zones.add_row(PageDirectory::block_of(record_id), new_row);
+    if (metadata.indexed_columns == 0) return;
+    RowView old_row(metadata.columns, metadata.column_count, old_record->data(), old_record->size(), record_id);
+    ToastReader toast = toast_reader();
+    old_row.set_toast_reader(&toast);
+    new_row.set_toast_reader(&toast);
+    for (size_t col = 0; col < handle.indexes.size(); ++col) {
+        if (!handle.indexes[col]) continue;
+        std::string old_key = BTreeIndex::key_of(old_row, col);
+        std::string new_key = BTreeIndex::key_of(new_row, col);
+        if (old_key == new_key) continue;
+        handle.indexes[col]->remove(old_key, record_id);
+        handle.indexes[col]->insert(new_key, record_id);
+    }
+}
+
+void FileStorageLayer::mutate_matches(TableHandle& handle, const PredicateProgram* where,
+    const std::optional<IndexRange>& index_range,
+    const std::function<void(Page& page, const std::vector<uint32_t>& record_ids)>& mutate) {
+    const TableMetadata& metadata = handle.metadata;
+    if (where && where->always_false()) return;
+    std::optional<KeyRange> key_range;
+    ColumnType range_type = ColumnType::INT;
+    if (index_range) {
+        key_range = make_key_range(metadata, *index_range);
+        range_type = metadata.columns[index_range->column].type;
+    }
+    ToastReader toast = toast_reader();
+    auto matches = [&](RowView row) {
+        toast.clear();
+        row.set_toast_reader(&toast);
+        if (key_range && !BTreeIndex::in_range(range_type, *key_range, BTreeIndex::key_of(row, index_range->column))) {
+            return false;
+        }
+        return !where || where->matches(row);
+    };
+    std::vector<uint32_t> record_ids;
+    if (key_range && handle.indexes[index_range->column]) {
+        // Candidates from the index, grouped by page in record id order so each page is latched once
+        std::vector<std::pair<uint32_t, uint32_t>> candidates; // (page id, record id)
+        for (uint32_t record_id : handle.indexes[index_range->column]->range(*key_range)) {
+            candidates.emplace_back(handle.directory.page_for_record(record_id), record_id);
+        }
+        std::sort(candidates.begin(), candidates.end());
+        for (size_t i = 0; i < candidates.size();) {
+            const uint32_t page_id = candidates[i].first;
+            size_t end = i;
+            while (end < candidates.size() && candidates[end].first == page_id) ++end;
+            if (page_id != INVALID_PAGE_ID) {
+                PageGuard page = get_or_load_page(page_id, PageLatch::Exclusive);
+                record_ids.clear();
+                for (; i < end; ++i) {
+                    const Slot* slot = page->find_record(candidates[i].second);
+                    if (slot && matches(page->row_view(metadata.columns, metadata.column_count, *slot))) {
+                        record_ids.push_back(candidates[i].second);
+                    }
                 }
-                catalog_.update_table(metadata);
-                return;
-            } else {
-                throw std::runtime_error("Delete failed: record not found or already deleted");
+                if (!record_ids.empty()) mutate(*page, record_ids);
             }
+            i = end;
         }
-        current_page_id = page.get_next_page_id();
+        return;
+    }
+    const std::vector<uint32_t> pages = table_pages_locked(handle, where);
+    ReadAhead read_ahead = heap_read_ahead();
+    for (size_t next = 0; next < pages.size();) {
+        read_ahead.advance(pages, next);
+        PageGuard page = get_or_load_page(pages[next++], PageLatch::Exclusive);
+        // Ids first: a change may compact the page and move the slots being walked
+        record_ids.clear();
+        const Slot* slots = page->slots();
+        for (size_t i = 0; i < page->slot_count(); ++i) {
+            if (slots[i].is_occupied() && matches(page->row_view(metadata.columns, metadata.column_count, slots[i]))) {
+                record_ids.push_back(slots[i].record_id);
+            }
+        }
+        if (!record_ids.empty()) mutate(*page, record_ids);
     }
-    throw std::runtime_error("Record not found for deletion");
 }
 
 void FileStorageLayer::flush() {
-    if (!is_open) return;
+    std::unique_lock<std::shared_mutex> state(state_latch_);
+    flush_locked();
+}
 
-    for (auto& [page_id, page] : page_cache_) {
-        if (page.is_dirty()) {
-            write_page_to_disk(page);
+void FileStorageLayer::flush_locked() {
+    if (!is_open || read_only_) return;
+
+    // Checkpoint: once every page and the catalog are synced, the log is no longer needed
+    if (wal_) commit_log();
+    buffer_pool_.flush_all();
+    flush_table_maps();
+
+    std::unique_lock<std::mutex> lock(catalog_mutex_);
+    if (catalog_.is_dirty()) {
+        std::vector<uint8_t> image = catalog_.serialize();
+        uint32_t next_page_id = INVALID_PAGE_ID;
+        if (image.size() > PAGE_SIZE) {
+            // Allocating chain pages takes the catalog mutex and changes the header, so the catalog page is imaged after
+            lock.unlock();
+            next_page_id = write_page_chain(*disk_, image.data() + PAGE_SIZE, image.size() - PAGE_SIZE, catalog_pages_,
+                [this] { return allocate_new_page(); });
+            lock.lock();
         }
+        catalog_.set_next_page_id(next_page_id);
+        image = catalog_.serialize();
+        disk_->write_page(CATALOG_PAGE_ID, image.data());
+        catalog_.clear_dirty();
+    }
+    disk_->sync();
+    if (wal_) {
+        wal_->truncate();
+        logged_catalog_lsn_ = catalog_.get_lsn();
     }
+}
 
-    if (catalog_.is_dirty()) {
-        std::ofstream out(get_page_path(CATALOG_PAGE_ID), std::ios::binary);
-        auto data = catalog_.serialize();
-        out.write(reinterpret_cast<const char*>(data.data()), data.size());
+void FileStorageLayer::start_background_writer() {
+    if (options_.background_write_pages == 0 && options_.checkpoint_interval.count() <= 0) return;
+    std::lock_guard<std::mutex> lock(background_mutex_);
+    if (background_writer_.joinable()) return;
+    background_stop_ = false;
+    background_writer_ = std::thread([this] { run_background_writer(); });
+}
+
+void FileStorageLayer::stop_background_writer() {
+    {
+        std::lock_guard<std::mutex> lock(background_mutex_);
+        if (!background_writer_.joinable()) return;
+        background_stop_ = true;
+    }
+    background_wake_.notify_all();
+    background_writer_.join();
+}
+
+void FileStorageLayer::run_background_writer() {
+    using Clock = std::chrono::steady_clock;
+    const size_t pages_per_round = options_.background_write_pages == 0 ? 0 :
+        std::max<size_t>(1, options_.background_write_pages * BACKGROUND_WRITER_PERIOD.count() / 1000);
+    Clock::time_point last_checkpoint = Clock::now();
+    std::unique_lock<std::mutex> lock(background_mutex_);
+    while (!background_wake_.wait_for(lock, BACKGROUND_WRITER_PERIOD, [this] { return background_stop_; })) {
+        lock.unlock();
+        try {
+            bool checkpoint = false;
+            if (options_.checkpoint_interval.count() > 0 && Clock::now() - last_checkpoint >= options_.checkpoint_interval) {
+                std::shared_lock<std::shared_mutex> state(state_latch_);
+                // Without a log there is nothing to bound, only dirty pages to sync
+                checkpoint = !wal_ || wal_->last_lsn() >= wal_->start_lsn();
+                last_checkpoint = Clock::now();
+            }
+            if (checkpoint) {
+                flush();
+            } else if (pages_per_round > 0) {
+                std::shared_lock<std::shared_mutex> state(state_latch_);
+                buffer_pool_.write_back(pages_per_round);
+            }
+        } catch (const std::exception&) {
+            // A page that cannot be written stays dirty; the next flush() reports the error
+        }
+        lock.lock();
+    }
+}
+
+void FileStorageLayer::commit() {
+    {
+        std::shared_lock<std::shared_mutex> state(state_latch_);
+        if (!is_open) return;
+        if (wal_) {
+            commit_log();
+            if (wal_->size_bytes() <= options_.wal_checkpoint_bytes) return;
+        }
+    }
+    flush();
+}
+
+void FileStorageLayer::commit_log() {
+    // Chains released by changes logged before this commit record are free once it is durable
+    std::vector<ToastPointer> released;
+    {
+        std::lock_guard<std::mutex> lock(overflow_mutex_);
+        released.swap(released_overflow_);
+    }
+    uint32_t commit_lsn;
+    bool durable;
+    {
+        // Table changes reach the catalog as they are made, so its image here is never behind the log
+        std::lock_guard<std::mutex> lock(catalog_mutex_);
+        if (catalog_.get_lsn() != logged_catalog_lsn_) {
+            if (catalog_.changes_are_partial()) {
+                // Only the tables touched since the last record, so commits stay cheap with many tables
+                auto changes = catalog_.serialize_changes();
+                wal_->append(WalRecordType::CatalogTables, CATALOG_PAGE_ID, changes.data(), changes.size());
+            } else {
+                auto image = catalog_.serialize();
+                wal_->append(WalRecordType::Catalog, CATALOG_PAGE_ID, image.data(), catalog_.serialized_size());
+            }
+            catalog_.clear_changes();
+            logged_catalog_lsn_ = catalog_.get_lsn();
+        }
+        commit_lsn = wal_->append_commit();
+        durable = commit_lsn <= wal_->durable_lsn();
+    }
+    // Outside the catalog mutex so concurrent committers can share one sync
+    if (!durable) wal_->flush(commit_lsn);
+    std::lock_guard<std::mutex> lock(overflow_mutex_);
+    free_overflow_.insert(free_overflow_.end(), released.begin(), released.end());
+}
+
+void FileStorageLayer::prepare_page_change(Page& page) {
+    if (wal_ && page.get_lsn() < wal_->start_lsn()) {
+        // A torn write of this page could not be redone from records alone
+        page.set_lsn(wal_->append(WalRecordType::PageImage, page.get_page_id(), page.image(), PAGE_SIZE));
     }
 }
 
-std::string FileStorageLayer::get_page_path(uint32_t page_id) const {
-    return storage_path + "/" + PAGE_FILE_PREFIX + std::to_string(page_id) + PAGE_FILE_EXTENSION;
+void FileStorageLayer::log_page_change(Page& page, WalRecordType type, uint32_t arg, const uint8_t* data, size_t size) {
+    if (!wal_) return;
+    page.set_lsn(wal_->append(type, page.get_page_id(), &arg, sizeof(arg), data, size));
+}
+
+void FileStorageLayer::recover_from_log() {
+    std::vector<WalRecord> uncommitted;
+    std::vector<WalRecord> records = wal_->recover(&uncommitted);
+    if (records.empty() && uncommitted.empty()) return;
+    for (const auto& record : records) {
+        replay_log_record(record);
+    }
+    if (!uncommitted.empty()) roll_back_log_records(uncommitted);
+    // Directory and free-space pages are written outside the log, so rebuild them from the heap chains
+    std::vector<TableMetadata> tables = catalog_.tables();
+    for (auto& metadata : tables) {
+        metadata.directory_page = INVALID_PAGE_ID;
+        metadata.free_space_head = INVALID_PAGE_ID;
+        metadata.zone_map_head = INVALID_PAGE_ID;
+        // Index pages are not logged either
+        for (auto& root : metadata.index_roots) {
+            root = INVALID_PAGE_ID;
+        }
+        catalog_.update_table(metadata);
+    }
+    catalog_.set_dirty();
+    for (const auto& metadata : tables) {
+        if (metadata.indexed_columns != 0) {
+            get_table_handle(metadata.name);
+        }
+    }
+    flush_locked();
+}
+
+void FileStorageLayer::roll_back_log_records(const std::vector<WalRecord>& records) {
+    // Written pages may hold some of these changes and not others, so all of them are redone first.
+    // The catalog is logged only just before a commit record, so a catalog record here never committed.
+    for (const auto& record : records) {
+        if (record.type != WalRecordType::Catalog && record.type != WalRecordType::CatalogTables) replay_log_record(record);
+    }
+    for (auto it = records.rbegin(); it != records.rend(); ++it) {
+        undo_log_record(*it);
+    }
+    // The undo is logged like any change, so a crash before this commit rolls it back along with the rest
+    commit_log();
+}
+
+void FileStorageLayer::undo_log_record(const WalRecord& record) {
+    WalRecord inverse{record.type, 0, record.page_id, record.payload};
+    switch (record.type) {
+    case WalRecordType::Insert:
+        // Both carry the record id and the row, so the payload serves either way
+        inverse.type = WalRecordType::Delete;
+        break;
+    case WalRecordType::Delete:
+        inverse.type = WalRecordType::Insert;
+        break;
+    case WalRecordType::SetNextPage:
+        if (inverse.payload.size() != 2 * sizeof(uint32_t)) throw std::runtime_error("Corrupt log record");
+        std::rotate(inverse.payload.begin(), inverse.payload.begin() + sizeof(uint32_t), inverse.payload.end());
+        break;
+    case WalRecordType::Update: {
+        uint32_t prefix[2];
+        if (inverse.payload.size() < sizeof(prefix)) throw std::runtime_error("Corrupt log record");
+        std::memcpy(prefix, record.payload.data(), sizeof(prefix));
+        if (prefix[1] > record.payload.size() - sizeof(prefix)) throw std::runtime_error("Corrupt log record");
+        // Swap the new row and the old one
+        auto new_row = inverse.payload.begin() + sizeof(prefix);
+        std::rotate(new_row, new_row + prefix[1], inverse.payload.end());
+        prefix[1] = static_cast<uint32_t>(record.payload.size() - sizeof(prefix) - prefix[1]);
+        std::memcpy(inverse.payload.data(), prefix, sizeof(prefix));
+        break;
+    }
+    default:
+        // Page inits and images need nothing once the changes after them are undone
+        return;
+    }
+    inverse.lsn = wal_->append(inverse.type, inverse.page_id, inverse.payload.data(), inverse.payload.size());
+    replay_log_record(inverse);
+}
+
+void FileStorageLayer::replay_log_record(const WalRecord& record) {
+    switch (record.type) {
+    case WalRecordType::Commit:
+        return;
+    case WalRecordType::Catalog: {
+        // The chain stays wherever the pages last put it
+        const uint32_t next_page_id = catalog_.get_next_page_id();
+        catalog_.deserialize(record.payload);
+        catalog_.set_next_page_id(next_page_id);
+        return;
+    }
+    case WalRecordType::CatalogTables:
+        catalog_.apply_changes(record.payload);
+        return;
+    case WalRecordType::PageImage: {
+        PageGuard page = get_or_create_page(record.page_id);
+        page->deserialize(record.payload);
+        page->mark_dirty();
+        return;
+    }
+    default:
+        break;
+    }
+    if (record.payload.size() < sizeof(uint32_t)) throw std::runtime_error("Corrupt log record");
+    uint32_t arg;
+    std::memcpy(&arg, record.payload.data(), sizeof(arg));
+    const uint8_t* data = record.payload.data() + sizeof(arg);
+    const size_t size = record.payload.size() - sizeof(arg);
+
+    if (record.type == WalRecordType::PageInit) {
+        PageGuard page;
+        try {
+            page = get_or_load_page(record.page_id);
+        } catch (const std::runtime_error&) {
+            // Never written, or torn: the page starts empty either way
+        }
+        if (page && page->get_lsn() >= record.lsn) return;
+        page.release();
+        page = get_or_create_page(record.page_id, arg);
+        if (size >= 2 * sizeof(uint16_t)) {
+            uint16_t pax_format[2];
+            std::memcpy(pax_format, data, sizeof(pax_format));
+            // Records without the encodings predate them and keep every column plain
+            const bool encoded = size > sizeof(pax_format);
+            if (pax_format[0] > PAX_MAX_COLUMNS || (encoded && size != sizeof(pax_format) + pax_format[0])) {
+                throw std::runtime_error("Corrupt log record");
+            }
+            ColumnEncoding encodings[PAX_MAX_COLUMNS];
+            if (encoded) std::memcpy(encodings, data + sizeof(pax_format), pax_format[0]);
+            page->format_pax(pax_format[0], pax_format[1], encoded ? encodings : nullptr);
+        }
+        page->set_lsn(record.lsn);
+        return;
+    }
+
+    PageGuard page = get_or_load_page(record.page_id);
+    if (page->get_lsn() >= record.lsn) return;
+    bool applied = true;
+    switch (record.type) {
+    case WalRecordType::Insert:
+        applied = page->insert_record(arg, data, size).has_value();
+        if (applied) page->free_id_bitmap().set(arg - page->get_id_range_start());
+        break;
+    case WalRecordType::Update: {
+        // The new row's length, the new row, then the old row
+        uint32_t new_size;
+        if (size < sizeof(new_size)) throw std::runtime_error("Corrupt log record");
+        std::memcpy(&new_size, data, sizeof(new_size));
+        if (new_size > size - sizeof(new_size)) throw std::runtime_error("Corrupt log record");
+        applied = page->update_record(arg, std::vector<uint8_t>(data + sizeof(new_size), data + sizeof(new_size) + new_size));
+        break;
+    }
+    case WalRecordType::Delete:
+        applied = page->delete_record(arg);
+        if (applied) page->free_id_bitmap().reset(arg - page->get_id_range_start());
+        break;
+    case WalRecordType::SetNextPage:
+        page->set_next_page_id(arg);
+        break;
+    default:
+        throw std::runtime_error("Corrupt log record: unknown type");
+    }
+    if (!applied) throw std::runtime_error("Log replay failed on page " + std::to_string(record.page_id));
+    page->set_lsn(record.lsn);
 }
 
 uint32_t FileStorageLayer::allocate_new_page() {
+    std::lock_guard<std::mutex> lock(catalog_mutex_);
     if (catalog_.get_free_page_id() != INVALID_PAGE_ID) {
         uint32_t allocated_page = catalog_.get_free_page_id();
 
@@ -552,84 +1182,394 @@ uint32_t FileStorageLayer::allocate_new_page() {
     return new_page_id;
 }
 
+void FileStorageLayer::save_table_metadata(const TableMetadata& metadata) {
+    std::lock_guard<std::mutex> lock(catalog_mutex_);
+    catalog_.update_table(metadata);
+}
+
+void FileStorageLayer::save_record_count(const TableMetadata& metadata) {
+    std::lock_guard<std::mutex> lock(catalog_mutex_);
+    catalog_.update_record_count(metadata);
+}
+
 void FileStorageLayer::write_page_to_disk(Page& page) {
-    std::ofstream out(get_page_path(page.get_page_id()), std::ios::binary);
-    auto data = page.serialize();
-    out.write(reinterpret_cast<const char*>(data.data()), data.size());
+    // Write-ahead rule: the records behind this page version must be durable first. They are not
+    // committed by it: recovery rolls back whatever no commit record covers.
+    if (wal_ && page.get_lsn() > wal_->durable_lsn()) {
+        wal_->flush(page.get_lsn());
+    }
+    disk_->write_page(page.get_page_id(), page.image());
+    page.clear_dirty();
+    counters_.pages_written.fetch_add(1, std::memory_order_relaxed);
 }
 
-Page& FileStorageLayer::get_or_load_page(uint32_t page_id) {
-    auto it = page_cache_.find(page_id);
-    if (it != page_cache_.end()) {
-        return it->second;
+void FileStorageLayer::write_pages_to_disk(const std::vector<Page*>& pages) {
+    uint32_t newest_lsn = 0;
+    std::vector<PageWrite> writes;
+    writes.reserve(pages.size());
+    for (Page* page : pages) {
+        newest_lsn = std::max(newest_lsn, page->get_lsn());
+        writes.push_back(PageWrite{page->get_page_id(), page->image()});
+    }
+    if (wal_ && newest_lsn > wal_->durable_lsn()) {
+        wal_->flush(newest_lsn);
     }
+    disk_->write_pages(writes);
+    for (Page* page : pages) page->clear_dirty();
+    counters_.pages_written.fetch_add(pages.size(), std::memory_order_relaxed);
+}
 
-    std::ifstream in(get_page_path(page_id), std::ios::binary);
-    if (!in) throw std::runtime_error("Page not found");
+void FileStorageLayer::read_pages_from_disk(std::vector<BufferPool::PendingRead> reads) {
+    std::vector<PageRead> disk_reads;
+    disk_reads.reserve(reads.size());
+    for (auto& read : reads) {
+        Page* page = read.page;
+        disk_reads.push_back(PageRead{read.page_id, page->image_buffer(), [page, done = std::move(read.done)](bool found) {
+            bool loaded = found;
+            if (loaded) {
+                try {
+                    page->load_image();
+                    page->clear_dirty();
+                } catch (const std::exception&) {
+                    // A fetch of this page reads it again and reports the error
+                    loaded = false;
+                }
+            }
+            done(loaded);
+        }});
+    }
+    counters_.pages_read.fetch_add(disk_reads.size(), std::memory_order_relaxed);
+    disk_->read_pages_async(std::move(disk_reads));
+}
 
-    std::vector<uint8_t> data(PAGE_SIZE);
-    in.read(reinterpret_cast<char*>(data.data()), PAGE_SIZE);
+ReadAhead FileStorageLayer::heap_read_ahead() {
+    if (options_.read_ahead_pages == 0) return ReadAhead();
+    if (mapped_ != nullptr) {
+        return ReadAhead([this](const uint32_t* page_ids, size_t count) { mapped_->will_need(page_ids, count); },
+            options_.read_ahead_pages);
+    }
+    // Reading ahead synchronously would only move the wait earlier
+    if (!disk_->async_reads()) return ReadAhead();
+    return ReadAhead([this](const uint32_t* page_ids, size_t count) { buffer_pool_.prefetch(page_ids, count); },
+        options_.read_ahead_pages);
+}
 
-    Page new_page(page_id);
-    new_page.deserialize(data);
-    auto [insert_it, _] = page_cache_.emplace(page_id, std::move(new_page));
-    return insert_it->second;
+bool FileStorageLayer::read_page_from_disk(uint32_t page_id, Page& page) {
+    if (!disk_->read_page(page_id, page.image_buffer())) return false;
+    counters_.pages_read.fetch_add(1, std::memory_order_relaxed);
+    page.load_image();
+    page.clear_dirty();
+    return true;
 }
 
-Page& FileStorageLayer::get_or_create_page(uint32_t page_id) {
-    return get_or_create_page(page_id, 0);
+PageGuard FileStorageLayer::get_or_load_page(uint32_t page_id, PageLatch latch) {
+    return buffer_pool_.fetch_page(page_id, latch);
 }
 
-Page& FileStorageLayer::get_or_create_page(uint32_t page_id, uint32_t id_range_start) {
-    try {
-        return get_or_load_page(page_id);
-    }
-    catch (...) {
-        Page new_page(page_id, id_range_start);
-        auto [it, _] = page_cache_.emplace(page_id, std::move(new_page));
-        return it->second;
+PageRef FileStorageLayer::read_heap_page(uint32_t page_id) {
+    if (mapped_ != nullptr) {
+        const uint8_t* image = mapped_->page_image(page_id);
+        if (image == nullptr) throw std::runtime_error("Page " + std::to_string(page_id) + " is past the end of the segment");
+        // Pages last written in the legacy layout are converted by loading them into the pool
+        if (Page::is_in_place_image(image)) return PageRef::from_image(image);
     }
+    return PageRef(get_or_load_page(page_id, PageLatch::Shared));
+}
+
+PageGuard FileStorageLayer::get_or_create_page(uint32_t page_id) {
+    return get_or_create_page(page_id, 0);
+}
+
+PageGuard FileStorageLayer::get_or_create_page(uint32_t page_id, uint32_t id_range_start) {
+    return buffer_pool_.create_page(page_id, id_range_start);
 }
 
 TableMetadata& FileStorageLayer::get_table_metadata(const std::string& table_name) {
-    auto cache_it = table_cache_.find(table_name);
-    if (cache_it != table_cache_.end()) {
-        return cache_it->second;
+    return get_table_handle(table_name).metadata;
+}
+
+TableHandle& FileStorageLayer::get_table_handle(const std::string& table_name) {
+    {
+        std::shared_lock<std::shared_mutex> tables(tables_mutex_);
+        auto cache_it = table_cache_.find(table_name);
+        if (cache_it != table_cache_.end()) {
+            return *cache_it->second;
+        }
+    }
+    // Building a handle can rebuild indexes and save their roots, so only one thread builds at a time
+    std::lock_guard<std::mutex> loading(table_load_mutex_);
+    {
+        std::shared_lock<std::shared_mutex> tables(tables_mutex_);
+        auto cache_it = table_cache_.find(table_name);
+        if (cache_it != table_cache_.end()) {
+            return *cache_it->second;
+        }
+    }
+    std::optional<TableMetadata> table_opt;
+    {
+        std::lock_guard<std::mutex> lock(catalog_mutex_);
+        table_opt = catalog_.get_table(table_name);
     }
-    auto table_opt = catalog_.get_table(table_name);
     if (!table_opt.has_value()) {
         throw std::runtime_error("Table does not exist");
     }
-    auto [it, _] = table_cache_.emplace(table_name, table_opt.value());
-    return it->second;
+    // Built without holding tables_mutex_, so lookups of tables already loaded are not held up
+    auto loaded = std::make_unique<TableHandle>();
+    TableHandle& handle = *loaded;
+    handle.metadata = table_opt.value();
+    handle.indexes.resize(handle.metadata.column_count);
+    handle.zones = ZoneMap(handle.metadata.column_count);
+    const TableMetadata& metadata = handle.metadata;
+    if (metadata.directory_page != INVALID_PAGE_ID) {
+        handle.directory.load(*disk_, metadata.directory_page);
+    }
+    if (handle.directory.block_count() < metadata.next_id_block && metadata.first_data_page != INVALID_PAGE_ID) {
+        // Directory missing or behind the page chain: rebuild it from the chain's id ranges
+        uint32_t current_page_id = metadata.first_data_page;
+        while (current_page_id != INVALID_PAGE_ID) {
+            PageRef page = read_heap_page(current_page_id);
+            handle.directory.set_block_page(PageDirectory::block_of(page.header().id_range_start), current_page_id);
+            current_page_id = page.header().next_page_id;
+        }
+    }
+    if (metadata.free_space_head != INVALID_PAGE_ID) {
+        handle.free_space.load(*disk_, metadata.free_space_head);
+    }
+    if (metadata.zone_map_head != INVALID_PAGE_ID) {
+        handle.zones.load(*disk_, metadata.zone_map_head);
+    }
+    // Zones decide which pages a scan reads, so blocks the map does not cover are rebuilt from their pages
+    for (uint32_t block = handle.zones.block_count(); block < handle.directory.block_count(); ++block) {
+        handle.zones.clear_block(block);
+        uint32_t page_id = handle.directory.page_for_block(block);
+        if (page_id == INVALID_PAGE_ID) continue;
+        PageRef page = read_heap_page(page_id);
+        for (size_t i = 0; i < page.slot_count(); ++i) {
+            const Slot& slot = page.slot(i);
+            if (slot.is_occupied()) handle.zones.add_row(block, page.row_view(metadata.columns, metadata.column_count, slot));
+        }
+    }
+    // Free space only steers inserts, so a read-only storage leaves the map as stored
+    for (uint32_t block = handle.free_space.block_count(); !read_only_ && block < handle.directory.block_count(); ++block) {
+        uint32_t page_id = handle.directory.page_for_block(block);
+        if (page_id == INVALID_PAGE_ID) continue;
+        PageGuard page = get_or_load_page(page_id, PageLatch::Shared);
+        update_free_space(handle, *page);
+    }
+    bool rebuilt = false;
+    for (uint32_t col = 0; col < metadata.column_count; ++col) {
+        if (!(metadata.indexed_columns & (1u << col))) continue;
+        if (metadata.index_roots[col] != INVALID_PAGE_ID) {
+            open_index(handle, col, metadata.index_roots[col]);
+        } else if (!read_only_) {
+            // Read-only storages cannot write the rebuilt tree, so their queries scan instead
+            build_index(handle, col);
+            rebuilt = true;
+        }
+    }
+    if (rebuilt) {
+        save_table_metadata(metadata);
+    }
+    std::unique_lock<std::shared_mutex> tables(tables_mutex_);
+    auto [it, _] = table_cache_.emplace(table_name, std::move(loaded));
+    return *it->second;
+}
+
+PageGuard FileStorageLayer::get_record_page(TableHandle& handle, uint32_t record_id, PageLatch latch) {
+    uint32_t page_id;
+    if (latch == PageLatch::Exclusive) {
+        // Writers already hold the table latch
+        page_id = handle.directory.page_for_record(record_id);
+    } else {
+        std::shared_lock<std::shared_mutex> table_lock(handle.latch);
+        page_id = handle.directory.page_for_record(record_id);
+    }
+    if (page_id == INVALID_PAGE_ID) {
+        return PageGuard();
+    }
+    return get_or_load_page(page_id, latch);
+}
+
+void FileStorageLayer::update_free_space(TableHandle& handle, const Page& page) {
+    uint32_t free_bytes = page.first_free_id().has_value() ? page.reclaimable_space() : 0;
+    handle.free_space.set(PageDirectory::block_of(page.get_id_range_start()), free_bytes);
+}
+
+BTreeIndex& FileStorageLayer::open_index(TableHandle& handle, int column, uint32_t root_page_id) {
+    // Node pages carry the LSN of the change they follow, so evicting one obeys the write-ahead rule
+    auto stamp = [this](Page& page) {
+        if (wal_) page.set_lsn(wal_->last_lsn());
+    };
+    handle.indexes[column] = std::make_unique<BTreeIndex>(buffer_pool_, handle.metadata.columns[column].type, root_page_id,
+        [this] { return allocate_new_page(); }, stamp);
+    return *handle.indexes[column];
+}
+
+void FileStorageLayer::build_index(TableHandle& handle, int column) {
+    TableMetadata& metadata = handle.metadata;
+    const ColumnType type = metadata.columns[column].type;
+    std::vector<std::pair<std::string, uint32_t>> entries;
+    std::vector<uint32_t> pages;
+    for (uint32_t page_id : handle.directory.block_pages()) {
+        if (page_id != INVALID_PAGE_ID) pages.push_back(page_id);
+    }
+    ScanCursor cursor(metadata.columns, metadata.column_count, std::move(pages),
+        [this](uint32_t page_id) { return read_heap_page(page_id); }, heap_read_ahead());
+    while (cursor.next()) {
+        RowView row = cursor.row();
+        entries.emplace_back(BTreeIndex::key_of(row, column), row.record_id());
+    }
+    cursor.close();
+    // Sorted input always appends to the rightmost leaf
+    std::sort(entries.begin(), entries.end(), [type](const auto& a, const auto& b) {
+        int c = BTreeIndex::compare_keys(type, a.first, b.first);
+        return c != 0 ? c < 0 : a.second < b.second;
+    });
+    uint32_t root = BTreeIndex::create(buffer_pool_, [this] { return allocate_new_page(); });
+    BTreeIndex& index = open_index(handle, column, root);
+    for (const auto& [key, record_id] : entries) {
+        index.insert(key, record_id);
+    }
+    metadata.indexed_columns |= 1u << column;
+    metadata.index_roots[column] = index.root_page_id();
+}
+
+void FileStorageLayer::index_row(TableHandle& handle, const RowView& row) {
+    for (size_t col = 0; col < handle.indexes.size(); ++col) {
+        if (handle.indexes[col]) handle.indexes[col]->insert(BTreeIndex::key_of(row, col), row.record_id());
+    }
+    save_index_roots(handle);
+}
+
+void FileStorageLayer::unindex_row(TableHandle& handle, const RowView& row) {
+    for (size_t col = 0; col < handle.indexes.size(); ++col) {
+        if (handle.indexes[col]) handle.indexes[col]->remove(BTreeIndex::key_of(row, col), row.record_id());
+    }
 }
 
-Page& FileStorageLayer::get_last_page_for_table(const std::string& table_name) {
-    TableMetadata& metadata = get_table_metadata(table_name);
-    if (metadata.last_data_page == INVALID_PAGE_ID) {
-        uint32_t new_page_id = allocate_new_page();
-        Page& new_page = get_or_create_page(new_page_id);
+void FileStorageLayer::save_index_roots(TableHandle& handle) {
+    bool changed = false;
+    for (size_t col = 0; col < handle.indexes.size(); ++col) {
+        if (!handle.indexes[col]) continue;
+        uint32_t root = handle.indexes[col]->root_page_id();
+        if (handle.metadata.index_roots[col] != root) {
+            handle.metadata.index_roots[col] = root;
+            changed = true;
+        }
+    }
+    if (changed) {
+        save_table_metadata(handle.metadata);
+    }
+}
+
+PageGuard FileStorageLayer::append_data_page(TableHandle& handle) {
+    TableMetadata& metadata = handle.metadata;
+    // Pin the current tail first so no eviction splits the logged append
+    PageGuard prev_last;
+    if (metadata.last_data_page != INVALID_PAGE_ID) {
+        prev_last = get_or_load_page(metadata.last_data_page);
+    }
+    uint32_t new_page_id = allocate_new_page();
+    uint32_t id_range_start = PageDirectory::block_start(metadata.next_id_block);
+    PageGuard new_page = get_or_create_page(new_page_id, id_range_start);
+    // A PAX page logs its format along with the init, so replay lays it out the same way
+    std::vector<uint8_t> pax_format;
+    if (metadata.layout == TableLayout::Pax) {
+        uint16_t counts[2] = {static_cast<uint16_t>(metadata.column_count), 0};
+        ColumnEncoding encodings[PAX_MAX_COLUMNS];
+        for (uint32_t c = 0; c < metadata.column_count; ++c) {
+            if (metadata.columns[c].type == ColumnType::TEXT) counts[1] |= static_cast<uint16_t>(1u << c);
+            encodings[c] = metadata.columns[c].encoding;
+        }
+        new_page->format_pax(counts[0], counts[1], encodings);
+        pax_format.resize(sizeof(counts) + metadata.column_count);
+        std::memcpy(pax_format.data(), counts, sizeof(counts));
+        std::memcpy(pax_format.data() + sizeof(counts), encodings, metadata.column_count);
+    }
+    // Other threads' commits are held off until the catalog matches the logged chain
+    std::lock_guard<std::mutex> lock(catalog_mutex_);
+    log_page_change(*new_page, WalRecordType::PageInit, id_range_start, pax_format.data(), pax_format.size());
+    if (!prev_last) {
         metadata.first_data_page = new_page_id;
-        metadata.last_data_page = new_page_id;
-        catalog_.update_table(metadata);
-        return new_page;
+    } else {
+        prepare_page_change(*prev_last);
+        const uint32_t old_next = prev_last->get_next_page_id();
+        prev_last->set_next_page_id(new_page_id);
+        log_page_change(*prev_last, WalRecordType::SetNextPage, new_page_id, reinterpret_cast<const uint8_t*>(&old_next),
+            sizeof(old_next));
     }
-    return get_or_load_page(metadata.last_data_page);
+    metadata.last_data_page = new_page_id;
+    handle.directory.set_block_page(metadata.next_id_block, new_page_id);
+    handle.zones.clear_block(metadata.next_id_block);
+    metadata.next_id_block++;
+    update_free_space(handle, *new_page);
+    catalog_.update_table(metadata);
+    return new_page;
 }
 
-Page& FileStorageLayer::find_free_page_for_table(const std::string& table_name, uint32_t record_size) {
-    TableMetadata& metadata = get_table_metadata(table_name);
-    uint32_t current_page_id = metadata.first_data_page;
+void FileStorageLayer::flush_table_maps() {
+    auto allocate = [this] { return allocate_new_page(); };
+    for (auto& [name, handle_ptr] : table_cache_) {
+        TableHandle& handle = *handle_ptr;
+        bool changed = false;
+        if (handle.directory.is_dirty()) {
+            uint32_t head = handle.directory.save(*disk_, allocate);
+            changed |= head != handle.metadata.directory_page;
+            handle.metadata.directory_page = head;
+        }
+        if (handle.free_space.is_dirty()) {
+            uint32_t head = handle.free_space.save(*disk_, allocate);
+            changed |= head != handle.metadata.free_space_head;
+            handle.metadata.free_space_head = head;
+        }
+        if (handle.zones.is_dirty()) {
+            uint32_t head = handle.zones.save(*disk_, allocate);
+            changed |= head != handle.metadata.zone_map_head;
+            handle.metadata.zone_map_head = head;
+        }
+        if (changed) {
+            save_table_metadata(handle.metadata);
+        }
+    }
+}
+
+PageGuard FileStorageLayer::get_last_page_for_table(const std::string& table_name) {
+    TableHandle& handle = get_table_handle(table_name);
+    if (handle.metadata.last_data_page == INVALID_PAGE_ID) {
+        return append_data_page(handle);
+    }
+    return get_or_load_page(handle.metadata.last_data_page);
+}
 
-    while (current_page_id != INVALID_PAGE_ID) {
-        Page& page = get_or_load_page(current_page_id);
-        if (page.has_space(record_size + sizeof(Slot))) {
+PageGuard FileStorageLayer::find_free_page_for_table(TableHandle& handle, uint32_t required) {
+    while (auto block = handle.free_space.find_block(required)) {
+        uint32_t page_id = handle.directory.page_for_block(*block);
+        if (page_id == INVALID_PAGE_ID) {
+            handle.free_space.set(*block, 0);
+            continue;
+        }
+        PageGuard page = get_or_load_page(page_id);
+        if (page->first_free_id().has_value() && page->reclaimable_space() >= required) {
             return page;
         }
-        current_page_id = page.get_next_page_id();
+        // Stale entry: record what the page really has and look again
+        update_free_space(handle, *page);
     }
+    return PageGuard();
+}
 
-    throw std::runtime_error("No free page found");
+namespace {
+// What one scan worker produced for its page range
+struct ScanPartial {
+    std::vector<std::vector<std::string>> rows;
+    int64_t sum = 0;     // Only filled when the SUM is folded into the scan
+    std::vector<int32_t> sum_values; // INT values not yet added to sum, a batch at a time
+    std::optional<RowSorter> sorter; // Only with ORDER BY
+    std::string key;                 // Sort key of the row being consumed
+    size_t matched = 0;
+    size_t width = 0;    // Field count of the rows, for validating the aggregate column
+    ScanTally tally;     // Rows and bytes read; rows emitted are counted once the partials are combined
+};
 }
 
 std::vector<std::vector<std::string>> FileStorageLayer::scan(
@@ -640,57 +1580,260 @@ std::vector<std::vector<std::string>> FileStorageLayer::scan(
     const std::optional<size_t>& limit,
     const std::optional<std::pair<std::string, int>>& aggregate)
 {
+    ScanSpec spec;
+    spec.projection = projection;
+    spec.filter_func = filter_func;
+    spec.order_by = order_by;
+    spec.limit = limit;
+    spec.aggregate = aggregate;
+    return scan(table, spec);
+}
+
+std::vector<std::vector<std::string>> FileStorageLayer::scan(const std::string& table, const ScanSpec& spec)
+{
+    const auto& [projection, filter_func, order_by, limit, aggregate, row_filter, index_range, where] = spec;
+    std::shared_lock<std::shared_mutex> state(state_latch_);
     if (!is_open) {
         throw std::runtime_error("Storage not open");
     }
-    std::vector<std::vector<std::string>> results;
-    const TableMetadata& metadata = get_table_metadata(table);
-    std::vector<ColumnSchema> schema(metadata.columns, metadata.columns + metadata.column_count);
-    uint32_t current_page_id = metadata.first_data_page;
-    while (current_page_id != INVALID_PAGE_ID) {
-        Page& page = get_or_load_page(current_page_id);
-        for (const auto& slot : page.get_slots()) {
-            if (slot.is_occupied()) {
-                auto record_data = page.get_record(slot.record_id);
-                if (record_data.has_value()) {
-                    auto row = deserialize_row(schema, record_data.value());
-                    if (filter_func && !(*filter_func)(row)) {
-                        continue;
-                    }
-                    if (projection) {
-                        std::vector<std::string> projected_row;
-                        for (int idx : *projection) {
-                            if (idx >= 0 && static_cast<size_t>(idx) < row.size()) {
-                                projected_row.push_back(row[idx]);
-                            }
-                        }
-                        results.push_back(std::move(projected_row));
-                    } else {
-                        results.push_back(std::move(row));
-                    }
-                }
+    TableHandle& handle = get_table_handle(table);
+    const TableMetadata& metadata = handle.metadata;
+    const auto started = std::chrono::steady_clock::now();
+    const bool ordered = order_by && !order_by->empty();
+    // LIMIT is applied before the aggregate, so SUM can only be folded into the scan without one
+    const bool fold_sum = aggregate && aggregate->first == "SUM" && !limit;
+    // ORDER BY positions refer to the returned row; keys are read in place from the table column behind each
+    SortKeyEncoder encoder;
+    if (ordered) {
+        std::vector<int> output_columns;
+        if (projection) {
+            for (int idx : *projection) {
+                if (idx >= 0 && static_cast<uint32_t>(idx) < metadata.column_count) output_columns.push_back(idx);
             }
+        } else {
+            output_columns.resize(metadata.column_count);
+            std::iota(output_columns.begin(), output_columns.end(), 0);
         }
-        current_page_id = page.get_next_page_id();
+        std::vector<SortColumn> sort_columns;
+        for (const auto& [col, asc] : *order_by) {
+            if (col < 0 || static_cast<size_t>(col) >= output_columns.size()) continue;
+            const int table_col = output_columns[col];
+            sort_columns.push_back({table_col, asc, metadata.columns[table_col].type});
+        }
+        encoder = SortKeyEncoder(std::move(sort_columns));
     }
-    if (order_by && !order_by->empty()) {
-        std::sort(results.begin(), results.end(), [&](const std::vector<std::string>& a, const std::vector<std::string>& b) {
-            for (const auto& [col, asc] : *order_by) {
-                if (col < 0 || static_cast<size_t>(col) >= a.size() || static_cast<size_t>(col) >= b.size()) continue;
-                try {
-                    int ai = std::stoi(a[col]);
-                    int bi = std::stoi(b[col]);
-                    if (ai != bi) return asc ? ai < bi : ai > bi;
-                } catch (...) {
-                    if (a[col] != b[col]) return asc ? a[col] < b[col] : a[col] > b[col];
+
+    // Bounds on the indexed column, checked on every row so they hold even without an index
+    std::optional<KeyRange> key_range;
+    ColumnType range_type = ColumnType::INT;
+    if (index_range) {
+        key_range = make_key_range(metadata, *index_range);
+        range_type = metadata.columns[index_range->column].type;
+    }
+
+    // Without a text filter, SUM of an INT column reads the raw field and adds whole batches at once
+    int sum_column = -1;
+    size_t sum_width = 0;
+    if (fold_sum && !filter_func) {
+        const int col = aggregate->second;
+        sum_width = metadata.column_count;
+        int table_col = col;
+        if (projection) {
+            sum_width = 0;
+            table_col = -1;
+            for (int idx : *projection) {
+                if (idx < 0 || static_cast<uint32_t>(idx) >= metadata.column_count) continue;
+                if (static_cast<int>(sum_width++) == col) table_col = idx;
+            }
+        }
+        if (table_col >= 0 && static_cast<uint32_t>(table_col) < metadata.column_count
+            && metadata.columns[table_col].type == ColumnType::INT) {
+            sum_column = table_col;
+        }
+    }
+
+    // Runs one row through the pipeline; returns false once the partial needs no more rows
+    auto consume = [&](const RowView& view, ScanPartial& out) {
+        auto& results = out.rows;
+        // Without ORDER BY the first N qualifying rows are the answer
+        if (!ordered && limit && results.size() >= *limit) return false;
+        out.tally.rows_scanned++;
+        if (key_range && !BTreeIndex::in_range(range_type, *key_range, BTreeIndex::key_of(view, index_range->column))) {
+            return true;
+        }
+        if (row_filter && !(*row_filter)(view)) {
+            return true;
+        }
+        if (where && !where->matches(view)) {
+            return true;
+        }
+        if (sum_column >= 0) {
+            if (out.matched++ == 0) out.width = view.column_count() == 0 ? 0 : sum_width;
+            if (view.column_count() == 0) return true;
+            out.tally.bytes_decoded += INT_SIZE;
+            out.sum_values.push_back(view.get_int(sum_column));
+            if (out.sum_values.size() == BATCH_CAPACITY) {
+                out.sum += sum_int(out.sum_values.data(), out.sum_values.size());
+                out.sum_values.clear();
+            }
+            return true;
+        }
+        std::vector<std::string> row;
+        if (filter_func) {
+            row = view.to_strings();
+            out.tally.bytes_decoded += text_bytes(row);
+            if (!(*filter_func)(row)) {
+                return true;
+            }
+        }
+        if (ordered && !fold_sum) {
+            if (view.column_count() == 0) {
+                out.key.clear();
+            } else {
+                encoder.encode(view, out.key);
+            }
+            // Rows a full top-N heap would drop are never decoded
+            if (!out.sorter->admits(out.key)) return true;
+        }
+        if (projection) {
+            // Decode only the projected fields
+            std::vector<std::string> projected_row;
+            projected_row.reserve(projection->size());
+            for (int idx : *projection) {
+                if (idx >= 0 && static_cast<size_t>(idx) < view.column_count()) {
+                    projected_row.push_back(filter_func ? row[idx] : view.to_string(idx));
                 }
             }
-            return false;
+            row = std::move(projected_row);
+            if (!filter_func) out.tally.bytes_decoded += text_bytes(row);
+        } else if (!filter_func) {
+            row = view.to_strings();
+            out.tally.bytes_decoded += text_bytes(row);
+        }
+        if (fold_sum) {
+            if (out.matched++ == 0) out.width = row.size();
+            int col = aggregate->second;
+            if (col >= 0 && static_cast<size_t>(col) < row.size()) {
+                try {
+                    out.sum += std::stoll(row[col]);
+                } catch (...) {}
+            }
+            return true;
+        }
+        if (ordered) {
+            out.sorter->add(std::move(out.key), std::move(row));
+        } else {
+            results.push_back(std::move(row));
+        }
+        return true;
+    };
+    auto finish = [&](ScanPartial& out) {
+        auto& results = out.rows;
+        if (ordered) out.sorter->seal();
+        out.sum += sum_int(out.sum_values.data(), out.sum_values.size());
+        out.sum_values.clear();
+        out.matched = fold_sum ? out.matched : results.size();
+    };
+    auto scan_pages = [&](std::vector<uint32_t> page_ids, ScanPartial& out) {
+        ScanCursor cursor(metadata.columns, metadata.column_count, std::move(page_ids),
+            [this](uint32_t page_id) { return read_heap_page(page_id); }, heap_read_ahead());
+        while (cursor.next() && consume(cursor.row(), out)) {}
+        cursor.close();
+        finish(out);
+    };
+    // Each worker sorts within its share of the budget; the runs are merged at the end
+    auto add_sorters = [&](std::vector<ScanPartial>& partials) {
+        if (!ordered) return;
+        for (auto& partial : partials) partial.sorter.emplace(encoder, limit, SORT_MEMORY_BUDGET / partials.size());
+    };
+
+    std::vector<ScanPartial> partials(1);
+    std::vector<std::pair<uint32_t, uint32_t>> indexed_rows; // (record id, page id)
+    bool use_index = false;
+    if (key_range) {
+        std::shared_lock<std::shared_mutex> table_lock(handle.latch);
+        if (const BTreeIndex* index = handle.indexes[index_range->column].get()) {
+            use_index = true;
+            for (uint32_t record_id : index->range(*key_range)) {
+                indexed_rows.emplace_back(record_id, handle.directory.page_for_record(record_id));
+            }
+        }
+    }
+    if (use_index) {
+        // Visit the matches in record id order so each heap page is fetched once, as a table scan would
+        std::sort(indexed_rows.begin(), indexed_rows.end());
+        add_sorters(partials);
+        PageRef page;
+        ToastReader toast = toast_reader();
+        for (const auto& [record_id, page_id] : indexed_rows) {
+            if (page_id == INVALID_PAGE_ID) continue;
+            if (!page || page.page_id() != page_id) {
+                page.release();
+                page = read_heap_page(page_id);
+            }
+            const Slot* slot = page.find_record(record_id);
+            if (slot == nullptr) continue;
+            RowView row = page.row_view(metadata.columns, metadata.column_count, *slot);
+            toast.clear();
+            row.set_toast_reader(&toast);
+            if (!consume(row, partials[0])) {
+                break;
+            }
+        }
+        page.release();
+        finish(partials[0]);
+    } else {
+        std::vector<uint32_t> pages = table_pages(handle, where);
+        partials.resize(scan_workers(pages.size()));
+        add_sorters(partials);
+        run_page_ranges(pages, partials.size(), [&](size_t w, std::vector<uint32_t> range) {
+            scan_pages(std::move(range), partials[w]);
         });
     }
+    ScanTally tally;
+    for (const auto& partial : partials) {
+        tally.rows_scanned += partial.tally.rows_scanned;
+        tally.bytes_decoded += partial.tally.bytes_decoded;
+    }
+    StorageCounters::add_time(counters_.scan_nanos, std::chrono::steady_clock::now() - started);
+
+    if (fold_sum) {
+        int64_t sum = 0;
+        size_t matched = 0;
+        size_t width = 0;
+        for (const auto& partial : partials) {
+            if (matched == 0) width = partial.width;
+            matched += partial.matched;
+            sum += partial.sum;
+        }
+        int col = aggregate->second;
+        if (col < 0 || matched == 0 || static_cast<size_t>(col) >= width) {
+            throw std::runtime_error("Invalid column index for aggregation");
+        }
+        tally.rows_emitted = matched;
+        counters_.add(tally);
+        return { { std::to_string(sum) } };
+    }
+
+    std::vector<std::vector<std::string>> results;
+    if (ordered) {
+        const auto sort_started = std::chrono::steady_clock::now();
+        RowSorter& sorter = *partials[0].sorter;
+        for (size_t i = 1; i < partials.size(); ++i) sorter.merge(std::move(*partials[i].sorter));
+        results = sorter.finish();
+        StorageCounters::add_time(counters_.sort_nanos, std::chrono::steady_clock::now() - sort_started);
+    } else {
+        results = std::move(partials[0].rows);
+        for (size_t i = 1; i < partials.size(); ++i) {
+            results.insert(results.end(), std::make_move_iterator(partials[i].rows.begin()),
+                std::make_move_iterator(partials[i].rows.end()));
+        }
+    }
     if (limit && results.size() > *limit) {
         results.resize(*limit);
     }
+    tally.rows_emitted = results.size();
+    counters_.add(tally);
     if (aggregate) {
         const std::string& op = aggregate->first;
         int col = aggregate->second;
@@ -723,7 +1866,245 @@ std::vector<std::vector<std::string>> FileStorageLayer::scan(
     return results;
 }
 
+void FileStorageLayer::scan_rows(const std::string& table, const std::function<bool(const RowView&)>& visitor) {
+    ScanCursor cursor = open_scan(table);
+    while (cursor.next()) {
+        if (!visitor(cursor.row())) {
+            break;
+        }
+    }
+    cursor.close();
+}
+
+ScanCursor FileStorageLayer::open_scan(const std::string& table) {
+    std::shared_lock<std::shared_mutex> state(state_latch_);
+    if (!is_open) {
+        throw std::runtime_error("Storage not open");
+    }
+    TableHandle& handle = get_table_handle(table);
+    const TableMetadata& metadata = handle.metadata;
+    return ScanCursor(metadata.columns, metadata.column_count, table_pages(handle),
+        [this](uint32_t page_id) { return read_heap_page(page_id); }, heap_read_ahead(), &counters_);
+}
+
+std::vector<uint32_t> FileStorageLayer::table_pages(TableHandle& handle, const PredicateProgram* filter) {
+    // Pages appended after this snapshot are not part of the scan
+    std::shared_lock<std::shared_mutex> table_lock(handle.latch);
+    return table_pages_locked(handle, filter);
+}
+
+std::vector<uint32_t> FileStorageLayer::table_pages_locked(const TableHandle& handle, const PredicateProgram* filter) const {
+    // Blocks are handed out in append order, so directory order is the page chain's order
+    const std::vector<uint32_t>& block_pages = handle.directory.block_pages();
+    std::vector<uint32_t> pages;
+    pages.reserve(block_pages.size());
+    for (uint32_t block = 0; block < block_pages.size(); ++block) {
+        if (block_pages[block] == INVALID_PAGE_ID) continue;
+        if (filter && !filter->may_match(handle.zones.zones(block))) continue;
+        pages.push_back(block_pages[block]);
+    }
+    return pages;
+}
+
+BatchCursor FileStorageLayer::open_batch_scan(const std::string& table, const std::vector<int>& columns,
+    const PredicateProgram* filter) {
+    std::shared_lock<std::shared_mutex> state(state_latch_);
+    if (!is_open) {
+        throw std::runtime_error("Storage not open");
+    }
+    TableHandle& handle = get_table_handle(table);
+    const TableMetadata& metadata = handle.metadata;
+    return BatchCursor(metadata.columns, metadata.column_count, columns, table_pages(handle, filter),
+        [this](uint32_t page_id) { return read_heap_page(page_id); }, heap_read_ahead(), &counters_);
+}
+
+AggregateResult FileStorageLayer::aggregate(const std::string& table, int column, const PredicateProgram* filter) {
+    std::shared_lock<std::shared_mutex> state(state_latch_);
+    if (!is_open) {
+        throw std::runtime_error("Storage not open");
+    }
+    TableHandle& handle = get_table_handle(table);
+    const TableMetadata& metadata = handle.metadata;
+    const bool count_only = column < 0;
+    if (!count_only && (static_cast<uint32_t>(column) >= metadata.column_count || metadata.columns[column].type != ColumnType::INT)) {
+        throw std::runtime_error("Aggregate needs an INT column");
+    }
+    std::vector<int> columns = filter ? filter->columns() : std::vector<int>();
+    if (!count_only && std::find(columns.begin(), columns.end(), column) == columns.end()) columns.push_back(column);
+
+    const auto started = std::chrono::steady_clock::now();
+    std::vector<uint32_t> pages = table_pages(handle, filter);
+    std::vector<AggregateResult> partials(scan_workers(pages.size()));
+    run_page_ranges(pages, partials.size(), [&](size_t w, std::vector<uint32_t> range) {
+        BatchCursor cursor(metadata.columns, metadata.column_count, columns, std::move(range),
+            [this](uint32_t page_id) { return read_heap_page(page_id); }, heap_read_ahead(), &counters_);
+        ColumnBatch batch;
+        std::vector<uint16_t> selection(BATCH_CAPACITY);
+        std::vector<int32_t> selected_values(BATCH_CAPACITY);
+        ScanTally tally;
+        while (cursor.next(batch)) {
+            if (count_only) {
+                const size_t selected = filter ? filter->select(batch, selection.data()) : batch.size;
+                partials[w].count += selected;
+                tally.rows_emitted += selected;
+                continue;
+            }
+            const int32_t* values = batch.ints[column].data();
+            if (!filter) {
+                partials[w].add(values, batch.size);
+                tally.rows_emitted += batch.size;
+                continue;
+            }
+            size_t selected = filter->select(batch, selection.data());
+            gather_int(values, selection.data(), selected, selected_values.data());
+            partials[w].add(selected_values.data(), selected);
+            tally.rows_emitted += selected;
+        }
+        cursor.close();
+        counters_.add(tally);
+    });
+    AggregateResult result;
+    for (const auto& partial : partials) result.merge(partial);
+    StorageCounters::add_time(counters_.scan_nanos, std::chrono::steady_clock::now() - started);
+    return result;
+}
+
+HashAggregate FileStorageLayer::group_aggregate(const std::string& table, const std::vector<int>& group_columns,
+    const std::vector<AggregateSpec>& aggregates, const PredicateProgram* filter) {
+    std::shared_lock<std::shared_mutex> state(state_latch_);
+    if (!is_open) {
+        throw std::runtime_error("Storage not open");
+    }
+    TableHandle& handle = get_table_handle(table);
+    const TableMetadata& metadata = handle.metadata;
+    std::vector<ColumnType> types;
+    for (uint32_t c = 0; c < metadata.column_count; ++c) types.push_back(metadata.columns[c].type);
+    HashAggregate result(types, group_columns, aggregates);
+    std::vector<int> columns = result.columns();
+    if (filter) {
+        for (int c : filter->columns()) columns.push_back(c);
+        std::sort(columns.begin(), columns.end());
+        columns.erase(std::unique(columns.begin(), columns.end()), columns.end());
+    }
+
+    const auto started = std::chrono::steady_clock::now();
+    std::vector<uint32_t> pages = table_pages(handle, filter);
+    std::vector<HashAggregate> partials(scan_workers(pages.size()), result);
+    run_page_ranges(pages, partials.size(), [&](size_t w, std::vector<uint32_t> range) {
+        BatchCursor cursor(metadata.columns, metadata.column_count, columns, std::move(range),
+            [this](uint32_t page_id) { return read_heap_page(page_id); }, heap_read_ahead(), &counters_);
+        ColumnBatch batch;
+        std::vector<uint16_t> selection(BATCH_CAPACITY);
+        ScanTally tally;
+        while (cursor.next(batch)) {
+            size_t selected = batch.size;
+            if (filter) {
+                selected = filter->select(batch, selection.data());
+            } else {
+                std::iota(selection.begin(), selection.begin() + batch.size, 0);
+            }
+            partials[w].add(batch, selection.data(), selected);
+            tally.rows_emitted += selected;
+        }
+        cursor.close();
+        counters_.add(tally);
+    });
+    for (auto& partial : partials) result.merge(std::move(partial));
+    StorageCounters::add_time(counters_.scan_nanos, std::chrono::steady_clock::now() - started);
+    return result;
+}
+
+StorageStats FileStorageLayer::stats() const {
+    StorageStats stats;
+    stats.pages_read = counters_.pages_read.load(std::memory_order_relaxed);
+    stats.pages_written = counters_.pages_written.load(std::memory_order_relaxed);
+    stats.cache_hits = buffer_pool_.stats().hits;
+    stats.rows_scanned = counters_.rows_scanned.load(std::memory_order_relaxed);
+    stats.rows_emitted = counters_.rows_emitted.load(std::memory_order_relaxed);
+    stats.bytes_decoded = counters_.bytes_decoded.load(std::memory_order_relaxed);
+    stats.scan_time = std::chrono::nanoseconds(counters_.scan_nanos.load(std::memory_order_relaxed));
+    stats.sort_time = std::chrono::nanoseconds(counters_.sort_nanos.load(std::memory_order_relaxed));
+    return stats;
+}
+
+void FileStorageLayer::reset_stats() {
+    counters_.reset();
+    buffer_pool_.reset_stats();
+}
+
+size_t FileStorageLayer::scan_workers(size_t page_count) const {
+    return std::max<size_t>(std::min<size_t>(options_.scan_threads, page_count / PARALLEL_SCAN_MIN_PAGES), 1);
+}
+
+void FileStorageLayer::run_page_ranges(const std::vector<uint32_t>& pages, size_t workers,
+    const std::function<void(size_t worker, std::vector<uint32_t> range)>& work) {
+    if (workers <= 1) {
+        work(0, pages);
+        return;
+    }
+    ThreadPool& pool = get_scan_pool();
+    std::vector<std::future<void>> pending;
+    for (size_t w = 0; w < workers; ++w) {
+        size_t begin = pages.size() * w / workers;
+        size_t end = pages.size() * (w + 1) / workers;
+        std::vector<uint32_t> range(pages.begin() + begin, pages.begin() + end);
+        pending.push_back(pool.submit([&work, w, range = std::move(range)]() mutable {
+            work(w, std::move(range));
+        }));
+    }
+    for (auto& task : pending) task.wait();
+    for (auto& task : pending) task.get();
+}
+
+ThreadPool& FileStorageLayer::get_scan_pool() {
+    std::lock_guard<std::mutex> lock(scan_pool_mutex_);
+    if (!scan_pool_) {
+        scan_pool_ = std::make_unique<ThreadPool>(options_.scan_threads);
+    }
+    return *scan_pool_;
+}
+
+std::vector<ColumnSchema> FileStorageLayer::get_schema(const std::string& table) {
+    std::shared_lock<std::shared_mutex> state(state_latch_);
+    const TableMetadata& meta = get_table_metadata(table);
+    return std::vector<ColumnSchema>(meta.columns, meta.columns + meta.column_count);
+}
+
+size_t FileStorageLayer::row_count(const std::string& table) {
+    std::shared_lock<std::shared_mutex> state(state_latch_);
+    if (!is_open) throw std::runtime_error("Storage not open");
+    TableHandle& handle = get_table_handle(table);
+    std::shared_lock<std::shared_mutex> table_lock(handle.latch);
+    return handle.metadata.record_count;
+}
+
+void FileStorageLayer::create_index(const std::string& table, const std::string& column) {
+    std::shared_lock<std::shared_mutex> state(state_latch_);
+    if (!is_open) throw std::runtime_error("Storage not open");
+    check_writable();
+    TableHandle& handle = get_table_handle(table);
+    std::unique_lock<std::shared_mutex> table_lock(handle.latch);
+    TableMetadata& metadata = handle.metadata;
+    int col = -1;
+    for (uint32_t i = 0; i < metadata.column_count; ++i) {
+        if (column == metadata.columns[i].name) col = static_cast<int>(i);
+    }
+    if (col < 0) throw std::runtime_error("Column not found: " + column);
+    if (handle.indexes[col]) throw std::runtime_error("Index already exists on " + table + "." + column);
+    build_index(handle, col);
+    save_table_metadata(metadata);
+    ++schema_version_;
+}
+
+bool FileStorageLayer::has_index(const std::string& table, int column) {
+    std::shared_lock<std::shared_mutex> state(state_latch_);
+    TableHandle& handle = get_table_handle(table);
+    std::shared_lock<std::shared_mutex> table_lock(handle.latch);
+    return column >= 0 && static_cast<size_t>(column) < handle.indexes.size() && handle.indexes[column] != nullptr;
+}
+
 std::vector<std::string> FileStorageLayer::get_column_names(const std::string& table) {
+    std::shared_lock<std::shared_mutex> state(state_latch_);
     const TableMetadata& meta = get_table_metadata(table);
     std::vector<std::string> names;
     for (size_t i = 0; i < meta.column_count; ++i) {
@@ -0,0 +1,30 @@
+#include "toast.h"
+#include <cstring>
+#include <stdexcept>
+
+std::string_view toast_read(ToastReader* reader, const uint8_t* pointer) {
+    if (reader == nullptr) throw std::runtime_error("Row view cannot read a value stored out of line");
+    ToastPointer toast;
+    std::memcpy(&toast, pointer, sizeof(toast));
+    return reader->read(toast);
+}
+
+std::string_view ToastReader::read(const ToastPointer& pointer) {
+    std::string value;
+    value.reserve(pointer.length);
+    uint32_t page_id = pointer.first_page;
+    while (value.size() < pointer.length) {
+        if (page_id == INVALID_PAGE_ID) throw std::runtime_error("Corrupt overflow chain: value cut short");
+        PageRef page = fetch_page_(page_id);
+        const PageHeader& header = page.header();
+        const size_t piece = header.free_space_offset - sizeof(PageHeader);
+        if (!(header.flags & PAGE_OVERFLOW) || piece == 0) {
+            throw std::runtime_error("Corrupt overflow chain: page " + std::to_string(page_id) + " holds no piece");
+        }
+        value.append(reinterpret_cast<const char*>(page.image() + sizeof(PageHeader)),
+            std::min<size_t>(piece, pointer.length - value.size()));
+        page_id = header.next_page_id;
+    }
+    values_.push_back(std::move(value));
+    return values_.back();
+}
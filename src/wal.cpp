@@ -0,0 +1,255 @@
+#include "wal.h"
+#include "page.h"
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t size) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static uint32_t record_crc(const WalRecordHeader& header, const uint8_t* payload) {
+    const uint8_t* fields = reinterpret_cast<const uint8_t*>(&header) + sizeof(header.crc);
+    uint32_t crc = crc32_update(0, fields, sizeof(WalRecordHeader) - sizeof(header.crc));
+    return crc32_update(crc, payload, header.length);
+}
+
+static void write_all(int fd, const uint8_t* data, size_t size, uint64_t offset) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = ::pwrite(fd, data + done, size - done, offset + done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) throw std::runtime_error(std::string("WAL write failed: ") + std::strerror(errno));
+        done += static_cast<size_t>(n);
+    }
+}
+
+static void sync_fd(int fd) {
+    if (::fdatasync(fd) != 0) throw std::runtime_error(std::string("WAL fdatasync failed: ") + std::strerror(errno));
+}
+
+WriteAheadLog::WriteAheadLog(const std::string& path, std::chrono::microseconds commit_delay) : commit_delay_(commit_delay) {
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0) throw std::runtime_error("Cannot open WAL " + path + ": " + std::strerror(errno));
+    struct stat st {};
+    if (fstat(fd_, &st) != 0) {
+        ::close(fd_);
+        throw std::runtime_error("Cannot stat WAL " + path + ": " + std::strerror(errno));
+    }
+    if (static_cast<uint64_t>(st.st_size) < sizeof(WalFileHeader)) {
+        write_header();
+        sync_fd(fd_);
+        file_end_ = sizeof(WalFileHeader);
+        return;
+    }
+    WalFileHeader header{};
+    if (::pread(fd_, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+        header.magic != WAL_MAGIC || header.version == 0 || header.version > WAL_VERSION) {
+        ::close(fd_);
+        throw std::runtime_error("Corrupt WAL header in " + path);
+    }
+    // An older log can only be taken over once a checkpoint has emptied it
+    if (header.version != WAL_VERSION && static_cast<uint64_t>(st.st_size) > sizeof(WalFileHeader)) {
+        ::close(fd_);
+        throw std::runtime_error("WAL " + path + " was written by an older version; checkpoint it with that version first");
+    }
+    start_lsn_ = header.start_lsn;
+    next_lsn_ = start_lsn_;
+    durable_lsn_ = start_lsn_ - 1;
+    commit_lsn_ = start_lsn_ - 1;
+    file_end_ = static_cast<uint64_t>(st.st_size);
+    if (header.version != WAL_VERSION) {
+        write_header();
+        sync_fd(fd_);
+    }
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+void WriteAheadLog::write_header() {
+    WalFileHeader header{WAL_MAGIC, WAL_VERSION, start_lsn_, 0};
+    write_all(fd_, reinterpret_cast<const uint8_t*>(&header), sizeof(header), 0);
+}
+
+std::vector<WalRecord> WriteAheadLog::recover(std::vector<WalRecord>* uncommitted) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<uint8_t> data(file_end_ - sizeof(WalFileHeader));
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t n = ::pread(fd_, data.data() + done, data.size() - done, sizeof(WalFileHeader) + done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) throw std::runtime_error(std::string("WAL read failed: ") + std::strerror(errno));
+        done += static_cast<size_t>(n);
+    }
+
+    std::vector<WalRecord> records;
+    size_t committed_records = 0;
+    size_t committed_end = 0;
+    commit_lsn_ = start_lsn_ - 1;
+    uint32_t expected_lsn = start_lsn_;
+    size_t offset = 0;
+    // Stop at the first torn, corrupt or stale record; everything after it was never acknowledged
+    while (offset + sizeof(WalRecordHeader) <= data.size()) {
+        WalRecordHeader header;
+        std::memcpy(&header, data.data() + offset, sizeof(header));
+        if (header.lsn != expected_lsn || offset + sizeof(header) + header.length > data.size()) break;
+        const uint8_t* payload = data.data() + offset + sizeof(header);
+        if (record_crc(header, payload) != header.crc) break;
+        records.push_back({header.type, header.lsn, header.page_id, std::vector<uint8_t>(payload, payload + header.length)});
+        offset += sizeof(header) + header.length;
+        expected_lsn++;
+        if (header.type == WalRecordType::Commit) {
+            committed_records = records.size();
+            committed_end = offset;
+            commit_lsn_ = header.lsn;
+        }
+    }
+    size_t kept_records = committed_records;
+    size_t kept_end = committed_end;
+    if (uncommitted) {
+        uncommitted->assign(std::make_move_iterator(records.begin() + committed_records), std::make_move_iterator(records.end()));
+        kept_records = records.size();
+        kept_end = offset;
+    }
+    records.resize(committed_records);
+
+    file_end_ = sizeof(WalFileHeader) + kept_end;
+    if (::ftruncate(fd_, static_cast<off_t>(file_end_)) != 0) {
+        throw std::runtime_error(std::string("WAL truncate failed: ") + std::strerror(errno));
+    }
+    next_lsn_ = start_lsn_ + static_cast<uint32_t>(kept_records);
+    durable_lsn_ = next_lsn_ - 1;
+    buffer_.clear();
+    return records;
+}
+
+uint32_t WriteAheadLog::append(WalRecordType type, uint32_t page_id, const void* prefix, size_t prefix_size,
+    const void* payload, size_t payload_size, const void* suffix, size_t suffix_size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    WalRecordHeader header{};
+    header.lsn = next_lsn_++;
+    header.page_id = page_id;
+    header.length = static_cast<uint32_t>(prefix_size + payload_size + suffix_size);
+    header.type = type;
+    if (type == WalRecordType::Commit) commit_lsn_ = header.lsn;
+
+    const size_t start = buffer_.size();
+    buffer_.resize(start + sizeof(header) + header.length);
+    uint8_t* body = buffer_.data() + start + sizeof(header);
+    if (prefix_size > 0) std::memcpy(body, prefix, prefix_size);
+    if (payload_size > 0) std::memcpy(body + prefix_size, payload, payload_size);
+    if (suffix_size > 0) std::memcpy(body + prefix_size + payload_size, suffix, suffix_size);
+    header.crc = record_crc(header, body);
+    std::memcpy(buffer_.data() + start, &header, sizeof(header));
+
+    stats_.records++;
+    stats_.bytes += sizeof(header) + header.length;
+    return header.lsn;
+}
+
+uint32_t WriteAheadLog::append_commit() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (commit_lsn_ == next_lsn_ - 1) return commit_lsn_;
+    }
+    return append(WalRecordType::Commit, INVALID_PAGE_ID, nullptr, 0);
+}
+
+void WriteAheadLog::flush(uint32_t lsn) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stats_.commits++;
+    while (durable_lsn_ < lsn) {
+        if (syncing_) {
+            // Another caller is syncing; its write may already cover our records
+            synced_.wait(lock);
+            continue;
+        }
+        syncing_ = true;
+        if (commit_delay_.count() > 0) {
+            lock.unlock();
+            std::this_thread::sleep_for(commit_delay_);
+            lock.lock();
+        }
+        std::vector<uint8_t> pending;
+        pending.swap(buffer_);
+        const uint32_t target = next_lsn_ - 1;
+        const uint64_t offset = file_end_;
+        lock.unlock();
+        try {
+            write_all(fd_, pending.data(), pending.size(), offset);
+            sync_fd(fd_);
+        } catch (...) {
+            lock.lock();
+            syncing_ = false;
+            synced_.notify_all();
+            throw;
+        }
+        lock.lock();
+        file_end_ = offset + pending.size();
+        durable_lsn_ = target;
+        syncing_ = false;
+        stats_.syncs++;
+        synced_.notify_all();
+    }
+}
+
+void WriteAheadLog::truncate() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    synced_.wait(lock, [this] { return !syncing_; });
+    start_lsn_ = next_lsn_;
+    commit_lsn_ = next_lsn_ - 1;
+    buffer_.clear();
+    // New start LSN first: a crash before the truncate leaves only records the header already rules out
+    write_header();
+    sync_fd(fd_);
+    if (::ftruncate(fd_, sizeof(WalFileHeader)) != 0) {
+        throw std::runtime_error(std::string("WAL truncate failed: ") + std::strerror(errno));
+    }
+    file_end_ = sizeof(WalFileHeader);
+    durable_lsn_ = next_lsn_ - 1;
+}
+
+uint32_t WriteAheadLog::last_lsn() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return next_lsn_ - 1;
+}
+
+uint32_t WriteAheadLog::durable_lsn() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return durable_lsn_;
+}
+
+uint64_t WriteAheadLog::size_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return file_end_ + buffer_.size();
+}
+
+WalStats WriteAheadLog::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
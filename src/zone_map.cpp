@@ -0,0 +1,48 @@
+#include "zone_map.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+Zone* ZoneMap::block_zones(uint32_t block) {
+    const size_t end = (static_cast<size_t>(block) + 1) * column_count_;
+    if (zones_.size() < end) zones_.resize(end);
+    return zones_.data() + static_cast<size_t>(block) * column_count_;
+}
+
+void ZoneMap::add_row(uint32_t block, const RowView& row) {
+    if (row.column_count() < column_count_) return;
+    Zone* zones = block_zones(block);
+    for (uint32_t col = 0; col < column_count_; ++col) {
+        if (row.type(col) != ColumnType::INT) continue;
+        const int32_t value = row.get_int(col);
+        if (value < zones[col].min || value > zones[col].max) {
+            zones[col].add(value);
+            dirty_ = true;
+        }
+    }
+}
+
+void ZoneMap::clear_block(uint32_t block) {
+    Zone* zones = block_zones(block);
+    std::fill(zones, zones + column_count_, Zone());
+    dirty_ = true;
+}
+
+void ZoneMap::load(DiskManager& disk, uint32_t head_page_id) {
+    std::vector<uint8_t> payload = read_page_chain(disk, head_page_id, storage_pages_);
+    if (column_count_ == 0 || payload.size() % (sizeof(Zone) * column_count_) != 0) {
+        throw std::runtime_error("Corrupt zone map: truncated entry");
+    }
+    zones_.resize(payload.size() / sizeof(Zone));
+    if (!payload.empty()) {
+        std::memcpy(zones_.data(), payload.data(), payload.size());
+    }
+    dirty_ = false;
+}
+
+uint32_t ZoneMap::save(DiskManager& disk, const std::function<uint32_t()>& allocate_page) {
+    uint32_t head = write_page_chain(disk, reinterpret_cast<const uint8_t*>(zones_.data()),
+        zones_.size() * sizeof(Zone), storage_pages_, allocate_page);
+    dirty_ = false;
+    return head;
+}
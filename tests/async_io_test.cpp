@@ -0,0 +1,64 @@
+#include "gtest/gtest.h"
+#include "async_io.h"
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+class AsyncIoTest : public ::testing::TestWithParam<IoBackend> {
+protected:
+    std::string path = (fs::temp_directory_path() / "async_io_test.dat").string();
+    int fd = -1;
+
+    void SetUp() override {
+        fs::remove(path);
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        ASSERT_GE(fd, 0);
+    }
+    void TearDown() override {
+        ::close(fd);
+        fs::remove(path);
+    }
+};
+
+TEST_P(AsyncIoTest, WritesThenReadsMoreBlocksThanTheQueueHolds) {
+    std::unique_ptr<AsyncIo> io;
+    try {
+        io = AsyncIo::create(fd, GetParam(), 4);
+    } catch (const std::runtime_error& e) {
+        GTEST_SKIP() << e.what();
+    }
+    constexpr size_t BLOCKS = 32;
+    constexpr size_t BLOCK = 4096;
+    std::vector<std::vector<uint8_t>> blocks(BLOCKS, std::vector<uint8_t>(BLOCK));
+    std::vector<IoRequest> writes(BLOCKS);
+    for (size_t i = 0; i < BLOCKS; ++i) {
+        std::memset(blocks[i].data(), static_cast<int>(i + 1), BLOCK);
+        writes[i].write = true;
+        writes[i].offset = i * BLOCK;
+        writes[i].buffer = blocks[i].data();
+        writes[i].size = BLOCK;
+    }
+    for (ssize_t result : io->run(std::move(writes))) EXPECT_EQ(result, static_cast<ssize_t>(BLOCK));
+
+    std::vector<std::vector<uint8_t>> read_back(BLOCKS + 1, std::vector<uint8_t>(BLOCK));
+    std::vector<IoRequest> reads(BLOCKS + 1);
+    // Reverse order, and one block past the end of the file
+    for (size_t i = 0; i <= BLOCKS; ++i) {
+        reads[i].offset = (BLOCKS - i) * BLOCK;
+        reads[i].buffer = read_back[i].data();
+        reads[i].size = BLOCK;
+    }
+    std::vector<ssize_t> results = io->run(std::move(reads));
+    EXPECT_EQ(results[0], 0);
+    for (size_t i = 1; i <= BLOCKS; ++i) {
+        ASSERT_EQ(results[i], static_cast<ssize_t>(BLOCK));
+        EXPECT_EQ(read_back[i], blocks[BLOCKS - i]);
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(Backends, AsyncIoTest, ::testing::Values(IoBackend::Uring, IoBackend::Threads),
+    [](const ::testing::TestParamInfo<IoBackend>& info) { return info.param == IoBackend::Uring ? "Uring" : "Threads"; });
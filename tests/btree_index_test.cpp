@@ -0,0 +1,155 @@
+#include "gtest/gtest.h"
+#include "storage_layer.h"
+#include <algorithm>
+#include <filesystem>
+#include <map>
+
+namespace fs = std::filesystem;
+
+class BTreeIndexTest : public ::testing::Test {
+protected:
+    std::map<uint32_t, std::vector<uint8_t>> disk;
+    uint32_t next_page = 1;
+
+    BufferPool make_pool(size_t frames) {
+        return BufferPool(frames,
+            [this](uint32_t page_id, Page& page) {
+                auto it = disk.find(page_id);
+                if (it == disk.end()) return false;
+                page.deserialize(it->second);
+                return true;
+            },
+            [this](Page& page) {
+                disk[page.get_page_id()] = page.serialize();
+                page.clear_dirty();
+            });
+    }
+    BTreeIndex::PageAllocator allocator() {
+        return [this] { return next_page++; };
+    }
+    static std::string int_key(int32_t value) { return BTreeIndex::encode_key(ColumnType::INT, std::to_string(value)); }
+};
+
+TEST_F(BTreeIndexTest, RangesOverManySplitsMatchSortedKeys) {
+    BufferPool pool = make_pool(8); // Far fewer frames than nodes
+    BTreeIndex index(pool, ColumnType::INT, BTreeIndex::create(pool, allocator()), allocator());
+    constexpr int N = 20000;
+    for (int i = 0; i < N; ++i) {
+        int32_t key = (i * 7919) % N - N / 2;
+        index.insert(int_key(key), static_cast<uint32_t>(i + 1));
+    }
+    EXPECT_GT(next_page, 20u);
+
+    KeyRange all;
+    EXPECT_EQ(index.range(all).size(), static_cast<size_t>(N));
+
+    KeyRange small{int_key(-5), true, int_key(5), false};
+    auto ids = index.range(small);
+    ASSERT_EQ(ids.size(), 10u);
+    for (size_t i = 1; i < ids.size(); ++i) {
+        // Key order: key = (id - 1) * 7919 % N - N / 2 increases along the result
+        int32_t prev = static_cast<int32_t>((ids[i - 1] - 1) * 7919ull % N) - N / 2;
+        int32_t cur = static_cast<int32_t>((ids[i] - 1) * 7919ull % N) - N / 2;
+        EXPECT_LT(prev, cur);
+    }
+
+    KeyRange above{int_key(N / 2 - 3), false, std::nullopt, true};
+    EXPECT_EQ(index.range(above).size(), 2u);
+}
+
+TEST_F(BTreeIndexTest, DuplicateTextKeysAndRemoval) {
+    BufferPool pool = make_pool(16);
+    BTreeIndex index(pool, ColumnType::TEXT, BTreeIndex::create(pool, allocator()), allocator());
+    for (uint32_t id = 1; id <= 3000; ++id) {
+        index.insert("name" + std::to_string(id % 7) + std::string(40, 'x'), id);
+    }
+    std::string key = "name3" + std::string(40, 'x');
+    KeyRange equal{key, true, key, true};
+    auto ids = index.range(equal);
+    ASSERT_EQ(ids.size(), 429u);
+    EXPECT_TRUE(std::is_sorted(ids.begin(), ids.end()));
+
+    for (uint32_t id : ids) {
+        if (id % 2 == 0) {
+            EXPECT_TRUE(index.remove(key, id));
+        }
+    }
+    EXPECT_FALSE(index.remove(key, 2));
+    EXPECT_EQ(index.range(equal).size(), 215u);
+    EXPECT_THROW(index.insert(std::string(BTREE_MAX_KEY_SIZE + 1, 'k'), 1), std::runtime_error);
+}
+
+class IndexedTableTest : public ::testing::Test {
+protected:
+    std::string temp_dir;
+    StorageOptions options;
+
+    void SetUp() override {
+        temp_dir = (fs::temp_directory_path() / fs::path("indexed_table_test_dir")).string();
+        fs::remove_all(temp_dir);
+        options.buffer_pool_frames = 16;
+    }
+
+    void TearDown() override {
+        fs::remove_all(temp_dir);
+    }
+
+    static std::vector<std::vector<std::string>> sorted(std::vector<std::vector<std::string>> rows) {
+        std::sort(rows.begin(), rows.end());
+        return rows;
+    }
+};
+
+TEST_F(IndexedTableTest, IndexScansMatchFullScansThroughChanges) {
+    FileStorageLayer storage(options);
+    storage.open(temp_dir);
+    storage.create("t", {{"id", ColumnType::INT, INT_SIZE}, {"name", ColumnType::TEXT, 0}});
+    std::vector<std::vector<std::string>> rows;
+    for (int i = 0; i < 5000; ++i) {
+        rows.push_back({std::to_string(i % 1000), "n" + std::to_string(i % 13)});
+    }
+    auto ids = storage.insert_batch("t", rows);
+    storage.create_index("t", "id");
+    storage.create_index("t", "name");
+    EXPECT_TRUE(storage.has_index("t", 0));
+    EXPECT_THROW(storage.create_index("t", "id"), std::runtime_error);
+
+    // Maintained by later inserts, updates and deletes
+    storage.insert("t", {"42", "late"});
+    storage.update("t", ids[0], {"-1", "moved"});
+    storage.delete_record("t", ids[42]);
+
+    auto check = [&](FileStorageLayer& s, const IndexRange& range, const std::function<bool(const RowView&)>& pred) {
+        ScanSpec by_index;
+        by_index.index_range = range;
+        ScanSpec by_filter;
+        by_filter.row_filter = pred;
+        auto via_index = s.scan("t", by_index);
+        auto via_scan = s.scan("t", by_filter);
+        EXPECT_EQ(sorted(via_index), sorted(via_scan));
+        return via_index.size();
+    };
+    EXPECT_EQ(check(storage, IndexRange{0, "42", true, "42", true}, [](const RowView& r) { return r.get_int(0) == 42; }), 5u);
+    EXPECT_EQ(check(storage, IndexRange{0, "10", false, "20", true}, [](const RowView& r) { return r.get_int(0) > 10 && r.get_int(0) <= 20; }), 50u);
+    EXPECT_EQ(check(storage, IndexRange{0, std::nullopt, true, "0", true}, [](const RowView& r) { return r.get_int(0) <= 0; }), 5u);
+    EXPECT_EQ(check(storage, IndexRange{1, "moved", true, "moved", true}, [](const RowView& r) { return r.get_text(1) == "moved"; }), 1u);
+    storage.close();
+
+    // Persisted, and rebuilt when recovery cannot trust the pages
+    storage.open(temp_dir);
+    EXPECT_EQ(check(storage, IndexRange{0, "42", true, "42", true}, [](const RowView& r) { return r.get_int(0) == 42; }), 5u);
+    storage.insert("t", {"42", "after reopen"});
+    storage.commit();
+    std::string crash_dir = temp_dir + "_crash";
+    fs::remove_all(crash_dir);
+    fs::copy(temp_dir, crash_dir, fs::copy_options::recursive);
+    storage.close();
+
+    FileStorageLayer recovered(options);
+    recovered.open(crash_dir);
+    EXPECT_TRUE(recovered.has_index("t", 1));
+    auto rows_42 = check(recovered, IndexRange{0, "42", true, "42", true}, [](const RowView& r) { return r.get_int(0) == 42; });
+    EXPECT_EQ(rows_42, 6u);
+    recovered.close();
+    fs::remove_all(crash_dir);
+}
@@ -0,0 +1,205 @@
+#include "gtest/gtest.h"
+#include "storage_layer.h"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <map>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+class BufferPoolTest : public ::testing::Test {
+protected:
+    std::map<uint32_t, std::vector<uint8_t>> disk;
+    size_t writes = 0;
+
+    BufferPool make_pool(size_t frames) {
+        return BufferPool(frames,
+            [this](uint32_t page_id, Page& page) {
+                auto it = disk.find(page_id);
+                if (it == disk.end()) return false;
+                page.deserialize(it->second);
+                return true;
+            },
+            [this](Page& page) {
+                disk[page.get_page_id()] = page.serialize();
+                page.clear_dirty();
+                writes++;
+            });
+    }
+};
+
+TEST_F(BufferPoolTest, EvictsAndWritesBackDirtyVictims) {
+    BufferPool pool = make_pool(2);
+    for (uint32_t id = 1; id <= 4; ++id) {
+        PageGuard page = pool.create_page(id, id * IDS_PER_PAGE);
+        page->insert_record(id * IDS_PER_PAGE, {static_cast<uint8_t>(id)});
+    }
+    EXPECT_EQ(pool.resident_pages(), 2u);
+    EXPECT_EQ(pool.stats().evictions, 2u);
+    EXPECT_EQ(writes, 2u);
+
+    PageGuard first = pool.fetch_page(1);
+    auto record = first->get_record(IDS_PER_PAGE);
+    ASSERT_TRUE(record.has_value());
+    EXPECT_EQ((*record)[0], 1);
+    EXPECT_EQ(pool.stats().misses, 1u);
+}
+
+TEST_F(BufferPoolTest, PinnedFramesAreNotEvicted) {
+    BufferPool pool = make_pool(2);
+    PageGuard a = pool.create_page(1, 1);
+    PageGuard b = pool.create_page(2, 1025);
+    EXPECT_THROW(pool.create_page(3, 2049), std::runtime_error);
+    b.release();
+    PageGuard c = pool.create_page(3, 2049);
+    EXPECT_EQ(a->get_page_id(), 1u);
+    EXPECT_EQ(pool.stats().evictions, 1u);
+
+    PageGuard again = pool.fetch_page(1);
+    EXPECT_EQ(pool.stats().hits, 1u);
+}
+
+TEST_F(BufferPoolTest, WriteBackSkipsPinnedPagesAndFlushVisitsDirtyOnes) {
+    BufferPool pool = make_pool(8);
+    for (uint32_t id = 1; id <= 3; ++id) pool.create_page(id, id * IDS_PER_PAGE);
+    PageGuard pinned = pool.create_page(4, 4 * IDS_PER_PAGE);
+    EXPECT_EQ(pool.write_back(2), 2u);
+    EXPECT_EQ(writes, 2u);
+    EXPECT_TRUE(disk.count(1) && disk.count(2));
+    // Page 4 is still pinned, so only page 3 is left to write
+    EXPECT_EQ(pool.write_back(10), 1u);
+    EXPECT_EQ(writes, 3u);
+    EXPECT_EQ(pool.write_back(10), 0u);
+    EXPECT_EQ(pool.stats().background_writes, 3u);
+
+    // Listed again once released; clean pages are not written
+    pinned.release();
+    pool.fetch_page(1).release();
+    pool.flush_all();
+    EXPECT_EQ(writes, 4u);
+    EXPECT_TRUE(disk.count(4));
+    pool.flush_all();
+    EXPECT_EQ(writes, 4u);
+}
+
+TEST_F(BufferPoolTest, WriteBackLeavesFramesForFetches) {
+    BufferPool pool = make_pool(4);
+    for (uint32_t id = 1; id <= 4; ++id) pool.create_page(id, id * IDS_PER_PAGE);
+    // At most half of the shard per call
+    EXPECT_EQ(pool.write_back(10), 2u);
+    EXPECT_EQ(pool.write_back(10), 2u);
+}
+
+TEST(BufferPoolWaitTest, FetchWaitsForWriteBackPins) {
+    std::atomic<bool> writing{false};
+    BufferPool pool(4, [](uint32_t, Page&) { return false; }, [&](Page& page) {
+        writing = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        page.clear_dirty();
+    });
+    for (uint32_t id = 1; id <= 4; ++id) pool.create_page(id, id * IDS_PER_PAGE);
+    PageGuard a = pool.fetch_page(1);
+    PageGuard b = pool.fetch_page(2);
+    // The writer pins pages 3 and 4, so for a moment every frame is pinned
+    size_t written = 0;
+    std::thread writer([&] { written = pool.write_back(10); });
+    while (!writing) std::this_thread::yield();
+    PageGuard c = pool.create_page(5, 5 * IDS_PER_PAGE);
+    writer.join();
+    EXPECT_EQ(written, 2u);
+    EXPECT_EQ(c->get_page_id(), 5u);
+}
+
+TEST(BufferPoolWaitTest, DirtyVictimIsWrittenWithoutTheShardMutex) {
+    BufferPool* self = nullptr;
+    std::promise<void> fetched;
+    std::thread fetcher;
+    bool fetched_during_write = false;
+    BufferPool pool(2, [](uint32_t, Page&) { return false; }, [&](Page& page) {
+        // A hit on another page of the shard needs its mutex
+        fetcher = std::thread([&] {
+            self->fetch_page(2).release();
+            fetched.set_value();
+        });
+        fetched_during_write = fetched.get_future().wait_for(std::chrono::seconds(5)) == std::future_status::ready;
+        page.clear_dirty();
+    });
+    self = &pool;
+    pool.create_page(1, IDS_PER_PAGE).release();
+    PageGuard pinned = pool.create_page(2, 2 * IDS_PER_PAGE);
+    PageGuard created = pool.create_page(3, 3 * IDS_PER_PAGE);
+    fetcher.join();
+    EXPECT_TRUE(fetched_during_write);
+    EXPECT_EQ(pool.stats().dirty_writebacks, 1u);
+}
+
+TEST(BufferPoolWaitTest, MissIsReadWithoutTheShardMutex) {
+    BufferPool* self = nullptr;
+    std::promise<void> fetched;
+    std::thread fetcher;
+    bool fetched_during_read = false;
+    BufferPool pool(2, [&](uint32_t page_id, Page&) {
+        if (page_id != 5) return false;
+        // A hit on another page of the shard needs its mutex
+        fetcher = std::thread([&] {
+            self->fetch_page(2).release();
+            fetched.set_value();
+        });
+        fetched_during_read = fetched.get_future().wait_for(std::chrono::seconds(5)) == std::future_status::ready;
+        return true;
+    }, [](Page& page) { page.clear_dirty(); });
+    self = &pool;
+    pool.create_page(2, 2 * IDS_PER_PAGE).release();
+    pool.fetch_page(5).release();
+    fetcher.join();
+    EXPECT_TRUE(fetched_during_read);
+    // A failed read gives its frame back
+    EXPECT_THROW(pool.fetch_page(6), std::runtime_error);
+    EXPECT_THROW(pool.fetch_page(7), std::runtime_error);
+    pool.fetch_page(5).release();
+    EXPECT_EQ(pool.stats().misses, 3u);
+}
+
+TEST(BufferPoolStorageTest, SmallPoolRoundTripsLargeTable) {
+    std::string temp_dir = (fs::temp_directory_path() / fs::path("buffer_pool_test_dir")).string();
+    fs::remove_all(temp_dir);
+    StorageOptions options;
+    options.buffer_pool_frames = 4;
+    std::vector<uint32_t> ids;
+    {
+        FileStorageLayer storage(options);
+        storage.open(temp_dir);
+        storage.create("big", {{"id", ColumnType::INT, INT_SIZE}, {"name", ColumnType::TEXT, 0}});
+        for (int i = 0; i < 3000; ++i) {
+            ids.push_back(storage.insert("big", {std::to_string(i), "row_" + std::to_string(i)}));
+        }
+        EXPECT_GT(storage.buffer_pool_stats().evictions, 0u);
+        EXPECT_EQ(storage.scan("big").size(), 3000u);
+        storage.close();
+    }
+    FileStorageLayer storage(options);
+    storage.open(temp_dir);
+    for (int i = 0; i < 3000; i += 97) {
+        auto row = storage.get("big", ids[i]);
+        EXPECT_EQ(row[0], std::to_string(i));
+        EXPECT_EQ(row[1], "row_" + std::to_string(i));
+    }
+    storage.close();
+    fs::remove_all(temp_dir);
+}
+
+TEST_F(BufferPoolTest, FramesArePageAlignedAndDistinct) {
+    BufferPool pool = make_pool(8);
+    std::vector<PageGuard> guards;
+    for (uint32_t id = 0; id < 8; ++id) guards.push_back(pool.create_page(id, 0));
+    for (size_t i = 0; i < guards.size(); ++i) {
+        const uint8_t* image = guards[i]->image();
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(image) % PAGE_IMAGE_ALIGNMENT, 0u);
+        EXPECT_EQ(guards[i]->get_page_id(), i);
+        if (i > 0) {
+            EXPECT_NE(image, guards[i - 1]->image());
+        }
+    }
+}
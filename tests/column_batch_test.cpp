@@ -0,0 +1,128 @@
+#include "gtest/gtest.h"
+#include "column_batch.h"
+#include "storage_layer.h"
+#include <algorithm>
+#include <filesystem>
+#include <random>
+
+namespace fs = std::filesystem;
+
+TEST(ColumnBatchKernelTest, SelectionAndAggregatesMatchScalarLoops) {
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int32_t> dist(-50, 50);
+    // Odd length so the scalar tail runs too
+    std::vector<int32_t> values(1023);
+    for (auto& v : values) v = dist(rng);
+    values[5] = INT32_MAX;
+    values[6] = INT32_MIN;
+
+    const CompareOp ops[] = {CompareOp::Eq, CompareOp::Ne, CompareOp::Lt, CompareOp::Le, CompareOp::Gt, CompareOp::Ge};
+    auto passes = [](CompareOp op, int32_t a, int32_t b) {
+        switch (op) {
+        case CompareOp::Eq: return a == b;
+        case CompareOp::Ne: return a != b;
+        case CompareOp::Lt: return a < b;
+        case CompareOp::Le: return a <= b;
+        case CompareOp::Gt: return a > b;
+        case CompareOp::Ge: return a >= b;
+        }
+        return false;
+    };
+    std::vector<uint16_t> selection(values.size());
+    for (CompareOp op : ops) {
+        size_t n = select_int(values.data(), values.size(), op, 3, selection.data());
+        std::vector<uint16_t> expected;
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (passes(op, values[i], 3)) expected.push_back(static_cast<uint16_t>(i));
+        }
+        ASSERT_EQ(std::vector<uint16_t>(selection.begin(), selection.begin() + n), expected);
+
+        // Refining in place keeps only the rows that also pass the second comparison
+        size_t refined = refine_int(values.data(), selection.data(), n, CompareOp::Lt, 20, selection.data());
+        size_t expected_refined = std::count_if(expected.begin(), expected.end(), [&](uint16_t i) { return values[i] < 20; });
+        EXPECT_EQ(refined, expected_refined);
+    }
+
+    int64_t sum = 0;
+    for (int32_t v : values) sum += v;
+    EXPECT_EQ(sum_int(values.data(), values.size()), sum);
+    EXPECT_EQ(min_int(values.data(), values.size()), INT32_MIN);
+    EXPECT_EQ(max_int(values.data(), values.size()), INT32_MAX);
+    EXPECT_EQ(min_int(values.data(), 3), *std::min_element(values.begin(), values.begin() + 3));
+
+    AggregateResult result;
+    result.add(values.data(), 500);
+    result.add(values.data() + 500, values.size() - 500);
+    EXPECT_EQ(result.count, values.size());
+    EXPECT_EQ(result.sum, sum);
+    EXPECT_EQ(result.min, INT32_MIN);
+}
+
+class BatchScanTest : public ::testing::Test {
+protected:
+    std::string temp_dir;
+
+    void SetUp() override {
+        temp_dir = (fs::temp_directory_path() / fs::path("batch_scan_test_dir")).string();
+        fs::remove_all(temp_dir);
+    }
+
+    void TearDown() override {
+        fs::remove_all(temp_dir);
+    }
+};
+
+TEST_F(BatchScanTest, AggregatesMatchRowScans) {
+    StorageOptions options;
+    options.scan_threads = 4;
+    FileStorageLayer storage(options);
+    storage.open(temp_dir);
+    std::vector<ColumnSchema> schema = {{"id", ColumnType::INT, INT_SIZE}, {"val", ColumnType::INT, INT_SIZE}, {"tag", ColumnType::TEXT, 0}};
+    storage.create("t", schema);
+    std::vector<std::vector<std::string>> rows;
+    for (int i = 0; i < 30000; ++i) {
+        rows.push_back({std::to_string(i), std::to_string((i * 7919) % 10007 - 5000), "tag" + std::to_string(i % 5)});
+    }
+    auto ids = storage.insert_batch("t", rows);
+    for (size_t i = 0; i < ids.size(); i += 7) storage.delete_record("t", ids[i]);
+
+    // Every live row comes back once, with its columns decoded
+    BatchCursor cursor = storage.open_batch_scan("t", {0, 2});
+    ColumnBatch batch;
+    size_t seen = 0;
+    while (cursor.next(batch)) {
+        ASSERT_LE(batch.size, BATCH_CAPACITY);
+        for (size_t i = 0; i < batch.size; ++i) {
+            ASSERT_EQ(batch.texts[2][i], "tag" + std::to_string(batch.ints[0][i] % 5));
+        }
+        seen += batch.size;
+    }
+    cursor.close();
+    EXPECT_EQ(seen, storage.scan("t").size());
+
+    std::vector<FilterClause> clauses = {{0, ">=", "1000"}, {2, "!=", "tag3"}, {1, "<", "2500"}};
+    PredicateProgram program(clauses, schema);
+    AggregateResult expected;
+    for (const auto& row : storage.scan("t")) {
+        if (!program.matches(row)) continue;
+        int32_t v = std::stoi(row[1]);
+        expected.add(&v, 1);
+    }
+    AggregateResult filtered = storage.aggregate("t", 1, &program);
+    EXPECT_EQ(filtered.count, expected.count);
+    EXPECT_EQ(filtered.sum, expected.sum);
+    EXPECT_EQ(filtered.min, expected.min);
+    EXPECT_EQ(filtered.max, expected.max);
+
+    EXPECT_EQ(storage.aggregate("t", -1).count, seen);
+    EXPECT_EQ(storage.aggregate("t", -1, &program).count, expected.count);
+    EXPECT_THROW(storage.aggregate("t", 2), std::runtime_error);
+
+    // The folded SUM in scan() agrees with the batch aggregate
+    ScanSpec spec;
+    spec.aggregate = std::make_pair(std::string("SUM"), 1);
+    spec.row_filter = [&](const RowView& row) { return program.matches(row); };
+    auto sum = storage.scan("t", spec);
+    EXPECT_EQ(sum[0][0], std::to_string(expected.sum));
+    storage.close();
+}
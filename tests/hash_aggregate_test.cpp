@@ -0,0 +1,88 @@
+#include "gtest/gtest.h"
+#include "hash_aggregate.h"
+#include "sql_parser.h"
+#include "storage_layer.h"
+#include <filesystem>
+#include <map>
+
+namespace fs = std::filesystem;
+
+TEST(HashAggregateTest, ParallelGroupsMatchReference) {
+    std::string temp_dir = (fs::temp_directory_path() / fs::path("hash_aggregate_test_dir")).string();
+    fs::remove_all(temp_dir);
+    StorageOptions options;
+    options.scan_threads = 4;
+    FileStorageLayer storage(options);
+    storage.open(temp_dir);
+    std::vector<ColumnSchema> schema = {{"bucket", ColumnType::INT, INT_SIZE}, {"val", ColumnType::INT, INT_SIZE}, {"tag", ColumnType::TEXT, 0}};
+    storage.create("t", schema);
+    std::vector<std::vector<std::string>> rows;
+    // (tag, bucket) -> count, sum, min and max of val over the rows with val >= -4000
+    std::map<std::pair<std::string, int>, std::vector<int64_t>> expected;
+    for (int i = 0; i < 30000; ++i) {
+        int val = (i * 7919) % 10007 - 5000;
+        std::string tag = "tag" + std::to_string(i % 7);
+        rows.push_back({std::to_string(i % 4), std::to_string(val), tag});
+        if (val < -4000) continue;
+        auto [it, added] = expected.try_emplace({tag, i % 4}, std::vector<int64_t>{0, 0, val, val});
+        auto& e = it->second;
+        e[0]++;
+        e[1] += val;
+        e[2] = std::min<int64_t>(e[2], val);
+        e[3] = std::max<int64_t>(e[3], val);
+    }
+    storage.insert_batch("t", rows);
+
+    std::vector<FilterClause> clauses = {{1, ">=", "-4000"}};
+    PredicateProgram program(clauses, schema);
+    std::vector<AggregateSpec> aggregates = {{AggregateFn::Count, -1}, {AggregateFn::Sum, 1}, {AggregateFn::Min, 1},
+        {AggregateFn::Max, 1}, {AggregateFn::Avg, 1}};
+    HashAggregate result = storage.group_aggregate("t", {2, 0}, aggregates, &program);
+    ASSERT_EQ(result.group_count(), expected.size());
+    for (const auto& row : result.rows()) {
+        const auto& e = expected.at({row[0], std::stoi(row[1])});
+        EXPECT_EQ(row[2], std::to_string(e[0]));
+        EXPECT_EQ(row[3], std::to_string(e[1]));
+        EXPECT_EQ(row[4], std::to_string(e[2]));
+        EXPECT_EQ(row[5], std::to_string(e[3]));
+        EXPECT_NEAR(std::stod(row[6]), static_cast<double>(e[1]) / static_cast<double>(e[0]), 1e-9);
+    }
+
+    // Without group columns there is one row, even over no input
+    std::vector<FilterClause> none = {{1, ">", "999999"}};
+    PredicateProgram empty(none, schema);
+    auto totals = storage.group_aggregate("t", {}, aggregates, &empty).rows();
+    EXPECT_EQ(totals, (std::vector<std::vector<std::string>>{{"0", "0", "NULL", "NULL", "NULL"}}));
+    EXPECT_THROW(storage.group_aggregate("t", {}, {{AggregateFn::Sum, 2}}), std::runtime_error);
+    storage.close();
+    fs::remove_all(temp_dir);
+}
+
+TEST(HashAggregateTest, DecodedRowsAndMergedPartials) {
+    const std::vector<ColumnType> types = {ColumnType::TEXT, ColumnType::INT};
+    HashAggregate first(types, {0}, {{AggregateFn::Count, -1}, {AggregateFn::Max, 1}});
+    HashAggregate second(types, {0}, {{AggregateFn::Count, -1}, {AggregateFn::Max, 1}});
+    first.add({"a", "3"});
+    first.add({"b", "-1"});
+    second.add({"a", "9"});
+    second.add({"c", "4"});
+    first.merge(std::move(second));
+    auto rows = first.rows();
+    std::sort(rows.begin(), rows.end());
+    EXPECT_EQ(rows, (std::vector<std::vector<std::string>>{{"a", "2", "9"}, {"b", "1", "-1"}, {"c", "1", "4"}}));
+}
+
+TEST(HashAggregateTest, ParsesGroupBy) {
+    SqlLexer lexer;
+    SqlParser parser;
+    auto ast = parser.parse(lexer.tokenize("SELECT tag, COUNT(*), avg(val) FROM t WHERE val > 0 GROUP BY tag, id ORDER BY tag DESC LIMIT 5"));
+    EXPECT_EQ(ast->group_by, (std::vector<std::string>{"tag", "id"}));
+    ASSERT_EQ(ast->aggregates.size(), 2u);
+    EXPECT_EQ(ast->aggregates[0].fn, "COUNT");
+    EXPECT_EQ(ast->aggregates[0].column, "*");
+    EXPECT_EQ(ast->aggregates[1].fn, "AVG");
+    EXPECT_EQ(ast->select_columns[2], "AVG(val)");
+    ASSERT_EQ(ast->order_by.size(), 1u);
+    EXPECT_FALSE(ast->order_by[0].second);
+    EXPECT_EQ(ast->limit, 5);
+}
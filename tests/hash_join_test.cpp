@@ -0,0 +1,87 @@
+#include "gtest/gtest.h"
+#include "hash_join.h"
+#include "predicate.h"
+#include "storage_layer.h"
+#include <algorithm>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+class HashJoinTest : public ::testing::Test {
+protected:
+    std::string temp_dir;
+
+    void SetUp() override {
+        temp_dir = (fs::temp_directory_path() / fs::path("hash_join_test_dir")).string();
+        fs::remove_all(temp_dir);
+    }
+
+    void TearDown() override {
+        fs::remove_all(temp_dir);
+    }
+
+    static std::vector<std::vector<std::string>> collect(HashJoin& join) {
+        std::vector<std::vector<std::string>> rows;
+        join.run([&](const HashJoin::Values& left, const HashJoin::Values& right) {
+            std::vector<std::string> row(left.begin(), left.end());
+            row.insert(row.end(), right.begin(), right.end());
+            rows.push_back(std::move(row));
+        });
+        std::sort(rows.begin(), rows.end());
+        return rows;
+    }
+};
+
+TEST_F(HashJoinTest, SpilledJoinMatchesInMemoryJoin) {
+    FileStorageLayer storage;
+    storage.open(temp_dir);
+    storage.create("users", {{"id", ColumnType::INT, INT_SIZE}, {"name", ColumnType::TEXT, 0}, {"group", ColumnType::TEXT, 0}});
+    storage.create("orders", {{"user_id", ColumnType::INT, INT_SIZE}, {"amount", ColumnType::INT, INT_SIZE}, {"owner", ColumnType::TEXT, 0}});
+    std::vector<std::vector<std::string>> users;
+    for (int i = 0; i < 2000; ++i) users.push_back({std::to_string(i), "user" + std::to_string(i), "g" + std::to_string(i % 3)});
+    storage.insert_batch("users", users);
+    std::vector<std::vector<std::string>> orders;
+    for (int i = 0; i < 5000; ++i) {
+        orders.push_back({std::to_string(i % 2500), std::to_string(i), "user" + std::to_string(i % 2500)});
+    }
+    storage.insert_batch("orders", orders);
+
+    // INT keys, with a filter on each side
+    std::vector<FilterClause> user_filter = {{2, "!=", "g1"}};
+    std::vector<FilterClause> order_filter = {{1, "<", "4000"}};
+    JoinInput left{"users", 0, {1}, std::make_shared<const PredicateProgram>(user_filter, storage.get_schema("users"))};
+    JoinInput right{"orders", 0, {1}, std::make_shared<const PredicateProgram>(order_filter, storage.get_schema("orders"))};
+
+    std::vector<std::vector<std::string>> expected;
+    for (int i = 0; i < 4000; ++i) {
+        int user = i % 2500;
+        if (user < 2000 && user % 3 != 1) expected.push_back({"user" + std::to_string(user), std::to_string(i)});
+    }
+    std::sort(expected.begin(), expected.end());
+
+    HashJoin in_memory(storage, left, right);
+    EXPECT_EQ(collect(in_memory), expected);
+    EXPECT_TRUE(in_memory.stats().build_left);
+    EXPECT_EQ(in_memory.stats().partitions, 0u);
+    EXPECT_EQ(in_memory.stats().build_rows, 1333u);
+
+    HashJoin spilled(storage, left, right, 4096);
+    EXPECT_EQ(collect(spilled), expected);
+    EXPECT_GT(spilled.stats().partitions, 0u);
+    EXPECT_GT(spilled.stats().spilled_bytes, 0u);
+
+    // TEXT keys, and an INT key joined against a TEXT column by its printed value
+    JoinInput by_name{"users", 1, {0}, nullptr};
+    JoinInput by_owner{"orders", 2, {1}, nullptr};
+    HashJoin text_join(storage, by_name, by_owner, 4096);
+    auto text_rows = collect(text_join);
+    EXPECT_EQ(text_rows.size(), 4000u);
+    for (const auto& row : text_rows) EXPECT_EQ(std::stoi(row[0]), std::stoi(row[1]) % 2500);
+
+    std::vector<FilterClause> first_user = {{0, "=", "7"}};
+    JoinInput key_as_text{"users", 0, {1}, std::make_shared<const PredicateProgram>(first_user, storage.get_schema("users"))};
+    JoinInput owner_as_key{"orders", 2, {1}, nullptr};
+    HashJoin mixed(storage, key_as_text, owner_as_key);
+    EXPECT_TRUE(collect(mixed).empty());
+    storage.close();
+}
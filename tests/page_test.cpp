@@ -0,0 +1,201 @@
+#include "gtest/gtest.h"
+#include "page.h"
+#include "pax_page.h"
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+std::vector<uint8_t> bytes_of(const std::string& text) {
+    return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+// Encoded (INT, TEXT, INT) tuple, as the PAX tests store
+std::vector<uint8_t> pax_tuple(int32_t a, const std::string& b, int32_t c) {
+    std::vector<uint8_t> tuple(sizeof(TupleHeader) + 3 * INT_SIZE + b.size());
+    TupleHeader header {};
+    header.field_count = 3;
+    header.offsets[0] = sizeof(TupleHeader);
+    header.offsets[1] = header.offsets[0] + INT_SIZE;
+    header.offsets[2] = header.offsets[1] + INT_SIZE + b.size();
+    const uint32_t length = b.size();
+    std::memcpy(tuple.data(), &header, sizeof(header));
+    std::memcpy(tuple.data() + header.offsets[0], &a, INT_SIZE);
+    std::memcpy(tuple.data() + header.offsets[1], &length, INT_SIZE);
+    std::memcpy(tuple.data() + header.offsets[1] + INT_SIZE, b.data(), b.size());
+    std::memcpy(tuple.data() + header.offsets[2], &c, INT_SIZE);
+    return tuple;
+}
+}
+
+TEST(PageTest, ImageIsThePageAndRoundTrips) {
+    Page page(7, 1024);
+    ASSERT_TRUE(page.insert_record(1024, bytes_of("first")).has_value());
+    ASSERT_TRUE(page.insert_record(1025, bytes_of("second")).has_value());
+    page.free_id_bitmap().set(0);
+    page.free_id_bitmap().set(1);
+    std::vector<uint8_t> image = page.serialize();
+    ASSERT_EQ(image.size(), PAGE_SIZE);
+    EXPECT_EQ(std::memcmp(image.data(), page.image(), PAGE_SIZE), 0);
+
+    Page loaded;
+    loaded.deserialize(image);
+    EXPECT_EQ(loaded.get_page_id(), 7u);
+    EXPECT_EQ(loaded.get_record(1025), bytes_of("second"));
+    EXPECT_EQ(loaded.first_free_id(), 1026u);
+    EXPECT_EQ(loaded.reclaimable_space(), page.reclaimable_space());
+    // Records grow down from the bitmap
+    EXPECT_EQ(loaded.find_record(1024)->offset + 5u, PAGE_BITMAP_OFFSET);
+}
+
+TEST(PageTest, DeletesCompactOnlyPastTheThreshold) {
+    Page page(1, 0);
+    const std::vector<uint8_t> record(200, 'r');
+    uint32_t id = 0;
+    while (page.insert_record(id, record).has_value()) ++id;
+    const size_t full = page.slot_count();
+    ASSERT_GT(full, 30u);
+
+    // A few deletes leave the dead records in place
+    page.delete_record(0);
+    page.delete_record(1);
+    EXPECT_EQ(page.slot_count(), full);
+    EXPECT_FALSE(page.has_record(0));
+
+    uint32_t deleted = 2;
+    while (page.slot_count() == full) page.delete_record(deleted++);
+    EXPECT_GT(deleted * (record.size() + sizeof(Slot)), PAGE_COMPACT_THRESHOLD);
+    EXPECT_EQ(page.slot_count(), full - deleted);
+    for (uint32_t i = deleted; i < id; ++i) ASSERT_EQ(page.get_record(i), record) << i;
+
+    // An insert that needs the room dead records hold compacts first
+    Page crowded(2, 0);
+    id = 0;
+    while (crowded.insert_record(id, record).has_value()) ++id;
+    crowded.delete_record(3);
+    EXPECT_TRUE(crowded.insert_record(3, record).has_value());
+    EXPECT_FALSE(crowded.insert_record(id, record).has_value());
+    for (uint32_t i = 0; i < id; ++i) ASSERT_EQ(crowded.get_record(i), record) << i;
+}
+
+TEST(PageTest, LegacyImagesAreConvertedOnLoad) {
+    // Legacy layout: slots right after the header, then records packed from the end of the slot array
+    std::vector<uint8_t> image(PAGE_SIZE, 0);
+    PageHeader header;
+    header.initialize(3);
+    header.flags = PAGE_DIRTY;
+    header.slot_count = 2;
+    header.free_space_offset = 9;
+    std::memcpy(image.data(), &header, sizeof(header));
+    Slot slots[2] = {{0, 4, SLOT_OCCUPIED, 3}, {4, 5, SLOT_OCCUPIED, 4}};
+    std::memcpy(image.data() + sizeof(PageHeader), slots, sizeof(slots));
+    std::memcpy(image.data() + sizeof(PageHeader) + sizeof(slots), "abcdvwxyz", 9);
+    EXPECT_FALSE(Page::is_in_place_image(image.data()));
+
+    Page page;
+    page.deserialize(image);
+    EXPECT_TRUE(Page::is_in_place_image(page.image()));
+    EXPECT_EQ(page.get_record(3), bytes_of("abcd"));
+    EXPECT_EQ(page.get_record(4), bytes_of("vwxyz"));
+    EXPECT_NO_THROW(Page::check_image(page.image()));
+}
+
+TEST(PageTest, PaxPageStoresTuplesColumnWise) {
+    // Two INT columns and a TEXT column
+    std::vector<ColumnSchema> columns = {{"a", ColumnType::INT, INT_SIZE}, {"b", ColumnType::TEXT, 0}, {"c", ColumnType::INT, INT_SIZE}};
+    Page page(3, 0);
+    page.format_pax(3, 0b010);
+    ASSERT_TRUE(page.is_pax());
+    // Long text forces the page to be laid out again as it fills
+    uint32_t id = 0;
+    while (page.insert_record(id, pax_tuple(id, std::string(id % 40, 'x'), -static_cast<int32_t>(id))).has_value()) ++id;
+    ASSERT_GT(id, 150u);
+    EXPECT_LT(page.reclaimable_space(), pax_row_overhead(3) + 40u);
+    EXPECT_EQ(page.get_record(17), pax_tuple(17, std::string(17, 'x'), -17));
+    // Wrong field count is refused rather than misread
+    EXPECT_FALSE(page.insert_record(id, bytes_of("not a tuple")).has_value());
+
+    ASSERT_TRUE(page.update_record(5, pax_tuple(50, "grown", 51)));
+    for (uint32_t i = 0; i < id; i += 2) ASSERT_TRUE(page.delete_record(i));
+    ASSERT_TRUE(page.update_record(5, pax_tuple(50, std::string(120, 'y'), 51)));
+
+    Page loaded;
+    loaded.deserialize(page.serialize());
+    ASSERT_TRUE(loaded.is_pax());
+    EXPECT_FALSE(loaded.has_record(4));
+    EXPECT_EQ(loaded.get_record(5), pax_tuple(50, std::string(120, 'y'), 51));
+    const uint32_t last_kept = (id - 1) % 2 == 1 ? id - 1 : id - 2;
+    const Slot* slot = loaded.find_record(last_kept);
+    ASSERT_NE(slot, nullptr);
+    RowView row = loaded.row_view(columns.data(), 3, *slot);
+    EXPECT_EQ(row.get_int(2), -static_cast<int32_t>(slot->record_id));
+    EXPECT_EQ(row.get_text(1), std::string(slot->record_id % 40, 'x'));
+    EXPECT_EQ(loaded.reclaimable_space(), page.reclaimable_space());
+}
+
+TEST(PageTest, PaxPageEncodesColumnsThatShrink) {
+    std::vector<ColumnSchema> columns = {{"a", ColumnType::INT, INT_SIZE}, {"b", ColumnType::TEXT, 0}, {"c", ColumnType::INT, INT_SIZE}};
+    const ColumnEncoding requested[] = {ColumnEncoding::FrameOfReference, ColumnEncoding::Dictionary, ColumnEncoding::RunLength};
+    // Values in a narrow range, four distinct labels and long runs
+    auto row = [](uint32_t id) {
+        return pax_tuple(1000 + id % 200, "label-" + std::to_string(id % 4), static_cast<int32_t>(id / 100));
+    };
+    Page plain(3, 0);
+    plain.format_pax(3, 0b010);
+    Page encoded(4, 0);
+    encoded.format_pax(3, 0b010, requested);
+    uint32_t plain_rows = 0;
+    while (plain.insert_record(plain_rows, row(plain_rows)).has_value()) ++plain_rows;
+    uint32_t rows = 0;
+    while (encoded.insert_record(rows, row(rows)).has_value()) ++rows;
+    EXPECT_GT(rows, plain_rows * 3 / 2);
+    const PaxHeader& pax = pax_header(encoded.image());
+    for (size_t c = 0; c < 3; ++c) EXPECT_EQ(pax.encodings[c], static_cast<uint8_t>(requested[c]));
+    for (uint32_t id = 0; id < rows; ++id) ASSERT_EQ(encoded.get_record(id), row(id));
+
+    // Values outside the page's frame, dictionary and runs lay the page out again
+    for (uint32_t id = 0; id < rows; id += 3) ASSERT_TRUE(encoded.delete_record(id));
+    ASSERT_TRUE(encoded.update_record(151, pax_tuple(-5000, "other", 999)));
+    ASSERT_TRUE(encoded.insert_record(rows, row(rows)).has_value());
+
+    Page loaded;
+    loaded.deserialize(encoded.serialize());
+    EXPECT_EQ(loaded.get_record(151), pax_tuple(-5000, "other", 999));
+    EXPECT_EQ(loaded.get_record(rows), row(rows));
+    EXPECT_FALSE(loaded.has_record(150));
+    RowView view = loaded.row_view(columns.data(), 3, *loaded.find_record(152));
+    EXPECT_EQ(view.get_int(0), 1152);
+    EXPECT_EQ(view.get_text(1), "label-0");
+    EXPECT_EQ(view.get_int(2), 1);
+
+    // The batch kernels decode what get_record does
+    std::vector<uint16_t> live;
+    for (size_t i = 0; i < loaded.slot_count(); ++i) {
+        if (loaded.slots()[i].is_occupied()) live.push_back(static_cast<uint16_t>(i));
+    }
+    std::vector<int32_t> values(live.size());
+    pax_gather_ints(loaded.image(), 2, live.data(), live.size(), values.data());
+    std::string_view entries[PAX_DICTIONARY_MAX];
+    ASSERT_EQ(pax_dictionary(loaded.image(), 1, entries), 5u);
+    std::vector<uint8_t> codes(live.size());
+    pax_gather_codes(loaded.image(), 1, live.data(), live.size(), codes.data());
+    for (size_t i = 0; i < live.size(); ++i) {
+        const uint32_t id = loaded.slots()[live[i]].record_id;
+        const std::vector<uint8_t> expected = id == 151 ? pax_tuple(-5000, "other", 999) : row(id);
+        RowView original(columns.data(), 3, expected.data(), expected.size(), id);
+        ASSERT_EQ(values[i], original.get_int(2));
+        ASSERT_EQ(entries[codes[i]], original.get_text(1));
+    }
+
+    // AUTO keeps a column plain where no encoding is smaller
+    const ColumnEncoding automatic[] = {ColumnEncoding::Auto, ColumnEncoding::Auto, ColumnEncoding::Auto};
+    Page mixed(5, 0);
+    mixed.format_pax(3, 0b010, automatic);
+    uint32_t id = 0;
+    while (mixed.insert_record(id, pax_tuple(static_cast<int32_t>(id * 2654435761u), std::to_string(id), 7)).has_value()) ++id;
+    const PaxHeader& mixed_pax = pax_header(mixed.image());
+    EXPECT_EQ(mixed_pax.encodings[0], static_cast<uint8_t>(ColumnEncoding::Plain));
+    EXPECT_EQ(mixed_pax.encodings[1], static_cast<uint8_t>(ColumnEncoding::Plain));
+    EXPECT_EQ(mixed_pax.encodings[2], static_cast<uint8_t>(ColumnEncoding::RunLength));
+    EXPECT_EQ(mixed.get_record(id - 1), pax_tuple(static_cast<int32_t>((id - 1) * 2654435761u), std::to_string(id - 1), 7));
+}
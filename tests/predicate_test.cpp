@@ -0,0 +1,62 @@
+#include "gtest/gtest.h"
+#include "predicate.h"
+#include "storage_layer.h"
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+class PredicateProgramTest : public ::testing::Test {
+protected:
+    std::string temp_dir;
+    FileStorageLayer storage;
+    std::vector<ColumnSchema> schema = {{"id", ColumnType::INT, INT_SIZE}, {"name", ColumnType::TEXT, 0}, {"code", ColumnType::TEXT, 0}};
+
+    void SetUp() override {
+        temp_dir = (fs::temp_directory_path() / fs::path("predicate_test_dir")).string();
+        fs::remove_all(temp_dir);
+        storage.open(temp_dir);
+        storage.create("t", schema);
+        for (int i = -20; i < 80; ++i) {
+            storage.insert("t", {std::to_string(i), "n" + std::to_string(i % 4), std::to_string(i * 3)});
+        }
+    }
+
+    void TearDown() override {
+        storage.close();
+        fs::remove_all(temp_dir);
+    }
+
+    // Rows matched in place, checked against the same program run on the text rows
+    size_t count_matches(const std::vector<FilterClause>& clauses) {
+        PredicateProgram program(clauses, schema);
+        ScanSpec spec;
+        spec.row_filter = [&](const RowView& row) { return program.matches(row); };
+        auto in_place = storage.scan("t", spec);
+        std::vector<std::vector<std::string>> as_text;
+        for (auto& row : storage.scan("t")) {
+            if (program.matches(row)) as_text.push_back(row);
+        }
+        EXPECT_EQ(in_place, as_text);
+        return in_place.size();
+    }
+};
+
+TEST_F(PredicateProgramTest, EncodedAndTextRowsAgree) {
+    EXPECT_EQ(count_matches({{0, ">", "9"}, {0, "<=", "20"}}), 11u);
+    EXPECT_EQ(count_matches({{0, "!=", "5"}, {1, "=", "n1"}}), 19u);
+    EXPECT_EQ(count_matches({{2, ">=", "150"}}), 30u);
+    EXPECT_EQ(count_matches({{1, "!=", "n0"}, {0, "<", "0"}}), 15u);
+    // An INT only equals a literal that prints the same way
+    EXPECT_EQ(count_matches({{0, "=", "07"}}), 0u);
+    EXPECT_EQ(count_matches({{0, "!=", "07"}}), 100u);
+    EXPECT_EQ(count_matches({{0, "LIKE", "7"}}), 0u);
+}
+
+TEST_F(PredicateProgramTest, LiteralsAreParsedOnce) {
+    EXPECT_THROW(PredicateProgram({{0, ">", "abc"}}, schema), std::invalid_argument);
+    PredicateProgram never({{0, "=", "+7"}, {1, "=", "n3"}}, schema);
+    EXPECT_TRUE(never.always_false());
+    PredicateProgram program({{2, ">", "3"}, {1, "=", "n1"}, {0, "<", "50"}}, schema);
+    EXPECT_FALSE(program.always_false());
+    EXPECT_EQ(program.size(), 3u);
+}
@@ -0,0 +1,28 @@
+#include "gtest/gtest.h"
+#include "query_arena.h"
+#include <cstdint>
+#include <string>
+
+TEST(QueryArenaTest, ResetReusesBlocks) {
+    QueryArena arena(256);
+    std::string_view text = arena.copy("hello");
+    std::string_view number = arena.print(-2147483648LL);
+    EXPECT_EQ(text, "hello");
+    EXPECT_EQ(number, "-2147483648");
+    auto* aligned = arena.allocate(24, 16);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(aligned) % 16, 0u);
+    EXPECT_EQ(arena.blocks(), 1u);
+
+    // Growing past the first block adds larger ones; after a reset the same work needs no new block
+    for (int i = 0; i < 1000; ++i) arena.print(i);
+    const size_t grown = arena.blocks();
+    EXPECT_GT(grown, 1u);
+    for (int round = 0; round < 3; ++round) {
+        arena.reset();
+        for (int i = 0; i < 1000; ++i) ASSERT_EQ(arena.print(i), std::to_string(i));
+    }
+    EXPECT_EQ(arena.blocks(), grown);
+
+    std::string big(1000, 'b');
+    EXPECT_EQ(arena.copy(big), big);
+}
@@ -1,7 +1,13 @@
 #include "gtest/gtest.h"
+#include "sql_executor.h"
+#include "sql_lexer.h"
+#include "sql_parser.h"
 #include "storage_layer.h"
 #include <filesystem>
 #include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
 #include <vector>
 #include <string>
 #include <sstream>
@@ -89,4 +95,180 @@ TEST_F(SqlCliTest, SelectProjectionAndWhere) {
     EXPECT_EQ(rows[0][0], "Dog");
 }
 
-// Add more tests for error handling, SELECT *, and edge cases as needed. 
\ No newline at end of file
+// Add more tests for error handling, SELECT *, and edge cases as needed. 
+
+TEST_F(SqlCliTest, DeleteAndUpdateStatementsRunAsPlans) {
+    std::vector<ColumnSchema> schema = {
+        {"name", ColumnType::TEXT, 0},
+        {"age", ColumnType::INT, INT_SIZE}
+    };
+    storage.create("pets", schema);
+    auto ids = storage.insert_batch("pets", {{"Dog", "5"}, {"Cat", "3"}, {"Fish", "1"}, {"Bird", "2"}});
+    storage.delete_record("pets", ids[0]);
+    SqlLexer lexer;
+    SqlParser parser;
+    SqlExecutor executor;
+    auto run = [&](const std::string& sql) { executor.execute(*parser.parse(lexer.tokenize(sql)), storage); };
+
+    auto update = parser.parse(lexer.tokenize("UPDATE pets SET age = -7, name = 'Puss' WHERE name = 'Cat'"));
+    EXPECT_EQ(update->type, SqlAstType::Update);
+    ASSERT_EQ(update->assignments.size(), 2u);
+    EXPECT_EQ(update->assignments[0].val, "-7");
+    run("UPDATE pets SET age = -7, name = 'Puss' WHERE name = 'Cat'");
+    // Rows are found by their values, not by their position in a scan
+    run("DELETE FROM pets WHERE age = 1");
+    auto rows = storage.scan("pets");
+    ASSERT_EQ(rows.size(), 2u);
+    EXPECT_EQ(rows[0], (std::vector<std::string>{"Puss", "-7"}));
+    EXPECT_EQ(rows[1], (std::vector<std::string>{"Bird", "2"}));
+    run("DELETE FROM pets");
+    EXPECT_TRUE(storage.scan("pets").empty());
+}
+
+TEST_F(SqlCliTest, PreparedStatementsBindParametersAndReuseCachedPlans) {
+    std::vector<ColumnSchema> schema = {
+        {"name", ColumnType::TEXT, 0},
+        {"age", ColumnType::INT, INT_SIZE}
+    };
+    storage.create("pets", schema);
+    storage.insert_batch("pets", {{"Dog", "5"}, {"Cat", "3"}, {"Fish", "1"}, {"Bird", "2"}});
+    SqlExecutor executor;
+    auto output = [&](PreparedStatement& statement) {
+        std::ostringstream out;
+        std::streambuf* saved = std::cout.rdbuf(out.rdbuf());
+        executor.execute(statement, storage);
+        std::cout.rdbuf(saved);
+        return out.str();
+    };
+
+    PreparedStatement select = executor.prepare("SELECT name FROM pets WHERE age > ? AND age < ? ORDER BY age", storage);
+    ASSERT_EQ(select.param_count(), 2u);
+    EXPECT_THROW(executor.execute(select, storage), std::runtime_error);
+    EXPECT_THROW(select.bind(2, "0"), std::out_of_range);
+    select.bind(0, "1");
+    select.bind(1, "5");
+    EXPECT_EQ(output(select), "name\nBird\nCat\n");
+    select.bind(0, "-10");
+    EXPECT_EQ(output(select), "name\nFish\nBird\nCat\n");
+
+    // The same text, whitespace aside, is planned once
+    PreparedStatement again = executor.prepare("SELECT  name FROM pets\tWHERE age > ? AND age < ? ORDER BY age;", storage);
+    EXPECT_EQ(executor.plan_cache_stats().hits, 1u);
+    EXPECT_EQ(executor.plan_cache_stats().misses, 1u);
+    EXPECT_EQ(executor.cached_plans(), 1u);
+
+    PreparedStatement update = executor.prepare("UPDATE pets SET age = ? WHERE name = ?", storage);
+    update.bind(0, "-4");
+    update.bind(1, "Cat");
+    output(update);
+    update.bind(0, "x");
+    EXPECT_THROW(executor.execute(update, storage), std::runtime_error);
+
+    // A new index moves the schema on, so plans are made again and can use it
+    storage.create_index("pets", "age");
+    executor.prepare("SELECT  name FROM pets WHERE age > ? AND age < ? ORDER BY age", storage);
+    EXPECT_EQ(executor.plan_cache_stats().misses, 3u);
+    again.bind(0, "-5");
+    again.bind(1, "0");
+    EXPECT_EQ(output(again), "name\nCat\n");
+    PreparedStatement remove = executor.prepare("DELETE FROM pets WHERE age <= ?", storage);
+    remove.bind(0, "1");
+    EXPECT_EQ(output(remove), "Deleted 2 record(s) from pets\n");
+    EXPECT_EQ(storage.scan("pets").size(), 2u);
+}
+
+TEST_F(SqlCliTest, ExplainAnalyzeReportsOperatorsInsteadOfRows) {
+    std::vector<ColumnSchema> schema = {
+        {"name", ColumnType::TEXT, 0},
+        {"age", ColumnType::INT, INT_SIZE}
+    };
+    storage.create("pets", schema);
+    storage.insert_batch("pets", {{"Dog", "5"}, {"Cat", "3"}, {"Fish", "1"}, {"Bird", "2"}});
+    SqlExecutor executor;
+    auto output = [&](const std::string& sql) {
+        std::ostringstream out;
+        std::streambuf* saved = std::cout.rdbuf(out.rdbuf());
+        PreparedStatement statement = executor.prepare(sql, storage);
+        executor.execute(statement, storage);
+        std::cout.rdbuf(saved);
+        return out.str();
+    };
+
+    std::string report = output("EXPLAIN ANALYZE SELECT name FROM pets WHERE age > 1 ORDER BY age LIMIT 2");
+    EXPECT_NE(report.find("Seq scan on pets with filter: rows scanned=4 rows out=2"), std::string::npos) << report;
+    EXPECT_NE(report.find("Top-N sort by age ASC: rows out=2"), std::string::npos) << report;
+    EXPECT_NE(report.find("Rows: 2\n"), std::string::npos) << report;
+    EXPECT_NE(report.find("Execution time: "), std::string::npos) << report;
+    EXPECT_EQ(report.find("Bird"), std::string::npos) << report;
+
+    report = output("EXPLAIN ANALYZE SELECT COUNT(*) FROM pets");
+    EXPECT_NE(report.find("groups=1"), std::string::npos) << report;
+
+    // The statement still runs
+    report = output("EXPLAIN ANALYZE DELETE FROM pets WHERE age = 3");
+    EXPECT_NE(report.find("Delete via Seq scan on pets with filter: rows=1"), std::string::npos) << report;
+    EXPECT_EQ(storage.row_count("pets"), 3u);
+}
+
+// Drives the sql_cli binary itself, whose INSERT splits values on its own rather than through the lexer
+TEST_F(SqlCliTest, CliInsertedTextMatchesQuotedLiterals) {
+#ifndef SQL_CLI_PATH
+    GTEST_SKIP() << "Built without the path of sql_cli";
+#else
+    const std::string db_dir = temp_dir + "_cli";
+    const std::string script = temp_dir + "_cli.sql";
+    fs::remove_all(db_dir);
+    {
+        std::ofstream in(script);
+        in << db_dir << "\n"
+           << "CREATE TABLE t (id INT, name TEXT)\n"
+           << "INSERT INTO t VALUES (1, 'a'), (2, 'b'), (3, \"c, d\"), (4, 'b')\n"
+           << "DELETE FROM t WHERE name = 'b'\n"
+           << "UPDATE t SET name = 'zz' WHERE name = 'a'\n"
+           << "exit\n";
+    }
+    const std::string command = std::string("\"") + SQL_CLI_PATH + "\" < \"" + script + "\" > /dev/null";
+    ASSERT_EQ(std::system(command.c_str()), 0);
+
+    FileStorageLayer cli_storage;
+    cli_storage.open(db_dir);
+    EXPECT_EQ(cli_storage.scan("t"), (std::vector<std::vector<std::string>>{{"1", "zz"}, {"3", "c, d"}}));
+    cli_storage.close();
+    fs::remove_all(db_dir);
+    fs::remove(script);
+#endif
+}
+
+// INSERT stores a quoted literal as the text between the quotes, the same value WHERE and SET compare with
+TEST_F(SqlCliTest, CliInsertStoresQuotedTextWithoutQuotes) {
+#ifndef SQL_CLI_PATH
+    GTEST_SKIP() << "Built without the path of sql_cli";
+#else
+    const std::string db_dir = temp_dir + "_cli";
+    const std::string script = temp_dir + "_cli.sql";
+    const std::string output = temp_dir + "_cli.out";
+    fs::remove_all(db_dir);
+    {
+        std::ofstream in(script);
+        in << db_dir << "\n"
+           << "CREATE TABLE t (id INT, name TEXT)\n"
+           << "INSERT INTO t VALUES (1, 'Dog'), (2, \"it's\"), (3, Cat), (4, '')\n"
+           << "SELECT name FROM t WHERE id = 2\n"
+           << "exit\n";
+    }
+    const std::string command = std::string("\"") + SQL_CLI_PATH + "\" < \"" + script + "\" > \"" + output + "\"";
+    ASSERT_EQ(std::system(command.c_str()), 0);
+    std::ifstream out(output);
+    const std::string printed((std::istreambuf_iterator<char>(out)), std::istreambuf_iterator<char>());
+    EXPECT_NE(printed.find("name\nit's\n"), std::string::npos);
+
+    FileStorageLayer cli_storage;
+    cli_storage.open(db_dir);
+    EXPECT_EQ(cli_storage.scan("t"),
+        (std::vector<std::vector<std::string>>{{"1", "Dog"}, {"2", "it's"}, {"3", "Cat"}, {"4", ""}}));
+    cli_storage.close();
+    fs::remove_all(db_dir);
+    fs::remove(script);
+    fs::remove(output);
+#endif
+}
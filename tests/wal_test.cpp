@@ -0,0 +1,215 @@
+#include "gtest/gtest.h"
+#include "storage_layer.h"
+#include "wal.h"
+#include <algorithm>
+#include <filesystem>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+class WalTest : public ::testing::Test {
+protected:
+    std::string temp_dir;
+
+    void SetUp() override {
+        temp_dir = (fs::temp_directory_path() / fs::path("wal_test_dir")).string();
+        fs::remove_all(temp_dir);
+        fs::create_directory(temp_dir);
+    }
+
+    void TearDown() override {
+        fs::remove_all(temp_dir);
+    }
+
+    std::string log_path() const { return (fs::path(temp_dir) / WAL_FILE_NAME).string(); }
+};
+
+TEST_F(WalTest, RecoverKeepsOnlyCommittedRecords) {
+    {
+        WriteAheadLog wal(log_path());
+        wal.recover();
+        uint32_t arg = 42;
+        wal.append(WalRecordType::Insert, 3, &arg, sizeof(arg), "abc", 3);
+        wal.flush(wal.append(WalRecordType::Commit, INVALID_PAGE_ID, nullptr, 0));
+        // Durable but never committed
+        wal.flush(wal.append(WalRecordType::Delete, 3, &arg, sizeof(arg)));
+    }
+    WriteAheadLog wal(log_path());
+    auto records = wal.recover();
+    ASSERT_EQ(records.size(), 2u);
+    EXPECT_EQ(records[0].type, WalRecordType::Insert);
+    EXPECT_EQ(records[0].page_id, 3u);
+    EXPECT_EQ(records[0].payload.size(), sizeof(uint32_t) + 3);
+    EXPECT_EQ(records[1].type, WalRecordType::Commit);
+    EXPECT_EQ(wal.last_lsn(), 2u);
+    EXPECT_EQ(wal.append(WalRecordType::Commit, INVALID_PAGE_ID, nullptr, 0), 3u);
+}
+
+TEST_F(WalTest, RecoverCanKeepTheUncommittedTail) {
+    uint32_t arg = 42;
+    {
+        WriteAheadLog wal(log_path());
+        wal.recover();
+        wal.append(WalRecordType::Insert, 3, &arg, sizeof(arg), "abc", 3);
+        wal.flush(wal.append_commit());
+        wal.flush(wal.append(WalRecordType::Delete, 3, &arg, sizeof(arg), "abc", 3));
+    }
+    WriteAheadLog wal(log_path());
+    std::vector<WalRecord> uncommitted;
+    EXPECT_EQ(wal.recover(&uncommitted).size(), 2u);
+    ASSERT_EQ(uncommitted.size(), 1u);
+    EXPECT_EQ(uncommitted[0].type, WalRecordType::Delete);
+    EXPECT_EQ(uncommitted[0].lsn, 3u);
+    EXPECT_EQ(wal.durable_lsn(), 3u);
+    // The tail needs a commit record of its own; a second request reuses it
+    EXPECT_EQ(wal.append_commit(), 4u);
+    EXPECT_EQ(wal.append_commit(), 4u);
+}
+
+TEST_F(WalTest, TornTailIsDiscarded) {
+    {
+        WriteAheadLog wal(log_path());
+        wal.recover();
+        wal.flush(wal.append(WalRecordType::Commit, INVALID_PAGE_ID, nullptr, 0));
+        wal.flush(wal.append(WalRecordType::Commit, INVALID_PAGE_ID, nullptr, 0));
+    }
+    fs::resize_file(log_path(), fs::file_size(log_path()) - 1);
+    WriteAheadLog wal(log_path());
+    EXPECT_EQ(wal.recover().size(), 1u);
+    EXPECT_EQ(wal.durable_lsn(), 1u);
+}
+
+TEST_F(WalTest, TruncateKeepsLsnsIncreasing) {
+    {
+        WriteAheadLog wal(log_path());
+        wal.recover();
+        wal.flush(wal.append(WalRecordType::Commit, INVALID_PAGE_ID, nullptr, 0));
+        wal.truncate();
+        EXPECT_EQ(wal.start_lsn(), 2u);
+    }
+    WriteAheadLog wal(log_path());
+    EXPECT_TRUE(wal.recover().empty());
+    EXPECT_EQ(wal.append(WalRecordType::Commit, INVALID_PAGE_ID, nullptr, 0), 2u);
+}
+
+TEST_F(WalTest, ConcurrentCommitsShareSyncs) {
+    WriteAheadLog wal(log_path(), std::chrono::microseconds(2000));
+    wal.recover();
+    constexpr int THREADS = 8;
+    constexpr int COMMITS = 20;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; ++t) {
+        threads.emplace_back([&wal] {
+            for (int i = 0; i < COMMITS; ++i) {
+                wal.flush(wal.append(WalRecordType::Commit, INVALID_PAGE_ID, nullptr, 0));
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    WalStats stats = wal.stats();
+    EXPECT_EQ(stats.commits, static_cast<uint64_t>(THREADS * COMMITS));
+    EXPECT_LT(stats.syncs, stats.commits);
+    EXPECT_EQ(wal.durable_lsn(), static_cast<uint32_t>(THREADS * COMMITS));
+}
+
+// Copying the directory of a live instance captures exactly what a crash would leave behind
+TEST_F(WalTest, CommittedChangesSurviveACrash) {
+    std::string crash_dir = temp_dir + "_crash";
+    fs::remove_all(crash_dir);
+    StorageOptions options;
+    options.buffer_pool_frames = 4;
+    std::vector<uint32_t> ids;
+    {
+        FileStorageLayer storage(options);
+        storage.open(temp_dir);
+        storage.create("t", {{"id", ColumnType::INT, INT_SIZE}, {"name", ColumnType::TEXT, 0}});
+        std::vector<std::vector<std::string>> rows;
+        for (int i = 0; i < 3000; ++i) {
+            rows.push_back({std::to_string(i), "name" + std::to_string(i)});
+        }
+        ids = storage.insert_batch("t", rows);
+        storage.update("t", ids[10], {"-10", "updated"});
+        storage.delete_record("t", ids[20]);
+        storage.commit();
+        storage.insert("t", {"9999", "uncommitted"});
+        fs::copy(temp_dir, crash_dir, fs::copy_options::recursive);
+        EXPECT_GT(storage.wal_stats().syncs, 0u);
+    }
+
+    FileStorageLayer recovered(options);
+    recovered.open(crash_dir);
+    EXPECT_EQ(recovered.get("t", ids[10])[1], "updated");
+    EXPECT_EQ(recovered.get("t", ids[2999])[1], "name2999");
+    EXPECT_THROW(recovered.get("t", ids[20]), std::runtime_error);
+    EXPECT_EQ(recovered.scan("t").size(), 2999u);
+    recovered.insert("t", {"1", "after"});
+    recovered.close();
+    recovered.open(crash_dir);
+    EXPECT_EQ(recovered.scan("t").size(), 3000u);
+    recovered.close();
+    fs::remove_all(crash_dir);
+}
+
+TEST_F(WalTest, UncommittedChangesWrittenByEvictionAreRolledBack) {
+    std::string crash_dir = temp_dir + "_crash";
+    fs::remove_all(crash_dir);
+    StorageOptions options;
+    options.buffer_pool_frames = 4;
+    std::vector<uint32_t> ids;
+    std::vector<std::vector<std::string>> committed;
+    {
+        FileStorageLayer storage(options);
+        storage.open(temp_dir);
+        storage.create("t", {{"id", ColumnType::INT, INT_SIZE}, {"name", ColumnType::TEXT, 0}});
+        std::vector<std::vector<std::string>> rows;
+        for (int i = 0; i < 2000; ++i) {
+            rows.push_back({std::to_string(i), "name" + std::to_string(i)});
+        }
+        ids = storage.insert_batch("t", rows);
+        storage.commit();
+        committed = storage.scan("t");
+        // Far more pages than frames change, so eviction writes them before any commit
+        for (size_t i = 0; i < ids.size(); i += 3) {
+            storage.update("t", ids[i], {"-1", "n"});
+        }
+        for (size_t i = 1; i < ids.size(); i += 3) {
+            storage.delete_record("t", ids[i]);
+        }
+        storage.insert_batch("t", rows);
+        EXPECT_GT(storage.buffer_pool_stats().dirty_writebacks, 0u);
+        fs::copy(temp_dir, crash_dir, fs::copy_options::recursive);
+    }
+
+    FileStorageLayer recovered(options);
+    recovered.open(crash_dir);
+    // Rows put back take new slots, so they may scan in another order
+    auto rows = recovered.scan("t");
+    std::sort(rows.begin(), rows.end());
+    std::sort(committed.begin(), committed.end());
+    EXPECT_EQ(rows, committed);
+    EXPECT_EQ(recovered.get("t", ids[1])[1], "name1");
+    recovered.insert("t", {"1", "after"});
+    recovered.close();
+    recovered.open(crash_dir);
+    EXPECT_EQ(recovered.scan("t").size(), committed.size() + 1);
+    recovered.close();
+    fs::remove_all(crash_dir);
+}
+
+TEST_F(WalTest, CommitAppendsWithoutRewritingPages) {
+    FileStorageLayer storage;
+    storage.open(temp_dir);
+    storage.create("t", {{"id", ColumnType::INT, INT_SIZE}});
+    // The table's page is on disk already, so background writes only overwrite it in place
+    storage.flush();
+    auto segment_size = fs::file_size(fs::path(temp_dir) / SEGMENT_FILE_NAME);
+    for (int i = 0; i < 50; ++i) {
+        storage.insert("t", {std::to_string(i)});
+        storage.commit();
+    }
+    EXPECT_EQ(fs::file_size(fs::path(temp_dir) / SEGMENT_FILE_NAME), segment_size);
+    EXPECT_GT(fs::file_size(log_path()), sizeof(WalFileHeader));
+    storage.flush();
+    EXPECT_EQ(fs::file_size(log_path()), sizeof(WalFileHeader));
+    storage.close();
+}